@@ -20,7 +20,6 @@ namespace filesystem = std::filesystem;
 
 #include <jni.h>
 #include <tbb/concurrent_vector.h>
-#include <tbb/concurrent_priority_queue.h>
 #include <mar/util/util.hh>
 
 #include "tbb/mutex.h"
@@ -31,6 +30,8 @@ namespace filesystem = std::filesystem;
 #include "mar/acquisition/Camera.h"
 #include "mar/acquisition/FrameInfo.h"
 #include "RunningStatistics.hh"
+#include "mar/util/ShardedStatistics.hh"
+#include "mar/util/LatestValue.hh"
 #include "mar/Structures.h"
 
 namespace toMAR
@@ -47,9 +48,18 @@ namespace toMAR
       Repository& operator=(Repository &&) = delete;
 
       void set_native_window(ANativeWindow* nwin) {  }
-      bool add_camera(std::string camera_id, int qsize, bool isRearFacing);
+      //! handle (if not null) receives the camera's index in the handle table, also when it was previously added
+      bool add_camera(std::string camera_id, int qsize, bool isRearFacing, int* handle =nullptr);
       bool hardware_camera_interface(unsigned long camera, std::shared_ptr<Camera>& sptr);
       Camera* hardware_camera_interface_ptr(const unsigned long camera);
+      //! Constant time lookup for per frame calls (eg JNI enqueue) using the handle returned by add_camera.
+      Camera* camera(const int handle)
+      {
+         return ( (handle >= 0) && (handle < MAX_CAMERAS) ) ? cameraHandles[handle].load(std::memory_order_acquire)
+                                                            : nullptr;
+      }
+      int camera_handle(const unsigned long camera);
+      static constexpr int MAX_CAMERAS = 16;
       std::vector<std::shared_ptr<Camera>> rear_cameras();
       std::vector<std::shared_ptr<Camera>> front_cameras();
       std::vector<std::shared_ptr<Camera>> all_cameras();
@@ -57,6 +67,15 @@ namespace toMAR
       uint64_t new_frame(const unsigned long camera, std::shared_ptr<FrameInfo>& frame);
       uint64_t new_stereo_frame(const unsigned long camera1, std::shared_ptr<FrameInfo>& frame1,
                                 const unsigned long camera2, std::shared_ptr<FrameInfo>& frame2);
+      //! Enqueues both frames of a stereo pair or neither (counted in stereo.dropped_pairs), see FrameInfo::pairKey.
+      bool enqueue_stereo(Camera* camera1, FrameInfo* frame1, Camera* camera2, FrameInfo* frame2);
+      /**
+       * False if the frames were submitted as parts of different stereo pairs or either is not in the repository.
+       * Only frames submitted together (enqueue_stereo, ie MAR.enqueueBatch) carry a pair key, frames enqueued one
+       * at a time (pairKey 0 on both sides) always match.
+       */
+      bool is_submitted_pair(const unsigned long camera1, const uint64_t seq1,
+                             const unsigned long camera2, const uint64_t seq2);
       void stereo_pair(const unsigned long camera1, const uint64_t seq1,
                        const unsigned long camera2, const uint64_t seq2);
       bool delete_stereo_pair(const unsigned long camera1, const uint64_t seq1);
@@ -65,6 +84,8 @@ namespace toMAR
       bool get_frame(const unsigned long camera, uint64_t seqno, std::shared_ptr<FrameInfo>& frame);
       bool has_frame(uint64_t seqno);
       bool has_frame(const unsigned long camera, uint64_t seqno);
+      //! Frames of camera between insertion (new_frame) and deletion, ie in flight through the flow graph.
+      size_t frames_in_flight(const unsigned long camera);
       void delete_all_frames(uint64_t seqno);
       void delete_frame(const unsigned long camera, const uint64_t seqno);
 //      bool is_calibrating() { return isCalibrating; }
@@ -73,29 +94,34 @@ namespace toMAR
 //      bool set_is_rendering(unsigned long cameraId, bool setTo);
 //      tbb::concurrent_unordered_map<unsigned long, std::unique_ptr<std::atomic_bool>> rendererBusyFlags;
       std::atomic_bool is_rendering{false};
+      // Set by a renderer which uploads the camera image as YUV textures, camera sources then attach an NV12 copy
+      // (FrameInfo::nativeYuv) to each frame.
+      std::atomic_bool isYUVRendering{false};
       tbb::concurrent_unordered_map<unsigned long, std::atomic_uint64_t*> seqNumbers;
       tbb::concurrent_hash_map<size_t , std::pair<unsigned long, uint64_t>> stereoFrames;
       AAssetManager* pAssetManager = nullptr;
-      tbb::concurrent_unordered_map<unsigned long, RunningStatistics<uint64_t, long double>*>
+      std::string cacheDir; // App private cache directory (eg Vulkan pipeline cache)
+      // Per thread sharded so detector/renderer nodes can record concurrently, combine with combined() to read.
+      tbb::concurrent_unordered_map<unsigned long, util::ShardedStatistics<uint64_t, long double>*>
          detectorStatistics;
-      RunningStatistics<uint64_t, long double>* detectionStats(const unsigned long camera,
-                                                               bool isCreate=true);
+      util::ShardedStatistics<uint64_t, long double>* detectionStats(const unsigned long camera,
+                                                                     bool isCreate=true);
       void clear_detector_stats(const unsigned long camera);
-      tbb::concurrent_unordered_map<unsigned long, RunningStatistics<uint64_t, long double>*>
+      tbb::concurrent_unordered_map<unsigned long, util::ShardedStatistics<uint64_t, long double>*>
             renderStatistics;
-      RunningStatistics<uint64_t, long double>* rendererStats(const unsigned long camera,
-                                                              bool isCreate=true);
+      util::ShardedStatistics<uint64_t, long double>* rendererStats(const unsigned long camera,
+                                                                    bool isCreate=true);
       void clear_render_stats(const unsigned long camera);
 
-      tbb::concurrent_hash_map<uint64_t, std::vector<DetectedBoundingBox*>> aprilTags;
-      tbb::concurrent_priority_queue<uint64_t, UInt64DescComparator> recentAprilTags;
-//      tbb::concurrent_priority_queue<std::vector<DetectedBoundingBox*>> recentAprilTags;
-      tbb::concurrent_hash_map<uint64_t, DetectedBoundingBox*> faceDetections;
-      tbb::concurrent_priority_queue<uint64_t, UInt64DescComparator> recentFaceDetections;
-      tbb::concurrent_hash_map<uint64_t, DetectedROI*> faceOverlays;
-//      tbb::concurrent_priority_queue<uint64_t, UInt64DescComparator> recentFaceOverlays;
-      std::atomic_uint64_t lastFaceOverlay{0};
-      std::atomic_uint64_t currentRenderOverlay{1};
+      using DetectionChannel = util::LatestValue<std::vector<DetectedBoundingBox>>;
+      //! Latest bounding boxes (AprilTags or face) detected on camera's frames, nullptr if camera has no handle.
+      DetectionChannel* detections(const unsigned long camera)
+      {
+         const int handle = camera_handle(camera);
+         return (handle >= 0) ? &detectionChannels[handle] : nullptr;
+      }
+      // Latest front camera face, drawn over the rear camera frames (FaceRenderType::OVERLAY)
+      util::LatestValue<DetectedROI> faceOverlay;
 
       void javaVM(JavaVM *pvm);
       JavaVM* javaVM();
@@ -108,11 +134,17 @@ namespace toMAR
 
    private:
       tbb::concurrent_unordered_map<unsigned long, std::shared_ptr<Camera>> cameras;
+      // Cameras are never removed from cameras so the raw pointers stay valid.
+      std::atomic<Camera*> cameraHandles[MAX_CAMERAS] = {};
+      std::atomic_int noCameraHandles{0};
       tbb::concurrent_hash_map<unsigned long,
                       tbb::concurrent_hash_map<uint64_t, std::shared_ptr<FrameInfo>>*> camera_frames;
+      DetectionChannel detectionChannels[MAX_CAMERAS];
       JavaVM* vm;
 
 
+      int add_handle(Camera* camera);
+
       Repository() = default;
       ~Repository();
    };
@@ -35,6 +35,9 @@ Requires C++14 for multithreaded version which uses reader-writer locks.
 //#define _RUNNING_STATISTICS_MT_
 
 #include <cmath>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
 #ifdef _RUNNING_STATISTICS_MT_
 #include <thread>
 #include <mutex>
@@ -61,6 +64,15 @@ public:
 
    void operator()(const Real x)
    //-----------------------------
+   {
+      struct timespec tme;
+      clock_gettime(CLOCK_MONOTONIC, &tme);
+      (*this)(x, tme.tv_sec * 1000000000L + tme.tv_nsec);
+   }
+
+   // Add a sample observed at time ns (CLOCK_MONOTONIC nanoseconds) for callers that already have a timestamp
+   void operator()(const Real x, const int64_t ns)
+   //---------------------------------------------
    {
 #ifdef _RUNNING_STATISTICS_MT_
       std::unique_lock<std::shared_timed_mutex> lock(mutex);
@@ -76,9 +88,6 @@ public:
       M4 += term1 * delta_n2 * (n*n - 3*n + 3) + 6 * delta_n2 * M2 - 4 * delta_n * M3;
       M3 += term1 * delta_n * (n - 2) - 3 * delta_n * M2;
       M2 += term1;
-      struct timespec tme;
-      clock_gettime(CLOCK_MONOTONIC, &tme);
-      const int64_t ns = tme.tv_sec * 1000000000L + tme.tv_nsec;
       if (startTime <= 0) startTime = ns;
       endTime = ns;         
    }
@@ -89,8 +98,12 @@ public:
 #ifdef _RUNNING_STATISTICS_MT_
       std::unique_lock<std::shared_timed_mutex> lock(mutex);
 #endif
+      if (a.n == 0) return b;
+      if (b.n == 0) return a;
       RunningStatistics combined;
       combined.n = a.n + b.n;
+      combined.startTime = std::min(a.startTime, b.startTime);
+      combined.endTime = std::max(a.endTime, b.endTime);
 
       Real delta = b.M1 - a.M1;
       Real delta2 = delta*delta;
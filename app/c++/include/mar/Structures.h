@@ -5,6 +5,10 @@
 #include <cstdint>
 #include <memory>
 #include <array>
+#include <vector>
+#include <limits>
+
+#include <android/log.h>
 
 #include "mar/util/util.hh"
 
@@ -95,7 +99,7 @@ namespace toMAR
       //------------------------
    {
       DetectRect<double> BB;
-      const unsigned long cameraId;
+      unsigned long cameraId;
       uint64_t seqno;
       int64_t timestamp;
 
@@ -108,54 +112,19 @@ namespace toMAR
       {}
    };
 
-   class DetectedBoundingBoxCompare
-   {
-   public:
-      bool operator()(const DetectedBoundingBox* l,
-                      const DetectedBoundingBox* r) const { return l->seqno > r->seqno; }
-   };
-
+   //! Image (RGBA) region of a detection, eg the face pasted over another camera's frames.
    struct DetectedROI
    //================
    {
-      void* image;
+      std::vector<unsigned char> image;
+      int width = 0, height = 0;
       DetectRect<double> BB;
-      const unsigned long cameraId;
+      unsigned long cameraId;
       uint64_t seqno;
-      int64_t timestamp =-1;
-      bool inUse = false;
-
-      DetectedROI() : image(nullptr), BB(), cameraId(std::numeric_limits<unsigned long>::max()), seqno(0), timestamp(-1) {}
-
-      DetectedROI(uint64_t seq, const unsigned long camera, void* img, double top, double left,
-                  double bottom, double right) : image(img), BB(top, left, bottom, right),
-                  cameraId(camera), seqno(seq), timestamp(toMAR::util::now_monotonic()),inUse(false)
-      {}
-
-#if !defined(NDEBUG)
-      ~DetectedROI()
-      //------------
-      {
-         if (image) //Delete in renderer
-            __android_log_print(ANDROID_LOG_ERROR, "~DetectedROI",
-                                "Disposing DetectedROI with dangling image");
-      }
 
-#endif
+      DetectedROI() : BB(), cameraId(std::numeric_limits<unsigned long>::max()), seqno(0) {}
    };
 
-   class DetectedROICompare
-   {
-   public:
-      bool operator()(const DetectedROI* l, const DetectedROI* r) const { return l->seqno > r->seqno; }
-   };
-
-    struct UInt64DescComparator
-    {
-    public:
-        bool operator()(const uint64_t& l, const uint64_t& r) const { return l < r; }
-    };
-
    template <class T1, class T2>
     struct pair_hasher
     {
@@ -2,30 +2,45 @@
 #define __MAR_CAMERA__
 //#define LOCK_FREE_QUEUE
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <stack>
+#include <string>
+#include <vector>
+#include <utility>
 
 #ifdef LOCK_FREE_QUEUE
 #include "lockfree/concurrentqueue.h"
 #else
 #include "tbb/concurrent_queue.h"
 #endif
+#include "tbb/spin_mutex.h"
+#include "tbb/spin_rw_mutex.h"
 
 #include "mar/jniint.h"
 #include "mar/acquisition/FrameInfo.h"
+#include "mar/util/Metrics.h"
 
 namespace toMAR
 {
-   class Camera
-   //==========
+   class Camera : public std::enable_shared_from_this<Camera>
+   //==========================================================
    {
       public:
          Camera(std::string& id, size_t queueSize, bool isRearFacing =true,
                int width =-1, int height =-1);
 
+         ~Camera();
+
+         //! Registers the queue depth gauge, once the camera is owned by the repository.
+         void register_metrics();
+
          unsigned long camera_id() { return id; }
 
-         void camera_id(std::string camera) { id = camera_ID(camera); }
+         const std::string& camera_name() const { return name; }
+
+         void camera_id(std::string camera) { name = camera; id = camera_ID(camera); }
 
          void camera_id(unsigned long camera) { id = camera; }
 
@@ -35,12 +50,63 @@ namespace toMAR
 
          void get_preview_size(int& width, int& height) { width = previewWidth; height = previewHeight; }
 
+         //! Camera2 lens and sensor characteristics (mm and degrees), used to map device rotation to image motion.
+         void optics(float focalLength, float sensorWidth, float sensorHeight, int sensorOrientation)
+         {
+            this->focalLength = focalLength; this->sensorWidth = sensorWidth; this->sensorHeight = sensorHeight;
+            this->sensorOrientation = sensorOrientation;
+         }
+
+         //! Focal length in pixels of w x h frames (the output is cropped from the sensor), 0 if unknown.
+         double focal_pixels(int w, int h) const
+         {
+            if ( (focalLength <= 0) || (sensorWidth <= 0) || (sensorHeight <= 0) ) return 0;
+            return focalLength * std::max(w / sensorWidth, h / sensorHeight);
+         }
+
+         int sensor_orientation() const { return sensorOrientation; }
+
+         //! Set by the flow graph: whether its detector reads the camera's RGBA frames and whether it renders them.
+         void rgba_consumers(bool isDetected, bool isRendered)
+         {
+            isRGBADetected.store(isDetected); isRGBARendered.store(isRendered);
+         }
+
+         //! False if nothing would read the RGBA conversion of a frame enqueued now, so it can be skipped.
+         bool is_rgba_needed();
+
+         //! Direct buffers Java writes frames into for batched submission, referenced by index per frame.
+         void frame_buffers(std::vector<std::pair<unsigned char*, size_t>>& buffers)
+         {
+            tbb::spin_rw_mutex::scoped_lock lock(frameBuffersMutex, true);
+            frameBuffers.swap(buffers);
+         }
+
+         //! Hold a reader lock on frame_buffers_mutex() while using the returned buffer.
+         tbb::spin_rw_mutex& frame_buffers_mutex() { return frameBuffersMutex; }
+
+         unsigned char* frame_buffer(int i, size_t& size)
+         {
+            if ( (i < 0) || (static_cast<size_t>(i) >= frameBuffers.size()) ) return nullptr;
+            size = frameBuffers[i].second;
+            return frameBuffers[i].first;
+         }
+
+         bool is_full() { return (queue_size() >= queue_capacity()); }
+
          bool enqueue(FrameInfo* data);
 
+         /*! Enqueues frame1 on camera1 and frame2 on camera2, or neither if either queue is full, in which case the
+          * caller keeps ownership of both frames. Unlike enqueue it never evicts a queued frame. */
+         static bool enqueue_pair(Camera* camera1, FrameInfo* frame1, Camera* camera2, FrameInfo* frame2);
+
          bool dequeue(std::shared_ptr<FrameInfo>& data);
 
          void dequeue_blocked(std::shared_ptr<FrameInfo>& data);
 
+         //! Wakes a consumer blocked in dequeue_blocked with an empty frame (unless the queue is full).
+         void interrupt();
+
          bool dequeue_timed(std::shared_ptr<FrameInfo> &data, uint64_t timeout, long sleeptime=10000000LL);
 
          long queue_capacity() { return queue.capacity(); }
@@ -55,16 +121,27 @@ namespace toMAR
 
    private:
       Repository* repository;
+      std::string name;
       unsigned long id;
       int previewWidth, previewHeight;
+      float focalLength = 0, sensorWidth = 0, sensorHeight = 0;
+      int sensorOrientation = 90;
+      std::atomic_bool isRGBADetected{true}, isRGBARendered{true}; // Until a graph says otherwise
       bool isRearFacing;
       size_t maxQueueSize;
+      util::Counter* droppedFrames; // Frames discarded from (or not admitted to) a full queue
+      std::string queueGauge;
+      std::vector<std::pair<unsigned char*, size_t>> frameBuffers;
+      tbb::spin_rw_mutex frameBuffersMutex;
+      tbb::spin_mutex producerMutex; // Serialises enqueue and enqueue_pair so a checked queue stays non full
 #ifdef LOCK_FREE_QUEUE
       moodycamel::ConcurrentQueue<std::shared_ptr<FrameInfo>> queue;
 #else
       tbb::concurrent_bounded_queue<std::shared_ptr<FrameInfo>> queue;
 #endif
 
+      bool push(std::shared_ptr<FrameInfo>& data);
+
       friend class Repository;
    };
 };
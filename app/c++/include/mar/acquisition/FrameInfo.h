@@ -10,6 +10,8 @@
 #include <android/log.h>
 #include <mar/util/util.hh>
 #include <mar/util/Countable.hh>
+#include <mar/util/FrameTrace.h>
+#include <mar/util/BufferPool.hh>
 
 #include "mar/jniint.h"
 
@@ -32,24 +34,41 @@ namespace toMAR
       JavaVM* vm;
       std::atomic_int rgbaAcquires{0}, monoAcquires{0};
       std::atomic_bool isDetecting{false}, isTracking{false}, isRendering{false};
+      FrameTrace trace;
+      uint64_t pairKey = 0; // Same non zero value in both frames of a stereo pair submitted together
+      // Frames not backed by Java arrays (eg replayed from a recording) own their image data natively
+      std::unique_ptr<unsigned char[]> nativeRgba, nativeMono;
+      // NV12 (w*h*3/2) copy of the camera image, only attached while Repository::isYUVRendering is set
+      std::unique_ptr<unsigned char[]> nativeYuv;
+      // If set the native buffers came from (and are returned to) these pools instead of being deleted
+      std::shared_ptr<util::BufferPool> rgbaPool, monoPool, yuvPool;
 
       FrameInfo(unsigned long cameraId, int64_t ts, int w, int h, ColorFormats format, JavaVM* vm,
             int rgbaLen, jbyteArray rgbaData) : camera_id(cameraId), seqno(0),
             timestamp(util::now_monotonic()), javaTimestamp(ts),
             width(w), height(h), colorFormat(format), rgbaLen(rgbaLen), monoLen(0),
-            rgba(rgbaData), mono(nullptr), vm(vm) {}
+            rgba(rgbaData), mono(nullptr), vm(vm), trace(timestamp) {}
 
       FrameInfo(unsigned long cameraId, int64_t ts, int w, int h, ColorFormats format,  JavaVM* vm,
                 int rgbaLen, jbyteArray rgbaData, int monoLen, jbyteArray monoData) :
                 camera_id(cameraId), seqno(0), timestamp(util::now_monotonic()), javaTimestamp(ts),
                 width(w), height(h), colorFormat(format),
-                rgbaLen(rgbaLen), monoLen(monoLen), rgba(rgbaData), mono(monoData), vm(vm) {}
+                rgbaLen(rgbaLen), monoLen(monoLen), rgba(rgbaData), mono(monoData), vm(vm), trace(timestamp) {}
+
+      FrameInfo(unsigned long cameraId, int64_t ts, int w, int h, ColorFormats format, int rgbaLen,
+                std::unique_ptr<unsigned char[]> rgbaData, int monoLen, std::unique_ptr<unsigned char[]> monoData) :
+                camera_id(cameraId), seqno(0), timestamp(util::now_monotonic()), javaTimestamp(ts),
+                width(w), height(h), colorFormat(format), rgbaLen(rgbaLen), monoLen(monoLen), rgba(nullptr),
+                mono(nullptr), vm(nullptr), trace(timestamp), nativeRgba(std::move(rgbaData)),
+                nativeMono(std::move(monoData)) {}
 
       FrameInfo(const FrameInfo& other) = delete;
       FrameInfo& operator=(FrameInfo const&) = delete;
 
-      ~FrameInfo() { dispose(); }
+      ~FrameInfo() { FrameTracer::instance().complete(camera_id, seqno, javaTimestamp, trace); dispose(); }
 
+      //! False if the RGBA conversion was skipped (see Camera::is_rgba_needed).
+      bool has_color() const { return ( (nativeRgba) || (rgba != nullptr) ); }
       unsigned char* getColorData(void*& context);
       void releaseColorData(void *context, unsigned char* p);
       unsigned char* getMonoData(void*& context);
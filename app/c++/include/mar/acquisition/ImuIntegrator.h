@@ -0,0 +1,85 @@
+#ifndef _MAR_IMU_INTEGRATOR_H
+#define _MAR_IMU_INTEGRATOR_H
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+#include <android/sensor.h>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "tbb/concurrent_unordered_map.h"
+
+namespace toMAR
+{
+   //! Device motion over the interval between two consecutive frames of a camera.
+   struct FrameMotion
+   {
+      int64_t start = 0, end = 0; // Previous and current frame timestamps (sensor clock, CLOCK_BOOTTIME)
+      // Rotation of the device (Android sensor coordinates) from start to end, ie v_start = rotation * v_end
+      Eigen::Quaternionf rotation = Eigen::Quaternionf::Identity();
+      Eigen::Vector3f angularVelocity = Eigen::Vector3f::Zero(); // Newest gyro sample (rad/s) at or before end
+      Eigen::Vector3f acceleration = Eigen::Vector3f::Zero(); // Mean accelerometer (m/s^2) over the interval
+      int gyroSamples = 0, accelSamples = 0;
+      bool isExtrapolated = false; // No gyro sample reached end, the remainder used angularVelocity
+   };
+
+   /**
+    * Pre-integrates gyroscope (and averages accelerometer) samples between consecutive frames of each camera as
+    * the frames enter the pipeline (Repository::new_frame), so trackers and renderers can get the inter-frame
+    * rotation for a frame in constant time with motion() instead of querying Sensors themselves, and predict()
+    * the rotation from a frame to a later (eg display) time. Uses the calibrated gyroscope if it was added to
+    * Sensors, else the uncalibrated one; frames are not integrated when neither is available.
+    */
+   class ImuIntegrator
+   //=================
+   {
+   public:
+      static ImuIntegrator& instance();
+
+      ImuIntegrator(ImuIntegrator const&) = delete;
+      ImuIntegrator(ImuIntegrator&&) = delete;
+      ImuIntegrator& operator=(ImuIntegrator const&) = delete;
+      ImuIntegrator& operator=(ImuIntegrator &&) = delete;
+
+      //! Called once per frame in sequence order by the (single) source thread of the camera.
+      bool on_frame(unsigned long camera, uint64_t seqno, int64_t timestamp);
+
+      //! Motion between frame seqno and its predecessor, false if it is not (or no longer) available.
+      bool motion(unsigned long camera, uint64_t seqno, FrameMotion& result) const;
+
+      /**
+       * Rotation from the time of frame seqno to time (sensor clock) using the gyro samples received since the
+       * frame and extrapolating past the newest one. Returns identity if the frame is not available.
+       */
+      Eigen::Quaternionf predict(unsigned long camera, uint64_t seqno, int64_t time) const;
+
+      //! Rotation over [start, end] from the gyro samples currently held by Sensors.
+      bool integrate(int64_t start, int64_t end, FrameMotion& result) const;
+
+      void clear();
+
+      static constexpr size_t HISTORY = 64; // Frames per camera available to motion()
+
+   private:
+      ImuIntegrator() = default;
+
+      struct Slot
+      {
+         std::atomic<uint64_t> sequence{0}; // Frame seqno + 1 once written, 0 while being written
+         FrameMotion motion;
+      };
+      struct CameraMotion
+      {
+         Slot slots[HISTORY];
+         int64_t lastTimestamp = 0;
+      };
+
+      tbb::concurrent_unordered_map<unsigned long, CameraMotion*> cameras;
+
+      int gyroscope() const;
+   };
+}
+#endif
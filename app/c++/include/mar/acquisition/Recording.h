@@ -0,0 +1,150 @@
+#ifndef _MAR_RECORDING_H
+#define _MAR_RECORDING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <android/sensor.h>
+
+#include "tbb/concurrent_queue.h"
+
+namespace toMAR
+{
+   /*
+    * Recording container (native endian, every record starts on an 8 byte boundary so the file can be mmapped
+    * and read in place):
+    *    RecordingHeader
+    *    { RecordHeader payload[size] padding[(8 - size % 8) % 8] } ...
+    * FRAME records hold a RecordedFrame followed by the YUV bytes exactly as handed to enqueueYUV, SENSOR records
+    * hold an ASensorEvent. Records are in arrival order and timestamps are the camera/sensor (CLOCK_BOOTTIME) times.
+    */
+   constexpr char RECORDING_MAGIC[8] = { 'M', 'A', 'R', 'R', 'E', 'C', '0', '1' };
+   constexpr uint32_t RECORDING_VERSION = 1;
+
+   struct RecordingHeader
+   {
+      char magic[8];
+      uint32_t version;
+      uint32_t reserved;
+      int64_t created; // CLOCK_REALTIME ns
+   };
+
+   enum class RecordType : uint32_t { FRAME = 1, SENSOR = 2 };
+
+   struct RecordHeader
+   {
+      RecordType type;
+      uint32_t size;
+      int64_t timestamp;
+   };
+
+   struct RecordedFrame
+   {
+      static constexpr uint32_t IS_RGBA = 1, HAS_MONO = 2, IS_REAR_FACING = 4;
+      char cameraName[16]; // Camera2 id, used to re-create the camera on replay
+      uint64_t cameraId;
+      int32_t width, height;
+      uint32_t flags;
+      uint32_t yuvLength;
+   };
+
+   /**
+    * Streams frames (from the JNI enqueue thread) and sensor events (from the sensor looper) to a recording file.
+    * Callers only copy the data into a buffer which a writer thread appends to the file, so a slow disk drops
+    * records (counted in recorder.dropped) instead of stalling the camera or sensor threads.
+    */
+   class StreamRecorder
+   //==================
+   {
+   public:
+      static StreamRecorder& instance();
+
+      StreamRecorder(StreamRecorder const&) = delete;
+      StreamRecorder(StreamRecorder&&) = delete;
+      StreamRecorder& operator=(StreamRecorder const&) = delete;
+      StreamRecorder& operator=(StreamRecorder &&) = delete;
+
+      bool start(const std::string& filename, size_t maxQueued =16);
+      void stop();
+      bool is_recording() { return isRecording.load(std::memory_order_relaxed); }
+
+      bool record_frame(const std::string& cameraName, unsigned long cameraId, int64_t timestamp, int width,
+                        int height, bool isRGBA, bool hasMono, bool isRearFacing, const void* yuv, size_t yuvLength);
+      bool record_sensor(const ASensorEvent& event);
+
+   private:
+      StreamRecorder() = default;
+      ~StreamRecorder() { stop(); }
+
+      std::atomic_bool isRecording{false};
+      tbb::concurrent_bounded_queue<std::vector<unsigned char>*> queue;
+      std::thread writerThread;
+
+      bool submit(RecordType type, int64_t timestamp, const void* part1, size_t len1, const void* part2,
+                  size_t len2);
+      void writer(int fd);
+   };
+
+   //! Read only memory mapped view of a recording with an index of its records.
+   class RecordingReader
+   //===================
+   {
+   public:
+      RecordingReader() = default;
+      ~RecordingReader() { close(); }
+      RecordingReader(const RecordingReader&) = delete;
+      RecordingReader& operator=(const RecordingReader&) = delete;
+
+      bool open(const std::string& filename);
+      void close();
+      size_t size() { return offsets.size(); }
+      const RecordHeader* record(size_t i) const
+      { return reinterpret_cast<const RecordHeader*>(base + offsets[i]); }
+      const unsigned char* payload(size_t i) const { return base + offsets[i] + sizeof(RecordHeader); }
+
+   private:
+      const unsigned char* base = nullptr;
+      size_t length = 0;
+      std::vector<size_t> offsets;
+   };
+
+   /**
+    * Feeds a recording back into the pipeline: frames are converted as in enqueueYUV and enqueued on their camera
+    * (created if necessary) while sensor events are injected into Sensors. speed scales the recorded inter-record
+    * gaps (1 = original rate, 2 = twice as fast); speed <= 0 replays as fast as the camera queues drain without
+    * dropping any frames so every run sees identical input.
+    */
+   class ReplaySource
+   //================
+   {
+   public:
+      ReplaySource(const std::string& filename, double speed =1.0, bool isLoop =false, int queueSize =3) :
+                   filename(filename), speed(speed), isLoop(isLoop), queueSize(queueSize) {}
+      ~ReplaySource() { stop(); }
+
+      bool start();
+      void stop();
+      bool is_running() { return isRunning.load(); }
+
+      uint64_t frames() { return replayedFrames.load(std::memory_order_relaxed); }
+      uint64_t events() { return replayedEvents.load(std::memory_order_relaxed); }
+
+   private:
+      std::string filename;
+      double speed;
+      bool isLoop;
+      int queueSize;
+      RecordingReader reader;
+      std::thread replayThread;
+      std::atomic_bool isRunning{false}, mustStop{false};
+      std::atomic<uint64_t> replayedFrames{0}, replayedEvents{0};
+
+      void run();
+      bool replay_frame(const RecordHeader* header, const unsigned char* payload);
+   };
+}
+#endif
@@ -1,56 +1,201 @@
 #ifndef MAR_SENSORDATA_HH
 #define MAR_SENSORDATA_HH
 
-#include <mutex>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 #include <android/sensor.h>
 
-#include "mar/util/bounded_map.h"
-
 namespace toMAR
 {
-   class SensorData
+   class SensorRing;
+
+   /**
+    * A view of the events of one sensor between two positions in its SensorRing. No data is copied, so the oldest
+    * events can be overwritten by the sensor thread while the span is in use; check intact() after reading (or use
+    * SensorRing::copy) if the span may be held for longer than the ring's time window.
+    */
+   class SensorSpan
+   //==============
    {
    public:
-      SensorData(unsigned long max_queue_size, std::mutex& mtx) : shared_queue(max_queue_size, 0), mutex(mtx) {}
+      SensorSpan() = default;
+      SensorSpan(const SensorRing* ring, uint64_t first, uint64_t last) : ring(ring), first(first), last(last) {}
+
+      size_t size() const { return static_cast<size_t>(last - first); }
+      bool empty() const { return (last == first); }
+      inline const ASensorEvent& operator[](size_t i) const;
+      //! True if none of the events in the span have been overwritten since it was created.
+      inline bool intact() const;
+
+   private:
+      const SensorRing* ring = nullptr;
+      uint64_t first = 0, last = 0;
+
+      friend class SensorRing;
+   };
+
+   /**
+    * Single producer ring of ASensorEvent values in timestamp order (events arriving out of order are dropped) with
+    * binary search range queries. The producer (sensor looper thread) never waits; readers detect and discard
+    * events overwritten during a read instead of locking.
+    */
+   class SensorRing
+   //==============
+   {
+   public:
+      explicit SensorRing(size_t max_size)
+      {
+         size_t n = 16;
+         while (n < max_size) n <<= 1;
+         capacity = n;
+         mask = n - 1;
+         events.reset(new ASensorEvent[n]);
+      }
 
-      void push(ASensorEvent & ev)
-      //------------------------
+      void push(const ASensorEvent& ev)
+      //-------------------------------
       {
-         std::lock_guard<std::mutex> lock(mutex);
-         ASensorEvent * event = new ASensorEvent(ev);
-         shared_queue.insert(std::make_pair(ev.timestamp, event));
+         const uint64_t h = head.load(std::memory_order_relaxed);
+         if ( (h > 0) && (ev.timestamp < events[(h - 1) & mask].timestamp) )
+            return;
+         events[h & mask] = ev;
+         head.store(h + 1, std::memory_order_release);
       }
 
-      unsigned long between(const __int64_t start, const __int64_t end, std::multimap<int64_t, ASensorEvent*> &events)
-      //----------------------------------------------------------------------------------------
+      //! Events with start <= timestamp <= end.
+      SensorSpan between(int64_t start, int64_t end) const
+      //--------------------------------------------------
       {
-         std::lock_guard<std::mutex> lock(mutex);
-         return shared_queue.between(start, end, events);
+         uint64_t lo, hi;
+         window(lo, hi);
+         return SensorSpan(this, lower_bound(lo, hi, start), upper_bound(lo, hi, end));
       }
 
-      unsigned long all(std::multimap<int64_t, ASensorEvent*> &events)
-      //----------------------------------------------------
+      //! Events with timestamp >= start.
+      SensorSpan from(int64_t start) const
+      //----------------------------------
       {
-         std::lock_guard<std::mutex> lock(mutex);
-         return shared_queue.all(events);
+         uint64_t lo, hi;
+         window(lo, hi);
+         return SensorSpan(this, lower_bound(lo, hi, start), hi);
       }
 
-      unsigned long from(const __int64_t start, std::multimap<int64_t, ASensorEvent*> &events)
-      //----------------------------------------------------------------------------
+      SensorSpan all() const
+      //--------------------
       {
-         std::lock_guard<std::mutex> lock(mutex);
-         return shared_queue.from(start, events);
+         uint64_t lo, hi;
+         window(lo, hi);
+         return SensorSpan(this, lo, hi);
       }
 
+      //! Append the events of span to out, omitting any the producer overwrote while they were being copied.
+      size_t copy(const SensorSpan& span, std::vector<ASensorEvent>& out) const
+      //-----------------------------------------------------------------------
+      {
+         const size_t before = out.size();
+         for (size_t i = 0; i < span.size(); i++)
+            out.push_back(span[i]);
+         const uint64_t oldest = oldest_intact();
+         if (span.first < oldest)
+         {
+            const size_t lost = static_cast<size_t>(std::min(oldest - span.first, uint64_t(span.size())));
+            out.erase(out.begin() + before, out.begin() + before + lost);
+         }
+         return out.size() - before;
+      }
+
+      size_t size() const
+      //-----------------
+      {
+         uint64_t lo, hi;
+         window(lo, hi);
+         return static_cast<size_t>(hi - lo);
+      }
+
+      bool empty() const { return (head.load(std::memory_order_acquire) == 0); }
+
+      //! Timestamp of the newest event (0 if none)
+      int64_t latest() const
+      {
+         const uint64_t h = head.load(std::memory_order_acquire);
+         return (h == 0) ? 0 : events[(h - 1) & mask].timestamp;
+      }
+
+      void clear() { head.store(0, std::memory_order_release); }
+
+   private:
+      std::unique_ptr<ASensorEvent[]> events;
+      size_t capacity, mask;
+      std::atomic<uint64_t> head{0}; // Total events pushed, event i is in slot i & mask
+
+      // The slot after the newest may be mid write, so one fewer than capacity events are readable
+      inline uint64_t oldest_intact() const
+      {
+         const uint64_t h = head.load(std::memory_order_acquire);
+         return (h >= capacity) ? h - capacity + 1 : 0;
+      }
+
+      inline void window(uint64_t& lo, uint64_t& hi) const
+      {
+         hi = head.load(std::memory_order_acquire);
+         lo = (hi >= capacity) ? hi - capacity + 1 : 0;
+      }
+
+      uint64_t lower_bound(uint64_t lo, uint64_t hi, int64_t ts) const
+      //---------------------------------------------------------------
+      {
+         while (lo < hi)
+         {
+            const uint64_t mid = lo + (hi - lo) / 2;
+            if (events[mid & mask].timestamp < ts) lo = mid + 1; else hi = mid;
+         }
+         return lo;
+      }
+
+      uint64_t upper_bound(uint64_t lo, uint64_t hi, int64_t ts) const
+      //---------------------------------------------------------------
+      {
+         while (lo < hi)
+         {
+            const uint64_t mid = lo + (hi - lo) / 2;
+            if (events[mid & mask].timestamp <= ts) lo = mid + 1; else hi = mid;
+         }
+         return lo;
+      }
+
+      friend class SensorSpan;
+   };
+
+   inline const ASensorEvent& SensorSpan::operator[](size_t i) const { return ring->events[(first + i) & ring->mask]; }
+
+   inline bool SensorSpan::intact() const { return (ring == nullptr) || (first >= ring->oldest_intact()); }
+
+   class SensorData
+   {
+   public:
+      SensorData(unsigned long max_queue_size) : ring(max_queue_size) {}
+
+      void push(const ASensorEvent& ev) { ring.push(ev); }
+
+      SensorSpan between(const int64_t start, const int64_t end) const { return ring.between(start, end); }
+
+      SensorSpan all() const { return ring.all(); }
+
+      SensorSpan from(const int64_t start) const { return ring.from(start); }
+
+      size_t copy(const SensorSpan& span, std::vector<ASensorEvent>& events) const { return ring.copy(span, events); }
+
       bool supported() { return is_supported; }
 
    private:
-      struct ASensor *sensor;
-      struct ASensorEventQueue *sensor_queue;
-      bounded_map<__int64_t, ASensorEvent *> shared_queue;
-      std::mutex& mutex;
-      bool is_supported = false, good = false;
+      struct ASensor *sensor = nullptr;
+      struct ASensorEventQueue *sensor_queue = nullptr;
+      SensorRing ring;
+      bool is_supported = false, good = false, is_replay = false; // is_replay: fed by inject() not a sensor queue
 
 
       friend class Sensors;
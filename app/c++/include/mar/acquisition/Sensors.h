@@ -4,12 +4,17 @@
 #include <cstdio>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <future>
 #include <mutex>
 
 #include <android/sensor.h>
 #include <dlfcn.h>
 
 #include "tbb/spin_mutex.h"
+#include "tbb/concurrent_unordered_map.h"
 
 #include "mar/acquisition/SensorData.hh"
 
@@ -32,26 +37,64 @@ namespace toMAR
 
       bool add_sensor(int sensor, int queuedMax, std::stringstream* errs);
       size_t size() { return sensors.size(); }
+      //! Enables the added sensors on a single event queue attached to the calling thread's looper.
       size_t initialize(std::stringstream* errs =nullptr);
-      size_t get_all(int sensorid, std::multimap<int64_t, ASensorEvent*>& events);
-      size_t get_all(std::multimap<int64_t, ASensorEvent*> &events);
-      size_t get_all_between(int64_t start, int64_t end, std::multimap<int64_t, ASensorEvent*>& events);
-      size_t get_between(int sensorid, int64_t start, int64_t end, std::multimap<int64_t, ASensorEvent*>& events);
-      size_t get_from(int sensorid, int64_t start, std::multimap<int64_t, ASensorEvent*>& events);
-      size_t get_all_from(int64_t start, std::multimap<int64_t, ASensorEvent*>& events);
+      /**
+       * As initialize() but only the looper is prepared on the calling thread (which must then call
+       * process_queues()); enabling the sensors runs on another thread so it can overlap the caller's other startup
+       * work. wait_initialized() returns the number of sensors initialized.
+       */
+      bool initialize_async();
+      size_t wait_initialized(std::stringstream* errs =nullptr);
+      // Zero copy views of a sensor's events (empty if the sensor was not added), see SensorSpan::intact
+      SensorSpan span_all(int sensorid);
+      SensorSpan span_between(int sensorid, int64_t start, int64_t end);
+      SensorSpan span_from(int sensorid, int64_t start);
+
+      // Copying versions, append events to the vector in timestamp order (the get_all* versions merge all sensors)
+      size_t get_all(int sensorid, std::vector<ASensorEvent>& events);
+      size_t get_all(std::vector<ASensorEvent> &events);
+      size_t get_all_between(int64_t start, int64_t end, std::vector<ASensorEvent>& events);
+      size_t get_between(int sensorid, int64_t start, int64_t end, std::vector<ASensorEvent>& events);
+      size_t get_from(int sensorid, int64_t start, std::vector<ASensorEvent>& events);
+      size_t get_all_from(int64_t start, std::vector<ASensorEvent>& events);
 
       void sensor_handler_thread(int timeout_ms, int max_to_process, bool &stop);
 
       int process_queues(int timeout_ms, int max_to_process);
 
+      /**
+       * Adds a sensor fed by inject() instead of a sensor queue (used when replaying a recording). False if the
+       * sensor was added with add_sensor, whose ring only the sensor looper may push to.
+       */
+      bool add_replay_sensor(int sensor, int queuedMax =1000);
+      /**
+       * Add an event as if it had been read from the sensor's queue. The sensor must have been added with
+       * add_replay_sensor and only one thread may inject events for it.
+       */
+      bool inject(const ASensorEvent& event);
+
       std::string package_name;
    private:
       Sensors() {}
+      ~Sensors();
       ASensorManager* getSensorManager(const char* packageName);
+      ASensorManager* sensorManager = nullptr;
+      void* androidHandle = nullptr;
+      std::once_flag managerOnce;
       tbb::spin_mutex sensorLock;
-      std::unordered_map<int, SensorData*> sensors;
-      ALooper *looper;
-      std::mutex mutex;
+      // Concurrent so that replay sensors can be added while other threads read the sensors (sensorLock serialises
+      // adding them)
+      tbb::concurrent_unordered_map<int, SensorData*> sensors;
+      ALooper *looper = nullptr;
+      ASensorEventQueue* eventQueue = nullptr; // Shared by all sensors
+      std::vector<SensorData*> sensorsByType; // Initialized sensors indexed by type (for types < MAX_INDEXED_TYPE)
+      std::future<size_t> initializing;
+      std::stringstream initErrors;
+
+      size_t enable_sensors(std::stringstream* errs);
+      SensorData* sensor_data(int sensorid);
+      size_t merge(std::vector<ASensorEvent>& events, size_t from);
 
       static std::unordered_map<int, std::pair<std::string, int>> SUPPORTED_SENSORS;
    };
@@ -3,12 +3,15 @@
 
 #include <vector>
 #include <thread>
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include <sstream>
+#include <limits>
 
 #include "tbb/flow_graph.h"
 #include "tbb/task_scheduler_init.h"
+#include "tbb/task_arena.h"
 
 #include "mar/architecture/tbb/TBBCalibration.h"
 #include <mar/architecture/tbb/TBBRouter.h>
@@ -18,6 +21,8 @@
 #include "mar/render/Renderer.h"
 #include "mar/architecture/tbb/TBBCameraSource.h"
 #include "mar/CalibrationValues.hh"
+#include "mar/util/NodeProfiler.h"
+#include "mar/util/CpuPlacement.h"
 #include <mar/acquisition/Sensors.h>
 
 #include <android/log.h>
@@ -35,6 +40,82 @@ namespace toMAR
 
    enum class RendererType : unsigned { STANDARD = 0, BENCHMARK = 1, NONE = 3 };
 
+   //! Concurrency and buffering of a flow graph node.
+   struct NodeSpec
+   {
+      size_t concurrency = 1;
+      // Frames held while all of concurrency is busy, 0 to reject them (the router then skips or drops the frame)
+      size_t buffer = 0;
+      // Run the node body in the compute arena instead of the pipeline arena (see GraphSpec)
+      bool isOffloaded = false;
+   };
+
+   struct ArenaSpec
+   {
+      size_t concurrency = 0; // 0 for the default (see TBBGraphArchitecture::build)
+   };
+
+   //! The nodes for one camera, or for a stereo pair whose frames are joined before they are routed.
+   struct CameraSpec
+   {
+      unsigned long cameraId = std::numeric_limits<unsigned long>::max();
+      unsigned long stereoCameraId = std::numeric_limits<unsigned long>::max();
+      DetectorType detectorType = DetectorType::NONE;
+      TrackerType trackerType = TrackerType::NONE;
+      bool isRendered = true;
+      bool isOverlayOnRear = false; // Face detections are drawn over another (rear) camera's frames
+      // detector concurrency 0 uses detector_concurrency()
+      NodeSpec router, detector{0, 0, true}, tracker{1, 0, true}, render;
+      // Frames of a camera admitted by its source before downstream nodes release them, further frames are dropped
+      // at the source. 0 bounds it by the frames the router and stages can hold (max_in_flight()).
+      size_t maxInFlight = 0;
+
+      bool is_stereo() const { return (stereoCameraId != std::numeric_limits<unsigned long>::max()); }
+      //! The AprilTag and face detectors read RGBA frames, the trackers and simulation detector no frame data.
+      bool is_rgba_detected() const
+      {
+         return ( (detectorType == DetectorType::APRILTAGS) || (detectorType == DetectorType::FACE_RECOGNITION) );
+      }
+      size_t max_in_flight() const
+      {
+         if (maxInFlight > 0) return maxInFlight;
+         size_t n = router.concurrency + detector.concurrency + detector.buffer + tracker.concurrency + tracker.buffer;
+         if (isRendered) n += render.concurrency + render.buffer;
+         return n;
+      }
+   };
+
+   /**
+    * Topology for TBBGraphArchitecture: a source, router and detector/tracker/render nodes per CameraSpec. The node
+    * concurrency and buffering can be tuned per device without recompiling by overrides (see apply()), by default
+    * read from GRAPH_SPEC_FILE when the architecture is made.
+    * The graph runs in a small, high priority pipeline arena (sources, routers and render) while offloaded node
+    * bodies (by default detectors and trackers) run in a separate compute arena of bounded concurrency, so long
+    * detections can not occupy the workers the render path needs.
+    */
+   struct GraphSpec
+   {
+      std::vector<CameraSpec> cameras;
+      RendererType rendererType = RendererType::STANDARD;
+      ArenaSpec pipelineArena, computeArena;
+      // Core set of each util::StageClass ("big", "little", "all" or a CPU list such as "4-7"), empty for no pinning
+      std::string cores[static_cast<unsigned>(util::StageClass::COUNT)];
+
+      static constexpr const char* GRAPH_SPEC_FILE = "/sdcard/Documents/mar-graph.conf";
+
+      /**
+       * Applies overrides separated by newlines or ';' of the form [camera.]node.attribute=value where camera is an
+       * index into cameras (all cameras if omitted), node one of router, detector, tracker or render and attribute
+       * concurrency, buffer or offload (0 or 1), or source.max_in_flight, eg "detector.concurrency=3;
+       * 0.render.buffer=1". Arena sizes are set by arena.pipeline.concurrency and arena.compute.concurrency,
+       * core sets by cores.<class>=<cores> for a StageClass name (pipeline, compute, sensors or camera), eg
+       * "cores.pipeline=big; cores.compute=little". '#' starts a comment.
+       */
+      bool apply(const std::string& overrides, std::string* errors =nullptr);
+      //! apply() the contents of file path, false (leaving the spec unchanged) if it can not be read.
+      bool load(const char* path);
+   };
+
    class FlowGraphArchitecture;
 
    FlowGraphArchitecture *make_architecture(std::string type, Renderer *renderer,
@@ -66,9 +147,13 @@ namespace toMAR
       static Detector* make_detector(DetectorType detectorType, unsigned long camera1,
                                      bool isOverlayOnRear =false,
                                      int64_t frequencyMs =0);
+      //! A DetectorPool of concurrency instances if concurrency > 1 (0 for detector_concurrency(detectorType)).
       static Detector* make_detector(DetectorType detectorType, unsigned long camera1,
                                      unsigned long camera2, bool isOverlayOnRear =false,
-                                     int64_t frequencyMs =0);
+                                     int64_t frequencyMs =0, size_t concurrency =0);
+      //! Detector instances (and detector node concurrency) for detectorType, see DetectorPool.
+      static size_t detector_concurrency(DetectorType detectorType);
+      static constexpr int MAX_DETECTOR_CONCURRENCY = 4;
       static Tracker* make_tracker(TrackerType trackerType, unsigned long camera1);
       static Tracker* make_tracker(TrackerType trackerType, unsigned long camera1,
                                    unsigned long camera2);
@@ -86,267 +171,87 @@ namespace toMAR
       void output_benchmark();
    };
 
-   class TBBMonoArchitecture : public FlowGraphArchitecture
-   //============================================================
+   /**
+    * Builds the tbb::flow::graph for a GraphSpec at runtime. Each CameraSpec gets a source node (two joined source
+    * nodes for a stereo pair) feeding its own TBBRouter, which routes to the camera's detector, tracker and render
+    * nodes (router ports 0, 1 and 2), so any number of cameras can be added.
+    */
+   class TBBGraphArchitecture : public FlowGraphArchitecture
+   //=======================================================
    {
    public:
-      TBBMonoArchitecture(Renderer* renderer, unsigned long camera, DetectorType detectorType,
-                         TrackerType trackerType, RendererType rendererType = RendererType::STANDARD) :
-            FlowGraphArchitecture(renderer, detectorType, trackerType, rendererType), cameraId(camera),
-            cameraSourceNode(camera), renderNode(make_render(rendererType, renderer, cameraId))
-      {}
+      TBBGraphArchitecture(Renderer* renderer, const GraphSpec& spec);
 
       bool start() override;
 
-      virtual ~TBBMonoArchitecture() = default;
-
-   private:
-      void run();
-      std::thread thread;
-      tbb::flow::graph graph;
-      unsigned long cameraId;
-
-      TBBMonoCameraSourceNode cameraSourceNode;
-      tbb::flow::source_node<uintptr_t> tbbSourceNode{graph, cameraSourceNode, false};
-      std::unique_ptr<Detector> detectorNode{make_detector(defaultDetectorType, cameraId)};
-      std::unique_ptr<Tracker> trackerNode{make_tracker(defaultTrackerType, cameraId)};
-      std::unordered_map<unsigned long, TBBRouterParameters> routerMap =
-      {
-         { cameraId, TBBRouterParameters(0, detectorNode.get(), trackerNode.get(), renderer, false) }
-      };
-      TBBRouter routerNode{routerMap};
-      tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple> tbbRouterNode{graph, tbb::flow::serial, routerNode};
-//      TBBCalibration calibrationNode;
-//      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbCalibrationNode{graph, 2, calibrationNode};
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbDetectorNode{graph, 1,
-                                    [this] (uint64_t seqno) -> uint64_t { return (*detectorNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbTrackerNode{graph, 1,
-                           [this] (uint64_t seqno) -> uint64_t { return (*trackerNode)(seqno); } };
-      std::unique_ptr<RenderNode> renderNode;
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbRenderNode{graph, 1,
-                           [this] (uint64_t seqno) -> uint64_t { return (*renderNode)(seqno); } };
-   };
+      //! Terminates the graph and waits for run() to drain it.
+      void stop() override;
 
-   class TBBStereoArchitecture : public FlowGraphArchitecture
-   //============================================================
-   {
-   public:
-      TBBStereoArchitecture(Renderer* renderer, unsigned long camera1, unsigned long camera2,
-                            DetectorType detectorType, TrackerType trackerType,
-                            RendererType rendererType = RendererType::STANDARD) :
-            FlowGraphArchitecture(renderer, detectorType, trackerType),
-            cameraId1(camera1), cameraId2(camera2),
-            cameraSourceNode1(camera1), cameraSourceNode2(camera2),
-            renderNode(make_render(rendererType, renderer, camera1))
-      {}
-
-      bool start() override
-      //-------------------
-      {
-         thread = std::thread(&TBBStereoArchitecture::run, this);
-         return true;
-      }
+      const GraphSpec& graph_spec() const { return spec; }
 
-      virtual ~TBBStereoArchitecture() = default;
+      virtual ~TBBGraphArchitecture();
 
    private:
-      void run();
-      std::thread thread;
-      tbb::flow::graph graph;
-      unsigned long cameraId1, cameraId2;
-
-      TBBMonoCameraSourceNode cameraSourceNode1, cameraSourceNode2;
-      tbb::flow::source_node<uintptr_t> tbbSourceNode1{graph, cameraSourceNode1, false};
-      tbb::flow::source_node<uintptr_t> tbbSourceNode2{graph, cameraSourceNode2, false};
-      tbb::flow::join_node<std::tuple<uintptr_t, uintptr_t>> tbbCamerasJoinNode{graph};
-      tbb::flow::function_node<std::tuple<uintptr_t, uintptr_t>, uintptr_t, tbb::flow::queueing>
-      tbbJoinProcessor{graph, 1,
-      [this] (std::tuple<uintptr_t, uintptr_t> tt) -> uintptr_t
-      //--------------------------------------------------------
-      {
-         CameraFrame* cameraFrame1 = (CameraFrame*) std::get<0>(tt);
-         CameraFrame* cameraFrame2 = (CameraFrame*) std::get<1>(tt);
-         if ( (cameraFrame1->count + cameraFrame2->count) == 0)
-            return (uintptr_t) cameraFrame1;
-         // __android_log_print(ANDROID_LOG_INFO, " Stereo join node", "Router %lu %lu %lu %lu",
-         //                     cameraFrame1->cameras[0].cameraId, cameraFrame1->cameras[0].seqno_1,
-         //                     cameraFrame2->cameras[0].cameraId, cameraFrame2->cameras[0].seqno_1);
-         unsigned long id1 = cameraFrame1->cameras[0].cameraId;
-         uint64_t seq1 = cameraFrame1->cameras[0].seqno_1;
-         unsigned long id2 = cameraFrame2->cameras[0].cameraId;
-         uint64_t seq2 = cameraFrame2->cameras[0].seqno_1;
-         repository->stereo_pair(id1, seq1, id2, seq2);
-         cameraFrame1->set_stereo(0, id1, id2, seq1, seq2, true);
-         return (uintptr_t) cameraFrame1;
-      } };
-      std::unique_ptr<Detector> detectorNode{make_detector(defaultDetectorType, cameraId1, cameraId2)};
-      std::unique_ptr<Tracker> trackerNode{make_tracker(defaultTrackerType, cameraId1, cameraId2)};
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbDetectorNode{graph, 1,
-                           [this] (uint64_t seqno) -> uint64_t { return (*detectorNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbTrackerNode{graph, 1,
-                           [this] (uint64_t seqno) -> uint64_t { return (*trackerNode)(seqno); } };
-      std::unordered_map<unsigned long, TBBRouterParameters> routerMap =
+      using SourceNode = tbb::flow::source_node<uintptr_t>;
+      using StereoJoinNode = tbb::flow::join_node<std::tuple<uintptr_t, uintptr_t>>;
+      using StereoJoinProcessor = tbb::flow::function_node<std::tuple<uintptr_t, uintptr_t>, uintptr_t,
+                                                           tbb::flow::queueing>;
+      using RouterNode = tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple>;
+
+      /**
+       * A detector, tracker or render node with NodeSpec concurrency. Without buffering the node rejects frames when
+       * busy. With buffering a limiter_node admits concurrency + buffer frames into a queueing node and is
+       * decremented as each completes. An offloaded node admits frames through the limiter in the same way but
+       * its body is enqueued in arena by an async_node, which signals completion to the limiter through its gateway.
+       * The body is timed in NodeProfiler under name.
+       */
+      class StageNode
+      //=============
       {
-         { cameraId1, TBBRouterParameters(0, detectorNode.get(), trackerNode.get(), renderer, false) },
-      };
-      TBBRouter routerNode{routerMap};
-      tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple> tbbRouterNode{graph, 2, routerNode};
-      std::unique_ptr<RenderNode> renderNode;
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbRenderNode{graph, 1,
-                             [this] (uint64_t seqno) -> uint64_t { return (*renderNode)(seqno); } };
-   };
-
-   //Monocular rear and front with rendering of rear + overlayed face detected in front camera
-   class TBBMonoAndFrontArchitecture : public FlowGraphArchitecture
-   //============================================================
-   {
-   public:
-      TBBMonoAndFrontArchitecture(Renderer* renderer, unsigned long backCamera,
-                                  unsigned long frontCamera,
-                                  DetectorType rearDetectorType, DetectorType frontDetectorType,
-                                  TrackerType rearTrackerType, TrackerType frontTrackerType,
-                                  RendererType rendererType = RendererType::STANDARD) :
-            FlowGraphArchitecture(renderer, rearDetectorType, rearTrackerType),
-            backCameraId(backCamera), frontCameraId(frontCamera), frontDetectorType(frontDetectorType),
-            backSourceNode(backCamera), frontSourceNode(frontCamera),
-            renderNode(make_render(rendererType, renderer, backCamera))//,
-//            dummyRenderNode(make_render(RendererType::NONE, nullptr, frontCamera, true))
-      {}
-
+      public:
+         StageNode(tbb::flow::graph& graph, const NodeSpec& spec, const std::string& name,
+                   std::function<uint64_t(uint64_t)> body, tbb::task_arena* arena =nullptr);
 
-      bool start() override;
+         tbb::flow::receiver<uint64_t>& input();
+         NodeStats* stats() const { return nodeStats; }
 
-      virtual ~TBBMonoAndFrontArchitecture() = default;
+      private:
+         using OffloadNode = tbb::flow::async_node<uint64_t, tbb::flow::continue_msg>;
 
-   private:
-      void run();
-      std::thread thread;
-      tbb::flow::graph graph;
-      unsigned long backCameraId, frontCameraId;
-      DetectorType frontDetectorType;
-
-      TBBMonoCameraSourceNode backSourceNode, frontSourceNode;
-      tbb::flow::source_node<uintptr_t> tbbBackSourceNode{graph, backSourceNode, false};
-      tbb::flow::source_node<uintptr_t> tbbFrontSourceNode{graph, frontSourceNode, false};
-      std::unique_ptr<Detector> backDetectorNode{make_detector(defaultDetectorType, backCameraId)};
-      std::unique_ptr<Tracker> backTrackerNode{make_tracker(defaultTrackerType, backCameraId)};
-      std::unique_ptr<Detector> frontDetectorNode{make_detector(frontDetectorType, frontCameraId,
-                                                  true, true, 0)};
-      std::unique_ptr<Tracker> frontTrackerNode{make_tracker(defaultTrackerType, frontCameraId, true)};
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbFrontDetectorNode{graph, 1,
-         [this] (uint64_t seqno) -> uint64_t { return (*frontDetectorNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbFrontTrackerNode{graph, 1,
-         [this] (uint64_t seqno) -> uint64_t { return (*frontTrackerNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbBackDetectorNode{graph, 1,
-         [this] (uint64_t seqno) -> uint64_t { return (*backDetectorNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbBackTrackerNode{graph, 1,
-         [this] (uint64_t seqno) -> uint64_t { return (*backTrackerNode)(seqno); } };
-      std::unordered_map<unsigned long, TBBRouterParameters> rearRouterMap =
-      {
-         { backCameraId, TBBRouterParameters(0, backDetectorNode.get(), backTrackerNode.get(), renderer, false) },
+         NodeStats* nodeStats;
+         std::unique_ptr<tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting>> rejecting;
+         std::unique_ptr<tbb::flow::limiter_node<uint64_t>> limiter;
+         std::unique_ptr<tbb::flow::function_node<uint64_t, tbb::flow::continue_msg, tbb::flow::queueing>> queueing;
+         std::unique_ptr<OffloadNode> offload;
       };
-      TBBRouter rearRouterNode{rearRouterMap};
-      tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple> tbbRearRouterNode{graph, 1, rearRouterNode};
-      std::unordered_map<unsigned long, TBBRouterParameters> frontRouterMap =
+
+      //! The nodes built for one CameraSpec.
+      struct CameraNodes
       {
-         { frontCameraId, TBBRouterParameters(0, frontDetectorNode.get(), frontTrackerNode.get(), nullptr, true) }
+         std::vector<TBBMonoCameraSourceNode> sources;
+         std::vector<std::unique_ptr<SourceNode>> sourceNodes;
+         std::unique_ptr<StereoJoinNode> join;
+         std::unique_ptr<StereoJoinProcessor> joinProcessor;
+         std::unique_ptr<Detector> detector;
+         std::unique_ptr<Tracker> tracker;
+         std::unique_ptr<RenderNode> render;
+         std::unique_ptr<RouterNode> router;
+         std::unique_ptr<StageNode> detectorStage, trackerStage, renderStage;
       };
-      TBBRouter frontRouterNode{frontRouterMap};
-      tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple> tbbFrontRouterNode{graph, 1, frontRouterNode};
-      std::unique_ptr<RenderNode> renderNode;
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbRenderNode{graph, 1,
-         [this] (uint64_t seqno) -> uint64_t { return (*renderNode)(seqno); } };
-//      std::unique_ptr<RenderNode> dummyRenderNode;
-//      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbDummyRenderNode{graph, 1,
-//         [this] (uint64_t seqno) -> uint64_t { return (*dummyRenderNode)(seqno); } };
-   };
-
-   /*
-    * WARNING: TBBStereoAndFrontArchitecture untested as none of my devices supported
-    * 3 video streams.
-    */
-   //Stereo rear and monocular front with rendering of rear and overlay face detected in front camera
-   class TBBStereoAndFrontArchitecture : public FlowGraphArchitecture
-      //============================================================
-   {
-   public:
-      TBBStereoAndFrontArchitecture(Renderer* renderer, unsigned long backCamera1,
-                                    unsigned long backCamera2, unsigned long frontCamera,
-                                    DetectorType rearDetectorType, DetectorType frontDetectorType,
-                                    TrackerType rearTrackerType, TrackerType frontTrackerType,
-                                    RendererType rendererType = RendererType::STANDARD) :
-            FlowGraphArchitecture(renderer, rearDetectorType, rearTrackerType),
-            backCameraId1(backCamera1), backCameraId2(backCamera2),
-            frontCameraId(frontCamera), frontDetectorType(frontDetectorType),
-            backCameraSourceNode1(backCamera1), backCameraSourceNode2(backCamera2),
-            frontCameraSourceNode(frontCamera),
-            renderNode(make_render(rendererType, renderer, backCamera1))
-      {}
-
-      bool start() override;
 
-      virtual ~TBBStereoAndFrontArchitecture() = default;
-
-   private:
+      void build();
       void run();
+      //! Camera::rgba_consumers() for the camera(s) of a CameraSpec.
+      void rgba_consumers(const CameraSpec& camera, bool isDetected, bool isRendered);
+      uintptr_t join_stereo(const std::tuple<uintptr_t, uintptr_t>& frames);
+
+      GraphSpec spec;
       std::thread thread;
+      tbb::task_arena pipelineArena, computeArena;
+      std::unique_ptr<util::ArenaPlacementObserver> pipelineObserver, computeObserver;
+      tbb::task_group_context graphContext;
+      std::vector<std::unique_ptr<CameraNodes>> cameraNodes; // Destroyed explicitly, before graph
       tbb::flow::graph graph;
-      unsigned long backCameraId1, backCameraId2, frontCameraId;
-      DetectorType frontDetectorType;
-
-      TBBMonoCameraSourceNode backCameraSourceNode1, backCameraSourceNode2, frontCameraSourceNode;
-      tbb::flow::source_node<uintptr_t> tbbSourceNode1{graph, backCameraSourceNode1, false};
-      tbb::flow::source_node<uintptr_t> tbbSourceNode2{graph, backCameraSourceNode2, false};
-      tbb::flow::source_node<uintptr_t> tbbFrontSourceNode{graph, frontCameraSourceNode, false};
-      tbb::flow::join_node<std::tuple<uintptr_t, uintptr_t>> tbbCamerasJoinNode{graph};
-      tbb::flow::function_node<std::tuple<uintptr_t, uintptr_t>, uintptr_t, tbb::flow::queueing>
-            tbbJoinProcessor{graph, 1,
-      [this] (std::tuple<uintptr_t, uintptr_t> tt) -> uintptr_t
-      //--------------------------------------------------------
-      {
-         CameraFrame* cameraFrame1 = (CameraFrame*) std::get<0>(tt);
-         CameraFrame* cameraFrame2 = (CameraFrame*) std::get<1>(tt);
-         if ( (cameraFrame1->count + cameraFrame2->count) == 0)
-            return (uintptr_t) cameraFrame1;
-         // __android_log_print(ANDROID_LOG_INFO, " Stereo join node", "Router %lu %lu %lu %lu",
-         //                     cameraFrame1->cameras[0].cameraId, cameraFrame1->cameras[0].seqno_1,
-         //                     cameraFrame2->cameras[0].cameraId, cameraFrame2->cameras[0].seqno_1);
-         unsigned long id1 = cameraFrame1->cameras[0].cameraId;
-         uint64_t seq1 = cameraFrame1->cameras[0].seqno_1;
-         unsigned long id2 = cameraFrame2->cameras[0].cameraId;
-         uint64_t seq2 = cameraFrame2->cameras[0].seqno_1;
-         repository->stereo_pair(id1, seq1, id2, seq2);
-         cameraFrame1->set_stereo(0, id1, id2, seq1, seq2, true);
-         return (uintptr_t) cameraFrame1;
-      } };
-      std::unique_ptr<Detector> backDetectorNode{make_detector(defaultDetectorType, backCameraId1, backCameraId2)};
-      std::unique_ptr<Tracker> backTrackerNode{make_tracker(defaultTrackerType, backCameraId1, backCameraId2)};
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbBackDetectorNode{graph, 1,
-      [this] (uint64_t seqno) -> uint64_t { return (*backDetectorNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbBackTrackerNode{graph, 1,
-      [this] (uint64_t seqno) -> uint64_t { return (*backTrackerNode)(seqno); } };
-      std::unique_ptr<Detector> frontDetectorNode{make_detector(frontDetectorType, frontCameraId,
-                                                  true, true, 0)};
-      std::unique_ptr<Tracker> frontTrackerNode{make_tracker(defaultTrackerType, frontCameraId, true)};
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbFrontDetectorNode{graph, 1,
-      [this] (uint64_t seqno) -> uint64_t { return (*frontDetectorNode)(seqno); } };
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbFrontTrackerNode{graph, 1,
-      [this] (uint64_t seqno) -> uint64_t { return (*frontTrackerNode)(seqno); } };
-      std::unordered_map<unsigned long, TBBRouterParameters> backRouterMap =
-      {
-         { backCameraId1, TBBRouterParameters(0, backDetectorNode.get(), backTrackerNode.get(), renderer, false) },
-      };
-      TBBRouter backRouterNode{backRouterMap};
-      tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple> tbbBackRouterNode{graph, 2, backRouterNode};
-      std::unordered_map<unsigned long, TBBRouterParameters> frontRouterMap =
-      {
-         { frontCameraId, TBBRouterParameters(0, frontDetectorNode.get(), frontTrackerNode.get(), nullptr, true) }
-      };
-      TBBRouter frontRouterNode{frontRouterMap};
-      tbb::flow::multifunction_node<uintptr_t, RouterOutputTuple> tbbFrontRouterNode{graph, 1, frontRouterNode};
-      std::unique_ptr<RenderNode> renderNode;
-      tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting> tbbRenderNode{graph, 1,
-      [this] (uint64_t seqno) -> uint64_t { return (*renderNode)(seqno); } };
    };
 };
 #endif
@@ -1,32 +1,74 @@
 #ifndef TBB_JAVA_CAMERA_INTERFACE_
 #define TBB_JAVA_CAMERA_INTERFACE_
 #include <memory>
+#include <deque>
 
 #include "tbb/concurrent_vector.h"
+#include "tbb/spin_mutex.h"
 
 #include "mar/architecture/tbb/TBBCameraSource.h"
 #include "mar/Repository.h"
 #include "mar/acquisition/Camera.h"
 #include "mar/util/RingBuffer.hh"
+#include "mar/util/Metrics.h"
 
 namespace toMAR
 {
 
+   /**
+    * Admission shared by the two sources of a stereo pair. The join pairs the n-th frame of one camera with the n-th
+    * of the other, so both are admitted or dropped together: the first source to reach slot n decides for both
+    * (over the frames in flight of both cameras) and the other source follows that decision.
+    */
+   class StereoAdmission
+   //===================
+   {
+   public:
+      StereoAdmission(unsigned long camera1, unsigned long camera2, size_t maxInFlight) :
+            cameraIds{camera1, camera2}, maxInFlight(maxInFlight), repository(Repository::instance())
+      {}
+
+      //! True if the dequeued frame (hasFrame) of camera is admitted, false if it must be dropped.
+      bool admit(unsigned long camera, bool hasFrame);
+
+   private:
+      const unsigned long cameraIds[2];
+      const size_t maxInFlight;
+      Repository* repository;
+      std::deque<bool> pending[2]; // Decisions made by one side not yet followed by the other
+      tbb::spin_mutex mutex;
+   };
+
+   /**
+    * Source for one camera. With maxInFlight > 0 frames are dropped as they are dequeued, before they are inserted
+    * in the repository, while maxInFlight frames of the camera are still in flight (counted in
+    * source.<camera>.dropped). Terminal stages release their slot by deleting the frame. The sources of a stereo pair
+    * share a StereoAdmission (pair()) instead so the two cameras never get out of step.
+    */
    class TBBMonoCameraSourceNode
    //========================================================
    {
    public:
-      explicit TBBMonoCameraSourceNode(unsigned long camera) :
-            cameraId(camera), repository(Repository::instance()), is_ok(init())
+      explicit TBBMonoCameraSourceNode(unsigned long camera, size_t maxInFlight =0) :
+            cameraId(camera), repository(Repository::instance()), maxInFlight(maxInFlight), is_ok(init())
       {}
 
       bool good() { return is_ok; }
+      //! Admits frames through admission, shared with the source of the other camera of a stereo pair.
+      void pair(std::shared_ptr<StereoAdmission> admission) { stereoAdmission = admission; }
       bool operator()(uintptr_t& pcameraFrame); // const;
+      //! Unblocks a call of operator() waiting for a frame, which then returns an empty frame.
+      void interrupt() { camera_interface->interrupt(); }
+      //! Discards frames (and interrupts) still queued once the node has stopped.
+      void clear() { camera_interface->clear(); }
 
    private:
       const unsigned long cameraId;
       Camera* camera_interface;
       Repository* repository;
+      size_t maxInFlight;
+      std::shared_ptr<StereoAdmission> stereoAdmission;
+      util::Counter* dropped = nullptr;
       bool is_ok;
 
       bool init();
@@ -10,7 +10,9 @@
 #ifdef HAS_FACE_DETECTION
 #include "opencv2/face.hpp"
 #endif
+#include <tbb/concurrent_queue.h>
 #include "mar/Repository.h"
+#include "mar/util/cv.h"
 #include "mar/architecture/tbb/TBBTimedTest.hh"
 #include "mar/RunningStatistics.hh"
 
@@ -56,7 +58,7 @@ namespace toMAR
 
       uint64_t operator()(uint64_t seqno) override;
 
-      bool is_detecting() override { return isDetecting[camera1Id]->load(); }
+      bool is_detecting() override { return isDetecting.load(); }
 
       ~AprilTagTBBDetector();
    private:
@@ -65,7 +67,7 @@ namespace toMAR
       const unsigned long camera1Id, camera2Id;
       apriltag_detector_t *detector;
       Repository* repository;
-      static tbb::concurrent_unordered_map<unsigned long, std::atomic_bool*> isDetecting;
+      std::atomic_bool isDetecting{false};
    };
 #endif
 
@@ -75,26 +77,23 @@ namespace toMAR
    {
    public:
       FaceTBBDetector(unsigned long camera) : Detector(), cameraId(camera),
-         repository(Repository::instance()), last_detection(toMAR::util::now_monotonic())
-      {
-         isDetecting[cameraId] = new std::atomic_bool(false);
-      }
+         repository(Repository::instance()), cascade(vision::face_cascade()),
+         last_detection(toMAR::util::now_monotonic())
+      {}
 
-      bool is_detecting() override { return isDetecting[cameraId]->load(); }
+      bool is_detecting() override { return isDetecting.load(); }
 
       uint64_t operator()(uint64_t seqno) override;
 
       bool good() { return isGood; }
 
-      ~FaceTBBDetector();
-
    private:
       const unsigned long cameraId;
       Repository* repository;
+      std::shared_ptr<cv::CascadeClassifier> cascade; // Not shared with other instances, see DetectorPool
       bool isGood{false};
       int64_t last_detection =0;
-
-      static tbb::concurrent_unordered_map<unsigned long, std::atomic_bool*> isDetecting;
+      std::atomic_bool isDetecting{false};
    };
 
    class FaceOverlayTBBDetector : public Detector
@@ -102,30 +101,51 @@ namespace toMAR
    {
    public:
       explicit FaceOverlayTBBDetector(unsigned long camera) : Detector(),
-            cameraId(camera), repository(Repository::instance())
-      {
-         isDetecting[cameraId] = new std::atomic_bool(false);
-      }
-
-      ~FaceOverlayTBBDetector();
+            cameraId(camera), repository(Repository::instance()), cascade(vision::face_cascade())
+      {}
 
-      bool is_detecting() override { return isDetecting[cameraId]->load(); }
+      bool is_detecting() override { return isDetecting.load(); }
 
       uint64_t operator()(uint64_t seqno) override;
 
       bool good() { return isGood; }
 
-//      ~FaceTBBDetector();
-
    private:
       const unsigned long cameraId;
       Repository* repository;
+      std::shared_ptr<cv::CascadeClassifier> cascade;
       bool isGood{false};
-
-      static tbb::concurrent_unordered_map<unsigned long, std::atomic_bool*> isDetecting;
+      std::atomic_bool isDetecting{false};
    };
 #endif
 
+   /**
+    * Several instances of a detector behind one flow graph node with the same concurrency (see
+    * FlowGraphArchitecture::make_detector), each detection borrows an idle instance so instance state (eg the
+    * apriltag_detector_t or face cascade) is never shared. Detections may complete out of frame order, the
+    * Repository latest value channels keep the published results in seqno order by discarding those older than a
+    * result already published (counted in detector.out_of_order).
+    */
+   class DetectorPool : public Detector
+   //==================================
+   {
+   public:
+      DetectorPool(unsigned long camera, std::vector<std::unique_ptr<Detector>>&& instances);
+
+      uint64_t operator()(uint64_t seqno) override;
+
+      //! True when every instance is busy, so the router only offers frames the node can accept.
+      bool is_detecting() override { return busy.load() >= instances.size(); }
+
+      size_t size() const { return instances.size(); }
+
+   private:
+      const unsigned long cameraId;
+      std::vector<std::unique_ptr<Detector>> instances;
+      tbb::concurrent_queue<Detector*> idle;
+      std::atomic_size_t busy{0};
+   };
+
    class TBBNullDetector : public Detector
    //===============================================================
    {
@@ -9,6 +9,7 @@
 #include "mar/Repository.h"
 #include "mar/architecture/tbb/TBBDetector.h"
 #include "mar/architecture/tbb/TBBTracker.h"
+#include "mar/util/NodeProfiler.h"
 
 namespace toMAR
 {
@@ -24,6 +25,8 @@ namespace toMAR
       Tracker* tracker = nullptr;
       Renderer* renderer = nullptr;
       bool isDelete = false;
+      // Receiving node stats, try_put results for each port are reported to them if set
+      NodeStats* detectorStats = nullptr, * trackerStats = nullptr, * renderStats = nullptr;
 
       TBBRouterParameters(int detectorPort, Detector *detector, Tracker *tracker,
                           Renderer *renderer, bool isDelete) : portStart(detectorPort),
@@ -49,11 +52,14 @@ namespace toMAR
 
       void set_name(std::string n) { name = n; }
       std::string get_name() { return name; }
+      //! Times the router body itself.
+      void set_stats(NodeStats* nodeStats) { stats = nodeStats; }
 
    private:
       Repository* repository;
       std::unordered_map<unsigned long, TBBRouterParameters> map;
       std::string name;
+      NodeStats* stats = nullptr;
    };
 }
 #endif
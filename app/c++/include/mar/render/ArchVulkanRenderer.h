@@ -2,8 +2,10 @@
 #define _ARCH_VULKAN_RENDERER_H
 
 #include "mar/render/VulkanRenderer.h"
+#include "mar/render/OverlayReprojection.h"
 #include "mar/acquisition/FrameInfo.h"
 #include <mar/util/cv.h>
+#include "mar/util/Metrics.h"
 
 namespace toMAR
 {
@@ -12,22 +14,10 @@ namespace toMAR
    struct ArchVulkanRendererState
    {
       bool isAprilTags;
-      int64_t lastAprilTagTime;
       FaceRenderType faceRenderType;
-      std::vector<DetectedBoundingBox *> lastAprilTags;
-      DetectedBoundingBox* lastFace;
-      int64_t lastFaceTime;
-      DetectedROI* lastOverlay;
-      int64_t lastOverlayTime;
-      uint64_t lastSeq;
 
-      ArchVulkanRendererState(bool isAprilTags, int64_t lastAprilTagTime,
-                              FaceRenderType faceRenderType,
-                              DetectedBoundingBox *lastFace, int64_t lastFaceTime,
-                              DetectedROI *lastOverlay, int64_t lastOverlayTime) :
-         isAprilTags(isAprilTags), lastAprilTagTime(lastAprilTagTime), faceRenderType(faceRenderType),
-         lastFace(lastFace), lastFaceTime(lastFaceTime),
-         lastOverlay(lastOverlay), lastOverlayTime(lastOverlayTime), lastSeq(0)
+      ArchVulkanRendererState(bool isAprilTags, FaceRenderType faceRenderType) :
+         isAprilTags(isAprilTags), faceRenderType(faceRenderType)
       {}
    };
 
@@ -42,35 +32,51 @@ namespace toMAR
 
    protected:
       void draw(FrameInfo *frame, void *texture) override;
+      bool is_drawing() override;
 
    private:
       int id;
       static tbb::concurrent_unordered_map<int, ArchVulkanRendererState*> states;
+      OverlayReprojection reprojection;
 
+      //! Detections older than this (ns) are not drawn, eg when the detector has stopped or is falling behind.
+      static constexpr int64_t MAX_DETECTION_AGE = 400000000;
 
-      inline void draw_bounding_boxes(FrameInfo *frame, void *texture,
-                                      std::vector<DetectedBoundingBox *> &L)
-      //--------------------------------------------------------------------
+      //! target's box moved by the device rotation since the frame it was detected in (see OverlayReprojection).
+      inline DetectRect<double> latched_rect(FrameInfo *frame, const DetectedBoundingBox& target)
+      //-----------------------------------------------------------------------------------------
       {
-         for (DetectedBoundingBox *target : L)
+         if (! reprojection.is_latched(target.cameraId, target.seqno, frame->seqno))
          {
-            DetectRect<double> &rect = target->BB;
-            toMAR::vision::drawBB(texture, frame->width, frame->height, rect.top, rect.left,
-                                  rect.bottom, rect.right, 255, 0, 0, 6,
-                                  "VulkanRenderer::draw()");
+            Camera* camera = (target.cameraId == frame->camera_id)
+                             ? repository->hardware_camera_interface_ptr(target.cameraId) : nullptr;
+            reprojection.latch(camera, target.seqno, frame->seqno, frame->width, frame->height);
          }
+         return reprojection.apply(target.BB);
       }
 
-      inline void delete_last_tags()
-      //---------------------------
+      //! Draws the latest boxes detected on the frame's camera, returns the number drawn.
+      inline size_t draw_bounding_boxes(FrameInfo *frame, void *texture, const int64_t now)
+      //-----------------------------------------------------------------------------------
       {
-         ArchVulkanRendererState* state = ArchVulkanRenderer::states[id];
-         if (! state->lastAprilTags.empty())
+         static util::Counter* stale = util::Metrics::instance().counter("render.stale_detections");
+         Repository::DetectionChannel* channel = repository->detections(frame->camera_id);
+         const Repository::DetectionChannel::Slot* latest = (channel != nullptr) ? channel->read() : nullptr;
+         if (latest == nullptr)
+            return 0;
+         if ( (now - latest->timestamp) > MAX_DETECTION_AGE)
+         {
+            if (! latest->value.empty()) stale->add();
+            return 0;
+         }
+         for (const DetectedBoundingBox& target : latest->value)
          {
-            for (DetectedBoundingBox *pBB : state->lastAprilTags) if (pBB) delete pBB;
-            state->lastAprilTags.clear();
+            const DetectRect<double> rect = latched_rect(frame, target);
+            toMAR::vision::drawBB(texture, frame->width, frame->height, rect.top, rect.left,
+                                  rect.bottom, rect.right, 255, 0, 0, 6,
+                                  "VulkanRenderer::draw()");
          }
-         state->lastAprilTagTime = 0;
+         return latest->value.size();
       }
    };
 }
@@ -0,0 +1,52 @@
+#ifndef _MAR_OVERLAY_REPROJECTION_H
+#define _MAR_OVERLAY_REPROJECTION_H
+
+#include <cstdint>
+
+#include <android/log.h>
+
+#include <Eigen/Core>
+
+#include "mar/Structures.h"
+
+namespace toMAR
+{
+   class Camera;
+
+   /**
+    * Late latched reprojection of overlays detected on an earlier frame than the one they are drawn over. Just
+    * before the overlay is drawn (immediately before the render submit) latch() takes the device rotation between
+    * the detection frame and the displayed frame from the gyro samples held by ImuIntegrator, and apply() moves
+    * overlay geometry with the rotation homography K C R^T C^T K^-1 (C maps device to camera axes). Translation is
+    * ignored, ie the scene is treated as distant, which is what gyro only latching can correct.
+    */
+   class OverlayReprojection
+   //=======================
+   {
+   public:
+      /**
+       * Prepares the warp from frame detectedSeqno of camera to its frame displayedSeqno (w x h). Returns false,
+       * leaving the identity warp, if the motion of either frame or the camera optics are not known.
+       */
+      bool latch(Camera* camera, uint64_t detectedSeqno, uint64_t displayedSeqno, int w, int h);
+
+      //! True if latch() was last called for these frames (so it need not be repeated for each overlay).
+      bool is_latched(unsigned long camera, uint64_t detectedSeqno, uint64_t displayedSeqno) const
+      {
+         return ( (latchedCamera == camera) && (latchedDetected == detectedSeqno) &&
+                  (latchedDisplayed == displayedSeqno) );
+      }
+
+      //! Rect with its corners warped (as points (top, left) and (bottom, right), see vision::drawBB).
+      DetectRect<double> apply(const DetectRect<double>& rect) const;
+
+      bool is_identity() const { return isIdentity; }
+
+   private:
+      Eigen::Matrix3d H = Eigen::Matrix3d::Identity();
+      bool isIdentity = true;
+      unsigned long latchedCamera = 0;
+      uint64_t latchedDetected = 0, latchedDisplayed = 0;
+   };
+}
+#endif
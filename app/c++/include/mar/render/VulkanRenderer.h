@@ -26,9 +26,12 @@ namespace toMAR
    protected:
       VulkanRenderer(const char *appName, const char* assetsDir, bool isShowFPS =false);
       virtual void draw(FrameInfo* frame, void *texture) {}
+      //! True if draw() currently overlays the RGBA texture, in which case frames are not rendered from YUV.
+      virtual bool is_drawing() { return false; }
 
       std::string shadersAssetsDir;
-      const std::string CAMERA_VERTEX_SHADER{"camera.vert.spv"}, CAMERA_FRAGMENT_SHADER{"camera.frag.spv"};
+      const std::string CAMERA_VERTEX_SHADER{"camera.vert.spv"}, CAMERA_FRAGMENT_SHADER{"camera.frag.spv"},
+                        CAMERA_YUV_FRAGMENT_SHADER{"camera_yuv.frag.spv"};
       //cache some of the main loop calls to improve performance (VulkanMemoryAlloc doesn't play nicely with volk as at 02/2019)
       PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
       PFN_vkQueuePresentKHR fpQueuePresentKHR;
@@ -44,6 +47,7 @@ namespace toMAR
       VkSurfaceKHR surface = VK_NULL_HANDLE;
       VkPhysicalDevice physical_device = VK_NULL_HANDLE;
       VkPhysicalDeviceFeatures physical_device_features;
+      VkPhysicalDeviceProperties physical_device_properties;
       VkDevice device = VK_NULL_HANDLE;;
       VkSwapchainKHR swapchain = VK_NULL_HANDLE;
       uint32_t graphics_queuefamily_index =UINT32_MAX, present_queuefamily_index =UINT32_MAX, swapchain_len = 0,
@@ -59,6 +63,10 @@ namespace toMAR
       VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
       VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
       VkPipeline pipeline = VK_NULL_HANDLE;
+      VkPipeline yuv_pipeline = VK_NULL_HANDLE; // Samples the luma and chroma textures, null if YUV is unsupported
+      bool is_yuv_bound = false; // The default command buffers were recorded with yuv_pipeline
+      VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+      std::string pipeline_cache_file;
       VkPresentModeKHR present_mode;
       VkFormat depth_format;
       VkImage depth_image  = VK_NULL_HANDLE;
@@ -83,6 +91,14 @@ namespace toMAR
       VkImageView camera_texture_image_view = VK_NULL_HANDLE;
       VmaAllocationInfo camera_texture_image_allocinfo;
       VmaAllocation camera_texture_image_alloc = VK_NULL_HANDLE;;
+      // NV12 frames (FrameInfo::nativeYuv) are uploaded as a R8 luma and a half size R8G8 chroma texture
+      VkImage camera_luma_image = VK_NULL_HANDLE, camera_chroma_image = VK_NULL_HANDLE;
+      VkImageView camera_luma_image_view = VK_NULL_HANDLE, camera_chroma_image_view = VK_NULL_HANDLE;
+      VmaAllocation camera_luma_image_alloc = VK_NULL_HANDLE, camera_chroma_image_alloc = VK_NULL_HANDLE;
+      VkBuffer yuv_staging_buffer = VK_NULL_HANDLE;
+      VmaAllocation yuv_staging_alloc = VK_NULL_HANDLE;
+      VmaAllocationInfo yuv_staging_alloc_info = {};
+      VkDeviceSize yuv_staging_size = 0;
       struct CameraTextureVertex { float pos[2]; }; //dummy used to force render, the actual tex coordinates are const in shader
       VkBuffer camera_vertex_buffer = VK_NULL_HANDLE;
       VmaAllocation camera_vertex_buffer_alloc = VK_NULL_HANDLE;
@@ -92,6 +108,7 @@ namespace toMAR
                   const char* shaderAssetOverrideDir =nullptr);
       bool recreate();
       void destroy(bool isRenderOnly=false);
+      void destroy_swapchain();
       VkPhysicalDevice select_device(const std::vector<VkPhysicalDevice>& physicalDevices, const VkPhysicalDeviceType preferredType);
       bool begin_single_command();
       bool end_single_command();
@@ -102,6 +119,8 @@ namespace toMAR
       bool create_render_pass();
       bool create_camera_tex_descriptor();
       bool create_camera_vertex_buffer();
+      bool create_pipeline_cache();
+      bool save_pipeline_cache();
       bool create_pipeline();
       bool create_framebuffers();
       bool create_instance();
@@ -115,6 +134,10 @@ namespace toMAR
       bool create_camera_texture(uint32_t w, uint32_t h);
       bool update_camera_texture_view();
       bool update_camera_texture(uint64_t seqno, FrameInfo* frame, const VkCommandBuffer& commandBuffer);
+      bool create_camera_yuv_textures(uint32_t w, uint32_t h);
+      void destroy_camera_yuv_textures();
+      bool update_camera_yuv_texture(FrameInfo* frame);
+      bool bind_camera_pipeline(bool isYUV);
       bool record_default_commands();
 #if !defined(NDEBUG)
       VkDebugReportCallbackEXT debug_report;
@@ -0,0 +1,72 @@
+#ifndef _MAR_BUFFER_POOL_H
+#define _MAR_BUFFER_POOL_H
+
+#include <cstddef>
+#include <atomic>
+
+#include "tbb/concurrent_queue.h"
+
+namespace toMAR
+{
+   namespace util
+   {
+      /**
+       * Free list of equally sized byte buffers so per frame image data is recycled instead of allocated. Held by
+       * shared_ptr from the frames using its buffers, so buffers released after the owner has gone are still
+       * returned safely. At most maxFree buffers are retained, any more are deleted on release.
+       */
+      class BufferPool
+      //==============
+      {
+      public:
+         BufferPool(size_t bufferSize, size_t maxFree =8) : bufferSize(bufferSize), maxFree(maxFree) {}
+
+         ~BufferPool()
+         {
+            unsigned char* p;
+            while (available.try_pop(p))
+               delete[] p;
+         }
+
+         BufferPool(const BufferPool&) = delete;
+         BufferPool& operator=(const BufferPool&) = delete;
+
+         unsigned char* acquire()
+         //----------------------
+         {
+            unsigned char* p;
+            if (available.try_pop(p))
+            {
+               freeCount.fetch_sub(1, std::memory_order_relaxed);
+               return p;
+            }
+            allocated.fetch_add(1, std::memory_order_relaxed);
+            return new unsigned char[bufferSize];
+         }
+
+         void release(unsigned char* p)
+         //----------------------------
+         {
+            if (p == nullptr) return;
+            if (freeCount.fetch_add(1, std::memory_order_relaxed) < maxFree)
+               available.push(p);
+            else
+            {
+               freeCount.fetch_sub(1, std::memory_order_relaxed);
+               delete[] p;
+            }
+         }
+
+         size_t buffer_size() const { return bufferSize; }
+
+         //! Buffers allocated over the lifetime of the pool (a steady state pool stops growing this).
+         size_t allocations() const { return allocated.load(std::memory_order_relaxed); }
+
+      private:
+         const size_t bufferSize, maxFree;
+         tbb::concurrent_queue<unsigned char*> available;
+         std::atomic<size_t> freeCount{0}, allocated{0};
+      };
+   }
+}
+#endif
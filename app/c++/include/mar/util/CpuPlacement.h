@@ -0,0 +1,130 @@
+#ifndef _MAR_CPU_PLACEMENT_H
+#define _MAR_CPU_PLACEMENT_H
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "tbb/spin_mutex.h"
+#include "tbb/task_arena.h"
+#include "tbb/task_scheduler_observer.h"
+
+namespace toMAR
+{
+   namespace util
+   {
+      //! Parses a kernel CPU list such as "0-3,6" (as in /sys/devices/system/cpu/online) into sorted CPU ids.
+      bool parse_cpu_list(const std::string& list, std::vector<int>& cpus);
+      std::string cpu_list(const std::vector<int>& cpus);
+
+      /**
+       * Online CPUs this process may run on (the sysfs online list restricted to the sched_getaffinity mask, so a
+       * cgroup cpuset is honoured) with their relative capacity: cpu_capacity where the kernel exports it (arm64),
+       * otherwise cpufreq/cpuinfo_max_freq. On big.LITTLE devices the big cores are those of the highest capacity.
+       */
+      struct CpuTopology
+      //================
+      {
+         struct Cpu
+         {
+            int id;
+            int64_t capacity; // 0 if unknown
+         };
+         std::vector<Cpu> cpus;
+
+         static CpuTopology read(const std::string& sysfs ="/sys/devices/system/cpu");
+
+         std::vector<int> all() const;
+         std::vector<int> big() const;
+         //! The cores below the highest capacity, or all cores if they are all the same.
+         std::vector<int> little() const;
+         bool is_heterogeneous() const;
+
+         /**
+          * Resolves a core set, one of "big", "little", "all" or a CPU list, to the allowed CPUs it names. False if
+          * spec is invalid or names none of the allowed CPUs.
+          */
+         bool resolve(const std::string& spec, std::vector<int>& resolved) const;
+      };
+
+      //! Thread classes that can be placed on their own core set.
+      enum class StageClass : unsigned
+      {
+         PIPELINE = 0, // Sources, routers and render (the pipeline task arena)
+         COMPUTE,      // Detectors and trackers (the compute task arena, including apriltag's worker threads)
+         SENSORS,      // The sensor looper thread
+         CAMERA,       // Camera callback threads (AImageReader listener, Java camera enqueue)
+         COUNT
+      };
+      const char* stage_class_name(StageClass stage);
+
+      /**
+       * Core set per StageClass. Threads pin themselves with pin_current_thread() (cheap after the first call on a
+       * thread unless the placement changes) and TBB arenas are pinned by ArenaPlacementObserver. An empty core set
+       * leaves the class to the kernel scheduler.
+       */
+      class CpuPlacement
+      //================
+      {
+      public:
+         static CpuPlacement& instance();
+
+         CpuPlacement(CpuPlacement const&) = delete;
+         CpuPlacement(CpuPlacement&&) = delete;
+         CpuPlacement& operator=(CpuPlacement const&) = delete;
+         CpuPlacement& operator=(CpuPlacement &&) = delete;
+
+         //! Sets the core set (see CpuTopology::resolve) of stage, "" to clear it. False if spec does not resolve.
+         bool set(StageClass stage, const std::string& spec);
+         std::vector<int> cores(StageClass stage);
+         const CpuTopology& topology() const { return topo; }
+
+         /**
+          * Pins the calling thread to the cores of stage, false if stage has no core set (or on error). The mask is
+          * read back after pinning and a thread the kernel did not place on exactly those cores (eg a cpuset
+          * changed since the topology was read) is logged and counted in placement.<class>.not_honoured. Later calls
+          * on the thread return the same result without pinning again until the placement changes.
+          */
+         bool pin_current_thread(StageClass stage);
+         //! Returns the calling thread to all the allowed CPUs.
+         void unpin_current_thread();
+
+         static bool set_affinity(const std::vector<int>& cpus, pid_t tid =0);
+         //! The CPUs tid (0 for the calling thread) may run on according to sched_getaffinity.
+         static bool get_affinity(std::vector<int>& cpus, pid_t tid =0);
+
+      private:
+         CpuPlacement() : topo(CpuTopology::read()) {}
+
+         CpuTopology topo;
+         std::vector<int> coreSets[static_cast<unsigned>(StageClass::COUNT)];
+         std::atomic<unsigned> generation{1};
+         tbb::spin_mutex mutex;
+      };
+
+      /**
+       * Pins threads to the cores of a StageClass while they are in a task arena. Workers migrate between arenas so
+       * they are unpinned again when they leave.
+       */
+      class ArenaPlacementObserver : public tbb::task_scheduler_observer
+      //================================================================
+      {
+      public:
+         ArenaPlacementObserver(tbb::task_arena& arena, StageClass stage) :
+               tbb::task_scheduler_observer(arena), stage(stage)
+         {}
+
+         ~ArenaPlacementObserver() override { observe(false); }
+
+         void on_scheduler_entry(bool isWorker) override;
+         void on_scheduler_exit(bool isWorker) override;
+
+      private:
+         const StageClass stage;
+      };
+   }
+}
+#endif
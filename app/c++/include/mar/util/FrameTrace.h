@@ -0,0 +1,101 @@
+#ifndef _MAR_FRAME_TRACE_H
+#define _MAR_FRAME_TRACE_H
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <ostream>
+
+#include "tbb/spin_mutex.h"
+#include "tbb/enumerable_thread_specific.h"
+
+#include "mar/util/util.hh"
+#include "mar/util/LatencyHistogram.hh"
+
+namespace toMAR
+{
+   // PRESENT is recorded when vkQueuePresentKHR returns, not when the compositor scans the image out
+   enum class TraceStage : unsigned
+   {
+      ENQUEUE = 0, SOURCE, ROUTE, DETECT_START, DETECT_END, TRACK_START, TRACK_END, RENDER_START, RENDER_SUBMIT,
+      PRESENT, COUNT
+   };
+   constexpr unsigned TRACE_STAGES = static_cast<unsigned>(TraceStage::COUNT);
+
+   const char* trace_stage_name(TraceStage stage);
+
+   /**
+    * Fixed size per-frame record of the CLOCK_MONOTONIC time at which each pipeline stage saw the frame (0 if the
+    * stage was never reached). Each stage is written by a single node so relaxed stores suffice.
+    */
+   struct FrameTrace
+   //===============
+   {
+      explicit FrameTrace(int64_t enqueued)
+      {
+         for (unsigned i = 0; i < TRACE_STAGES; i++)
+            stamps[i].store(0, std::memory_order_relaxed);
+         stamps[0].store(enqueued, std::memory_order_relaxed);
+      }
+
+      inline void stamp(TraceStage stage)
+      { stamps[static_cast<unsigned>(stage)].store(util::now_monotonic(), std::memory_order_relaxed); }
+
+      inline int64_t at(TraceStage stage) const
+      { return stamps[static_cast<unsigned>(stage)].load(std::memory_order_relaxed); }
+
+      std::atomic<int64_t> stamps[TRACE_STAGES];
+   };
+
+   /**
+    * Collects completed FrameTraces (called when a FrameInfo is destroyed) into per-thread latency histograms
+    * (time from native enqueue to each stage, plus enqueue to present and sensor timestamp to present) and
+    * keeps the most recent traces for export in Chrome trace-event format (chrome://tracing, Perfetto).
+    */
+   class FrameTracer
+   //===============
+   {
+   public:
+      static FrameTracer& instance();
+
+      FrameTracer(FrameTracer const&) = delete;
+      FrameTracer(FrameTracer&&) = delete;
+      FrameTracer& operator=(FrameTracer const&) = delete;
+      FrameTracer& operator=(FrameTracer &&) = delete;
+
+      void complete(unsigned long camera, uint64_t seqno, int64_t javaTimestamp, const FrameTrace& trace);
+
+      //! Per-stage latency summary (count, mean, p50/p95/p99, max in ms) as a JSON object.
+      void latency_json(std::ostream& out);
+      bool write_chrome_trace(const char* filename);
+      void clear();
+
+      uint64_t dropped() { return droppedFrames.load(std::memory_order_relaxed); }
+
+      std::atomic_bool enabled{true};
+
+      static constexpr size_t RECENT_TRACES = 2048;
+
+   private:
+      FrameTracer() : recent(RECENT_TRACES) {}
+
+      struct StageHistograms
+      {
+         util::LatencyHistogram stages[TRACE_STAGES];
+         util::LatencyHistogram total, glass;
+      };
+      struct TraceRecord
+      {
+         unsigned long camera = 0;
+         uint64_t seqno = 0;
+         int64_t stamps[TRACE_STAGES] = {0};
+      };
+
+      tbb::enumerable_thread_specific<StageHistograms> histograms;
+      std::atomic<uint64_t> droppedFrames{0};
+      std::vector<TraceRecord> recent;
+      size_t recentNext = 0, recentCount = 0;
+      tbb::spin_mutex recentMutex;
+   };
+};
+#endif
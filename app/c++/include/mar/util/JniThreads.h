@@ -0,0 +1,43 @@
+#ifndef _MAR_JNI_THREADS_H
+#define _MAR_JNI_THREADS_H
+
+#include <jni.h>
+
+#include "tbb/task_scheduler_observer.h"
+
+namespace toMAR
+{
+   namespace util
+   {
+      /**
+       * JNIEnv of the calling thread, cached in thread local storage so only the first call on a thread reaches the
+       * VM. A thread that is not attached is attached (as name) and detached again by detach_current_thread() or,
+       * failing that, when the thread exits. Threads attached elsewhere (Java threads) are never detached here.
+       * Returns nullptr if vm is null or the thread can not be attached.
+       */
+      JNIEnv* thread_env(JavaVM* vm, const char* name =nullptr);
+
+      //! Detaches the calling thread if thread_env() attached it.
+      void detach_current_thread();
+
+      /**
+       * Global observer attaching every TBB thread to the VM as it joins the scheduler and detaching it as it
+       * leaves, so node bodies (eg FrameInfo::getColorData or the FrameInfo destructor) find a cached JNIEnv instead
+       * of attaching lazily. Create once the VM is known and keep for the life of the library.
+       */
+      class JniAttachObserver : public tbb::task_scheduler_observer
+      //===========================================================
+      {
+      public:
+         explicit JniAttachObserver(JavaVM* vm) : tbb::task_scheduler_observer(false), vm(vm) { observe(true); }
+         ~JniAttachObserver() override { observe(false); }
+
+         void on_scheduler_entry(bool isWorker) override;
+         void on_scheduler_exit(bool isWorker) override;
+
+      private:
+         JavaVM* vm;
+      };
+   }
+}
+#endif
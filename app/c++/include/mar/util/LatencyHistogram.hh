@@ -0,0 +1,132 @@
+#ifndef _MAR_LATENCY_HISTOGRAM_HH
+#define _MAR_LATENCY_HISTOGRAM_HH
+
+#include <cstdint>
+#include <atomic>
+#include <limits>
+
+namespace toMAR
+{
+   namespace util
+   {
+      /**
+       * Log-linear (HDR style) histogram of non-negative integer values (normally nanoseconds). Each power of two
+       * range is split into SUB_COUNT linear buckets so percentiles have a relative error below 1/SUB_COUNT.
+       * record() may only be called by a single owning thread (typically via tbb::enumerable_thread_specific), but
+       * the counters are relaxed atomics so other threads may merge_into() a snapshot at any time without locking.
+       */
+      class LatencyHistogram
+      //====================
+      {
+      public:
+         static constexpr unsigned SUB_BITS = 4, SUB_COUNT = 1u << SUB_BITS;
+         static constexpr unsigned MAX_BITS = 40; // Values >= 2^40 (~18 minutes in ns) fall in the last bucket
+         static constexpr unsigned BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+         LatencyHistogram() { clear(); }
+         LatencyHistogram(const LatencyHistogram&) = delete;
+         LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+         inline void record(int64_t value)
+         //-------------------------------
+         {
+            const uint64_t v = (value < 0) ? 0 : static_cast<uint64_t>(value);
+            bump(counts[index(v)], 1);
+            bump(total, 1);
+            bump(sum, v);
+            if (v > maximum.load(std::memory_order_relaxed)) maximum.store(v, std::memory_order_relaxed);
+            if (v < minimum.load(std::memory_order_relaxed)) minimum.store(v, std::memory_order_relaxed);
+         }
+
+         //! Adds this histogram's counts into other. Safe to call while the owner is recording.
+         void merge_into(LatencyHistogram& other) const
+         //---------------------------------------------
+         {
+            for (unsigned i = 0; i < BUCKETS; i++)
+            {
+               const uint64_t c = counts[i].load(std::memory_order_relaxed);
+               if (c > 0)
+                  other.counts[i].fetch_add(c, std::memory_order_relaxed);
+            }
+            other.total.fetch_add(total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.sum.fetch_add(sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            const uint64_t mx = maximum.load(std::memory_order_relaxed), mn = minimum.load(std::memory_order_relaxed);
+            if (mx > other.maximum.load(std::memory_order_relaxed)) other.maximum.store(mx, std::memory_order_relaxed);
+            if (mn < other.minimum.load(std::memory_order_relaxed)) other.minimum.store(mn, std::memory_order_relaxed);
+         }
+
+         void clear()
+         //----------
+         {
+            for (unsigned i = 0; i < BUCKETS; i++)
+               counts[i].store(0, std::memory_order_relaxed);
+            total.store(0, std::memory_order_relaxed);
+            sum.store(0, std::memory_order_relaxed);
+            maximum.store(0, std::memory_order_relaxed);
+            minimum.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+         }
+
+         uint64_t size() const { return total.load(std::memory_order_relaxed); }
+         uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+         uint64_t min() const { return (size() == 0) ? 0 : minimum.load(std::memory_order_relaxed); }
+         double mean() const
+         {
+            const uint64_t n = size();
+            return (n == 0) ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+         }
+
+         //! Value at percentile p (0-100), reported as the midpoint of the matching bucket.
+         uint64_t percentile(double p) const
+         //---------------------------------
+         {
+            const uint64_t n = size();
+            if (n == 0) return 0;
+            if (p < 0) p = 0;
+            if (p > 100) p = 100;
+            uint64_t rank = static_cast<uint64_t>((p / 100.0) * n + 0.5);
+            if (rank < 1) rank = 1;
+            uint64_t seen = 0;
+            for (unsigned i = 0; i < BUCKETS; i++)
+            {
+               seen += counts[i].load(std::memory_order_relaxed);
+               if (seen >= rank)
+               {
+                  const uint64_t lo = lower_bound(i), hi = upper_bound(i);
+                  const uint64_t v = lo + (hi - lo) / 2;
+                  return (v > max()) ? max() : ((v < min()) ? min() : v);
+               }
+            }
+            return max();
+         }
+
+         static inline unsigned index(uint64_t v)
+         //--------------------------------------
+         {
+            if (v < 2*SUB_COUNT) return static_cast<unsigned>(v);
+            const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(v));
+            if (msb >= MAX_BITS) return BUCKETS - 1;
+            const unsigned shift = msb - SUB_BITS;
+            return shift*SUB_COUNT + static_cast<unsigned>(v >> shift);
+         }
+
+         static inline uint64_t lower_bound(unsigned bucket)
+         //-------------------------------------------------
+         {
+            if (bucket < 2*SUB_COUNT) return bucket;
+            const unsigned shift = bucket/SUB_COUNT - 1;
+            return static_cast<uint64_t>(bucket%SUB_COUNT + SUB_COUNT) << shift;
+         }
+
+         static inline uint64_t upper_bound(unsigned bucket) { return lower_bound(bucket + 1) - 1; }
+
+      private:
+         std::atomic<uint64_t> counts[BUCKETS];
+         std::atomic<uint64_t> total, sum, maximum, minimum;
+
+         // Single writer so a relaxed load/store avoids the cost of a locked read-modify-write
+         static inline void bump(std::atomic<uint64_t>& a, uint64_t v)
+         { a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed); }
+      };
+   }
+}
+#endif
@@ -0,0 +1,100 @@
+#ifndef _MAR_LATEST_VALUE_HH
+#define _MAR_LATEST_VALUE_HH
+
+#include <cstdint>
+#include <atomic>
+#include <utility>
+
+#include "tbb/spin_mutex.h"
+
+#include "mar/util/util.hh"
+
+namespace toMAR
+{
+   namespace util
+   {
+      /**
+       * Latest value channel from (detector) writers to a single reader (the renderer) implemented as a triple
+       * buffer: the writer fills the back slot and swaps it with the middle slot, the reader swaps the middle slot
+       * with its front slot when a newer value has been published. Reads are wait-free and return the front slot
+       * which stays valid (and unchanged) until the next read() so the reader can draw from it without copying.
+       * Memory is bounded to three T whose capacity is reused when writing with publish(seqno, fill).
+       * Writers are serialised by a spin lock held only while a result is copied in, results for frames older than
+       * the last one published (eg from a slower concurrent detector) are dropped.
+       */
+      template <typename T>
+      class LatestValue
+      //===============
+      {
+      public:
+         struct Slot
+         {
+            T value{};
+            uint64_t seqno = 0;     // Frame the value was computed for
+            int64_t timestamp = -1; // CLOCK_MONOTONIC time at which it was published
+         };
+
+         LatestValue() = default;
+         LatestValue(const LatestValue&) = delete;
+         LatestValue& operator=(const LatestValue&) = delete;
+
+         //! Publishes the value written in place by fill(T&) for frame seqno, false if a newer frame was published.
+         template <typename Fill>
+         bool publish(const uint64_t seqno, Fill&& fill)
+         //---------------------------------------------
+         {
+            tbb::spin_mutex::scoped_lock lock(writeMutex);
+            if ( (published) && (seqno < lastSeqno) )
+               return false;
+            Slot& slot = slots[back];
+            fill(slot.value);
+            slot.seqno = seqno;
+            slot.timestamp = now_monotonic();
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+            lastSeqno = seqno;
+            published = true;
+            return true;
+         }
+
+         bool publish_value(const uint64_t seqno, T&& value)
+         //-------------------------------------------------
+         {
+            return publish(seqno, [&value](T& v) { v = std::move(value); });
+         }
+
+         /**
+          * Reader only: the newest published slot or nullptr if nothing has been published yet. The returned slot
+          * may be the same as the previous read when nothing newer was published, see Slot::timestamp for its age.
+          */
+         const Slot* read()
+         //----------------
+         {
+            if (middle.load(std::memory_order_relaxed) & FRESH)
+            {
+               front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+               hasRead = true;
+            }
+            return (hasRead) ? &slots[front] : nullptr;
+         }
+
+         //! Nanoseconds since the slot last returned by read() was published (-1 if none).
+         int64_t age(const int64_t now =now_monotonic()) const
+         {
+            return (hasRead) ? now - slots[front].timestamp : -1;
+         }
+
+      private:
+         static constexpr unsigned INDEX = 3, FRESH = 4;
+
+         Slot slots[3];
+         std::atomic<unsigned> middle{1};
+         unsigned back = 0;  // Writer owned (under writeMutex)
+         unsigned front = 2; // Reader owned
+         bool hasRead = false;
+         uint64_t lastSeqno = 0;
+         bool published = false;
+         tbb::spin_mutex writeMutex;
+      };
+   }
+}
+#endif
@@ -0,0 +1,151 @@
+#ifndef _MAR_METRICS_H
+#define _MAR_METRICS_H
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <ostream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "tbb/spin_mutex.h"
+#include "tbb/enumerable_thread_specific.h"
+
+#include "mar/util/LatencyHistogram.hh"
+
+namespace toMAR
+{
+   namespace util
+   {
+      class Counter
+      //===========
+      {
+      public:
+         inline void add(uint64_t n =1) { v.fetch_add(n, std::memory_order_relaxed); }
+         uint64_t value() const { return v.load(std::memory_order_relaxed); }
+      private:
+         std::atomic<uint64_t> v{0};
+      };
+
+      class Gauge
+      //=========
+      {
+      public:
+         inline void set(int64_t value) { v.store(value, std::memory_order_relaxed); }
+         int64_t value() const { return v.load(std::memory_order_relaxed); }
+      private:
+         std::atomic<int64_t> v{0};
+      };
+
+      //! Per thread LatencyHistogram shards, merged when read so record() never contends.
+      class Histogram
+      //=============
+      {
+      public:
+         inline void record(int64_t value) { shards.local().record(value); }
+         void merge_into(LatencyHistogram& out) const { for (const LatencyHistogram& h : shards) h.merge_into(out); }
+      private:
+         tbb::enumerable_thread_specific<LatencyHistogram> shards;
+      };
+
+      /**
+       * Named counters, gauges and histograms for the pipeline. Metric objects are created once (cache the returned
+       * pointer, eg in a function static) and updated with relaxed atomics so recording never blocks. Gauges may
+       * instead be polled via a callback, and sections add an arbitrary JSON value (eg camera statistics) to each
+       * snapshot. A background exporter writes snapshots every interval to a JSON file (replaced atomically), a CSV
+       * file (appended) and/or a fixed size binary ring file for long captures; see write_ring() for the layout.
+       */
+      class Metrics
+      //===========
+      {
+      public:
+         static Metrics& instance();
+
+         Metrics(Metrics const&) = delete;
+         Metrics(Metrics&&) = delete;
+         Metrics& operator=(Metrics const&) = delete;
+         Metrics& operator=(Metrics &&) = delete;
+
+         //! A name already registered as another type logs an error and returns a metric that is never reported.
+         Counter* counter(const std::string& name);
+         Gauge* gauge(const std::string& name);
+         //! poll is called on the exporter thread, so it must not capture anything that may be destroyed first.
+         void gauge(const std::string& name, std::function<int64_t()> poll, const void* owner =nullptr);
+         //! isTime histograms record ns and are reported in ms, others (eg batch sizes) are reported as recorded.
+         Histogram* histogram(const std::string& name, bool isTime =true);
+         void section(const std::string& name, std::function<void(std::ostream&)> json);
+         /**
+          * Only polled gauges and sections are removed (counter/gauge/histogram pointers stay valid). If owner is not
+          * null only a gauge registered with the same owner is removed, not one registered since by another object.
+          */
+         void remove(const std::string& name, const void* owner =nullptr);
+
+         //! Complete JSON snapshot taken on the calling thread.
+         std::string snapshot_json();
+         //! Last snapshot written by the exporter, or a new one if the exporter is not running.
+         std::string latest();
+
+         bool start_exporter(const std::string& directory, int64_t intervalMs =1000, bool isCSV =true,
+                             bool isBinary =true, size_t ringRecords =1u << 20);
+         void stop_exporter();
+         bool is_exporting() { return isExporting.load(); }
+
+      private:
+         Metrics() = default;
+         ~Metrics() { stop_exporter(); }
+
+         enum class MetricType : uint32_t { COUNTER = 0, GAUGE, POLLED, HISTOGRAM, SECTION };
+         struct Entry
+         {
+            std::string name;
+            uint32_t id;
+            MetricType type;
+            bool isTime = true;
+            std::unique_ptr<Counter> counterMetric;
+            std::unique_ptr<Gauge> gaugeMetric;
+            std::unique_ptr<Histogram> histogramMetric;
+            std::function<int64_t()> poll;
+            const void* owner = nullptr;
+            std::function<void(std::ostream&)> json;
+         };
+         struct Sample
+         {
+            std::shared_ptr<Entry> entry;
+            int64_t value = 0;
+            uint64_t count = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+            double mean = 0;
+         };
+
+         std::vector<std::shared_ptr<Entry>> entries;
+         // Returned for a name registered as another type, so callers need not check for null
+         Counter unreportedCounter;
+         Gauge unreportedGauge;
+         Histogram unreportedHistogram;
+         uint32_t nextId = 0;
+         tbb::spin_mutex entriesMutex;
+
+         std::string latestSnapshot;
+         tbb::spin_mutex latestMutex;
+
+         std::thread exporterThread;
+         std::atomic_bool isExporting{false};
+         std::mutex exporterMutex;
+         std::condition_variable exporterCondition;
+         bool stopExporter = false;
+
+         std::shared_ptr<Entry> find_or_add(const std::string& name, MetricType type);
+         std::vector<Sample> sample();
+         void write_json(std::ostream& out, int64_t timestamp, const std::vector<Sample>& samples);
+         void write_csv(std::ostream& out, int64_t timestamp, const std::vector<Sample>& samples);
+         void write_ring(std::fstream& ring, const std::string& namesFile, std::string& names, int64_t timestamp,
+                         const std::vector<Sample>& samples, size_t capacity, uint64_t& written);
+         void exporter(std::string directory, int64_t intervalMs, bool isCSV, bool isBinary, size_t ringRecords);
+      };
+   }
+}
+#endif
@@ -0,0 +1,138 @@
+#ifndef _MAR_NODE_PROFILER_H
+#define _MAR_NODE_PROFILER_H
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+
+#include "tbb/spin_mutex.h"
+#include "tbb/enumerable_thread_specific.h"
+
+#include "mar/util/util.hh"
+
+namespace toMAR
+{
+   /**
+    * Counters for one flow graph node: invocations and busy time of its body, the number of bodies running at once
+    * (and its high-water mark), frames accepted by the node but not yet started (queued) and frames the node
+    * rejected. Updated with relaxed atomics from the node body (see NodeScope) and from the sender (TBBRouter).
+    */
+   struct NodeStats
+   //==============
+   {
+      explicit NodeStats(const std::string& name) : name(name) {}
+
+      //! The sender's try_put result: accepted frames wait in the node until a body starts, rejected are counted.
+      inline void offered(bool isAccepted)
+      {
+         if (isAccepted)
+            accepted.fetch_add(1, std::memory_order_relaxed);
+         else
+            rejected.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      inline void enter()
+      {
+         started.fetch_add(1, std::memory_order_relaxed);
+         const int64_t n = active.fetch_add(1, std::memory_order_relaxed) + 1;
+         int64_t highest = maxActive.load(std::memory_order_relaxed);
+         while ( (n > highest) && (! maxActive.compare_exchange_weak(highest, n, std::memory_order_relaxed)) );
+      }
+
+      //! Frames accepted but not started, only counted for nodes whose sender reports offered().
+      int64_t queued() const
+      {
+         const int64_t n = static_cast<int64_t>(accepted.load(std::memory_order_relaxed)) -
+                           static_cast<int64_t>(started.load(std::memory_order_relaxed));
+         return (n > 0) ? n : 0;
+      }
+
+      const std::string name;
+      std::atomic<uint64_t> invocations{0}, busyNs{0}, accepted{0}, started{0}, rejected{0};
+      std::atomic<int64_t> active{0}, maxActive{0};
+   };
+
+   /**
+    * Registry of NodeStats by node name, with a per-thread ring of the most recent body executions which can be
+    * exported in Chrome trace-event format (one lane per worker thread) to see how graph work was distributed.
+    * Recording never takes a lock; the rings are only locked by the exporter for the copy.
+    */
+   class NodeProfiler
+   //================
+   {
+   public:
+      static NodeProfiler& instance();
+
+      NodeProfiler(NodeProfiler const&) = delete;
+      NodeProfiler(NodeProfiler&&) = delete;
+      NodeProfiler& operator=(NodeProfiler const&) = delete;
+      NodeProfiler& operator=(NodeProfiler &&) = delete;
+
+      //! The stats for name, created on first use. The pointer stays valid (and is reused if the graph is rebuilt).
+      NodeStats* node(const std::string& name);
+
+      void completed(NodeStats* stats, uint64_t seqno, int64_t start, int64_t end);
+
+      //! Per node counters as a JSON array (for a Metrics section).
+      void stats_json(std::ostream& out);
+      bool write_chrome_trace(const char* filename);
+      void clear();
+
+      std::atomic_bool tracing{true};
+
+      static constexpr size_t RECENT_SPANS = 4096; // Per thread
+
+   private:
+      NodeProfiler() = default;
+
+      struct Span
+      {
+         const NodeStats* node = nullptr;
+         uint64_t seqno = 0;
+         int64_t start = 0, end = 0;
+      };
+      struct SpanRing
+      {
+         std::vector<Span> spans;
+         size_t next = 0, count = 0;
+         tbb::spin_mutex mutex; // Uncontended except while exporting
+      };
+
+      std::vector<std::unique_ptr<NodeStats>> nodes;
+      tbb::spin_mutex nodesMutex;
+      tbb::enumerable_thread_specific<SpanRing> rings;
+   };
+
+   //! Times a node body for the lifetime of the scope, eg NodeScope scope(stats, seqno) at the top of the body.
+   class NodeScope
+   //=============
+   {
+   public:
+      explicit NodeScope(NodeStats* stats, uint64_t seqno =0) : stats(stats), seqno(seqno)
+      {
+         if (stats != nullptr)
+         {
+            stats->enter();
+            start = util::now_monotonic();
+         }
+      }
+
+      ~NodeScope()
+      {
+         if (stats != nullptr)
+            NodeProfiler::instance().completed(stats, seqno, start, util::now_monotonic());
+      }
+
+      NodeScope(const NodeScope&) = delete;
+      NodeScope& operator=(const NodeScope&) = delete;
+
+   private:
+      NodeStats* stats;
+      uint64_t seqno;
+      int64_t start = 0;
+   };
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef _MAR_ROW_BANDS_HH
+#define _MAR_ROW_BANDS_HH
+
+#include <algorithm>
+
+#include "tbb/task_arena.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+#include "tbb/partitioner.h"
+
+namespace toMAR
+{
+   namespace vision
+   {
+      // Frames with fewer pixels are converted on the calling thread, below this the fork/join costs more than
+      // the parallel conversion saves.
+      constexpr int PARALLEL_MIN_PIXELS = 1280*720;
+      constexpr int BAND_ROWS = 64; // Rows per parallel task, even so chroma rows are never split between bands
+
+      // Conversions run in their own arena so they neither queue behind nor steal from the flow graph's detector
+      // and tracker tasks in the default arena.
+      inline tbb::task_arena& conversion_arena()
+      //----------------------------------------
+      {
+         static tbb::task_arena arena(std::max(2, std::min(4, tbb::this_task_arena::max_concurrency() / 2)));
+         return arena;
+      }
+
+      // Calls convert(y0, y1) for bands of rows covering [0, h), in parallel for large frames.
+      template <typename Convert>
+      void for_row_bands(int w, int h, const Convert& convert)
+      //------------------------------------------------------
+      {
+         if ( (w*h < PARALLEL_MIN_PIXELS) || (h % 2) )
+         {
+            convert(0, h);
+            return;
+         }
+         conversion_arena().execute([&]()
+         {
+            tbb::parallel_for(tbb::blocked_range<int>(0, h / 2, BAND_ROWS / 2),
+                              [&](const tbb::blocked_range<int>& r) { convert(2*r.begin(), 2*r.end()); },
+                              tbb::simple_partitioner());
+         });
+      }
+   }
+}
+#endif
@@ -0,0 +1,119 @@
+#ifndef _MAR_SHARDED_STATISTICS_HH
+#define _MAR_SHARDED_STATISTICS_HH
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+#include "tbb/enumerable_thread_specific.h"
+
+#include "mar/RunningStatistics.hh"
+#include "mar/util/LatencyHistogram.hh"
+
+namespace toMAR
+{
+   namespace util
+   {
+      /**
+       * RunningStatistics sharded per thread (tbb::enumerable_thread_specific) so that recording from several flow
+       * graph nodes never contends or races. Readers combine the shards with RunningStatistics::operator+ and merge
+       * the per-shard LatencyHistogram sketches for percentiles. Each shard is guarded by a sequence counter which
+       * the (single) owning thread bumps around an update so readers can retry instead of locking the writer out.
+       * clear() starts a new generation which each shard adopts (and resets itself for) on its next sample.
+       */
+      template <typename Int =uint64_t, typename Real=long double>
+      class ShardedStatistics
+      //=====================
+      {
+      public:
+         ShardedStatistics() = default;
+         ShardedStatistics(const ShardedStatistics&) = delete;
+         ShardedStatistics& operator=(const ShardedStatistics&) = delete;
+
+         //! Record sample x (nanoseconds) observed at CLOCK_MONOTONIC time ns.
+         void operator()(const Real x, const int64_t ns)
+         //---------------------------------------------
+         {
+            Shard& shard = shards.local();
+            const unsigned seq = shard.sequence.load(std::memory_order_relaxed);
+            shard.sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            const uint64_t current = generation.load(std::memory_order_relaxed);
+            if (shard.generation.load(std::memory_order_relaxed) != current)
+            {
+               shard.stats.clear();
+               shard.sketch.clear();
+               shard.generation.store(current, std::memory_order_relaxed);
+            }
+            shard.stats(x, ns);
+            shard.sketch.record(static_cast<int64_t>(x));
+            shard.sequence.store(seq + 2, std::memory_order_release);
+         }
+
+         //! Combined statistics over all threads that have recorded since the last clear().
+         RunningStatistics<Int, Real> combined() const
+         //-------------------------------------------
+         {
+            RunningStatistics<Int, Real> result;
+            const uint64_t current = generation.load(std::memory_order_relaxed);
+            for (const Shard& shard : shards)
+            {
+               RunningStatistics<Int, Real> snapshot;
+               unsigned before, after;
+               do
+               {
+                  before = shard.sequence.load(std::memory_order_acquire);
+                  if (before & 1u) continue; // Owner is mid update
+                  if (shard.generation.load(std::memory_order_relaxed) != current) break;
+                  snapshot = shard.stats;
+                  std::atomic_thread_fence(std::memory_order_acquire);
+                  after = shard.sequence.load(std::memory_order_relaxed);
+                  if (before == after)
+                  {
+                     result += snapshot;
+                     break;
+                  }
+               } while (true);
+            }
+            return result;
+         }
+
+         //! Merge the percentile sketches of all current shards into out.
+         void sketch(LatencyHistogram& out) const
+         //--------------------------------------
+         {
+            const uint64_t current = generation.load(std::memory_order_relaxed);
+            for (const Shard& shard : shards)
+            {
+               if (shard.generation.load(std::memory_order_relaxed) == current)
+                  shard.sketch.merge_into(out);
+            }
+         }
+
+         //! Percentiles (0-100) ps[0..n-1] returned in values[0..n-1] from a single merge of the sketches.
+         void percentiles(const double* ps, uint64_t* values, size_t n) const
+         //-----------------------------------------------------------------
+         {
+            std::unique_ptr<LatencyHistogram> merged(new LatencyHistogram);
+            sketch(*merged);
+            for (size_t i = 0; i < n; i++)
+               values[i] = merged->percentile(ps[i]);
+         }
+
+         void clear() { generation.fetch_add(1, std::memory_order_relaxed); }
+
+      private:
+         struct Shard
+         {
+            std::atomic<unsigned> sequence{0};
+            std::atomic<uint64_t> generation{0};
+            RunningStatistics<Int, Real> stats;
+            LatencyHistogram sketch;
+         };
+
+         tbb::enumerable_thread_specific<Shard> shards; // Default allocator is cache aligned
+         std::atomic<uint64_t> generation{0};
+      };
+   }
+}
+#endif
@@ -2,13 +2,61 @@
 #define _MAR_CV_H
 
 #include <vector>
+#include <memory>
 
 #include "mar/Structures.h"
 
+namespace cv { class CascadeClassifier; }
+
 namespace toMAR
 {
    namespace vision
    {
+      //! Chroma layout of YUV_420_888 planes: planar, interleaved UV (U first) or interleaved VU (V first).
+      enum class YUVLayout { I420, NV12, NV21, STRIDED };
+
+      YUVLayout yuv_layout(const void* U, const void* V, int uvPixelStride);
+
+      /**
+       * Converts YUV_420_888 planes (as returned by AImage/Image.Plane, with their row and pixel strides) to
+       * RGBA/BGRA, and to mono if mono is not null, in one pass without first packing them into I420. RGBA may be
+       * null if only mono is wanted.
+       */
+      bool Planes2RGBA(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                       int uvPixelStride, int w, int h, bool isRGBA, void* RGBA, void* mono, const char *logtag);
+
+      /**
+       * BT.601 video range YUV_420_888 to RGBA/BGRA with the numerics of cv::cvtColor(COLOR_YUV2RGBA_I420), for
+       * planar or arbitrarily strided chroma which OpenCV cannot convert in place. Large frames are converted in
+       * parallel row bands. The caller validates the dimensions (even w and h) and strides.
+       */
+      void strided_yuv2rgba(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                            int uvPixelStride, int w, int h, bool isRGBA, void* RGBA);
+
+      //! Per pixel numerics used to convert planes: OpenCV's BT.601 or those of the RenderScript kernels.
+      enum class YUVConversion : int { OPENCV = 0, RENDERSCRIPT = 1 };
+
+      /**
+       * Native equivalent of the app/rs/YUV2RGBA.rs kernels, bit exact with their 8 bit BT.601 integer arithmetic
+       * (yuvToRGBA4). If grey is not null it receives the luma plane (as YUVtoGrey) or, if isGreyWeighted, the
+       * 0.299/0.587/0.114 weighting of the first three output bytes (as YUVtoRGBAGrey/YUVtoBGRAGrey).
+       */
+      bool RSPlanes2RGBA(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                         int uvPixelStride, int w, int h, bool isRGBA, void* RGBA, void* grey, bool isGreyWeighted,
+                         const char *logtag);
+
+      //! Packs YUV_420_888 planes into contiguous I420 (w*h*3/2 bytes), the layout YUV2RGBA and recordings use.
+      void Planes2I420(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                       int uvPixelStride, int w, int h, void* I420);
+
+      /**
+       * Packs YUV_420_888 planes into NV12 (w*h luma followed by w*h/2 interleaved CbCr), the two plane layout
+       * VulkanRenderer uploads as luma and chroma textures. Only the luma rows are copied when the planes are
+       * already NV12.
+       */
+      void Planes2NV12(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                       int uvPixelStride, int w, int h, void* NV12);
+
       bool YUV2RGBA(void* YUV, void* RGBA, int w, int h, bool isRGBA, const char *logtag);
       bool YUV2Mono(void* YUV, void* mono, int w, int h, const char *logtag);
       bool NV2RGBA(void* Y, void* U, void *V, int w, int h, bool isRGBA, void* outputJavaRGB,
@@ -17,8 +65,12 @@ namespace toMAR
       bool drawBB(void* img, int width, int height, double top, double left, double bottom, double right,
                   int r, int g, int b, int stroke, const char *logtag);
       bool init_faces(void* params);
+      //! A classifier loaded from the cascade init_faces installed (null if it failed), one per concurrent detector.
+      std::shared_ptr<cv::CascadeClassifier> face_cascade();
       bool find_face(void *src, int width, int height, int minArea,  DetectRect<int>& faces,
                      const char *logtag);
+      bool find_face(cv::CascadeClassifier* classifier, void *src, int width, int height, int minArea,
+                     DetectRect<int>& faces, const char *logtag);
       void dump(unsigned long cid, uint64_t seqno, const char* nid, int w, int h,
                 void *framedata);
    }
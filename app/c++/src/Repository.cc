@@ -1,7 +1,9 @@
 #include <vector>
 #include <cassert>
+#include <algorithm>
 #include "tbb/mutex.h"
 #include "mar/Repository.h"
+#include "mar/acquisition/ImuIntegrator.h"
 
 namespace toMAR
 {
@@ -67,8 +69,8 @@ namespace toMAR
       return ret;
    };
 
-   bool Repository::add_camera(std::string camera, int qsize, bool isRearFacing)
-   //----------------------------------------------------------
+   bool Repository::add_camera(std::string camera, int qsize, bool isRearFacing, int* handle)
+   //---------------------------------------------------------------------------------------
    {
       unsigned long id = Camera::camera_ID(camera);
       if (id == std::numeric_limits<unsigned long>::max())
@@ -78,15 +80,21 @@ namespace toMAR
       if (it == cameras.end())
       {
          std::shared_ptr<Camera> sptr = std::make_shared<Camera>(camera, qsize, isRearFacing);
-         cameras.insert(std::make_pair(id, sptr));
+         auto inserted = cameras.insert(std::make_pair(id, sptr));
          assert(cameras.count(id) == 1);
+         if (inserted.second) // Not a camera added concurrently by another thread, which is discarded
+            sptr->register_metrics();
          clear_detector_stats(id);
          clear_render_stats(id);
-         return (cameras.count(id) == 1);
+         const int h = add_handle(inserted.first->second.get());
+         if (handle) *handle = h;
+         return ( (inserted.second) && (cameras.count(id) == 1) );
       }
       else
       {
          std::shared_ptr<Camera> interface = (*it).second;
+         const int h = add_handle(interface.get());
+         if (handle) *handle = h;
          if (interface->camera_id() != id)
          {
             interface->camera_id(id);
@@ -99,12 +107,43 @@ namespace toMAR
       return false;
    }
 
+   int Repository::add_handle(Camera* camera)
+   //----------------------------------------
+   {
+      const int n = std::min(noCameraHandles.load(), MAX_CAMERAS);
+      for (int i = 0; i < n; i++)
+         if (cameraHandles[i].load(std::memory_order_acquire) == camera)
+            return i;
+      const int handle = noCameraHandles.fetch_add(1);
+      if (handle >= MAX_CAMERAS)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "Repository::add_handle", "More than %d cameras", MAX_CAMERAS);
+         return -1;
+      }
+      cameraHandles[handle].store(camera, std::memory_order_release);
+      return handle;
+   }
+
+   int Repository::camera_handle(const unsigned long camera)
+   //-------------------------------------------------------
+   {
+      const int n = std::min(noCameraHandles.load(), MAX_CAMERAS);
+      for (int i = 0; i < n; i++)
+      {
+         Camera* p = cameraHandles[i].load(std::memory_order_acquire);
+         if ( (p != nullptr) && (p->camera_id() == camera) )
+            return i;
+      }
+      return -1;
+   }
+
    uint64_t Repository::new_frame(unsigned long camera, std::shared_ptr<FrameInfo>& frame)
    //------------------------------------------------------------------------------------------
    {
       uint64_t seqno = next_seqno(camera);
 //      __android_log_print(ANDROID_LOG_WARN, "Repository::new_frame()", "Seq: %lu Camera %lu", seqno, camera);
       frame->seqno = seqno;
+      ImuIntegrator::instance().on_frame(camera, seqno, frame->javaTimestamp);
       tbb::concurrent_hash_map<unsigned long,
                tbb::concurrent_hash_map<uint64_t, std::shared_ptr<FrameInfo>>*>::accessor it;
       if (! camera_frames.find(it, camera))
@@ -128,6 +167,11 @@ namespace toMAR
    //------------------------------------------------------------------------------------------------
    {
       uint64_t seqno = next_seqno(camera1);
+      // Pair before inserting so that any reader that finds one frame also finds its twin
+      if (frame1) frame1->seqno = seqno;
+      if (frame2) frame2->seqno = seqno;
+      if ( (frame1) && (frame2) )
+         stereo_pair(camera1, seqno, camera2, seqno);
       tbb::concurrent_hash_map<unsigned long,
             tbb::concurrent_hash_map<uint64_t, std::shared_ptr<FrameInfo>>*>::accessor it;
       if (! camera_frames.find(it, camera1))
@@ -156,6 +200,9 @@ namespace toMAR
          if (frames)
             frames->insert(std::make_pair(seqno, frame2));
       }
+      ImuIntegrator& imu = ImuIntegrator::instance();
+      if (frame1) imu.on_frame(camera1, seqno, frame1->javaTimestamp);
+      if (frame2) imu.on_frame(camera2, seqno, frame2->javaTimestamp);
       return seqno;
    }
 
@@ -172,7 +219,7 @@ namespace toMAR
       if ( (frames == nullptr) || (! frames->find(itf, seqno)) )
          return false;
       frame = itf->second;
-      if ( (frame) &&  (frame->rgbaLen > 0) )
+      if ( (frame) && (frame->width > 0) && (frame->height > 0) ) // rgbaLen is 0 if the RGBA conversion was skipped
          return true;
       else
       {
@@ -220,6 +267,16 @@ namespace toMAR
       return false;
    }
 
+   size_t Repository::frames_in_flight(const unsigned long camera)
+   //-------------------------------------------------------------
+   {
+      tbb::concurrent_hash_map<unsigned long,
+            tbb::concurrent_hash_map<uint64_t, std::shared_ptr<FrameInfo>>*>::const_accessor itc;
+      if ( (camera_frames.find(itc, camera)) && (itc->second != nullptr) )
+         return itc->second->size();
+      return 0;
+   }
+
    void Repository::delete_all_frames(uint64_t seqno)
    //-------------------------------------------
    {
@@ -325,24 +382,21 @@ namespace toMAR
       }
    }
 
-   RunningStatistics<uint64_t, long double>* Repository::detectionStats(const unsigned long camera,
-                                                                        bool isCreate)
-   //----------------------------------------------------------------------------------------------
+   util::ShardedStatistics<uint64_t, long double>* Repository::detectionStats(const unsigned long camera,
+                                                                              bool isCreate)
+   //----------------------------------------------------------------------------------------------------
    {
       auto it = detectorStatistics.find(camera);
-      if (it == detectorStatistics.end())
-      {
-         if (isCreate)
-         {
-            RunningStatistics<uint64_t, long double>* stats = new RunningStatistics<uint64_t, long double>;
-            detectorStatistics.insert(std::make_pair(camera, stats));
-            return stats;
-         }
-         else
-            return nullptr;
-      }
-      else
-         return  it->second;
+      if (it != detectorStatistics.end())
+         return it->second;
+      if (! isCreate)
+         return nullptr;
+      // Another node may have created the camera's statistics concurrently, so use whichever was inserted first.
+      util::ShardedStatistics<uint64_t, long double>* stats = new util::ShardedStatistics<uint64_t, long double>;
+      auto inserted = detectorStatistics.insert(std::make_pair(camera, stats));
+      if (! inserted.second)
+         delete stats;
+      return inserted.first->second;
    }
 
    void Repository::clear_detector_stats(const unsigned long camera)
@@ -353,24 +407,20 @@ namespace toMAR
          it->second->clear();
    }
 
-   RunningStatistics<uint64_t, long double>* Repository::rendererStats(const unsigned long camera,
-                                                                       bool isCreate)
-   //---------------------------------------------------------------------------------------------
+   util::ShardedStatistics<uint64_t, long double>* Repository::rendererStats(const unsigned long camera,
+                                                                             bool isCreate)
+   //---------------------------------------------------------------------------------------------------
    {
       auto it = renderStatistics.find(camera);
-      if (it == renderStatistics.end())
-      {
-         if (isCreate)
-         {
-            RunningStatistics<uint64_t, long double>* stats = new RunningStatistics<uint64_t, long double>;
-            renderStatistics.insert(std::make_pair(camera, stats));
-            return  stats;
-         }
-         else
-            return nullptr;
-      }
-      else
-         return  it->second;
+      if (it != renderStatistics.end())
+         return it->second;
+      if (! isCreate)
+         return nullptr;
+      util::ShardedStatistics<uint64_t, long double>* stats = new util::ShardedStatistics<uint64_t, long double>;
+      auto inserted = renderStatistics.insert(std::make_pair(camera, stats));
+      if (! inserted.second)
+         delete stats;
+      return inserted.first->second;
    }
 
    void Repository::clear_render_stats(const unsigned long camera)
@@ -435,6 +485,33 @@ namespace toMAR
       return 0;
    }
 
+   bool Repository::enqueue_stereo(Camera* camera1, FrameInfo* frame1, Camera* camera2, FrameInfo* frame2)
+   //-----------------------------------------------------------------------------------------------------
+   {
+      static std::atomic<uint64_t> nextPairKey{1};
+      static util::Counter* droppedPairs = util::Metrics::instance().counter("stereo.dropped_pairs");
+      // Never evicts, as an evicted frame would orphan its twin in the other queue
+      frame1->pairKey = frame2->pairKey = nextPairKey.fetch_add(1);
+      if (! Camera::enqueue_pair(camera1, frame1, camera2, frame2))
+      {
+         delete frame1;
+         delete frame2;
+         droppedPairs->add();
+         return false;
+      }
+      return true;
+   }
+
+   bool Repository::is_submitted_pair(const unsigned long camera1, const uint64_t seq1,
+                                      const unsigned long camera2, const uint64_t seq2)
+   //---------------------------------------------------------------------------------
+   {
+      std::shared_ptr<FrameInfo> frame1, frame2;
+      if ( (! get_frame(camera1, seq1, frame1)) || (! get_frame(camera2, seq2, frame2)) )
+         return false;
+      return (frame1->pairKey == frame2->pairKey);
+   }
+
    void Repository::stereo_pair(const unsigned long camera1, const uint64_t seq1,
                                 const unsigned long camera2, const uint64_t seq2)
    //-----------------------------------------------------------------------------
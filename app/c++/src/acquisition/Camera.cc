@@ -14,18 +14,72 @@ namespace toMAR
 #endif
    {
       repository = Repository::instance();
+      name = cameraId;
       id = camera_ID(cameraId);
 #ifndef LOCK_FREE_QUEUE
       queue.set_capacity(queueSize);
 #endif
+      util::Metrics& metrics = util::Metrics::instance();
+      droppedFrames = metrics.counter("camera." + cameraId + ".dropped");
+      queueGauge = "camera." + cameraId + ".queue_depth";
+   }
+
+   Camera::~Camera() { util::Metrics::instance().remove(queueGauge, this); }
+
+   void Camera::register_metrics()
+   //-----------------------------
+   {
+      // The exporter polls outside the repository, so it holds a weak reference rather than this
+      std::weak_ptr<Camera> camera = weak_from_this();
+      util::Metrics::instance().gauge(queueGauge, [camera]() -> int64_t
+      {
+         std::shared_ptr<Camera> sp = camera.lock();
+         return (sp) ? static_cast<int64_t>(sp->queue_size()) : 0;
+      }, this);
+   }
+
+   bool Camera::enqueue_pair(Camera* camera1, FrameInfo* frame1, Camera* camera2, FrameInfo* frame2)
+   //-----------------------------------------------------------------------------------------------
+   {
+      if (camera1 == camera2)
+         return false;
+      // Both producer locks (taken in address order) keep every other producer out, and consumers only make space,
+      // so queues that are not full here cannot fill before both frames are pushed.
+      Camera* first = std::min(camera1, camera2);
+      Camera* second = std::max(camera1, camera2);
+      tbb::spin_mutex::scoped_lock lock1(first->producerMutex), lock2(second->producerMutex);
+      if ( (camera1->is_full()) || (camera2->is_full()) )
+         return false;
+      std::shared_ptr<FrameInfo> sp1(frame1), sp2(frame2);
+      camera1->push(sp1);
+      camera2->push(sp2);
+      return true;
+   }
+
+   bool Camera::is_rgba_needed()
+   //---------------------------
+   {  // A renderer that can use the NV12 copy (isYUVRendering) uploads that instead
+      return ( (isRGBADetected.load(std::memory_order_relaxed)) ||
+               ( (isRGBARendered.load(std::memory_order_relaxed)) &&
+                 (! repository->isYUVRendering.load(std::memory_order_relaxed)) ) );
+   }
+
+   void Camera::interrupt()
+   //----------------------
+   {
+      std::shared_ptr<FrameInfo> empty;
+      push(empty);
    }
 
 #ifdef LOCK_FREE_QUEUE
+   bool Camera::push(std::shared_ptr<FrameInfo>& data) { return queue.try_enqueue(data); }
+
    bool Camera::enqueue(FrameInfo* data)
    //------------------------------------
    {
       std::shared_ptr<FrameInfo> sp(data);
-      if (! queue.try_enqueue(sp))
+      tbb::spin_mutex::scoped_lock lock(producerMutex);
+      if (! push(sp))
       {
          __android_log_print(ANDROID_LOG_WARN, "Camera::enqueue", "Queue full");
          std::shared_ptr<FrameInfo> old_data;
@@ -36,6 +90,7 @@ namespace toMAR
                uint64_t seq = old_data->seqno;
                old_data.reset();
                repository->delete_frame(seq);
+               droppedFrames->add();
             }
             if (queue.try_enqueue(sp))
                return true;
@@ -43,6 +98,7 @@ namespace toMAR
       }
       else
          return true;
+      droppedFrames->add();
       return false;
    }
 
@@ -75,11 +131,14 @@ namespace toMAR
 
    long Camera::queue_size() { return queue.size_approx(); }
 #else
+   bool Camera::push(std::shared_ptr<FrameInfo>& data) { return queue.try_push(data); }
+
    bool Camera::enqueue(FrameInfo* data)
    //------------------------------------
    {
       std::shared_ptr<FrameInfo> sp(data);
-      if (! queue.try_push(sp))
+      tbb::spin_mutex::scoped_lock lock(producerMutex);
+      if (! push(sp))
       {
          __android_log_print(ANDROID_LOG_WARN, "Camera::enqueue", "Queue full");
          std::shared_ptr<FrameInfo> old_data;
@@ -90,6 +149,7 @@ namespace toMAR
                uint64_t seq = old_data->seqno;
                old_data.reset();
                repository->delete_frame(id, seq);
+               droppedFrames->add();
             }
             if (queue.try_push(sp))
                return true;
@@ -97,6 +157,7 @@ namespace toMAR
       }
       else
          return true;
+      droppedFrames->add();
       return false;
    }
 
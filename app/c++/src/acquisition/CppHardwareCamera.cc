@@ -1,349 +1,384 @@
-#include "HardwareCamera.h"
+#include <cstring>
+#include <algorithm>
 
-#include <opencv2/core/core.hpp>
-#include <opencv2/core/mat.hpp>
-#include <opencv2/imgproc.hpp>
-#include <opencv2/imgcodecs.hpp>
+#include <android/log.h>
 
-#include "util.h"
+#include "mar/acquisition/CppHardwareCamera.h"
+#include "mar/Repository.h"
+#include "mar/acquisition/Camera.h"
+#include "mar/acquisition/FrameInfo.h"
+#include "mar/acquisition/Recording.h"
+#include "mar/util/Metrics.h"
+#include "mar/util/CpuPlacement.h"
+#include "mar/util/cv.h"
 
-bool HardwareCamera::open(const std::string& id)
-//----------------------------------------------
+namespace toMAR
 {
-   ACameraManager* manager = camera_manager.get();
-   ACameraIdList *camera_list = nullptr;
-   if (ACameraManager_getCameraIdList(manager, &camera_list) == ACAMERA_OK)
+   struct Planes
    {
+      uint8_t* data[3];
+      int lengths[3];
+      int32_t rowStrides[3], pixelStrides[3];
+   };
+
+   // Plane pointers and strides of a YUV_420_888 image of w x h, false if they do not cover the image.
+   static bool image_planes(AImage* image, int w, int h, Planes& planes)
+   //-------------------------------------------------------------------
+   {
+      for (int32_t i = 0; i < 3; i++)
+      {
+         if ( (AImage_getPlaneData(image, i, &planes.data[i], &planes.lengths[i]) != AMEDIA_OK) ||
+              (planes.lengths[i] <= 0) ||
+              (AImage_getPlaneRowStride(image, i, &planes.rowStrides[i]) != AMEDIA_OK) ||
+              (AImage_getPlanePixelStride(image, i, &planes.pixelStrides[i]) != AMEDIA_OK) )
+            return false;
+      }
+      if ( (planes.rowStrides[0] < w) || (planes.lengths[0] < planes.rowStrides[0]*(h - 1) + w) ||
+           (planes.rowStrides[1] != planes.rowStrides[2]) || (planes.pixelStrides[1] != planes.pixelStrides[2]) )
+         return false;
+      for (int i = 1; i < 3; i++)
+         if (planes.lengths[i] < planes.rowStrides[i]*(h/2 - 1) + planes.pixelStrides[i]*(w/2 - 1) + 1)
+            return false;
+      return true;
+   }
+
+   CppHardwareCamera::CppHardwareCamera(Camera* camera, std::shared_ptr<ACameraManager> manager) : camera(camera)
+   //------------------------------------------------------------------------------------------------------------
+   {
+      if (manager)
+         camera_manager = manager;
+      else
+         camera_manager.reset(ACameraManager_create(), ManagerDeleter());
+   }
+
+   bool CppHardwareCamera::open(const std::string& id)
+   //-------------------------------------------------
+   {
+      if (is_open)
+         close();
+      ACameraManager* manager = camera_manager.get();
+      ACameraIdList *camera_list = nullptr;
+      if ( (manager == nullptr) || (ACameraManager_getCameraIdList(manager, &camera_list) != ACAMERA_OK) )
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::open", "Could not list cameras");
+         return false;
+      }
       auto list_deleter = [](ACameraIdList* p){ if (p != nullptr) ACameraManager_deleteCameraIdList(p); };
       std::unique_ptr<ACameraIdList, decltype(list_deleter)> cameras(camera_list, list_deleter);
       for (int i = 0; i < cameras->numCameras; ++i)
       {
          const std::string cid(cameras->cameraIds[i]);
+         if ( (! id.empty()) && (id != cid) )
+            continue;
          ACameraMetadata* metadata_p;
-         if (ACameraManager_getCameraCharacteristics(manager, cid.c_str(), &metadata_p) == ACAMERA_OK)
+         if (ACameraManager_getCameraCharacteristics(manager, cid.c_str(), &metadata_p) != ACAMERA_OK)
+            continue;
+         std::unique_ptr<ACameraMetadata, MetaDeleter> meta_data(metadata_p);
+         if (id.empty())
          {
-            MetaDeleter deleter;
-            std::unique_ptr<ACameraMetadata, MetaDeleter> meta_data(metadata_p, deleter);
-            if (! id.empty())
-            {
-               if (id == cid)
-               {
-                  camera_id = id;
-                  metadata = std::move(meta_data);
-                  break;
-               }
-               else
-                  continue;
-            }
-            int32_t count = 0;
-            const uint32_t* tags = nullptr;
-            ACameraMetadata_getAllTags(meta_data.get(), &count, &tags);
-            for (int tagIdx = 0; tagIdx < count; ++tagIdx)
-            {
-               if (tags[tagIdx] == ACAMERA_LENS_FACING_BACK)
-               {
-                  ACameraMetadata_const_entry lensInfo = { 0 };
-                  if (ACameraMetadata_getConstEntry(meta_data.get(), tags[tagIdx], &lensInfo) == ACAMERA_OK)
-                  {
-                     auto facing = static_cast<acamera_metadata_enum_android_lens_facing_t>(lensInfo.data.u8[0]);
-                     if (facing == ACAMERA_LENS_FACING_BACK)
-                     {
-                        camera_id = cid;
-                        metadata = std::move(meta_data);
-                        break;
-                     }
-                  }
-               }
-            }
+            ACameraMetadata_const_entry lensInfo = { 0 };
+            if ( (ACameraMetadata_getConstEntry(meta_data.get(), ACAMERA_LENS_FACING, &lensInfo) != ACAMERA_OK) ||
+                 (lensInfo.data.u8[0] != ACAMERA_LENS_FACING_BACK) )
+               continue;
          }
+         camera_id = cid;
+         metadata = std::move(meta_data);
+         break;
       }
       if (camera_id.empty())
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::open", "Camera %s not found",
+                             (id.empty()) ? "(rear facing)" : id.c_str());
          return false;
-   }
-   else
-      return false;
-   if (camera_id.empty())
-      return false;
-   device_listener.context = static_cast<void *>(this);
-   device_listener.onDisconnected = &HardwareCamera::onDisconnected;
-   device_listener.onError = &HardwareCamera::onError;
-   ACameraDevice *cameradevice = nullptr;
-   if ( ACameraManager_openCamera(manager, camera_id.c_str(), &device_listener, &cameradevice) != ACAMERA_OK)
-   {
-      camera_id = "";
-      metadata.reset();
-      return false;
-   }
-   camera_device.reset(cameradevice);
-   is_open = true;
-   return true;
-}
+      }
+      device_listener.context = static_cast<void *>(this);
+      device_listener.onDisconnected = &CppHardwareCamera::onDisconnected;
+      device_listener.onError = &CppHardwareCamera::onError;
+      ACameraDevice *cameradevice = nullptr;
+      if (ACameraManager_openCamera(manager, camera_id.c_str(), &device_listener, &cameradevice) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::open", "Error opening camera %s",
+                             camera_id.c_str());
+         camera_id = "";
+         metadata.reset();
+         return false;
+      }
+      camera_device.reset(cameradevice);
+      is_open = true;
 
-bool HardwareCamera::start_preview(std::string dir, int w, int h)
-//---------------------------------------------------
-{
-   if (is_previewing)
-      stop_preview();
-   if ( (! is_open) || (! camera_device) )
-   {
-      LOGE("HardwareCamera::start_preview: Camera not initialized before start_preview called");
-      return false;
-   }
-   // AImageReader wouldn't be necessary if yuv_alloc->getSurface() worked in the NDK.
-   AImageReader *imgreader;
-   if (AImageReader_new(w, h, AIMAGE_FORMAT_YUV_420_888, 2, &imgreader) != AMEDIA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Could not create image reader for AIMAGE_FORMAT_YUV_420_888 of size 2");
-      return false;
-   }
-   img_reader.reset(imgreader);
-   image_listener.context = this; image_listener.onImageAvailable = onImageCallback;
-   if (AImageReader_setImageListener(imgreader, &image_listener) != AMEDIA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Error setting listener for ImageReader");
-      img_reader.reset(nullptr);
-      return false;
-   }
-   if (AImageReader_getWindow(imgreader, &surface) != AMEDIA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Error getting surface from ImageReader");
-      img_reader.reset(nullptr);
-      return false;
+      // Lens and sensor geometry for the overlay reprojection (see OverlayReprojection)
+      const ACameraMetadata* meta = metadata.get();
+      auto entry = [meta](uint32_t tag, ACameraMetadata_const_entry& e)
+      { return ( (ACameraMetadata_getConstEntry(meta, tag, &e) == ACAMERA_OK) && (e.count > 0) ); };
+      ACameraMetadata_const_entry focalLengths = { 0 }, sensorSize = { 0 }, orientation = { 0 };
+      if ( (camera != nullptr) && (entry(ACAMERA_LENS_INFO_AVAILABLE_FOCAL_LENGTHS, focalLengths)) &&
+           (entry(ACAMERA_SENSOR_INFO_PHYSICAL_SIZE, sensorSize)) && (sensorSize.count >= 2) )
+      {
+         const int sensorOrientation = (entry(ACAMERA_SENSOR_ORIENTATION, orientation)) ? orientation.data.i32[0]
+                                                                                         : 90;
+         camera->optics(focalLengths.data.f[0], sensorSize.data.f[0], sensorSize.data.f[1], sensorOrientation);
+      }
+      return true;
    }
 
-   if (renderscript.get() != nullptr)
-      renderscript->finish();
-   renderscript.clear();
-   renderscript = new android::RSC::RS();
-   if (renderscript->init(dir.c_str()))
+   bool CppHardwareCamera::start_preview(int w, int h, bool isRGBA, bool hasMono)
+   //---------------------------------------------------------------------------
    {
-      yuv2rgba_script.reset(new ScriptC_yuv2rgba(renderscript));
-      android::RSC::sp<const android::RSC::Element> yuv_element = android::RSC::Element::YUV(renderscript);
-      android::RSC::sp<const android::RSC::Type> yuv_type = android::RSC::Type::create(renderscript, yuv_element, w, h, 0);
-      yuv_alloc.clear();
-      yuv_alloc = android::RSC::Allocation::createTyped(renderscript, yuv_type, RS_ALLOCATION_MIPMAP_NONE,
-                                                        RS_ALLOCATION_USAGE_IO_INPUT | RS_ALLOCATION_USAGE_SCRIPT);
-   //   android::RSC::sp<android::Surface> yuv_surface = yuv_alloc->getSurface(); //Surface not defined anywhere (forward declaration in toolchains/renderscript/prebuilt/linux-x86_64/platform/rs/cpp/rsCppStructs.h)
-   //   android::Surface* yuv_surface = yuv_alloc->getSurface().get();      
+      if (is_previewing)
+         stop_preview();
+      if ( (! is_open) || (! camera_device) || (camera == nullptr) )
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview",
+                             "Camera not opened before start_preview called");
+         return false;
+      }
+      if ( (w <= 0) || (h <= 0) || (w % 2) || (h % 2) )
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Invalid size %dx%d", w, h);
+         return false;
+      }
+      camera_width = w; camera_height = h;
+      this->isRGBA = isRGBA; this->hasMono = hasMono;
+      camera->preview_size(w, h);
+      const size_t queued = static_cast<size_t>(std::max(camera->queue_capacity(), 1L)) + 2;
+      rgbaPool = std::make_shared<util::BufferPool>(static_cast<size_t>(w*h*4), queued);
+      monoPool = (hasMono) ? std::make_shared<util::BufferPool>(static_cast<size_t>(w*h), queued) : nullptr;
+      yuvPool = std::make_shared<util::BufferPool>(static_cast<size_t>(w*h + w*h/2), queued);
 
-      android::RSC::sp<const android::RSC::Element> rgba_element = android::RSC::Element::RGBA_8888(renderscript);
-      android::RSC::sp<const android::RSC::Type> rgba_type = android::RSC::Type::create(renderscript, rgba_element, w, h, 0);
-      rgba_alloc.clear();
-      rgba_alloc = android::RSC::Allocation::createTyped(renderscript, rgba_type, RS_ALLOCATION_MIPMAP_NONE,
-                                                         RS_ALLOCATION_USAGE_SHARED | RS_ALLOCATION_USAGE_SCRIPT);
-      android::RSC::sp<const android::RSC::Element> grey_element = android::RSC::Element::U8(renderscript);
-      android::RSC::sp<const android::RSC::Type> grey_type = android::RSC::Type::create(renderscript, grey_element, w, h, 0);
-      grey_alloc = android::RSC::Allocation::createTyped(renderscript, grey_type, RS_ALLOCATION_MIPMAP_NONE,
-                                                         RS_ALLOCATION_USAGE_SHARED | RS_ALLOCATION_USAGE_SCRIPT);
-   }
-   else
-   {
-      LOGE("HardwareCamera::start_preview: Error initializing renderscript with directory %s", dir.c_str());
-      renderscript.clear();
-   }
+      AImageReader *imgreader;
+      if (AImageReader_new(w, h, AIMAGE_FORMAT_YUV_420_888, MAX_IMAGES, &imgreader) != AMEDIA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview",
+                             "Could not create image reader for AIMAGE_FORMAT_YUV_420_888 %dx%d", w, h);
+         return false;
+      }
+      img_reader.reset(imgreader);
+      image_listener.context = this; image_listener.onImageAvailable = onImageCallback;
+      if (AImageReader_setImageListener(imgreader, &image_listener) != AMEDIA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview",
+                             "Error setting listener for ImageReader");
+         img_reader.reset(nullptr);
+         return false;
+      }
+      if (AImageReader_getWindow(imgreader, &surface) != AMEDIA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview",
+                             "Error getting surface from ImageReader");
+         img_reader.reset(nullptr);
+         return false;
+      }
 
-   ACameraDevice* device = camera_device.get();
-   session_listener.context = this;
-   session_listener.onActive = onSessionActive; session_listener.onReady = onSessionReady;session_listener.onClosed = onSessionClosed;
-   ACaptureSessionOutputContainer* outputs;
-   if (ACaptureSessionOutputContainer_create(&outputs) != ACAMERA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Error creating session output container.");
-      stop_preview();
-      return false;
-   }
-   yuv_outputs.reset(outputs);
-   ACaptureSessionOutput* output;
-   if (ACaptureSessionOutput_create(surface, &output)!= ACAMERA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Error creating session output.");
-      stop_preview();
-      return false;
-   }
-   yuv_output.reset(output);
-   if (ACaptureSessionOutputContainer_add(outputs, output) != ACAMERA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Error adding session output.");
-      stop_preview();
-      return false;
-   }
-   ACameraOutputTarget* target;
-   if (ACameraOutputTarget_create(surface, &target) != ACAMERA_OK)
-   {
-      LOGE("HardwareCamera::start_preview: Error creating target.");
-      stop_preview();
-      return false;
+      ACameraDevice* device = camera_device.get();
+      session_listener.context = this;
+      session_listener.onActive = onSessionActive; session_listener.onReady = onSessionReady;
+      session_listener.onClosed = onSessionClosed;
+      ACaptureSessionOutputContainer* outputs;
+      if (ACaptureSessionOutputContainer_create(&outputs) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview",
+                             "Error creating session output container.");
+         stop_preview();
+         return false;
+      }
+      yuv_outputs.reset(outputs);
+      ACaptureSessionOutput* output;
+      if (ACaptureSessionOutput_create(surface, &output)!= ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Error creating session output.");
+         stop_preview();
+         return false;
+      }
+      yuv_output.reset(output);
+      if (ACaptureSessionOutputContainer_add(outputs, output) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Error adding session output.");
+         stop_preview();
+         return false;
+      }
+      ACameraOutputTarget* target;
+      if (ACameraOutputTarget_create(surface, &target) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Error creating target.");
+         stop_preview();
+         return false;
+      }
+      output_target.reset(target);
+      ACaptureRequest* capture_request;
+      if (ACameraDevice_createCaptureRequest(device, TEMPLATE_RECORD, &capture_request) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Error creating capture request");
+         stop_preview();
+         return false;
+      }
+      request.reset(capture_request);
+      if (ACaptureRequest_addTarget(capture_request, target) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview",
+                             "Error binding target to capture request");
+         stop_preview();
+         return false;
+      }
+      ACameraCaptureSession* sess;
+      if (ACameraDevice_createCaptureSession(device, outputs, &session_listener, &sess) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Error creating session.");
+         stop_preview();
+         return false;
+      }
+      session.reset(sess);
+      is_previewing = true;
+      if (ACameraCaptureSession_setRepeatingRequest(sess, nullptr, 1, &capture_request, nullptr) != ACAMERA_OK)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::start_preview", "Error starting repeat requests.");
+         stop_preview();
+         return false;
+      }
+      return true;
    }
-   output_target.reset(target);
-   if (ACameraDevice_createCaptureRequest(device, TEMPLATE_RECORD, &request) != ACAMERA_OK)
+
+   void CppHardwareCamera::stop_preview()
+   //-----------------------------------
    {
-      LOGE("HardwareCamera::start_preview: Error creating capture request");
-      stop_preview();
-      return false;
+      is_previewing = false;
+      session.reset(nullptr);
+      if (img_reader)
+         AImageReader_setImageListener(img_reader.get(), nullptr);
+      request.reset(nullptr);
+      output_target.reset(nullptr);
+      yuv_output.reset(nullptr);
+      yuv_outputs.reset(nullptr);
+      img_reader.reset(nullptr);
+      surface = nullptr;
+      camera_width = camera_height = -1;
    }
-   if (ACaptureRequest_addTarget(request, target) != ACAMERA_OK)
+
+   void CppHardwareCamera::close()
+   //-----------------------------
    {
-      LOGE("HardwareCamera::start_preview: Error binding target to capture request");
       stop_preview();
-      return false;
+      camera_device.reset(nullptr);
+      metadata.reset(nullptr);
+      camera_id = "";
+      is_open = false;
    }
-   ACameraCaptureSession* sess;
-   if (ACameraDevice_createCaptureSession(device, outputs, &session_listener, &sess) != ACAMERA_OK)
+
+   void CppHardwareCamera::on_camera_disconnect()
+   //--------------------------------------------
    {
-      LOGE("HardwareCamera::start_preview: Error creating session output.");
-      stop_preview();
-      return false;
+      __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::on_camera_disconnect", "Camera %s disconnected",
+                          camera_id.c_str());
+      is_previewing = false;
    }
-   session.reset(sess);
-   if (ACameraCaptureSession_setRepeatingRequest(sess, nullptr, 1, &request, nullptr) != ACAMERA_OK)
+
+   void CppHardwareCamera::on_error(int err)
+   //---------------------------------------
    {
-      LOGE("HardwareCamera::start_preview: Error starting repeat requests.");
-      stop_preview();
-      return false;
+      __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::on_error", "Camera %s error %d", camera_id.c_str(),
+                          err);
    }
-   is_previewing = true;
-   rgba_size = w*h*4;
-   camera_width = w; camera_height = h;
-   rgba_data.reset(new unsigned char[rgba_size]);
-   return true;
-}
 
-void HardwareCamera::stop_preview()
-//--------------------------------
-{
-   session.reset(nullptr);
-   output_target.reset(nullptr);
-   img_reader.reset(nullptr);
-   yuv_outputs.reset(nullptr);
-   yuv_output.reset(nullptr);
-   if (renderscript.get() != nullptr)
-      renderscript->finish();
-   renderscript.clear();
-   rgba_size = 0;
-   camera_width = camera_height = -1;
-   is_previewing = false;
-}
-
-void HardwareCamera::on_camera_disconnect()
-//-------------------------------
-{
-   LOGE("Camera %s disconnected", camera_id.c_str());
-   if (is_previewing)
-      stop_preview();
-   camera_device.reset(nullptr);
-   metadata.reset(nullptr);
-   is_open = false;
-}
-
-void HardwareCamera::on_error(int err) { LOGE("Camera %s error %d", camera_id.c_str(), err); }
-
-void HardwareCamera::on_image_available(AImageReader *reader)
-//--------------------------------------------------------
-{
-   static int badcount = 0;
-   int32_t format;
-   media_status_t status = AImageReader_getFormat(reader, &format);
-   if ( (status == AMEDIA_OK) && (format == AIMAGE_FORMAT_YUV_420_888) )
+   void CppHardwareCamera::on_image_available(AImageReader *reader)
+   //--------------------------------------------------------------
    {
-      AImage *image;
-      status = AImageReader_acquireNextImage(reader, &image);
-      if (status == AMEDIA_OK)
+      static util::Counter* errors = util::Metrics::instance().counter("native_camera.errors");
+      static util::Counter* frames = util::Metrics::instance().counter("native_camera.frames");
+      AImage *acquired = nullptr;
+      media_status_t status = AImageReader_acquireLatestImage(reader, &acquired);
+      if (status != AMEDIA_OK)
       {
-         uint8_t *Y = nullptr, *U = nullptr, *V = nullptr;
-         int ylen = 0, ulen = 0, vlen =0;
-         media_status_t ystatus = AImage_getPlaneData(image, 0, &Y, &ylen);
-         media_status_t ustatus = AImage_getPlaneData(image, 1, &U, &ulen);
-         media_status_t vstatus = AImage_getPlaneData(image, 2, &V, &vlen);
-         if ( (ystatus != AMEDIA_OK) || (ylen <= 0) || (ustatus != AMEDIA_OK) || (ulen <= 0) || (vstatus != AMEDIA_OK) || (vlen <= 0) )
+         if (status != AMEDIA_IMGREADER_NO_BUFFER_AVAILABLE)
          {
-            if (badcount++ < 200)
-               LOGE("HardwareCamera::on_image_available: AImage_getPlaneData failed (%d %d %d", ystatus, ustatus, vstatus);
+            if (errors->value() < 200)
+               __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::on_image_available",
+                                   "AImageReader_acquireLatestImage error %d", status);
+            errors->add();
          }
-         else
-         {
-            int64_t ts;
-            AImage_getTimestamp(image, &ts);
-            int32_t width, height, ystride, ustride, vstride;
-            AImage_getHeight(image, &height);
-            AImage_getWidth(image, &width);
-            AImage_getPlaneRowStride(image, 0, &ystride);
-            AImage_getPlaneRowStride(image, 1, &ustride);
-            AImage_getPlaneRowStride(image, 2, &vstride);
-            LOGW("HardwareCamera::on_image_available: height: %d, stride: %d", height, ystride);
-//            std::unique_ptr<unsigned char> rgb_data(mar::util::cpuYUV2RGB(Y, U, V, ylen, ulen, ystride, height));
-            std::unique_ptr<unsigned char> rgb_data(mar::util::YUVRaw(Y, U, V, width, height,
-                                                                      ylen, ulen, vlen, ustride, vstride));
-            cv::Mat yuv(camera_height + camera_height/2, camera_width, CV_8UC1, rgb_data.get());
-            cv::Mat rgb;
-            cv::cvtColor(yuv, rgb, cv::COLOR_YUV420p2BGR);
-            // cv::Mat rgb(camera_height, camera_width, CV_8UC3, rgb_data.get());
-            cv::imwrite("/sdcard/framebuffer.png", rgb);
-/*
-            Image.Plane Yplane = planes[0];
-            Image.Plane Uplane = planes[1];
-            Image.Plane Vplane = planes[2];
-            ByteBuffer Y = Yplane.getBuffer();
-            ByteBuffer U = Uplane.getBuffer();
-            ByteBuffer V = Vplane.getBuffer();
-            Y.rewind();
-            U.rewind();
-            V.rewind();
-
- */
+         return;
+      }
+      std::unique_ptr<AImage, ImageDeleter> image(acquired);
+      if (! is_previewing.load())
+         return;
+      int64_t ts = 0;
+      int32_t format = 0, width = 0, height = 0;
+      AImage_getFormat(acquired, &format);
+      AImage_getTimestamp(acquired, &ts);
+      AImage_getWidth(acquired, &width);
+      AImage_getHeight(acquired, &height);
+      Planes planes;
+      if ( (format != AIMAGE_FORMAT_YUV_420_888) || (width != camera_width) || (height != camera_height) ||
+           (! image_planes(acquired, width, height, planes)) )
+      {
+         if (errors->value() < 200)
+            __android_log_print(ANDROID_LOG_ERROR, "CppHardwareCamera::on_image_available",
+                                "Unusable image format %d %dx%d (expected %dx%d)", format, width, height,
+                                camera_width, camera_height);
+         errors->add();
+         return;
+      }
 
-//            yuv_alloc->copy1DFrom(data); // This wouldn't be necessary if yuv_alloc->getSurface() worked in the NDK and the AImageReader was dropped
-//            yuv2rgba_script->set_in(yuv_alloc);
-//            yuv2rgba_script->forEach_yuv2rgba(rgba_alloc);
-//            rgba_alloc->copy1DTo(rgba_data.get());
-//            cv::Mat rgba(camera_height, camera_width, CV_8UC4, image);
-//            cv::imwrite("/sdcard/framebuffer.png", rgba);
-         }
-         AImage_delete(image);
+      StreamRecorder& recorder = StreamRecorder::instance();
+      if (recorder.is_recording())
+      {
+         yuv.resize(static_cast<size_t>(width*height + width*height/2));
+         toMAR::vision::Planes2I420(planes.data[0], planes.data[1], planes.data[2], planes.rowStrides[0],
+                                    planes.rowStrides[1], planes.pixelStrides[1], width, height, yuv.data());
+         recorder.record_frame(camera->camera_name(), camera->camera_id(), ts, width, height, isRGBA, hasMono,
+                               camera->is_rear_facing(), yuv.data(), yuv.size());
       }
-      else
-         if (badcount++ < 200)
-            LOGE("HardwareCamera::on_image_available: AImageReader_acquireNext/LatestImage error %d", status);
+      // Skip the RGBA conversion when neither the camera's detector nor the renderer would read it
+      std::unique_ptr<unsigned char[]> rgba((camera->is_rgba_needed()) ? rgbaPool->acquire() : nullptr), mono;
+      if (monoPool)
+         mono.reset(monoPool->acquire());
+      const bool isConverted = toMAR::vision::Planes2RGBA(planes.data[0], planes.data[1], planes.data[2],
+                                                          planes.rowStrides[0], planes.rowStrides[1],
+                                                          planes.pixelStrides[1], width, height, isRGBA,
+                                                          rgba.get(), mono.get(),
+                                                          "CppHardwareCamera::on_image_available");
+      std::unique_ptr<unsigned char[]> nv12;
+      if ( (isConverted) && (Repository::instance()->isYUVRendering.load(std::memory_order_relaxed)) )
+      {
+         nv12.reset(yuvPool->acquire());
+         toMAR::vision::Planes2NV12(planes.data[0], planes.data[1], planes.data[2], planes.rowStrides[0],
+                                    planes.rowStrides[1], planes.pixelStrides[1], width, height, nv12.get());
+      }
+      image.reset(); // Return the image to the reader as soon as its planes have been read
+      if (! isConverted)
+      {
+         rgbaPool->release(rgba.release());
+         if (monoPool)
+            monoPool->release(mono.release());
+         errors->add();
+         return;
+      }
+      const int rgbaLen = (rgba) ? width*height*4 : 0, monoLen = (mono) ? width*height : 0;
+      FrameInfo* frame = new FrameInfo(camera->camera_id(), ts, width, height,
+                                       (isRGBA) ? ColorFormats::RGBA : ColorFormats::BGRA, rgbaLen,
+                                       std::move(rgba), monoLen, std::move(mono));
+      frame->rgbaPool = rgbaPool;
+      frame->monoPool = monoPool;
+      frame->nativeYuv = std::move(nv12);
+      frame->yuvPool = yuvPool;
+      camera->enqueue(frame);
+      frames->add();
    }
-   else
-   if (badcount++ < 200)
-      LOGE("HardwareCamera::on_image_available: AImageReader_getFormat error %d format %d", status, format);
-
-}
-
-void HardwareCamera::onDisconnected(void *context, ACameraDevice *device)
-{
-   HardwareCamera* camera = static_cast<HardwareCamera*>(context);
-   camera->on_camera_disconnect();
-}
-
-void HardwareCamera::onError(void *context, ACameraDevice *device, int error)
-{
-   HardwareCamera* camera = static_cast<HardwareCamera*>(context);
-   camera->on_error(error);
-}
-
-void HardwareCamera::onImageCallback(void *context, AImageReader* reader)
-{
-   HardwareCamera* camera = static_cast<HardwareCamera*>(context);
-   camera->on_image_available(reader);
-}
 
-void HardwareCamera::onSessionActive(void *context, ACameraCaptureSession *session)
-{
-   HardwareCamera* camera = static_cast<HardwareCamera*>(context);
-   camera->on_session_active(session);
-}
+   void CppHardwareCamera::onDisconnected(void *context, ACameraDevice *device)
+   {
+      CppHardwareCamera* camera = static_cast<CppHardwareCamera*>(context);
+      camera->on_camera_disconnect();
+   }
 
-void HardwareCamera::onSessionReady(void *context, ACameraCaptureSession *session)
-{
-   HardwareCamera* camera = static_cast<HardwareCamera*>(context);
-   camera->on_session_ready(session);
-}
+   void CppHardwareCamera::onError(void *context, ACameraDevice *device, int error)
+   {
+      CppHardwareCamera* camera = static_cast<CppHardwareCamera*>(context);
+      camera->on_error(error);
+   }
 
-void HardwareCamera::onSessionClosed(void *context, ACameraCaptureSession *session)
-{
-   HardwareCamera* camera = static_cast<HardwareCamera*>(context);
-   camera->on_session_closed(session);
+   void CppHardwareCamera::onImageCallback(void *context, AImageReader* reader)
+   {
+      util::CpuPlacement::instance().pin_current_thread(util::StageClass::CAMERA);
+      CppHardwareCamera* camera = static_cast<CppHardwareCamera*>(context);
+      camera->on_image_available(reader);
+   }
 }
-
-
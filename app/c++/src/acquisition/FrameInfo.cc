@@ -1,12 +1,18 @@
 #include "mar/acquisition/FrameInfo.h"
+#include "mar/util/JniThreads.h"
 
 namespace toMAR
 {
    unsigned char *FrameInfo::getColorData(void *&context)
    //------------------------------------------
    {
+      if (nativeRgba)
+      {
+         context = nullptr;
+         return nativeRgba.get();
+      }
       JNIEnv *env;
-      if (getEnv(env))
+      if ( (rgba != nullptr) && (getEnv(env)) )
       {
          void *p = env->GetPrimitiveArrayCritical(rgba, 0);
          context = static_cast<void *>(env);
@@ -19,6 +25,8 @@ namespace toMAR
    void FrameInfo::releaseColorData(void *context, unsigned char *p)
    //----------------------------------
    {
+      if ( (nativeRgba) || (p == nullptr) )
+         return;
       JNIEnv *env = static_cast<JNIEnv *>(context);
       if (env == nullptr)
       {
@@ -40,6 +48,11 @@ namespace toMAR
    unsigned char *FrameInfo::getMonoData(void *&context)
    //------------------------------------------
    {
+      if (nativeMono)
+      {
+         context = nullptr;
+         return nativeMono.get();
+      }
       JNIEnv *env;
       if (getEnv(env))
       {
@@ -54,6 +67,8 @@ namespace toMAR
    void FrameInfo::releaseMonoData(void *context, unsigned char *p)
    //---------------------------------------------------
    {
+      if (nativeMono)
+         return;
       JNIEnv *env = static_cast<JNIEnv *>(context);
       if (env == nullptr)
       {
@@ -76,6 +91,14 @@ namespace toMAR
    //-----------------------
    {
       // __android_log_print(ANDROID_LOG_INFO, "FrameInfo::dispose()", "Disposing camera %lu seq %lu", camera_id, seqno);
+      if (rgbaPool)
+         rgbaPool->release(nativeRgba.release());
+      if (monoPool)
+         monoPool->release(nativeMono.release());
+      if (yuvPool)
+         yuvPool->release(nativeYuv.release());
+      if ( (rgba == nullptr) && (mono == nullptr) )
+         return; // Natively owned data is freed with the FrameInfo
       JNIEnv *env;
       if (getEnv(env))
       {
@@ -84,7 +107,8 @@ namespace toMAR
             __android_log_print(ANDROID_LOG_ERROR, "FrameInfo::dispose",
                                 "rgba usage count %d when attempting to release camera %lu frame %lu. Java VM may ABEND.",
                                 expected, camera_id, seqno);
-         env->DeleteGlobalRef(rgba);
+         if (rgba)
+            env->DeleteGlobalRef(rgba);
          if (mono)
          {
             expected = 0;
@@ -99,29 +123,8 @@ namespace toMAR
 
    bool FrameInfo::getEnv(JNIEnv *&env)
    //---------------------------------
-   {
-      env = nullptr;
-      if (vm == nullptr)
-      {
-         __android_log_print(ANDROID_LOG_ERROR, "jni::getEnv", "Call to getEnv before vm initialized");
-         return false;
-      }
-
-      int status = vm->GetEnv((void **)&env, JNI_VERSION_1_6);
-      if (status == JNI_OK)
-         return true;
-      else
-      {
-         if (status == JNI_EDETACHED)
-         {
-            __android_log_print(ANDROID_LOG_WARN, "jni::getEnv", "Thread not attached. Attempting to attach");
-            if (vm->AttachCurrentThread(&env, NULL) != 0)
-               __android_log_print(ANDROID_LOG_ERROR, "jni::getEnv", "Error attaching thread");
-            else
-               return true;
-         } else if (status == JNI_EVERSION)
-            __android_log_print(ANDROID_LOG_ERROR, "jni::getEnv", "Java version not supported");
-      }
-      return false;
+   {  // TBB workers are attached by util::JniAttachObserver so this is normally just the thread local lookup
+      env = util::thread_env(vm);
+      return (env != nullptr);
    }
 };
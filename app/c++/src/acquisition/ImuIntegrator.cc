@@ -0,0 +1,172 @@
+#include <cmath>
+
+#include "mar/acquisition/ImuIntegrator.h"
+#include "mar/acquisition/Sensors.h"
+#include "mar/util/Metrics.h"
+
+namespace toMAR
+{
+   // How far either side of an interval to look for the gyro samples in effect at its start and following its end
+   constexpr int64_t GYRO_MARGIN_NS = 20000000L;
+
+   // Rotation for body angular velocity w (rad/s) held for dt seconds
+   static inline Eigen::Quaternionf rotation_delta(const Eigen::Vector3f& w, const float dt)
+   //--------------------------------------------------------------------------------------
+   {
+      const float speed = w.norm();
+      if (speed * dt < 1e-6f) // First order, avoids dividing by a tiny norm
+         return Eigen::Quaternionf(1.0f, 0.5f * w.x() * dt, 0.5f * w.y() * dt, 0.5f * w.z() * dt).normalized();
+      return Eigen::Quaternionf(Eigen::AngleAxisf(speed * dt, w / speed));
+   }
+
+   ImuIntegrator& ImuIntegrator::instance()
+   //--------------------------------------
+   {
+      static ImuIntegrator the_instance;
+      return the_instance;
+   }
+
+   int ImuIntegrator::gyroscope() const
+   //----------------------------------
+   {
+      Sensors& sensors = Sensors::instance();
+      if (! sensors.span_all(ASENSOR_TYPE_GYROSCOPE).empty())
+         return ASENSOR_TYPE_GYROSCOPE;
+      if (! sensors.span_all(ASENSOR_TYPE_GYROSCOPE_UNCALIBRATED).empty())
+         return ASENSOR_TYPE_GYROSCOPE_UNCALIBRATED;
+      return -1;
+   }
+
+   bool ImuIntegrator::integrate(int64_t start, int64_t end, FrameMotion& result) const
+   //----------------------------------------------------------------------------------
+   {
+      result.start = start;
+      result.end = end;
+      result.rotation.setIdentity();
+      result.gyroSamples = result.accelSamples = 0;
+      const int gyro = gyroscope();
+      if ( (gyro < 0) || (end < start) )
+         return false;
+      Sensors& sensors = Sensors::instance();
+      thread_local std::vector<ASensorEvent> events;
+      events.clear();
+      sensors.get_between(gyro, start - GYRO_MARGIN_NS, end + GYRO_MARGIN_NS, events);
+      if (events.empty())
+         return false;
+
+      // Zero order hold: each sample's rate applies until the next sample, the newest one until end.
+      Eigen::Quaternionf q = Eigen::Quaternionf::Identity();
+      Eigen::Vector3f w(events[0].data[0], events[0].data[1], events[0].data[2]);
+      int64_t t = start;
+      bool isCovered = false;
+      for (const ASensorEvent& event : events)
+      {
+         if (event.timestamp >= end)
+         {
+            isCovered = true;
+            break;
+         }
+         const Eigen::Vector3f sample(event.data[0], event.data[1], event.data[2]);
+         if (event.timestamp > start)
+         {
+            q = q * rotation_delta(w, static_cast<float>(event.timestamp - t) * 1e-9f);
+            t = event.timestamp;
+            result.gyroSamples++;
+         }
+         w = sample;
+      }
+      if (t < end)
+         q = q * rotation_delta(w, static_cast<float>(end - t) * 1e-9f);
+      result.rotation = q.normalized();
+      result.angularVelocity = w;
+      result.isExtrapolated = ! isCovered;
+
+      events.clear();
+      if (sensors.get_between(ASENSOR_TYPE_ACCELEROMETER, start, end, events) > 0)
+      {
+         Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+         for (const ASensorEvent& event : events)
+            sum += Eigen::Vector3f(event.data[0], event.data[1], event.data[2]);
+         result.acceleration = sum / static_cast<float>(events.size());
+         result.accelSamples = static_cast<int>(events.size());
+      }
+      else
+         result.acceleration.setZero();
+      return true;
+   }
+
+   bool ImuIntegrator::on_frame(unsigned long camera, uint64_t seqno, int64_t timestamp)
+   //-----------------------------------------------------------------------------------
+   {
+      static util::Counter* extrapolated = util::Metrics::instance().counter("imu.extrapolated");
+      if ( (timestamp <= 0) || (Sensors::instance().size() == 0) )
+         return false;
+      CameraMotion* cameraMotion;
+      auto it = cameras.find(camera);
+      if (it == cameras.end())
+      {
+         CameraMotion* created = new CameraMotion;
+         auto inserted = cameras.insert(std::make_pair(camera, created));
+         if (! inserted.second)
+            delete created;
+         cameraMotion = inserted.first->second;
+      }
+      else
+         cameraMotion = it->second;
+
+      Slot& slot = cameraMotion->slots[seqno % HISTORY];
+      slot.sequence.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      const int64_t last = cameraMotion->lastTimestamp;
+      const int64_t start = ( (last > 0) && (last < timestamp) ) ? last : timestamp;
+      FrameMotion motion;
+      const bool isIntegrated = integrate(start, timestamp, motion);
+      slot.motion = motion;
+      cameraMotion->lastTimestamp = timestamp;
+      if (isIntegrated)
+      {
+         slot.sequence.store(seqno + 1, std::memory_order_release);
+         if (motion.isExtrapolated)
+            extrapolated->add();
+      }
+      return isIntegrated;
+   }
+
+   bool ImuIntegrator::motion(unsigned long camera, uint64_t seqno, FrameMotion& result) const
+   //-----------------------------------------------------------------------------------------
+   {
+      auto it = cameras.find(camera);
+      if (it == cameras.end())
+         return false;
+      const Slot& slot = it->second->slots[seqno % HISTORY];
+      const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+      if (before != seqno + 1)
+         return false;
+      result = slot.motion;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return (slot.sequence.load(std::memory_order_relaxed) == before);
+   }
+
+   Eigen::Quaternionf ImuIntegrator::predict(unsigned long camera, uint64_t seqno, int64_t time) const
+   //-------------------------------------------------------------------------------------------------
+   {
+      FrameMotion frame, ahead;
+      if ( (! motion(camera, seqno, frame)) || (time <= frame.end) )
+         return Eigen::Quaternionf::Identity();
+      if (integrate(frame.end, time, ahead))
+         return ahead.rotation;
+      return rotation_delta(frame.angularVelocity, static_cast<float>(time - frame.end) * 1e-9f);
+   }
+
+   void ImuIntegrator::clear()
+   //-------------------------
+   {
+      for (auto it = cameras.begin(); it != cameras.end(); ++it)
+      {
+         CameraMotion* cameraMotion = it->second;
+         for (Slot& slot : cameraMotion->slots)
+            slot.sequence.store(0, std::memory_order_relaxed);
+         cameraMotion->lastTimestamp = 0;
+      }
+   }
+}
@@ -0,0 +1,385 @@
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <set>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <android/log.h>
+
+#include "mar/acquisition/Recording.h"
+#include "mar/acquisition/Sensors.h"
+#include "mar/acquisition/Camera.h"
+#include "mar/Repository.h"
+#include "mar/util/util.hh"
+#include "mar/util/cv.h"
+#include "mar/util/Metrics.h"
+
+namespace toMAR
+{
+   static inline size_t padding(size_t size) { return (8 - size % 8) % 8; }
+
+   // False if replaying the record would read past its payload: a frame whose dimensions are odd, zero or need more
+   // than its I420 data, or a sensor record shorter than an ASensorEvent.
+   static bool is_valid_record(const RecordHeader* record)
+   //-----------------------------------------------------
+   {
+      switch (record->type)
+      {
+         case RecordType::FRAME:
+         {
+            if (record->size < sizeof(RecordedFrame))
+               return false;
+            const RecordedFrame* frame = reinterpret_cast<const RecordedFrame*>(record + 1);
+            const int64_t w = frame->width, h = frame->height;
+            if ( (w <= 0) || (h <= 0) || (w % 2) || (h % 2) || (w > 65536) || (h > 65536) )
+               return false;
+            return ( (static_cast<uint64_t>(w*h*3/2) <= frame->yuvLength) &&
+                     (frame->yuvLength <= record->size - sizeof(RecordedFrame)) );
+         }
+         case RecordType::SENSOR:
+            return (record->size >= sizeof(ASensorEvent));
+         default:
+            return true; // Skipped (with a warning) by ReplaySource::run
+      }
+   }
+
+   StreamRecorder& StreamRecorder::instance()
+   //----------------------------------------
+   {
+      static StreamRecorder the_instance;
+      return the_instance;
+   }
+
+   bool StreamRecorder::start(const std::string& filename, size_t maxQueued)
+   //-----------------------------------------------------------------------
+   {
+      if (isRecording.load())
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "StreamRecorder::start", "Already recording");
+         return false;
+      }
+      int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "StreamRecorder::start", "Error opening %s (%s)", filename.c_str(),
+                             std::strerror(errno));
+         return false;
+      }
+      RecordingHeader header;
+      std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+      header.version = RECORDING_VERSION;
+      header.reserved = 0;
+      header.created = util::now_realtime();
+      if (::write(fd, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)))
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "StreamRecorder::start", "Error writing header to %s (%s)",
+                             filename.c_str(), std::strerror(errno));
+         ::close(fd);
+         return false;
+      }
+      std::vector<unsigned char>* stale;
+      while (queue.try_pop(stale)) // Records submitted as the previous recording stopped
+         delete stale;
+      queue.set_capacity(static_cast<std::ptrdiff_t>(maxQueued) + 1); // +1 leaves room for the stop sentinel
+      writerThread = std::thread(&StreamRecorder::writer, this, fd);
+      isRecording.store(true);
+      return true;
+   }
+
+   void StreamRecorder::stop()
+   //-------------------------
+   {
+      bool recording = true;
+      if (! isRecording.compare_exchange_strong(recording, false))
+         return;
+      queue.push(nullptr);
+      if (writerThread.joinable())
+         writerThread.join();
+   }
+
+   bool StreamRecorder::submit(RecordType type, int64_t timestamp, const void* part1, size_t len1,
+                               const void* part2, size_t len2)
+   //---------------------------------------------------------------------------------------------
+   {
+      static util::Counter* dropped = util::Metrics::instance().counter("recorder.dropped");
+      if ( (! isRecording.load(std::memory_order_relaxed)) || (queue.size() >= queue.capacity() - 1) )
+      {
+         dropped->add();
+         return false;
+      }
+      const size_t size = len1 + len2;
+      std::vector<unsigned char>* buffer = new std::vector<unsigned char>(sizeof(RecordHeader) + size + padding(size));
+      RecordHeader header{type, static_cast<uint32_t>(size), timestamp};
+      unsigned char* p = buffer->data();
+      std::memcpy(p, &header, sizeof(header));
+      p += sizeof(header);
+      std::memcpy(p, part1, len1);
+      if (len2 > 0)
+         std::memcpy(p + len1, part2, len2);
+      if (! queue.try_push(buffer))
+      {
+         delete buffer;
+         dropped->add();
+         return false;
+      }
+      return true;
+   }
+
+   bool StreamRecorder::record_frame(const std::string& cameraName, unsigned long cameraId, int64_t timestamp,
+                                     int width, int height, bool isRGBA, bool hasMono, bool isRearFacing,
+                                     const void* yuv, size_t yuvLength)
+   //----------------------------------------------------------------------------------------------------------
+   {
+      RecordedFrame frame;
+      std::memset(&frame, 0, sizeof(frame));
+      std::strncpy(frame.cameraName, cameraName.c_str(), sizeof(frame.cameraName) - 1);
+      frame.cameraId = cameraId;
+      frame.width = width;
+      frame.height = height;
+      frame.flags = (isRGBA ? RecordedFrame::IS_RGBA : 0) | (hasMono ? RecordedFrame::HAS_MONO : 0) |
+                    (isRearFacing ? RecordedFrame::IS_REAR_FACING : 0);
+      frame.yuvLength = static_cast<uint32_t>(yuvLength);
+      return submit(RecordType::FRAME, timestamp, &frame, sizeof(frame), yuv, yuvLength);
+   }
+
+   bool StreamRecorder::record_sensor(const ASensorEvent& event)
+   //-----------------------------------------------------------
+   {
+      return submit(RecordType::SENSOR, event.timestamp, &event, sizeof(event), nullptr, 0);
+   }
+
+   void StreamRecorder::writer(int fd)
+   //---------------------------------
+   {
+      bool isGood = true;
+      while (true)
+      {
+         std::vector<unsigned char>* buffer;
+         queue.pop(buffer);
+         if (buffer == nullptr)
+            break;
+         if (isGood)
+         {
+            const unsigned char* p = buffer->data();
+            size_t remaining = buffer->size();
+            while (remaining > 0)
+            {
+               ssize_t written = ::write(fd, p, remaining);
+               if (written < 0)
+               {
+                  if (errno == EINTR) continue;
+                  __android_log_print(ANDROID_LOG_ERROR, "StreamRecorder::writer", "Write error (%s)",
+                                      std::strerror(errno));
+                  isGood = false;
+                  break;
+               }
+               p += written;
+               remaining -= static_cast<size_t>(written);
+            }
+         }
+         delete buffer;
+      }
+      ::close(fd);
+   }
+
+   bool RecordingReader::open(const std::string& filename)
+   //-----------------------------------------------------
+   {
+      close();
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "RecordingReader::open", "Error opening %s (%s)", filename.c_str(),
+                             std::strerror(errno));
+         return false;
+      }
+      struct stat st;
+      if ( (fstat(fd, &st) != 0) || (static_cast<size_t>(st.st_size) < sizeof(RecordingHeader)) )
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "RecordingReader::open", "%s is not a recording", filename.c_str());
+         ::close(fd);
+         return false;
+      }
+      length = static_cast<size_t>(st.st_size);
+      void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (p == MAP_FAILED)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "RecordingReader::open", "Error mapping %s (%s)", filename.c_str(),
+                             std::strerror(errno));
+         length = 0;
+         return false;
+      }
+      base = static_cast<const unsigned char*>(p);
+      const RecordingHeader* header = reinterpret_cast<const RecordingHeader*>(base);
+      if ( (std::memcmp(header->magic, RECORDING_MAGIC, sizeof(header->magic)) != 0) ||
+           (header->version != RECORDING_VERSION) )
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "RecordingReader::open", "%s is not a version %u recording",
+                             filename.c_str(), RECORDING_VERSION);
+         close();
+         return false;
+      }
+      madvise(const_cast<unsigned char*>(base), length, MADV_SEQUENTIAL);
+      size_t offset = sizeof(RecordingHeader), invalid = 0;
+      while (offset + sizeof(RecordHeader) <= length)
+      {
+         const RecordHeader* record = reinterpret_cast<const RecordHeader*>(base + offset);
+         if (offset + sizeof(RecordHeader) + record->size > length)
+            break; // Truncated final record (recording interrupted)
+         if (is_valid_record(record))
+            offsets.push_back(offset);
+         else
+            invalid++;
+         offset += sizeof(RecordHeader) + record->size + padding(record->size);
+      }
+      if (invalid > 0)
+         __android_log_print(ANDROID_LOG_WARN, "RecordingReader::open", "Skipped %zu malformed records in %s",
+                             invalid, filename.c_str());
+      return true;
+   }
+
+   void RecordingReader::close()
+   //---------------------------
+   {
+      if (base != nullptr)
+         munmap(const_cast<unsigned char*>(base), length);
+      base = nullptr;
+      length = 0;
+      offsets.clear();
+   }
+
+   bool ReplaySource::start()
+   //------------------------
+   {
+      if (isRunning.load())
+         return false;
+      if (! reader.open(filename))
+         return false;
+      if (reader.size() == 0)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "ReplaySource::start", "%s contains no records", filename.c_str());
+         return false;
+      }
+      // Create the replayed sensors before any events are injected, so inject() never adds to the sensors that
+      // readers are iterating. Sensors that are live on this device keep their own events.
+      std::set<int> sensorTypes;
+      for (size_t i = 0; i < reader.size(); i++)
+      {
+         if (reader.record(i)->type == RecordType::SENSOR)
+            sensorTypes.insert(reinterpret_cast<const ASensorEvent*>(reader.payload(i))->type);
+      }
+      for (int type : sensorTypes)
+      {
+         if (! Sensors::instance().add_replay_sensor(type))
+            __android_log_print(ANDROID_LOG_WARN, "ReplaySource::start",
+                                "Sensor %d is live, its recorded events are not replayed", type);
+      }
+      mustStop.store(false);
+      isRunning.store(true);
+      replayThread = std::thread(&ReplaySource::run, this);
+      return true;
+   }
+
+   void ReplaySource::stop()
+   //-----------------------
+   {
+      mustStop.store(true);
+      if (replayThread.joinable())
+         replayThread.join();
+      reader.close();
+   }
+
+   bool ReplaySource::replay_frame(const RecordHeader* header, const unsigned char* payload)
+   //---------------------------------------------------------------------------------------
+   {
+      const RecordedFrame* recorded = reinterpret_cast<const RecordedFrame*>(payload);
+      Repository* repository = Repository::instance();
+      Camera* camera = repository->hardware_camera_interface_ptr(recorded->cameraId);
+      if (camera == nullptr)
+      {
+         std::string name(recorded->cameraName, strnlen(recorded->cameraName, sizeof(recorded->cameraName)));
+         repository->add_camera(name, queueSize, ((recorded->flags & RecordedFrame::IS_REAR_FACING) != 0));
+         camera = repository->hardware_camera_interface_ptr(recorded->cameraId);
+         if (camera == nullptr)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "ReplaySource::replay_frame", "Could not create camera %s",
+                                name.c_str());
+            return false;
+         }
+         camera->preview_size(recorded->width, recorded->height);
+      }
+      if (speed <= 0)
+      {  // Wait for space rather than let the camera queue discard frames
+         while ( (camera->queue_size() >= camera->queue_capacity()) && (! mustStop.load()) )
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+      }
+      const int w = recorded->width, h = recorded->height;
+      const bool isRGBA = ((recorded->flags & RecordedFrame::IS_RGBA) != 0);
+      void* yuv = const_cast<unsigned char*>(payload + sizeof(RecordedFrame));
+      const int rgbaLen = w*h*4;
+      std::unique_ptr<unsigned char[]> rgba(new unsigned char[rgbaLen]);
+      if (! toMAR::vision::YUV2RGBA(yuv, rgba.get(), w, h, isRGBA, "ReplaySource::replay_frame"))
+         return false;
+      int monoLen = 0;
+      std::unique_ptr<unsigned char[]> mono;
+      if ((recorded->flags & RecordedFrame::HAS_MONO) != 0)
+      {
+         monoLen = w*h;
+         mono.reset(new unsigned char[monoLen]);
+         if (! toMAR::vision::YUV2Mono(yuv, mono.get(), w, h, "ReplaySource::replay_frame"))
+         {
+            mono.reset();
+            monoLen = 0;
+         }
+      }
+      FrameInfo* frame_info = new FrameInfo(recorded->cameraId, header->timestamp, w, h,
+                                            (isRGBA) ? ColorFormats::RGBA : ColorFormats::BGRA, rgbaLen,
+                                            std::move(rgba), monoLen, std::move(mono));
+      return camera->enqueue(frame_info);
+   }
+
+   void ReplaySource::run()
+   //----------------------
+   {
+      Sensors& sensors = Sensors::instance();
+      Repository* repository = Repository::instance();
+      while ( (! repository->initialised.load()) && (! mustStop.load()) ) // As in enqueueYUV, wait for startMAR
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      do
+      {
+         const int64_t first = reader.record(0)->timestamp, started = util::now_monotonic();
+         for (size_t i = 0; (i < reader.size()) && (! mustStop.load()); i++)
+         {
+            const RecordHeader* header = reader.record(i);
+            if (speed > 0)
+            {
+               const int64_t due = started + static_cast<int64_t>((header->timestamp - first) / speed);
+               const int64_t wait = due - util::now_monotonic();
+               if (wait > 0)
+                  std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
+            switch (header->type)
+            {
+               case RecordType::FRAME:
+                  if (replay_frame(header, reader.payload(i)))
+                     replayedFrames.fetch_add(1, std::memory_order_relaxed);
+                  break;
+               case RecordType::SENSOR:
+                  if (sensors.inject(*reinterpret_cast<const ASensorEvent*>(reader.payload(i))))
+                     replayedEvents.fetch_add(1, std::memory_order_relaxed);
+                  break;
+               default:
+                  __android_log_print(ANDROID_LOG_WARN, "ReplaySource::run", "Skipping unknown record type %u",
+                                      static_cast<unsigned>(header->type));
+                  break;
+            }
+         }
+      } while ( (isLoop) && (! mustStop.load()) );
+      isRunning.store(false);
+   }
+}
@@ -1,10 +1,15 @@
 #include <sstream>
+#include <algorithm>
 
 #include <android/log.h>
 
 #include "mar/acquisition/Sensors.h"
 #include "mar/Repository.h"
 #include "mar/acquisition/SensorData.hh"
+#include "mar/acquisition/Recording.h"
+#include "mar/util/Metrics.h"
+#include "mar/util/CpuPlacement.h"
+#include "mar/util/util.hh"
 
 namespace toMAR
 {
@@ -22,7 +27,9 @@ namespace toMAR
       { ASENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED, std::pair<std::string, int>("Uncalibrated Magnetic", 6) },
    };
 
-   const int LOOPER_ID_USER = 3;
+   const int LOOPER_ID_USER = 3; // Looper ident of the event queue shared by all sensors
+   const int EVENT_BATCH = 32;
+   const int MAX_INDEXED_TYPE = 256; // Sensor types below this are dispatched through a flat array
 
    bool Sensors::add_sensor(int sensor_id, int queuedMax, std::stringstream* errs)
    //-------------------------------------------------
@@ -38,7 +45,7 @@ namespace toMAR
       auto supportedIter = SUPPORTED_SENSORS.find(sensor_id);
       bool isSupported = (supportedIter != SUPPORTED_SENSORS.end());
       if (isSupported)
-         sensor_name = supportedIter->first;
+         sensor_name = supportedIter->second.first;
       else
          sensor_name = "Unknown/Unsupported";
 
@@ -54,8 +61,10 @@ namespace toMAR
          auto it = sensors.find(sensor_id);
          if (it == sensors.end())
          {
-            SensorData* sensor_info = new SensorData(queuedMax, mutex);
-            sensors[sensor_id] = sensor_info;
+            SensorData* sensor_info = new SensorData(queuedMax);
+            sensor_info->sensor = sensor;
+            sensor_info->is_supported = isSupported;
+            sensors.insert(std::make_pair(sensor_id, sensor_info));
             return true;
          }
       }
@@ -64,10 +73,44 @@ namespace toMAR
 
    size_t Sensors::initialize(std::stringstream* errs)
    //-----------------------------------------------
+   {
+      if (looper == nullptr)
+         looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+      return enable_sensors(errs);
+   }
+
+   bool Sensors::initialize_async()
+   //------------------------------
+   {
+      if (looper == nullptr)
+         looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+      if (looper == nullptr)
+         return false;
+      initErrors.str("");
+      initializing = std::async(std::launch::async, &Sensors::enable_sensors, this, &initErrors);
+      return true;
+   }
+
+   size_t Sensors::wait_initialized(std::stringstream* errs)
+   //-------------------------------------------------------
+   {
+      if (! initializing.valid())
+         return 0;
+      size_t n = initializing.get();
+      if (errs)
+         *errs << initErrors.str();
+      return n;
+   }
+
+   // ALooper_addFd is thread safe, so the queue can be created and the sensors enabled on any thread as long as
+   // the looper belongs to the thread that calls process_queues.
+   size_t Sensors::enable_sensors(std::stringstream* errs)
+   //-----------------------------------------------------
    {
       if (sensors.size() == 0)
       {
-         *errs << "Sensors::initialize - No sensors to initialize";
+         if (errs)
+            *errs << "Sensors::initialize - No sensors to initialize";
          return 0;
       }
       ASensorManager *sensor_manager = getSensorManager(package_name.c_str());
@@ -77,25 +120,41 @@ namespace toMAR
             *errs << "Error getting Android Sensor Manager using main package name '" << package_name << "'";
          return 0;
       }
-      if (looper == nullptr)
-         looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
       if (looper == nullptr)
       {
          if (errs)
             *errs << "Error getting Android thread looper.";
          return 0;
       }
+      if (eventQueue == nullptr)
+         eventQueue = ASensorManager_createEventQueue(sensor_manager, looper, LOOPER_ID_USER, nullptr, nullptr);
+      if (eventQueue == nullptr)
+      {
+         if (errs)
+            *errs << "Error obtaining sensor events queue";
+         return 0;
+      }
       size_t n = 0;
       for (auto it = sensors.begin(); it != sensors.end(); ++it)
       {
          int sensor_id = it->first;
          SensorData* sensor_info = it->second;
-         auto supported_it = SUPPORTED_SENSORS.find(sensor_id);
-         sensor_info->is_supported = (supported_it != SUPPORTED_SENSORS.end());
+         if (sensor_info->is_replay)
+         {
+            n++;
+            continue;
+         }
+         if (sensor_info->good)
+         {
+            n++;
+            continue;
+         }
          std::string sensor_name;
-         if (sensor_info->is_supported)
+         auto supported_it = SUPPORTED_SENSORS.find(sensor_id);
+         if (supported_it != SUPPORTED_SENSORS.end())
             sensor_name = supported_it->second.first;
-         sensor_info->sensor = const_cast<ASensor *>(ASensorManager_getDefaultSensor(sensor_manager, sensor_id));
+         if (sensor_info->sensor == nullptr)
+            sensor_info->sensor = const_cast<ASensor *>(ASensorManager_getDefaultSensor(sensor_manager, sensor_id));
          if (sensor_info->sensor == nullptr)
          {
             if (errs)
@@ -103,14 +162,6 @@ namespace toMAR
             sensor_info->good = false;
             continue;
          }
-         sensor_info->sensor_queue = ASensorManager_createEventQueue(sensor_manager, looper, LOOPER_ID_USER, nullptr, nullptr);
-         if (sensor_info->sensor_queue == nullptr)
-         {
-            if (errs)
-               *errs << "Error obtaining " << sensor_name << " events queue";
-            sensor_info->good = false;
-            continue;
-         }
          int bestrate = ASensor_getMinDelay(sensor_info->sensor);
          if (bestrate <= 0)
          {
@@ -118,146 +169,241 @@ namespace toMAR
                *errs << "Error obtaining best sampling rate for " << sensor_name << " sensor.";
             bestrate = 4000;
          }
-         int sensor_status = ASensorEventQueue_enableSensor(sensor_info->sensor_queue, sensor_info->sensor);
+         int sensor_status = ASensorEventQueue_enableSensor(eventQueue, sensor_info->sensor);
          if (sensor_status < 0)
          {
             if (errs)
                *errs << "Error enabling " << sensor_name << " sensor";
-            ASensorManager_destroyEventQueue(sensor_manager, sensor_info->sensor_queue);
             sensor_info->good = false;
             continue;
          }
-         sensor_status = ASensorEventQueue_setEventRate(sensor_info->sensor_queue, sensor_info->sensor, bestrate);
+         sensor_status = ASensorEventQueue_setEventRate(eventQueue, sensor_info->sensor, bestrate);
          if (sensor_status < 0)
          {
             if (errs)
                *errs << "Error setting rate to " << bestrate << " for " << sensor_name << " sensor";
-            //ASensorEventQueue_disableSensor(sensor_info->sensor_queue, sensor_info->sensor);
-            //ASensorManager_destroyEventQueue(sensor_manager, queue);
+            //ASensorEventQueue_disableSensor(eventQueue, sensor_info->sensor);
+         }
+         sensor_info->sensor_queue = eventQueue;
+         sensor_info->good = true;
+         if (sensor_id < MAX_INDEXED_TYPE)
+         {
+            if (static_cast<size_t>(sensor_id) >= sensorsByType.size())
+               sensorsByType.resize(sensor_id + 1, nullptr);
+            sensorsByType[sensor_id] = sensor_info;
          }
          n++;
       }
       return n;
    }
 
+   // Drains the shared event queue EVENT_BATCH events at a time, dispatching each event on its sensor type.
+   // max_to_process caps the events handled per call; anything left stays queued and wakes the next poll.
    int Sensors::process_queues(int timeout_ms, int max_to_process)
    //-----------------------------------------------------------
    {
-      int poll = ALooper_pollAll(timeout_ms, nullptr, nullptr, nullptr);
-      if ( (poll == ALOOPER_POLL_TIMEOUT) || (poll == ALOOPER_POLL_ERROR) )
-         return 0;
-      int count = 0;
-      for(auto it = sensors.begin(); it != sensors.end(); ++it)
+      static util::Histogram* batchSizes = util::Metrics::instance().histogram("sensors.batch", false);
+      static util::Histogram* eventLag = util::Metrics::instance().histogram("sensors.lag");
+      static util::Counter* eventCount = util::Metrics::instance().counter("sensors.events");
+      StreamRecorder& recorder = StreamRecorder::instance();
+      ASensorEvent batch[EVENT_BATCH];
+      int count = 0, timeout = timeout_ms;
+      while (count < max_to_process)
       {
-         SensorData* sensor_info = it->second;
-         ASensorEventQueue *queue = sensor_info->sensor_queue;
-         if (ASensorEventQueue_hasEvents(queue) > 0)
+         const int ident = ALooper_pollAll(timeout, nullptr, nullptr, nullptr);
+         if (ident < 0) // timeout, error or wake
+            break;
+         timeout = 0; // Only wait for the first wakeup, then take whatever else is ready
+         if ( (ident != LOOPER_ID_USER) || (eventQueue == nullptr) )
+            continue;
+         ssize_t n;
+         while ( (count < max_to_process) &&
+                 ((n = ASensorEventQueue_getEvents(eventQueue, batch, std::min(EVENT_BATCH, max_to_process - count))) > 0) )
          {
-            ASensorEvent event;
-            count = 0;
-            while (ASensorEventQueue_getEvents(queue, &event, 1) > 0)
+            for (ssize_t i = 0; i < n; i++)
             {
-               sensor_info->push(event);
-               if (count++ > max_to_process) break;
+               const ASensorEvent& event = batch[i];
+               SensorData* sensor_info = ( (event.type >= 0) && (event.type < static_cast<int>(sensorsByType.size())) )
+                                         ? sensorsByType[event.type] : sensor_data(event.type);
+               if (sensor_info != nullptr)
+                  sensor_info->push(event);
             }
+            if (recorder.is_recording())
+               for (ssize_t i = 0; i < n; i++)
+                  recorder.record_sensor(batch[i]);
+            count += static_cast<int>(n);
+            batchSizes->record(n);
+            const int64_t lag = util::now_boot() - batch[n - 1].timestamp;
+            if ( (lag >= 0) && (lag < 10000000000L) ) // Some HALs don't use CLOCK_BOOTTIME
+               eventLag->record(lag);
          }
       }
+      eventCount->add(static_cast<uint64_t>(count));
       return count;
    }
 
+   bool Sensors::add_replay_sensor(int sensor, int queuedMax)
+   //--------------------------------------------------------
+   {
+      tbb::spin_mutex::scoped_lock _lock(sensorLock);
+      auto it = sensors.find(sensor);
+      if (it != sensors.end())
+         return it->second->is_replay;
+      SensorData* sensor_info = new SensorData(queuedMax);
+      sensor_info->is_replay = sensor_info->good = true;
+      sensor_info->is_supported = (SUPPORTED_SENSORS.find(sensor) != SUPPORTED_SENSORS.end());
+      sensors.insert(std::make_pair(sensor, sensor_info));
+      return true;
+   }
+
+   bool Sensors::inject(const ASensorEvent& event)
+   //---------------------------------------------
+   {
+      SensorData* sensor_info = sensor_data(event.type);
+      if ( (sensor_info == nullptr) || (! sensor_info->is_replay) )
+         return false;
+      sensor_info->push(event);
+      return true;
+   }
+
    //Despite linking with libandroid and all other sensor APIs linking OK, ASensorManager_getInstanceForPackage doesn't
+   //link, so it is looked up (once, the manager is cached) with dlsym.
    ASensorManager *Sensors::getSensorManager(const char *packageName)
    //------------------------------------------------------
    {
-      typedef ASensorManager *(*PF_GETINSTANCEFORPACKAGE)(const char *name);
-      void *androidHandle = dlopen("libandroid.so", RTLD_NOW);
-      PF_GETINSTANCEFORPACKAGE getInstanceForPackageFunc = (PF_GETINSTANCEFORPACKAGE) dlsym(androidHandle,
-                                                                                            "ASensorManager_getInstanceForPackage");
-      if (getInstanceForPackageFunc)
-         return getInstanceForPackageFunc(packageName);
+      std::call_once(managerOnce, [this, packageName]()
+      {
+         typedef ASensorManager *(*PF_GETINSTANCEFORPACKAGE)(const char *name);
+         androidHandle = dlopen("libandroid.so", RTLD_NOW);
+         if (androidHandle == nullptr)
+            return;
+         PF_GETINSTANCEFORPACKAGE getInstanceForPackageFunc = (PF_GETINSTANCEFORPACKAGE) dlsym(androidHandle,
+                                                                                               "ASensorManager_getInstanceForPackage");
+         if (getInstanceForPackageFunc)
+         {
+            sensorManager = getInstanceForPackageFunc(packageName);
+            return;
+         }
+         typedef ASensorManager *(*PF_GETINSTANCE)();
+         PF_GETINSTANCE getInstanceFunc = (PF_GETINSTANCE) dlsym(androidHandle, "ASensorManager_getInstance");
+         if (getInstanceFunc != nullptr)
+            sensorManager = getInstanceFunc();
+      });
+      return sensorManager;
+   }
+
+   Sensors::~Sensors()
+   //-----------------
+   {
+      if (androidHandle != nullptr)
+         dlclose(androidHandle);
+   }
+
+   SensorData* Sensors::sensor_data(int sensorid)
+   //--------------------------------------------
+   {
+      auto it = sensors.find(sensorid);
+      return (it == sensors.end()) ? nullptr : it->second;
+   }
+
+   // Sort the events appended after position from by timestamp (each sensor's run is already in order)
+   size_t Sensors::merge(std::vector<ASensorEvent>& events, size_t from)
+   //-------------------------------------------------------------------
+   {
+      std::stable_sort(events.begin() + from, events.end(),
+                       [](const ASensorEvent& a, const ASensorEvent& b) { return a.timestamp < b.timestamp; });
+      return events.size() - from;
+   }
+
+   SensorSpan Sensors::span_all(int sensorid)
+   //----------------------------------------
+   {
+      SensorData* sensor_info = sensor_data(sensorid);
+      return (sensor_info == nullptr) ? SensorSpan() : sensor_info->all();
+   }
+
+   SensorSpan Sensors::span_between(int sensorid, int64_t start, int64_t end)
+   //------------------------------------------------------------------------
+   {
+      SensorData* sensor_info = sensor_data(sensorid);
+      return (sensor_info == nullptr) ? SensorSpan() : sensor_info->between(start, end);
+   }
 
-      typedef ASensorManager *(*PF_GETINSTANCE)();
-      PF_GETINSTANCE getInstanceFunc = (PF_GETINSTANCE) dlsym(androidHandle, "ASensorManager_getInstance");
-      if (getInstanceFunc == nullptr) return nullptr;
-      return getInstanceFunc();
+   SensorSpan Sensors::span_from(int sensorid, int64_t start)
+   //--------------------------------------------------------
+   {
+      SensorData* sensor_info = sensor_data(sensorid);
+      return (sensor_info == nullptr) ? SensorSpan() : sensor_info->from(start);
    }
 
-   size_t Sensors::get_all_between(int64_t start, int64_t end, std::multimap<int64_t, ASensorEvent*>& events)
-   //------------------------------------------------------------------------------------------------------------------
+   size_t Sensors::get_all_between(int64_t start, int64_t end, std::vector<ASensorEvent>& events)
+   //--------------------------------------------------------------------------------------------
    {
-      size_t no = 0;
+      const size_t first = events.size();
       for(auto it = sensors.begin(); it != sensors.end(); ++it)
       {
-         int sensorid = it->first;
          SensorData* sensor_info = it->second;
-         no += sensor_info->between(start, end, events);
+         sensor_info->copy(sensor_info->between(start, end), events);
       }
-      return no;
+      return merge(events, first);
    }
 
-   size_t Sensors::get_between(int sensorid, int64_t start, int64_t end, std::multimap<int64_t, ASensorEvent*>& events)
+   size_t Sensors::get_between(int sensorid, int64_t start, int64_t end, std::vector<ASensorEvent>& events)
    //------------------------------------------------------------------------------------------------------
    {
-      auto it = sensors.find(sensorid);
-      if (it == sensors.end())
+      SensorData* sensor_info = sensor_data(sensorid);
+      if (sensor_info == nullptr)
          return 0;
-      SensorData* sensor_info = it->second;
-      return sensor_info->between(start, end, events);
+      return sensor_info->copy(sensor_info->between(start, end), events);
    }
 
-   size_t Sensors::get_all(int sensorid, std::multimap<int64_t, ASensorEvent*>& events)
-   //------------------------------------------------------------------------
+   size_t Sensors::get_all(int sensorid, std::vector<ASensorEvent>& events)
+   //----------------------------------------------------------------------
    {
-      auto it = sensors.find(sensorid);
-      if (it == sensors.end())
+      SensorData* sensor_info = sensor_data(sensorid);
+      if (sensor_info == nullptr)
          return 0;
-      SensorData* sensor_info = it->second;
-      return sensor_info->all(events);
+      return sensor_info->copy(sensor_info->all(), events);
    }
 
-   size_t Sensors::get_all(std::multimap<int64_t, ASensorEvent*>& events)
-   //--------------------------------------------------------------------
+   size_t Sensors::get_all(std::vector<ASensorEvent>& events)
+   //--------------------------------------------------------
    {
-      size_t no = 0;
+      const size_t first = events.size();
       for(auto it = sensors.begin(); it != sensors.end(); ++it)
       {
-         int sensorid = it->first;
          SensorData* sensor_info = it->second;
-         no += sensor_info->all(events);
-
+         sensor_info->copy(sensor_info->all(), events);
       }
-      return no;
+      return merge(events, first);
    }
 
-   size_t Sensors::get_from(int sensorid, int64_t start, std::multimap<int64_t, ASensorEvent *> &events)
-   //----------------------------------------------------------------------------------------------------
+   size_t Sensors::get_from(int sensorid, int64_t start, std::vector<ASensorEvent>& events)
+   //--------------------------------------------------------------------------------------
    {
-      auto it = sensors.find(sensorid);
-      if (it == sensors.end())
+      SensorData* sensor_info = sensor_data(sensorid);
+      if (sensor_info == nullptr)
          return 0;
-      SensorData* sensor_info = it->second;
-      return sensor_info->from(start, events);
+      return sensor_info->copy(sensor_info->from(start), events);
    }
 
-   size_t Sensors::get_all_from(int64_t start, std::multimap<int64_t, ASensorEvent *> &events)
-   //-----------------------------------------------------------------------------------------
+   size_t Sensors::get_all_from(int64_t start, std::vector<ASensorEvent>& events)
+   //----------------------------------------------------------------------------
    {
-      size_t no = 0;
+      const size_t first = events.size();
       for(auto it = sensors.begin(); it != sensors.end(); ++it)
       {
-         int sensorid = it->first;
          SensorData* sensor_info = it->second;
-         no += sensor_info->from(start, events);
-
+         sensor_info->copy(sensor_info->from(start), events);
       }
-      return no;
-
+      return merge(events, first);
    }
 
    void Sensors::sensor_handler_thread(int timeout_ms, int max_to_process, bool &stop)
    //--------------------------------------------------------------------------------
    {
 //      looper = ALooper_forThread();
+      util::CpuPlacement::instance().pin_current_thread(util::StageClass::SENSORS);
       std::stringstream errs;
       size_t noSensors = sensors.size();
       size_t inited = initialize(&errs);
@@ -10,39 +10,176 @@ namespace toMAR
                                             RendererType rendererType)
    //-----------------------------------------------------------------------------------------
    {
-      if (type == "TBB")
+      if ( (type != "TBB") || ( (rearCameras.empty()) && (frontCameras.empty()) ) )
+         return nullptr;
+      GraphSpec spec;
+      spec.rendererType = rendererType;
+      if (! rearCameras.empty())
+      {  // Rendered rear camera, or stereo pair if there are two
+         CameraSpec rear;
+         rear.cameraId = rearCameras[0]->camera_id();
+         if (rearCameras.size() > 1)
+         {
+            rear.stereoCameraId = rearCameras[1]->camera_id();
+            rear.router.concurrency = 2;
+         }
+         rear.detectorType = rearDetectorType;
+         rear.trackerType = rearTrackerType;
+         spec.cameras.push_back(rear);
+      }
+      if (! frontCameras.empty())
+      {  // With a rear camera the front camera is not rendered, its face detections are overlaid on the rear frames
+         CameraSpec front;
+         front.cameraId = frontCameras[0]->camera_id();
+         front.detectorType = frontDetectorType;
+         front.trackerType = frontTrackerType;
+         front.isRendered = rearCameras.empty();
+         front.isOverlayOnRear = (! rearCameras.empty());
+         spec.cameras.push_back(front);
+      }
+      spec.load(GraphSpec::GRAPH_SPEC_FILE);
+      return new TBBGraphArchitecture(renderer, spec);
+   }
+
+   static bool parse_size(const std::string& s, size_t& value)
+   //---------------------------------------------------------
+   {
+      if ( (s.empty()) || (s.find_first_not_of("0123456789") != std::string::npos) )
+         return false;
+      value = std::stoul(s);
+      return true;
+   }
+
+   static std::string trim(const std::string& s)
+   //-------------------------------------------
+   {
+      const size_t first = s.find_first_not_of(" \t\r\n");
+      if (first == std::string::npos) return "";
+      return s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+   }
+
+   bool GraphSpec::apply(const std::string& overrides, std::string* errors)
+   //----------------------------------------------------------------------
+   {
+      std::stringstream errs;
+      std::string text = overrides;
+      std::replace(text.begin(), text.end(), ';', '\n');
+      std::istringstream lines(text);
+      std::string line;
+      while (std::getline(lines, line))
       {
-         if ( (! rearCameras.empty()) && (! frontCameras.empty()) )
+         const size_t comment = line.find('#');
+         if (comment != std::string::npos)
+            line.erase(comment);
+         line = trim(line);
+         if (line.empty()) continue;
+         const size_t eq = line.find('=');
+         std::vector<std::string> keys;
+         std::istringstream key(trim(line.substr(0, eq)));
+         for (std::string part; std::getline(key, part, '.'); )
+            keys.push_back(trim(part));
+         if ( (eq != std::string::npos) && (keys.size() == 2) && (keys[0] == "cores") )
+         {
+            const std::string cpus = trim(line.substr(eq + 1));
+            std::vector<int> listed;
+            unsigned stage = 0;
+            const unsigned count = static_cast<unsigned>(util::StageClass::COUNT);
+            while ( (stage < count) && (keys[1] != util::stage_class_name(static_cast<util::StageClass>(stage))) )
+               stage++;
+            if ( (stage >= count) ||
+                 ( (cpus != "big") && (cpus != "little") && (cpus != "all") && (! cpus.empty()) &&
+                   (! util::parse_cpu_list(cpus, listed)) ) )
+               errs << "Invalid core set override '" << line << "'; ";
+            else
+               cores[stage] = cpus;
+            continue;
+         }
+         size_t value = 0, index = 0;
+         const bool isArena = ( (keys.size() == 3) && (keys[0] == "arena") );
+         const bool isIndexed = ( (keys.size() == 3) && (! isArena) );
+         if ( (eq == std::string::npos) || (keys.size() < 2) || (keys.size() > 3) ||
+              (! parse_size(trim(line.substr(eq + 1)), value)) ||
+              ( (isIndexed) && ( (! parse_size(keys[0], index)) || (index >= cameras.size()) ) ) )
          {
-            if (rearCameras.size() > 1)
-               return new TBBStereoAndFrontArchitecture(renderer, rearCameras[0]->camera_id(),
-                                                        rearCameras[1]->camera_id(),
-                                                        frontCameras[0]->camera_id(),
-                                                        rearDetectorType, frontDetectorType,
-                                                        rearTrackerType, frontTrackerType,
-                                                        rendererType);
+            errs << "Invalid graph spec override '" << line << "'; ";
+            continue;
+         }
+         if (isArena)
+         {
+            ArenaSpec* arena = (keys[1] == "pipeline") ? &pipelineArena : (keys[1] == "compute") ? &computeArena
+                                                                                                  : nullptr;
+            if ( (arena == nullptr) || (keys[2] != "concurrency") )
+               errs << "Unknown arena override '" << line << "'; ";
             else
-               return new TBBMonoAndFrontArchitecture(renderer, rearCameras[0]->camera_id(),
-                                                      frontCameras[0]->camera_id(),
-                                                      rearDetectorType, frontDetectorType,
-                                                      rearTrackerType, frontTrackerType,
-                                                      rendererType);
+               arena->concurrency = value;
+            continue;
+         }
+         const std::string& node = keys[keys.size() - 2], & attribute = keys.back();
+         if (node == "source")
+         {
+            if (attribute != "max_in_flight")
+            {
+               errs << "Unknown source attribute '" << attribute << "'; ";
+               continue;
+            }
+            for (size_t i = 0; i < cameras.size(); i++)
+               if ( (! isIndexed) || (i == index) )
+                  cameras[i].maxInFlight = value;
+            continue;
          }
-         else if (! rearCameras.empty())
+         if ( (attribute != "concurrency") && (attribute != "buffer") && (attribute != "offload") )
          {
-            if (rearCameras.size() > 1)
-               return new TBBStereoArchitecture(renderer, rearCameras[0]->camera_id(),
-                                                rearCameras[1]->camera_id(), rearDetectorType,
-                                                rearTrackerType, rendererType);
+            errs << "Unknown node attribute '" << attribute << "'; ";
+            continue;
+         }
+         if ( (attribute == "concurrency") && (value == 0) && (node != "detector") )
+         {
+            errs << "Node concurrency must be at least 1 ('" << line << "'); ";
+            continue;
+         }
+         if ( (attribute == "offload") && (node == "router") )
+         {
+            errs << "The router always runs in the pipeline arena; ";
+            continue;
+         }
+         for (size_t i = 0; i < cameras.size(); i++)
+         {
+            if ( (isIndexed) && (i != index) ) continue;
+            CameraSpec& camera = cameras[i];
+            NodeSpec* nodeSpec = (node == "router") ? &camera.router : (node == "detector") ? &camera.detector
+                                 : (node == "tracker") ? &camera.tracker : (node == "render") ? &camera.render
+                                 : nullptr;
+            if (nodeSpec == nullptr)
+            {
+               errs << "Unknown node '" << node << "'; ";
+               break;
+            }
+            if (attribute == "concurrency")
+               nodeSpec->concurrency = value;
+            else if (attribute == "buffer")
+               nodeSpec->buffer = value;
             else
-               return new TBBMonoArchitecture(renderer, rearCameras[0]->camera_id(), rearDetectorType,
-                                              rearTrackerType, rendererType);
+               nodeSpec->isOffloaded = (value != 0);
          }
-         else if (! frontCameras.empty())
-            return new TBBMonoArchitecture(renderer, frontCameras[0]->camera_id(), frontDetectorType,
-                                           frontTrackerType, rendererType);
       }
-      return nullptr;
+      const std::string message = errs.str();
+      if (errors != nullptr)
+         *errors = message;
+      if (! message.empty())
+         __android_log_print(ANDROID_LOG_ERROR, "GraphSpec::apply", "%s", message.c_str());
+      return message.empty();
+   }
+
+   bool GraphSpec::load(const char* path)
+   //------------------------------------
+   {
+      std::ifstream ifs(path);
+      if (! ifs)
+         return false;
+      std::stringstream contents;
+      contents << ifs.rdbuf();
+      __android_log_print(ANDROID_LOG_INFO, "GraphSpec::load", "Applying graph overrides from %s", path);
+      return apply(contents.str());
    }
 
    Detector *FlowGraphArchitecture::make_detector(DetectorType detectorType, unsigned long camera1,
@@ -53,26 +190,63 @@ namespace toMAR
                            isOverlayOnRear, frequencyMs);
    }
 
-   Detector* FlowGraphArchitecture::make_detector(DetectorType detectorType, unsigned long camera1,
-                                                  unsigned long camera2, bool isOverlayOnRear,
-                                                  int64_t frequencyMs)
-   //-----------------------------------------------------------------------------------------
+   size_t FlowGraphArchitecture::detector_concurrency(DetectorType detectorType)
+   //--------------------------------------------------------------------------
    {
       switch (detectorType)
       {
-         case DetectorType::SIMULATE:
-            return new TBBSimulationDetector(camera1, DETECT_MEANRATE);
+#if defined(HAS_APRILTAGS) || defined(HAS_FACE_DETECTION)
          case DetectorType::APRILTAGS:
-            return new AprilTagTBBDetector(camera1, camera2);
          case DetectorType::FACE_RECOGNITION:
-            if (isOverlayOnRear)
-               return new FaceOverlayTBBDetector(camera1);
-            else
-               return new FaceTBBDetector(camera1);
-         case DetectorType::NONE: return new TBBNullDetector(camera1);
+         {  // Half the cores, leaving the remainder to the camera sources, router and renderer
+            const int cores = tbb::task_scheduler_init::default_num_threads();
+            return static_cast<size_t>(std::max(1, std::min(MAX_DETECTOR_CONCURRENCY, cores / 2)));
+         }
+#endif
+         default: // The simulation detector times itself with static state and the null detector needs no pool
+            return 1;
       }
    }
 
+   Detector* FlowGraphArchitecture::make_detector(DetectorType detectorType, unsigned long camera1,
+                                                  unsigned long camera2, bool isOverlayOnRear,
+                                                  int64_t frequencyMs, size_t concurrency)
+   //-----------------------------------------------------------------------------------------
+   {
+      const size_t n = (concurrency == 0) ? detector_concurrency(detectorType) : concurrency;
+      std::vector<std::unique_ptr<Detector>> instances;
+      for (size_t i = 0; i < n; i++)
+      {
+         Detector* detector = nullptr;
+         switch (detectorType)
+         {
+            case DetectorType::SIMULATE:
+               detector = new TBBSimulationDetector(camera1, DETECT_MEANRATE);
+               break;
+#ifdef HAS_APRILTAGS
+            case DetectorType::APRILTAGS:
+               detector = new AprilTagTBBDetector(camera1, camera2);
+               break;
+#endif
+#ifdef HAS_FACE_DETECTION
+            case DetectorType::FACE_RECOGNITION:
+               if (isOverlayOnRear)
+                  detector = new FaceOverlayTBBDetector(camera1);
+               else
+                  detector = new FaceTBBDetector(camera1);
+               break;
+#endif
+            default:
+               detector = new TBBNullDetector(camera1);
+               break;
+         }
+         if (n == 1)
+            return detector;
+         instances.emplace_back(detector);
+      }
+      return new DetectorPool(camera1, std::move(instances));
+   }
+
    Tracker* FlowGraphArchitecture::make_tracker(TrackerType trackerType, unsigned long camera1)
    {
       return make_tracker(trackerType, camera1, std::numeric_limits<unsigned long>::max());
@@ -109,295 +283,366 @@ namespace toMAR
       return nullptr;
    }
 
-   void TBBMonoArchitecture::run()
-   //----------------------------------
+   TBBGraphArchitecture::StageNode::StageNode(tbb::flow::graph& graph, const NodeSpec& spec, const std::string& name,
+                                              std::function<uint64_t(uint64_t)> body, tbb::task_arena* arena) :
+         nodeStats(NodeProfiler::instance().node(name))
+   //-------------------------------------------------------------------------------------------------------------
    {
-      tbb::task_scheduler_init init_parallel;
-      uint64_t tc = static_cast<uint64_t>(init_parallel.default_num_threads());
-      tbb::flow::make_edge(tbbSourceNode, tbbRouterNode );
-//      tbb::flow::output_port<0>(tbbRouterNode).register_successor(tbbCalibrationNode);
-//      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRouterNode), tbbCalibrationNode);
-      tbb::flow::make_edge(tbb::flow::output_port<0>(tbbRouterNode), tbbDetectorNode);
-      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRouterNode), tbbTrackerNode);
-      tbb::flow::make_edge(tbb::flow::output_port<2>(tbbRouterNode), tbbRenderNode);
-//      tbb::flow::make_edge(tbbCalibrationNode, tbbRenderNode);
-//      tbb::flow::make_edge(tbbTrackerNode, tbbRenderNode);
-
-      bool stopSensors = false, isSingleThreadedRender = renderer->is_single_threaded();
-      Sensors& sensorController = Sensors::instance();
-      size_t noSensors = sensorController.size();
-      std::thread sensorThread;
-      if ( (isSingleThreadedRender) && (noSensors > 0) )
-         sensorThread = std::thread(&Sensors::sensor_handler_thread, &sensorController, 10, 200, std::ref(stopSensors));
-      else if (! isSingleThreadedRender)
-      {
-         std::stringstream errs;
-         size_t inited = sensorController.initialize(&errs);
-         if (inited != noSensors)
-         {
-            __android_log_print(ANDROID_LOG_ERROR, "TBBFlowGraphArchitecture::run()",
-                                "Not all sensors initialized (%s %ld/%ld)", errs.str().c_str(), inited, noSensors);
-            noSensors = inited;
-         }
+      const size_t concurrency = std::max<size_t>(1, spec.concurrency);
+      NodeStats* stats = nodeStats;
+      if ( (spec.isOffloaded) && (arena != nullptr) )
+      {  // Without buffering the limiter rejects frames once concurrency bodies are running in the arena
+         limiter.reset(new tbb::flow::limiter_node<uint64_t>(graph, concurrency + spec.buffer));
+         offload.reset(new OffloadNode(graph, tbb::flow::unlimited,
+                       [body, stats, arena] (const uint64_t& seqno, OffloadNode::gateway_type& gateway)
+                       {
+                          gateway.reserve_wait(); // Keeps wait_for_all() waiting until the body has run
+                          arena->enqueue([body, stats, seqno, &gateway] ()
+                          {
+                             {
+                                NodeScope scope(stats, seqno);
+                                body(seqno);
+                             }
+                             gateway.try_put(tbb::flow::continue_msg());
+                             gateway.release_wait();
+                          });
+                       }));
+         tbb::flow::make_edge(*limiter, *offload);
+         tbb::flow::make_edge(*offload, limiter->decrement);
+#if TBB_PREVIEW_FLOW_GRAPH_TRACE
+         limiter->set_name((name + ".limiter").c_str());
+         offload->set_name(name.c_str());
+#endif
       }
-
-      renderer->initialize();
-      repository->initialised.store(true);
-      tbbSourceNode.activate();
-      while ( (! graph.is_cancelled()) && (! repository->must_terminate.load()) )
+      else if (spec.buffer == 0)
       {
-         if (isSingleThreadedRender)
-         {
-            uint64_t seqno = renderer->render_st();
-            if (seqno > 0)
-               ;//tbbFramerateControlQueueNode.try_put(seqno);
-            else
-               std::this_thread::sleep_for(std::chrono::milliseconds(10));
-         }
-         else if (noSensors > 0)
-            sensorController.process_queues(10, 200);
-         else
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
+         rejecting.reset(new tbb::flow::function_node<uint64_t, uint64_t, tbb::flow::rejecting>(
+                         graph, concurrency,
+                         [body, stats] (uint64_t seqno) -> uint64_t
+                         {
+                            NodeScope scope(stats, seqno);
+                            return body(seqno);
+                         }));
+#if TBB_PREVIEW_FLOW_GRAPH_TRACE
+         rejecting->set_name(name.c_str());
+#endif
       }
-//    if (detectorType == DetectorType::BENCHMARK)
-      output_benchmark();
-
-      if ( (isSingleThreadedRender) && (noSensors > 0) )
+      else
       {
-         stopSensors = true;
-         sensorThread.join();
+         limiter.reset(new tbb::flow::limiter_node<uint64_t>(graph, concurrency + spec.buffer));
+         queueing.reset(new tbb::flow::function_node<uint64_t, tbb::flow::continue_msg, tbb::flow::queueing>(
+                        graph, concurrency,
+                        [body, stats] (uint64_t seqno) -> tbb::flow::continue_msg
+                        {
+                           NodeScope scope(stats, seqno);
+                           body(seqno);
+                           return tbb::flow::continue_msg();
+                        }));
+         tbb::flow::make_edge(*limiter, *queueing);
+         tbb::flow::make_edge(*queueing, limiter->decrement);
+#if TBB_PREVIEW_FLOW_GRAPH_TRACE
+         limiter->set_name((name + ".limiter").c_str());
+         queueing->set_name(name.c_str());
+#endif
       }
+   }
 
-
+   tbb::flow::receiver<uint64_t>& TBBGraphArchitecture::StageNode::input()
+   //---------------------------------------------------------------------
+   {
+      if (rejecting)
+         return *rejecting;
+      return *limiter;
    }
 
-   bool TBBMonoArchitecture::start()
-   //------------------------------
+   TBBGraphArchitecture::TBBGraphArchitecture(Renderer* renderer, const GraphSpec& graphSpec) :
+         FlowGraphArchitecture(renderer,
+                               (graphSpec.cameras.empty()) ? DetectorType::NONE : graphSpec.cameras[0].detectorType,
+                               (graphSpec.cameras.empty()) ? TrackerType::NONE : graphSpec.cameras[0].trackerType,
+                               graphSpec.rendererType), spec(graphSpec), graph(graphContext)
+   //-----------------------------------------------------------------------------------------------------------
    {
-      if (! cameraSourceNode.good())
-      {
-         __android_log_print(ANDROID_LOG_ERROR, "TBBMonoArchitecture::start()",
-                             "Error initialising camera source");
-         return false;
-      }
-      thread = std::thread(&TBBMonoArchitecture::run, this);
-      return true;
+#if __TBB_TASK_PRIORITY
+      graphContext.set_priority(tbb::priority_high); // Workers prefer the pipeline arena when it has work
+#endif
+      build();
    }
 
-   void TBBStereoArchitecture::run()
-   //----------------------------------
+   TBBGraphArchitecture::~TBBGraphArchitecture()
+   //-------------------------------------------
    {
-      tbb::task_scheduler_init init_parallel;
-      uint64_t tc = static_cast<uint64_t>(init_parallel.default_num_threads());
+      stop();
+      cameraNodes.clear(); // Nodes unregister from the graph as they are destroyed, so they must go first
+   }
 
-      tbb::flow::make_edge(tbbSourceNode1, tbb::flow::input_port<0>(tbbCamerasJoinNode));
-      tbb::flow::make_edge(tbbSourceNode2, tbb::flow::input_port<1>(tbbCamerasJoinNode));
-      tbb::flow::make_edge(tbbCamerasJoinNode,  tbbJoinProcessor);
-      tbb::flow::make_edge(tbbJoinProcessor,  tbbRouterNode);
-//      tbb::flow::make_edge(tbbCamerasJoinNode, tbbRouterNode );
+   void TBBGraphArchitecture::stop()
+   //-------------------------------
+   {
+      FlowGraphArchitecture::stop();
+      if (thread.joinable())
+         thread.join();
+      for (const CameraSpec& camera : spec.cameras)
+         rgba_consumers(camera, true, true); // For frames enqueued before the next graph is built
+   }
 
-//      tbb::flow::output_port<0>(tbbRouterNode).register_successor(tbbCalibrationNode);
-//      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRouterNode), tbbCalibrationNode);
-      tbb::flow::make_edge(tbb::flow::output_port<0>(tbbRouterNode), tbbDetectorNode);
-      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRouterNode), tbbTrackerNode);
-      tbb::flow::make_edge(tbb::flow::output_port<2>(tbbRouterNode), tbbRenderNode);
-//      tbb::flow::make_edge(tbbCalibrationNode, tbbRenderNode);
-//      tbb::flow::make_edge(tbbTrackerNode, tbbRenderNode);
+   void TBBGraphArchitecture::rgba_consumers(const CameraSpec& camera, bool isDetected, bool isRendered)
+   //-------------------------------------------------------------------------------------------------
+   {
+      for (unsigned long id : { camera.cameraId, camera.stereoCameraId })
+      {
+         Camera* cameraInterface = (id == std::numeric_limits<unsigned long>::max()) ? nullptr
+                                   : repository->hardware_camera_interface_ptr(id);
+         if (cameraInterface != nullptr)
+            cameraInterface->rgba_consumers(isDetected, isRendered);
+      }
+   }
 
-      bool stopSensors = false, isSingleThreadedRender = renderer->is_single_threaded();
-      Sensors& sensorController = Sensors::instance();
-      size_t noSensors = sensorController.size();
-      std::thread sensorThread;
-      if ( (isSingleThreadedRender) && (noSensors > 0) )
-         sensorThread = std::thread(&Sensors::sensor_handler_thread, &sensorController, 10, 200, std::ref(stopSensors));
-      else if (! isSingleThreadedRender)
+   void TBBGraphArchitecture::build()
+   //--------------------------------
+   {
+      // The pipeline arena defaults to a thread for each source (they block waiting for frames) and for each
+      // router and non offloaded node body, the compute arena to the remaining cores less one per render body.
+      size_t pipelineThreads = 0, renderThreads = 0;
+      for (CameraSpec& camera : spec.cameras)
       {
-         std::stringstream errs;
-         size_t inited = sensorController.initialize(&errs);
-         if (inited != noSensors)
+         if (camera.detector.concurrency == 0)
+            camera.detector.concurrency = detector_concurrency(camera.detectorType);
+         pipelineThreads += ((camera.is_stereo()) ? 2 : 1) + camera.router.concurrency;
+         for (const NodeSpec* node : { &camera.detector, &camera.tracker })
+            if (! node->isOffloaded) pipelineThreads += node->concurrency;
+         if (camera.isRendered)
          {
-            __android_log_print(ANDROID_LOG_ERROR, "TBBFlowGraphArchitecture::run()",
-                                "Not all sensors initialized (%s %ld/%ld)", errs.str().c_str(), inited, noSensors);
-            noSensors = inited;
+            renderThreads += camera.render.concurrency;
+            if (! camera.render.isOffloaded) pipelineThreads += camera.render.concurrency;
          }
       }
+      const size_t cores = static_cast<size_t>(tbb::task_scheduler_init::default_num_threads());
+      if (spec.pipelineArena.concurrency == 0)
+         spec.pipelineArena.concurrency = std::max<size_t>(2, pipelineThreads);
+      if (spec.computeArena.concurrency == 0)
+         spec.computeArena.concurrency = (cores > renderThreads + 1) ? cores - renderThreads : 1;
+      pipelineArena.initialize(static_cast<int>(spec.pipelineArena.concurrency), 0);
+      computeArena.initialize(static_cast<int>(spec.computeArena.concurrency), 0);
+      util::CpuPlacement& placement = util::CpuPlacement::instance();
+      for (unsigned stage = 0; stage < static_cast<unsigned>(util::StageClass::COUNT); stage++)
+         placement.set(static_cast<util::StageClass>(stage), spec.cores[stage]);
+      if (! placement.cores(util::StageClass::PIPELINE).empty())
+      {
+         pipelineObserver.reset(new util::ArenaPlacementObserver(pipelineArena, util::StageClass::PIPELINE));
+         pipelineObserver->observe(true);
+      }
+      if (! placement.cores(util::StageClass::COMPUTE).empty())
+      {  // apriltag creates its worker pool on the first detection, so its threads inherit the compute cores
+         computeObserver.reset(new util::ArenaPlacementObserver(computeArena, util::StageClass::COMPUTE));
+         computeObserver->observe(true);
+      }
+      __android_log_print(ANDROID_LOG_INFO, "TBBGraphArchitecture::build", "Pipeline arena %zu, compute arena %zu",
+                          spec.pipelineArena.concurrency, spec.computeArena.concurrency);
 
-      renderer->initialize();
-      tbbSourceNode1.activate(); tbbSourceNode2.activate();
-      repository->initialised.store(true);
-      while ( (! graph.is_cancelled()) && (! repository->must_terminate) )
+      for (CameraSpec& camera : spec.cameras)
       {
-         if (isSingleThreadedRender)
+         std::unique_ptr<CameraNodes> nodes(new CameraNodes);
+         const size_t maxInFlight = camera.max_in_flight();
+         nodes->sources.emplace_back(camera.cameraId, maxInFlight);
+         if (camera.is_stereo())
          {
-            uint64_t seqno = renderer->render_st();
-            if (seqno > 0)
-               ;//tbbFramerateControlQueueNode.try_put(seqno);
-            else
-               std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            nodes->sources.emplace_back(camera.stereoCameraId, maxInFlight);
+            std::shared_ptr<StereoAdmission> admission =
+                  std::make_shared<StereoAdmission>(camera.cameraId, camera.stereoCameraId, maxInFlight);
+            for (TBBMonoCameraSourceNode& source : nodes->sources)
+               source.pair(admission);
+         }
+         for (TBBMonoCameraSourceNode& source : nodes->sources)
+            nodes->sourceNodes.emplace_back(new SourceNode(graph, source, false));
+         rgba_consumers(camera, camera.is_rgba_detected(), camera.isRendered);
+         __android_log_print(ANDROID_LOG_INFO, "TBBGraphArchitecture::build",
+                             "Camera %lu: at most %zu frames in flight", camera.cameraId, maxInFlight);
+
+         nodes->detector.reset(make_detector(camera.detectorType, camera.cameraId, camera.stereoCameraId,
+                                             camera.isOverlayOnRear, 0, camera.detector.concurrency));
+         nodes->tracker.reset(make_tracker(camera.trackerType, camera.cameraId, camera.stereoCameraId));
+         Renderer* cameraRenderer = (camera.isRendered) ? renderer : nullptr;
+         if (camera.isRendered)
+            nodes->render.reset(make_render(rendererType, renderer, camera.cameraId));
+
+         const std::string name = "camera." + std::to_string(camera.cameraId);
+         Detector* detector = nodes->detector.get();
+         Tracker* tracker = nodes->tracker.get();
+         nodes->detectorStage.reset(new StageNode(graph, camera.detector, name + ".detector",
+                                                  [detector] (uint64_t seqno) -> uint64_t
+                                                  { return (*detector)(seqno); }, &computeArena));
+         nodes->trackerStage.reset(new StageNode(graph, camera.tracker, name + ".tracker",
+                                                 [tracker] (uint64_t seqno) -> uint64_t
+                                                 { return (*tracker)(seqno); }, &computeArena));
+         if (nodes->render)
+         {
+            RenderNode* render = nodes->render.get();
+            nodes->renderStage.reset(new StageNode(graph, camera.render, name + ".render",
+                                                   [render] (uint64_t seqno) -> uint64_t
+                                                   { return (*render)(seqno); }, &computeArena));
          }
-         else if (noSensors > 0)
-            sensorController.process_queues(10, 200);
-         else
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
 
+         TBBRouterParameters routerParameters(0, nodes->detector.get(), nodes->tracker.get(), cameraRenderer,
+                                              ! camera.isRendered);
+         routerParameters.detectorStats = nodes->detectorStage->stats();
+         routerParameters.trackerStats = nodes->trackerStage->stats();
+         if (nodes->renderStage)
+            routerParameters.renderStats = nodes->renderStage->stats();
+         std::unordered_map<unsigned long, TBBRouterParameters> routerMap = { { camera.cameraId, routerParameters } };
+         TBBRouter router(routerMap, name + ".router");
+         router.set_stats(NodeProfiler::instance().node(router.get_name()));
+         nodes->router.reset(new RouterNode(graph, std::max<size_t>(1, camera.router.concurrency), router));
+#if TBB_PREVIEW_FLOW_GRAPH_TRACE
+         nodes->router->set_name(router.get_name().c_str());
+#endif
+
+         if (camera.is_stereo())
+         {
+            nodes->join.reset(new StereoJoinNode(graph));
+            nodes->joinProcessor.reset(new StereoJoinProcessor(graph, 1,
+                                       [this] (std::tuple<uintptr_t, uintptr_t> tt) -> uintptr_t
+                                       { return join_stereo(tt); }));
+            tbb::flow::make_edge(*nodes->sourceNodes[0], tbb::flow::input_port<0>(*nodes->join));
+            tbb::flow::make_edge(*nodes->sourceNodes[1], tbb::flow::input_port<1>(*nodes->join));
+            tbb::flow::make_edge(*nodes->join, *nodes->joinProcessor);
+            tbb::flow::make_edge(*nodes->joinProcessor, *nodes->router);
+         }
+         else
+            tbb::flow::make_edge(*nodes->sourceNodes[0], *nodes->router);
+         tbb::flow::make_edge(tbb::flow::output_port<0>(*nodes->router), nodes->detectorStage->input());
+         tbb::flow::make_edge(tbb::flow::output_port<1>(*nodes->router), nodes->trackerStage->input());
+         if (nodes->renderStage)
+            tbb::flow::make_edge(tbb::flow::output_port<2>(*nodes->router), nodes->renderStage->input());
+         cameraNodes.push_back(std::move(nodes));
       }
-//    if (detectorType == DetectorType::BENCHMARK)
-      output_benchmark();
-      if ( (isSingleThreadedRender) && (noSensors > 0) )
-      {
-         stopSensors = true;
-         sensorThread.join();
-      }
-
    }
 
-   bool TBBMonoAndFrontArchitecture::start()
-   //--------------------------------------
+   uintptr_t TBBGraphArchitecture::join_stereo(const std::tuple<uintptr_t, uintptr_t>& frames)
+   //-----------------------------------------------------------------------------------------
    {
-      thread = std::thread(&TBBMonoAndFrontArchitecture::run, this);
-//      frontThread = std::thread(&TBBMonoAndFrontArchitecture::run_forward, this);
-      return true;
+      CameraFrame* cameraFrame1 = (CameraFrame*) std::get<0>(frames);
+      CameraFrame* cameraFrame2 = (CameraFrame*) std::get<1>(frames);
+      if ( (cameraFrame1->count == 0) || (cameraFrame2->count == 0) )
+      {  // One camera had no frame for this slot, so the other frame has no twin
+         CameraFrame* realFrame = (cameraFrame1->count > 0) ? cameraFrame1 : cameraFrame2;
+         if (realFrame->count > 0)
+         {
+            static util::Counter* unpaired = util::Metrics::instance().counter("stereo.unpaired");
+            unpaired->add();
+            repository->delete_frame(realFrame->cameras[0].cameraId, realFrame->cameras[0].seqno_1);
+         }
+         delete cameraFrame2;
+         cameraFrame1->clear();
+         return (uintptr_t) cameraFrame1;
+      }
+      unsigned long id1 = cameraFrame1->cameras[0].cameraId;
+      uint64_t seq1 = cameraFrame1->cameras[0].seqno_1;
+      unsigned long id2 = cameraFrame2->cameras[0].cameraId;
+      uint64_t seq2 = cameraFrame2->cameras[0].seqno_1;
+      if (! repository->is_submitted_pair(id1, seq1, id2, seq2))
+      {  // Frames from different batched stereo submissions, pass the first camera's frame on as mono and drop the
+         // second, which would otherwise never be routed or deleted
+         static util::Counter* mismatched = util::Metrics::instance().counter("stereo.mismatched");
+         mismatched->add();
+         repository->delete_frame(id2, seq2);
+         delete cameraFrame2;
+         return (uintptr_t) cameraFrame1;
+      }
+      repository->stereo_pair(id1, seq1, id2, seq2);
+      cameraFrame1->set_stereo(0, id1, id2, seq1, seq2, true);
+      delete cameraFrame2;
+      return (uintptr_t) cameraFrame1;
    }
 
-   void TBBMonoAndFrontArchitecture::run()
-   //------------------------------------------
+   bool TBBGraphArchitecture::start()
+   //--------------------------------
    {
-      tbb::flow::make_edge(tbbBackSourceNode, tbbRearRouterNode );
-      tbb::flow::make_edge(tbbFrontSourceNode, tbbFrontRouterNode );
-//      tbb::flow::output_port<0>(tbbRouterNode).register_successor(tbbCalibrationNode);
-//      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRouterNode), tbbCalibrationNode);
-      tbb::flow::make_edge(tbb::flow::output_port<0>(tbbRearRouterNode), tbbBackDetectorNode);
-      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRearRouterNode), tbbBackTrackerNode);
-      tbb::flow::make_edge(tbb::flow::output_port<2>(tbbRearRouterNode), tbbRenderNode);
-
-      tbb::flow::make_edge(tbb::flow::output_port<0>(tbbFrontRouterNode), tbbFrontDetectorNode);
-      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbFrontRouterNode), tbbFrontTrackerNode);
-//      tbb::flow::make_edge(tbb::flow::output_port<2>(tbbFrontRouterNode), tbbDummyRenderNode);
-
-      bool stopSensors = false, isSingleThreadedRender = renderer->is_single_threaded();
-      Sensors& sensorController = Sensors::instance();
-      size_t noSensors = sensorController.size();
-      std::thread sensorThread;
-      if ( (isSingleThreadedRender) && (noSensors > 0) )
-         sensorThread = std::thread(&Sensors::sensor_handler_thread, &sensorController, 10, 200, std::ref(stopSensors));
-      else if (! isSingleThreadedRender)
+      if (cameraNodes.empty())
       {
-         std::stringstream errs;
-         size_t inited = sensorController.initialize(&errs);
-         if (inited != noSensors)
-         {
-            __android_log_print(ANDROID_LOG_ERROR, "TBBFlowGraphArchitecture::run()",
-                                "Not all sensors initialized (%s %ld/%ld)", errs.str().c_str(), inited, noSensors);
-            noSensors = inited;
-         }
+         __android_log_print(ANDROID_LOG_ERROR, "TBBGraphArchitecture::start()", "No cameras in graph spec");
+         return false;
       }
-
-      renderer->initialize();
-      tbbBackSourceNode.activate(); tbbFrontSourceNode.activate();
-      repository->initialised.store(true);
-      while ( (! repository->must_terminate) && (! graph.is_cancelled()) )
+      for (std::unique_ptr<CameraNodes>& nodes : cameraNodes)
       {
-         if (isSingleThreadedRender)
+         for (TBBMonoCameraSourceNode& source : nodes->sources)
          {
-            uint64_t seqno = renderer->render_st();
-            //if (seqno > 0)
-               ;//tbbFramerateControlQueueNode.try_put(seqno);
-            //else
-               std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (! source.good())
+            {
+               __android_log_print(ANDROID_LOG_ERROR, "TBBGraphArchitecture::start()",
+                                   "Error initialising camera source");
+               return false;
+            }
          }
-         else if (noSensors > 0)
-            sensorController.process_queues(10, 200);
-         else
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-      }
-      if ( (isSingleThreadedRender) && (noSensors > 0) )
-      {
-         stopSensors = true;
-         sensorThread.join();
       }
-      graph.wait_for_all();
-//      if (detectorType == DetectorType::BENCHMARK)
-         output_benchmark();
-   }
-
-   /*
-    * WARNING: TBBStereoAndFrontArchitecture untested as none of my devices supported
-    * 3 video streams.
-    */
-   bool TBBStereoAndFrontArchitecture::start()
-   //-----------------------------------------
-   {
-      thread = std::thread(&TBBStereoAndFrontArchitecture::run, this);
+      thread = std::thread(&TBBGraphArchitecture::run, this);
       return true;
    }
 
-   void TBBStereoAndFrontArchitecture::run()
-   //----------------------------------
+   void TBBGraphArchitecture::run()
+   //------------------------------
    {
       tbb::task_scheduler_init init_parallel;
-      uint64_t tc = static_cast<uint64_t>(init_parallel.default_num_threads());
-
-      tbb::flow::make_edge(tbbSourceNode1, tbb::flow::input_port<0>(tbbCamerasJoinNode));
-      tbb::flow::make_edge(tbbSourceNode2, tbb::flow::input_port<1>(tbbCamerasJoinNode));
-      tbb::flow::make_edge(tbbFrontSourceNode, tbbFrontRouterNode );
-      tbb::flow::make_edge(tbbCamerasJoinNode,  tbbJoinProcessor);
-      tbb::flow::make_edge(tbbJoinProcessor,  tbbBackRouterNode);
-//      tbb::flow::make_edge(tbbCamerasJoinNode, tbbRouterNode );
-
-//      tbb::flow::output_port<0>(tbbRouterNode).register_successor(tbbCalibrationNode);
-//      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbRouterNode), tbbCalibrationNode);
-      tbb::flow::make_edge(tbb::flow::output_port<0>(tbbBackRouterNode), tbbBackDetectorNode);
-      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbBackRouterNode), tbbBackTrackerNode);
-      tbb::flow::make_edge(tbb::flow::output_port<2>(tbbBackRouterNode), tbbRenderNode);
-      tbb::flow::make_edge(tbb::flow::output_port<0>(tbbFrontRouterNode), tbbFrontDetectorNode);
-      tbb::flow::make_edge(tbb::flow::output_port<1>(tbbFrontRouterNode), tbbFrontTrackerNode);
-
       bool stopSensors = false, isSingleThreadedRender = renderer->is_single_threaded();
       Sensors& sensorController = Sensors::instance();
       size_t noSensors = sensorController.size();
       std::thread sensorThread;
       if ( (isSingleThreadedRender) && (noSensors > 0) )
          sensorThread = std::thread(&Sensors::sensor_handler_thread, &sensorController, 10, 200, std::ref(stopSensors));
-      else if (! isSingleThreadedRender)
+      else if ( (! isSingleThreadedRender) && (noSensors > 0) )
+         sensorController.initialize_async(); // Overlaps renderer and camera startup, waited for below
+
+      renderer->initialize();
+      repository->initialised.store(true);
+      pipelineArena.execute([this] ()
+      {
+         graph.reset(); // Attaches the graph to the pipeline arena
+         for (std::unique_ptr<CameraNodes>& nodes : cameraNodes)
+            for (std::unique_ptr<SourceNode>& source : nodes->sourceNodes)
+               source->activate();
+      });
+      if ( (! isSingleThreadedRender) && (noSensors > 0) )
       {
          std::stringstream errs;
-         size_t inited = sensorController.initialize(&errs);
+         size_t inited = sensorController.wait_initialized(&errs);
          if (inited != noSensors)
          {
-            __android_log_print(ANDROID_LOG_ERROR, "TBBFlowGraphArchitecture::run()",
+            __android_log_print(ANDROID_LOG_ERROR, "TBBGraphArchitecture::run()",
                                 "Not all sensors initialized (%s %ld/%ld)", errs.str().c_str(), inited, noSensors);
             noSensors = inited;
          }
       }
-
-      renderer->initialize();
-      tbbSourceNode1.activate(); tbbSourceNode2.activate();
-      tbbFrontSourceNode.activate();
-      repository->initialised.store(true);
-      while ( (! graph.is_cancelled()) && (! repository->must_terminate) )
+      if (isSingleThreadedRender)
+         util::CpuPlacement::instance().pin_current_thread(util::StageClass::PIPELINE);
+      else if (noSensors > 0)
+         util::CpuPlacement::instance().pin_current_thread(util::StageClass::SENSORS);
+      while ( (! graph.is_cancelled()) && (! repository->must_terminate.load()) )
       {
          if (isSingleThreadedRender)
          {
             uint64_t seqno = renderer->render_st();
-            if (seqno > 0)
-               ;//tbbFramerateControlQueueNode.try_put(seqno);
-            else
+            if (seqno == 0)
                std::this_thread::sleep_for(std::chrono::milliseconds(10));
          }
          else if (noSensors > 0)
             sensorController.process_queues(10, 200);
          else
             std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
       }
+      // Sources return false once must_terminate is set, so wake any blocked waiting for a frame and let the frames
+      // in flight finish
+      for (std::unique_ptr<CameraNodes>& nodes : cameraNodes)
+         for (TBBMonoCameraSourceNode& source : nodes->sources)
+            source.interrupt();
+      pipelineArena.execute([this] () { graph.wait_for_all(); });
+      for (std::unique_ptr<CameraNodes>& nodes : cameraNodes)
+         for (TBBMonoCameraSourceNode& source : nodes->sources)
+            source.clear();
+      output_benchmark();
       if ( (isSingleThreadedRender) && (noSensors > 0) )
       {
          stopSensors = true;
          sensorThread.join();
       }
-//      if (detectorType == DetectorType::BENCHMARK)
-         output_benchmark();
    }
 
    void FlowGraphArchitecture::output_benchmark()
@@ -410,15 +655,21 @@ namespace toMAR
                    it != repository->detectorStatistics.end(); ++it)
          {
             unsigned long camera = it->first;
-            RunningStatistics<uint64_t, long double>* statistics = it->second;
+            util::ShardedStatistics<uint64_t, long double>* sharded = it->second;
             constexpr long double nano2s = static_cast<long double>(1000000000.0);
-            if ( (camera != std::numeric_limits<unsigned long>::max()) && (statistics != nullptr) )
+            if ( (camera != std::numeric_limits<unsigned long>::max()) && (sharded != nullptr) )
             {
+               RunningStatistics<uint64_t, long double> statistics = sharded->combined();
+               const double ps[] = { 50, 95, 99 };
+               uint64_t pv[3];
+               sharded->percentiles(ps, pv, 3);
                ofs << "Camera " << camera << std::endl;
-               long double mean = statistics->mean();
+               long double mean = statistics.mean();
                ofs << "Mean: " << std::fixed << std::setprecision(8) << mean / nano2s << std::endl;
-               ofs << "Deviation:" << std::fixed << std::setprecision(8) << statistics->deviation() / nano2s << std::endl;
+               ofs << "Deviation:" << std::fixed << std::setprecision(8) << statistics.deviation() / nano2s << std::endl;
                ofs << "Framerate (mean): " << std::fixed << std::setprecision(8) << (nano2s / mean) << std::endl;
+               ofs << "p50/p95/p99: " << std::fixed << std::setprecision(8) << pv[0] / nano2s << " "
+                   << pv[1] / nano2s << " " << pv[2] / nano2s << std::endl;
                ofs << std::string(80, '=') << std::endl;
             }
          }
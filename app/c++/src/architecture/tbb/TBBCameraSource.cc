@@ -13,6 +13,26 @@
 
 namespace toMAR
 {
+   bool StereoAdmission::admit(unsigned long camera, bool hasFrame)
+   //--------------------------------------------------------------
+   {
+      const unsigned side = (camera == cameraIds[0]) ? 0 : 1;
+      tbb::spin_mutex::scoped_lock lock(mutex);
+      std::deque<bool>& other = pending[1 - side];
+      if (! other.empty())
+      {  // The other camera's frame for this slot has been decided, follow it
+         const bool isAdmitted = other.front();
+         other.pop_front();
+         return ( (isAdmitted) && (hasFrame) );
+      }
+      bool isAdmitted = hasFrame;
+      if ( (isAdmitted) && (maxInFlight > 0) )
+         isAdmitted = ( (repository->frames_in_flight(cameraIds[0]) < maxInFlight) &&
+                        (repository->frames_in_flight(cameraIds[1]) < maxInFlight) );
+      pending[side].push_back(isAdmitted);
+      return isAdmitted;
+   }
+
    bool TBBMonoCameraSourceNode::init()
    //----------------------------------
    {
@@ -24,6 +44,13 @@ namespace toMAR
          return false;
       }
       camera_interface->clear();
+      const std::string name = "source." + std::to_string(cameraId);
+      util::Metrics& metrics = util::Metrics::instance();
+      dropped = metrics.counter(name + ".dropped");
+      Repository* repo = repository;
+      const unsigned long camera = cameraId;
+      metrics.gauge(name + ".in_flight",
+                    [repo, camera]() -> int64_t { return static_cast<int64_t>(repo->frames_in_flight(camera)); });
       return true;
    }
 
@@ -33,8 +60,19 @@ namespace toMAR
       std::shared_ptr<FrameInfo> frame;
       CameraFrame* cameraFrame = new CameraFrame;
       camera_interface->dequeue_blocked(frame);
+      bool isAdmitted;
+      if (stereoAdmission)
+         isAdmitted = stereoAdmission->admit(cameraId, (frame != nullptr));
+      else
+         isAdmitted = ( (maxInFlight == 0) || (repository->frames_in_flight(cameraId) < maxInFlight) );
+      if ( (frame) && (! isAdmitted) )
+      {  // Downstream has not caught up, drop the frame before it is entered in the repository
+         dropped->add();
+         frame.reset();
+      }
       if (frame) //(camera_interface->dequeue(frame))
       {
+         frame->trace.stamp(TraceStage::SOURCE);
          uint64_t seq = repository->new_frame(cameraId, frame); // + offset;
          cameraFrame->set(0, cameraId, seq);
 //         __android_log_print(ANDROID_LOG_INFO, "TBBMonoCameraSourceNode::operator()", "Camera %lu: Enqueued %lu", cameraId, seq);
@@ -59,11 +97,13 @@ namespace toMAR
       size_t i = 0;
       if (camera1Interface->dequeue(frame1))
       {
+         frame1->trace.stamp(TraceStage::SOURCE);
          uint64_t seq1 = repository->new_frame(camera1Id, frame1);
          cameraFrame->set(i++, camera1Id, seq1);
       }
       if (camera2Interface->dequeue(frame2))
       {
+         frame2->trace.stamp(TraceStage::SOURCE);
          uint64_t seq2 = repository->new_frame(camera2Id, frame2);
          cameraFrame->set(i, camera2Id, seq2);
       }
@@ -223,6 +263,8 @@ namespace toMAR
             return (! repository->must_terminate);
          if (! camera1_interface->dequeue(frame2))
             return (! repository->must_terminate);
+         frame1->trace.stamp(TraceStage::SOURCE);
+         frame2->trace.stamp(TraceStage::SOURCE);
          unsigned long camera1 = camera0_interface->camera_id();
          unsigned long camera2 = camera1_interface->camera_id();
          uint64_t seq = repository->new_stereo_frame(camera1, frame1, camera2, frame2);
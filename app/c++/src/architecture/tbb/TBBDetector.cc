@@ -16,9 +16,19 @@
 #include "mar/util/android.hh"
 #include "mar/util/util.hh"
 #include "mar/util/cv.h"
+#include "mar/util/Metrics.h"
 
 namespace toMAR
 {
+   //! Counts results discarded by a latest value channel because a newer frame's result was already published.
+   static inline void count_published(bool isPublished)
+   //--------------------------------------------------
+   {
+      static util::Counter* outOfOrder = util::Metrics::instance().counter("detector.out_of_order");
+      if (! isPublished)
+         outOfOrder->add();
+   }
+
    std::atomic_bool TBBSimulationDetector::isDetecting{false};
 
     uint64_t TBBSimulationDetector::operator()(uint64_t seqno)
@@ -28,7 +38,9 @@ namespace toMAR
        std::shared_ptr<FrameInfo> frame;
        if (repository->get_frame(camera1Id, seqno, frame))
        {
+          frame->trace.stamp(TraceStage::DETECT_START);
           spin(isDetecting, frame.get(), detectRate);
+          frame->trace.stamp(TraceStage::DETECT_END);
           frame->isDetecting.store(false);
           repository->delete_frame(camera1Id,  seqno);
        }
@@ -38,15 +50,12 @@ namespace toMAR
    bool TBBSimulationDetector::is_detecting() { return isDetecting.load(); }
 
 #ifdef HAS_APRILTAGS
-   tbb::concurrent_unordered_map<unsigned long, std::atomic_bool*> AprilTagTBBDetector::isDetecting;
-
    AprilTagTBBDetector::AprilTagTBBDetector(unsigned long camera1, unsigned long camera2) :
                                             Detector(),
                                             camera1Id(camera1), camera2Id(camera2),
                                             repository(Repository::instance())
    //-----------------------------------------------------------------------------------
    {
-      isDetecting[camera1] = new std::atomic_bool(false);
       init();
    }
 
@@ -73,12 +82,6 @@ namespace toMAR
          apriltag_detector_destroy(detector);
          detector = nullptr;
       }
-      auto it = isDetecting.find(camera1Id);
-      if (it != isDetecting.end())
-      {
-         if (it->second)
-            delete it->second;
-      }
    }
 
 
@@ -91,7 +94,8 @@ namespace toMAR
 //      __android_log_print(ANDROID_LOG_INFO, "AprilTagTBBDetector::operator()",
 //                          "Detector frame %lu", frame->seqno);
 
-      isDetecting[camera1Id]->store(true);
+      isDetecting.store(true);
+      frame->trace.stamp(TraceStage::DETECT_START);
 
 //      bool currently_detecting = false;  //not necessary - parallelism is set to 1
 //      if (! isDetecting.compare_exchange_strong(currently_detecting, true)) return seqno;
@@ -120,21 +124,19 @@ namespace toMAR
 
       if (detections != nullptr)
       {
-         tbb::concurrent_hash_map<uint64_t, std::vector<DetectedBoundingBox*>>& targets = repository->aprilTags;
-         std::vector<DetectedBoundingBox*> L;
-         for (int i = 0; i < zarray_size(detections); i++)
-         {
-            apriltag_detection_t *det;
-            zarray_get(detections, i, &det);
-//            cv::Rect2d rect(det->p[0][0], det->p[0][1], det->p[3][0] - det->p[0][0],
-//                            det->p[3][1] - det->p[0][1]);
-            L.push_back(new DetectedBoundingBox(seqno, camera1Id, det->p[0][0], det->p[0][1],
-                                                 det->p[2][0], det->p[2][1]));
-            apriltag_detection_destroy(det);
-         }
-         zarray_destroy(detections);
-         targets.insert(std::make_pair(seqno, L));
-         repository->recentAprilTags.push(seqno);
+         Repository::DetectionChannel* channel = repository->detections(camera1Id);
+         if (channel != nullptr)
+            count_published(channel->publish(seqno, [this, seqno, detections](std::vector<DetectedBoundingBox>& L)
+            {
+               L.clear();
+               for (int i = 0; i < zarray_size(detections); i++)
+               {
+                  apriltag_detection_t *det;
+                  zarray_get(detections, i, &det);
+                  L.emplace_back(seqno, camera1Id, det->p[0][0], det->p[0][1], det->p[2][0], det->p[2][1]);
+               }
+            }));
+         apriltag_detections_destroy(detections);
       }
       // As we don't have stereo calibration (see Kaliber) we can't do much with stereo info,
       // so just do detection on stereo camera for benchmark without using the detections.
@@ -179,6 +181,7 @@ namespace toMAR
 
       if (frame)
       {
+         frame->trace.stamp(TraceStage::DETECT_END);
          frame->isDetecting.store(false);
          repository->delete_frame(camera1Id,  seqno);
       }
@@ -189,7 +192,7 @@ namespace toMAR
          repository->delete_frame(camera2Id,  seqno);
       }
 
-      isDetecting[camera1Id]->store(false);
+      isDetecting.store(false);
       return seqno;
    }
 
@@ -243,50 +246,41 @@ namespace toMAR
 #endif
 
 #ifdef HAS_FACE_DETECTION
-   tbb::concurrent_unordered_map<unsigned long, std::atomic_bool*> FaceTBBDetector::isDetecting;
-   tbb::concurrent_unordered_map<unsigned long, std::atomic_bool*> FaceOverlayTBBDetector::isDetecting;
-
    uint64_t FaceTBBDetector::operator()(uint64_t seqno)
    //-------------------------------------------------
    {
       std::shared_ptr<FrameInfo> frame;
       if (! repository->get_frame(cameraId, seqno, frame))
          return seqno;
-      isDetecting[cameraId]->store(true);
+      isDetecting.store(true);
+      frame->trace.stamp(TraceStage::DETECT_START);
       void* env;
       unsigned char* framedata = frame->getColorData(env);
       DetectRect<int> faceBB;
-      if (toMAR::vision::find_face(framedata, frame->width, frame->height, 90000, faceBB,
-                               "FaceTBBDetector::()"))
+      if (toMAR::vision::find_face(cascade.get(), framedata, frame->width, frame->height, 90000, faceBB,
+                                   "FaceTBBDetector::()"))
       {
          cv::Rect roi(faceBB.top, faceBB.left, faceBB.width(), faceBB.height());
-         repository->faceDetections.insert(std::make_pair(seqno,
-                                           new DetectedBoundingBox(seqno, cameraId, roi.y, roi.x,
-                                           roi.y + roi.height, roi.x + roi.width)));
-         repository->recentFaceDetections.push(seqno);
+         Repository::DetectionChannel* channel = repository->detections(cameraId);
+         if (channel != nullptr)
+            count_published(channel->publish(seqno, [this, seqno, &roi](std::vector<DetectedBoundingBox>& L)
+            {
+               L.clear();
+               L.emplace_back(seqno, cameraId, roi.y, roi.x, roi.y + roi.height, roi.x + roi.width);
+            }));
          // __android_log_print(ANDROID_LOG_INFO, "FaceTBBDetector::operator()",
          //                     "Found face %d,%d %dx%d",
          //                     roi.x, roi.y, roi.x + roi.width, roi.y + roi.height);
       }
       frame->releaseColorData(env, framedata);
-      isDetecting[cameraId]->store(false);
+      frame->trace.stamp(TraceStage::DETECT_END);
+      isDetecting.store(false);
       frame->isDetecting.store(false);
       repository->delete_frame(cameraId, seqno);
       last_detection = toMAR::util::now_monotonic();
       return seqno;
    }
 
-   FaceTBBDetector::~FaceTBBDetector()
-   //---------------------------------
-   {
-      auto it = isDetecting.find(cameraId);
-      if (it != isDetecting.end())
-      {
-         if (it->second)
-            delete it->second;
-      }
-   }
-
    uint64_t FaceOverlayTBBDetector::operator()(uint64_t seqno)
    //-----------------------------------------------------------
    {
@@ -294,58 +288,35 @@ namespace toMAR
       if (! repository->get_frame(cameraId, seqno, frame))
          return seqno;
       const int64_t now = toMAR::util::now_monotonic();
-      isDetecting[cameraId]->store(true); // required for router
+      isDetecting.store(true); // required for router
+      frame->trace.stamp(TraceStage::DETECT_START);
       void* env;
       unsigned char* framedata = frame->getColorData(env);
       DetectRect<int> faceBB;
-      if (toMAR::vision::find_face(framedata, frame->width, frame->height, 20000, faceBB,
+      if (toMAR::vision::find_face(cascade.get(), framedata, frame->width, frame->height, 20000, faceBB,
                                    "FaceOverlayTBBDetector::()"))
       {
          cv::Rect roi(faceBB.top, faceBB.left, faceBB.width(), faceBB.height());
          // __android_log_print(ANDROID_LOG_INFO, "FaceOverlayTBBDetector::operator()",
          //                     "Found face %d,%d %dx%d",
          //                     roi.x, roi.y, roi.x + roi.width, roi.y + roi.height);
-         tbb::concurrent_hash_map<uint64_t, DetectedROI*>& overlays = repository->faceOverlays;
-         std::vector<uint64_t> dels;
-         int count = 0;
-         uint64_t delSeq = repository->currentRenderOverlay.load() - 1;
-         for (auto it=overlays.begin(); it!=overlays.end(); ++it)
-         {
-            if (count++ > 5) break;
-            DetectedROI *lastOverlay = it->second;
-            if (lastOverlay->inUse) continue;
-            uint64_t seq = it->first;
-            if (seq < delSeq)
-            {
-               if (lastOverlay != nullptr)
-               {
-                  dels.push_back(seq);
-                  if (lastOverlay->image != nullptr)
-                  {
-                     cv::Mat* pm = static_cast<cv::Mat*>(lastOverlay->image);
-                     delete pm;
-                  }
-                  lastOverlay->image = nullptr;
-                  delete lastOverlay;
-//                     it = overlays.erase(it);
-                  // __android_log_print(ANDROID_LOG_INFO, "FaceOverlayTBBDetector::()", "Deleted face overlay %lu", seq);
-               }
-            }
-         }
-         for (uint64_t sn : dels) overlays.erase(sn);
          try
          {
             cv::Mat rgba(frame->height, frame->width, CV_8UC4, framedata);
-            cv::Mat* m = new cv::Mat(roi.height, roi.width, CV_8UC4);  //new cv::Mat(rgba, roi);
-            cv::Rect croppedRoi = roi & cv::Rect(0, 0, rgba.cols, rgba.rows); // https://answers.opencv.org/question/70953/roi-out-of-bounds-issue/
-            rgba(croppedRoi).copyTo(*m);
-            overlays.insert(std::make_pair(seqno, new DetectedROI(seqno,  cameraId,
-                                           static_cast<void *>(m),
-                                           roi.y, roi.x, roi.y + roi.height, roi.x + roi.width)));
-            repository->lastFaceOverlay.store(seqno);
-            // __android_log_print(ANDROID_LOG_INFO, "FaceOverlayTBBDetector::()",
-            //                     "Pushed overlay %lu %lu %dx%d %dx%d %p %p", cameraId, seqno, roi.width, roi.height, m->cols, m->rows,
-            //                     static_cast<void *>(rgba.data), static_cast<void *>(m->data));
+            // https://answers.opencv.org/question/70953/roi-out-of-bounds-issue/
+            const cv::Rect croppedRoi = roi & cv::Rect(0, 0, rgba.cols, rgba.rows);
+            count_published(repository->faceOverlay.publish(seqno,
+                                                            [this, seqno, &rgba, &roi, &croppedRoi](DetectedROI& face)
+            {
+               face.image.resize(croppedRoi.area() * 4);
+               cv::Mat m(croppedRoi.height, croppedRoi.width, CV_8UC4, face.image.data());
+               rgba(croppedRoi).copyTo(m);
+               face.width = croppedRoi.width;
+               face.height = croppedRoi.height;
+               face.BB = DetectRect<double>(roi.y, roi.x, roi.y + roi.height, roi.x + roi.width);
+               face.cameraId = cameraId;
+               face.seqno = seqno;
+            }));
          }
          catch (cv::Exception& cverr)
          {
@@ -360,23 +331,43 @@ namespace toMAR
          }
       }
       frame->releaseColorData(env, framedata);
-      isDetecting[cameraId]->store(false);
+      frame->trace.stamp(TraceStage::DETECT_END);
+      isDetecting.store(false);
       frame->isDetecting.store(false);
       repository->delete_frame(cameraId, seqno);
       return seqno;
    }
+#endif
 
-   FaceOverlayTBBDetector::~FaceOverlayTBBDetector()
+   DetectorPool::DetectorPool(unsigned long camera, std::vector<std::unique_ptr<Detector>>&& detectors) :
+      Detector(), cameraId(camera), instances(std::move(detectors))
+   //--------------------------------------------------------------------------------------------------
+   {
+      for (std::unique_ptr<Detector>& detector : instances)
+         idle.push(detector.get());
+   }
+
+   uint64_t DetectorPool::operator()(uint64_t seqno)
    //-----------------------------------------------
    {
-      auto it = isDetecting.find(cameraId);
-      if (it != isDetecting.end())
-      {
-         if (it->second)
-            delete it->second;
+      Detector* detector;
+      if (! idle.try_pop(detector))
+      {  // Only if the node was given a higher concurrency than the number of instances
+         Repository* repository = Repository::instance();
+         std::shared_ptr<FrameInfo> frame;
+         if (repository->get_frame(cameraId, seqno, frame))
+         {
+            frame->isDetecting.store(false);
+            repository->delete_frame(cameraId, seqno);
+         }
+         return seqno;
       }
+      busy++;
+      (*detector)(seqno);
+      busy--;
+      idle.push(detector);
+      return seqno;
    }
-#endif
 
    uint64_t TBBNullDetector::operator()(uint64_t seqno)
    //-------------------------------------------------
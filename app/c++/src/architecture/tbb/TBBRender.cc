@@ -90,11 +90,11 @@ namespace toMAR
          {
             __android_log_print(ANDROID_LOG_INFO, " TBBBenchmarkRender::operator()", "Render %lu %lu", frame->camera_id, frame->seqno);
             const int64_t ts = frame->timestamp;
-            RunningStatistics<uint64_t, long double>* statistics = repository->rendererStats(cameraId);
+            util::ShardedStatistics<uint64_t, long double>* statistics = repository->rendererStats(cameraId);
             if (statistics)
             {
                long double taken = static_cast<long double>(ts - last_timestamp);
-               (*statistics)(taken);
+               (*statistics)(taken, ts);
             }
             last_timestamp = ts;
             renderer->render(seqno, cameraId); //TODO CHECK: renderer please reset repository->isRendering when done
@@ -3,9 +3,17 @@
 #include <android/log.h>
 
 #include "mar/architecture/tbb/TBBRouter.h"
+#include "mar/util/Metrics.h"
 
 namespace toMAR
 {
+   static inline bool offered(NodeStats* stats, bool isAccepted)
+   {
+      if (stats != nullptr)
+         stats->offered(isAccepted);
+      return isAccepted;
+   }
+
    void TBBRouter::operator()(const uintptr_t in,
                    tbb::flow::multifunction_node<uintptr_t,
                    RouterOutputTuple>::output_ports_type& out)
@@ -19,6 +27,12 @@ namespace toMAR
       //                     cameraFrame->count);
       if (cameraFrame->count == 0)
          return;
+      NodeScope scope(stats, cameraFrame->cameras[0].seqno_1);
+      static util::Metrics& metrics = util::Metrics::instance();
+      static util::Counter* routedDetect = metrics.counter("router.detect"),
+                          * routedTrack = metrics.counter("router.track"),
+                          * routedRender = metrics.counter("router.render"),
+                          * renderRejected = metrics.counter("router.render_rejected");
 
 ////      tbb::flow::interface11::internal::function_output<unsigned long> xxx = std::get<0>(out);
       for (CameraFrameData frameData : cameraFrame->cameras)
@@ -42,9 +56,11 @@ namespace toMAR
             std::shared_ptr<FrameInfo> frame;
             if (! repository->get_frame(cameraId, seq, frame))
                continue;
+            frame->trace.stamp(TraceStage::ROUTE);
             Detector* detectorPtr;
             Tracker* trackerPtr;
             Renderer* rendererPtr;
+            NodeStats* detectorStats, * trackerStats, * renderStats;
             int portStart;
             bool isDelete;
             auto it = map.find(cameraId);
@@ -56,6 +72,9 @@ namespace toMAR
                trackerPtr = params.tracker;
                rendererPtr = params.renderer;
                isDelete = params.isDelete;
+               detectorStats = params.detectorStats;
+               trackerStats = params.trackerStats;
+               renderStats = params.renderStats;
             }
             else
                continue;
@@ -66,7 +85,7 @@ namespace toMAR
                case 0:
                   if ( (detectorPtr != nullptr) && (! detectorPtr->is_detecting()) )
                   {
-                     isDetectRoute = std::get<0>(out).try_put(seq);
+                     isDetectRoute = offered(detectorStats, std::get<0>(out).try_put(seq));
                      if (isDetectRoute)
                      {
                         isDelete = false;
@@ -76,7 +95,7 @@ namespace toMAR
                   }
                   if ( (trackerPtr != nullptr) && (! isDetectRoute) && (! trackerPtr->is_tracking()) )
                   {
-                     isTrackRoute = std::get<1>(out).try_put(seq);
+                     isTrackRoute = offered(trackerStats, std::get<1>(out).try_put(seq));
                      if (isTrackRoute)
                      {
                         isDelete = false;
@@ -86,11 +105,15 @@ namespace toMAR
                   }
                   if (rendererPtr != nullptr)
                   {
-                     if (! std::get<2>(out).try_put(seq))
+                     if (! offered(renderStats, std::get<2>(out).try_put(seq)))
+                     {
+                        renderRejected->add();
                         repository->delete_frame(cameraId, seq);
-                      else
+                     }
+                     else
                      {
-                         frame->isRendering.store(true);
+                        frame->isRendering.store(true);
+                        routedRender->add();
 //                         __android_log_print(ANDROID_LOG_INFO, "TBBRouter::operator()", "Routed %lu %lu to renderer", cameraId, seqno);
                      }
                   }
@@ -103,7 +126,7 @@ namespace toMAR
                case 3:
                   if ( (detectorPtr != nullptr) && (! detectorPtr->is_detecting()) )
                   {
-                     isDetectRoute = std::get<3>(out).try_put(seq);
+                     isDetectRoute = offered(detectorStats, std::get<3>(out).try_put(seq));
                      if (isDetectRoute)
                      {
                         isDelete = false;
@@ -113,7 +136,7 @@ namespace toMAR
                   }
                   if ( (trackerPtr != nullptr) && (! isDetectRoute) && (! trackerPtr->is_tracking()) )
                   {
-                     isTrackRoute = std::get<4>(out).try_put(seq);
+                     isTrackRoute = offered(trackerStats, std::get<4>(out).try_put(seq));
                      if (isTrackRoute)
                      {
                         isDelete = false;
@@ -123,11 +146,15 @@ namespace toMAR
                   }
                   if (rendererPtr != nullptr)
                   {
-                     if (! std::get<5>(out).try_put(seq))
+                     if (! offered(renderStats, std::get<5>(out).try_put(seq)))
+                     {
+                        renderRejected->add();
                         repository->delete_frame(cameraId, seq);
-                      else
+                     }
+                     else
                      {
                         frame->isRendering.store(true);
+                        routedRender->add();
                         // __android_log_print(ANDROID_LOG_INFO, "TBBRouter::operator()", "Routed %lu %lu to renderer", cameraId, seqno);
                      }
                   }
@@ -136,7 +163,7 @@ namespace toMAR
                case 6:
                   if ( (detectorPtr != nullptr) && (! detectorPtr->is_detecting()) )
                   {
-                     isDetectRoute = std::get<6>(out).try_put(seq);
+                     isDetectRoute = offered(detectorStats, std::get<6>(out).try_put(seq));
                      if (isDetectRoute)
                      {
                         isDelete = false;
@@ -146,7 +173,7 @@ namespace toMAR
                   }
                   if ( (trackerPtr != nullptr) && (! isDetectRoute) && (! trackerPtr->is_tracking()) )
                   {
-                     isTrackRoute = std::get<7>(out).try_put(seq);
+                     isTrackRoute = offered(trackerStats, std::get<7>(out).try_put(seq));
                      if (isTrackRoute)
                      {
                         isDelete = false;
@@ -156,11 +183,15 @@ namespace toMAR
                   }
                   if (rendererPtr != nullptr)
                   {
-                     if (! std::get<8>(out).try_put(seq))
+                     if (! offered(renderStats, std::get<8>(out).try_put(seq)))
+                     {
+                        renderRejected->add();
                         repository->delete_frame(cameraId, seq);
-                      else
+                     }
+                     else
                      {
                         frame->isRendering.store(true);
+                        routedRender->add();
                         // __android_log_print(ANDROID_LOG_INFO, "TBBRouter::operator()", "Routed %lu %lu to renderer", cameraId, seqno);
                      }
                   }
@@ -169,7 +200,7 @@ namespace toMAR
                case 9:
                   if ( (detectorPtr != nullptr) && (! detectorPtr->is_detecting()) )
                   {
-                     isDetectRoute =  std::get<9>(out).try_put(seq);
+                     isDetectRoute = offered(detectorStats, std::get<9>(out).try_put(seq));
                      if (isDetectRoute)
                      {
                         isDelete = false;
@@ -179,7 +210,7 @@ namespace toMAR
                   }
                   if ( (trackerPtr != nullptr) && (! isDetectRoute) && (! trackerPtr->is_tracking()) )
                   {
-                     isTrackRoute = std::get<10>(out).try_put(seq);
+                     isTrackRoute = offered(trackerStats, std::get<10>(out).try_put(seq));
                      if (isTrackRoute)
                      {
                         isDelete = false;
@@ -189,11 +220,15 @@ namespace toMAR
                   }
                   if (rendererPtr != nullptr)
                   {
-                     if (! std::get<11>(out).try_put(seq))
+                     if (! offered(renderStats, std::get<11>(out).try_put(seq)))
+                     {
+                        renderRejected->add();
                         repository->delete_frame(cameraId, seq);
-                      else
+                     }
+                     else
                      {
                         frame->isRendering.store(true);
+                        routedRender->add();
                         // __android_log_print(ANDROID_LOG_INFO, "TBBRouter::operator()", "Routed %lu %lu to renderer", cameraId, seqno);
                      }
                   }
@@ -206,6 +241,8 @@ namespace toMAR
                   break;
 
             }
+            if (isDetectRoute) routedDetect->add();
+            if (isTrackRoute) routedTrack->add();
          }
       }
    }
@@ -12,7 +12,9 @@ namespace toMAR
       std::shared_ptr<FrameInfo> frame;
       if (repository->get_frame(cameraId, seqno, frame))
       {
+         frame->trace.stamp(TraceStage::TRACK_START);
          spin(isTracking, frame.get(), trackRate);
+         frame->trace.stamp(TraceStage::TRACK_END);
          frame->isTracking.store(false);
          repository->delete_frame(cameraId, seqno);
       }
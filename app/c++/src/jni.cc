@@ -2,6 +2,8 @@
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <mutex>
+#include <cmath>
 
 #include <jni.h>
 #include <android/asset_manager.h>
@@ -17,6 +19,12 @@
 #include "mar/acquisition/Camera.h"
 #include "mar/acquisition/FrameInfo.h"
 #include "mar/acquisition/Sensors.h"
+#include "mar/acquisition/Recording.h"
+#include "mar/acquisition/CppHardwareCamera.h"
+#include "mar/util/Metrics.h"
+#include "mar/util/NodeProfiler.h"
+#include "mar/util/CpuPlacement.h"
+#include "mar/util/JniThreads.h"
 #include <mar/util/cv.h>
 #include "mar/render/ArchVulkanRenderer.h"
 
@@ -36,6 +44,7 @@ static ANativeWindow* androidWindow = nullptr;
 static int orientation =0, androidWindowWidth, androidWindowHeight;
 static bool isAprilTags = false,  isFacialRecognition =false;
 static FaceRenderType faceRenderType = FaceRenderType::NONE;
+static void cameras_json(std::ostream& out);
 
 JavaVM* getVM() { return vm; }
 int get_screen_width() { return androidWindowWidth; }
@@ -44,29 +53,8 @@ int get_screen_height() { return androidWindowHeight; }
 bool getEnv(JNIEnv*& env)
 //--------------
 {
-   env = nullptr;
-   if (vm == nullptr)
-   {
-      __android_log_print(ANDROID_LOG_ERROR, "jni::getEnv", "Call to getEnv before vm initialized");
-      return false;
-   }
-
-   int status = vm->GetEnv((void **)&env, JNI_VERSION_1_6);
-   if (status == JNI_OK)
-      return true;
-   else
-   {
-      if (status == JNI_EDETACHED)
-      {
-         __android_log_print(ANDROID_LOG_WARN, "jni::getEnv", "Thread not attached. Attempting to attach");
-         if (vm->AttachCurrentThread(&env, NULL) != 0)
-            __android_log_print(ANDROID_LOG_ERROR, "jni::getEnv", "Error attaching thread");
-         else
-            return true;
-      } else if (status == JNI_EVERSION)
-         __android_log_print(ANDROID_LOG_ERROR, "jni::getEnv", "Java version not supported");
-   }
-   return false;
+   env = util::thread_env(vm);
+   return (env != nullptr);
 }
 
 extern "C"
@@ -79,17 +67,21 @@ jint JNI_OnLoad(JavaVM* vm_, void*)
       return JNI_ERR;
    init_class_loader(env);
    repository->javaVM(vm);
+   static util::JniAttachObserver jniAttachObserver(vm);
    return JNI_VERSION_1_6;
 }
 
 extern "C"
 JNIEXPORT void JNICALL Java_no_pack_drill_ararch_mar_MAR_initialize
-   (JNIEnv* env, jobject, jstring packageNameJava, jobject assman)
-//-----------------------------------------------------------
+   (JNIEnv* env, jobject, jstring packageNameJava, jobject assman, jstring cacheDirJava)
+//----------------------------------------------------------------------------------
 {
    const char *psz = env->GetStringUTFChars(packageNameJava, 0);
    packageName = psz;
    env->ReleaseStringUTFChars(packageNameJava, psz);
+   psz = env->GetStringUTFChars(cacheDirJava, 0);
+   repository->cacheDir = psz;
+   env->ReleaseStringUTFChars(cacheDirJava, psz);
    assetManagerRef = env->NewGlobalRef(assman);
    pAssetManager = AAssetManager_fromJava(env, assetManagerRef);
    if (pAssetManager == nullptr)
@@ -100,6 +92,13 @@ JNIEXPORT void JNICALL Java_no_pack_drill_ararch_mar_MAR_initialize
 //   assetReader.set_manager(pAssetManager);
    Sensors& sensor_controller(Sensors::instance());
    sensor_controller.package_name = packageName;
+
+   util::Metrics& metrics = util::Metrics::instance();
+   metrics.gauge("frameinfo.instances", [] { return static_cast<int64_t>(FrameInfo::instances()); });
+   metrics.gauge("frametrace.dropped", [] { return static_cast<int64_t>(FrameTracer::instance().dropped()); });
+   metrics.section("cameras", cameras_json);
+   metrics.section("latency", [](std::ostream& out) { FrameTracer::instance().latency_json(out); });
+   metrics.section("nodes", [](std::ostream& out) { NodeProfiler::instance().stats_json(out); });
 }
 
 extern "C"
@@ -130,56 +129,83 @@ tbb::concurrent_unordered_map<unsigned long,
       std::pair<int64_t, RunningStatistics<uint64_t, long double>>> enqueueStats;
 #endif
 
-extern "C"
-JNIEXPORT jstring JNICALL Java_no_pack_drill_ararch_mar_MAR_getStats
-      (JNIEnv* env, jobject inst)
-//------------------------------------------------------------------
+static void json_number(std::ostream& out, long double v)
+//-------------------------------------------------------
+{
+   if (std::isfinite(v))
+      out << v;
+   else
+      out << "null";
+}
+
+static void statistics_json(std::ostream& out, util::ShardedStatistics<uint64_t, long double>* sharded)
+//-----------------------------------------------------------------------------------------------------
 {
-   std::stringstream ss;
-   ss << "[\n";
    constexpr long double nano2s = static_cast<long double>(1000000000.0);
+   const double ps[] = { 50, 95, 99 };
+   uint64_t pv[3];
+   RunningStatistics<uint64_t, long double> stats = sharded->combined();
+   sharded->percentiles(ps, pv, 3);
+   const long double time = stats.time() / nano2s;
+   out << "{\"count\":" << stats.size() << std::fixed << std::setprecision(8) << ",\"mean\":";
+   json_number(out, stats.mean() / nano2s);
+   out << ",\"deviation\":";
+   json_number(out, (stats.size() > 1) ? stats.deviation() / nano2s : 0);
+   out << ",\"p50\":" << pv[0] / nano2s << ",\"p95\":" << pv[1] / nano2s << ",\"p99\":" << pv[2] / nano2s
+       << ",\"time\":" << time << ",\"meanframes\":";
+   json_number(out, (time > 0) ? stats.size() / time : 0);
+   out << "}";
+}
+
+// Snapshot section with the per camera queue, detector and renderer statistics
+static void cameras_json(std::ostream& out)
+//-----------------------------------------
+{
+   out << "[";
    const std::vector<std::shared_ptr<Camera>> &cameras = repository->all_cameras();
+   bool first = true;
    for (auto it = cameras.begin(); it != cameras.end(); ++it)
    {
       std::shared_ptr<Camera> cameraPtr = *it;
       unsigned long id = cameraPtr->camera_id();
-      ss << "\"Camera\": { \"id:\" " << id << std::endl;
-      RunningStatistics<uint64_t, long double>* pstats = repository->detectionStats(id, false);
-      if (pstats)
+      out << (first ? "" : ",") << "{\"id\":" << id << ",\"queue_depth\":" << cameraPtr->queue_size()
+          << ",\"queue_capacity\":" << cameraPtr->queue_capacity();
+      first = false;
+      util::ShardedStatistics<uint64_t, long double>* sharded = repository->detectionStats(id, false);
+      if (sharded)
       {
-         ss << "\"detector\": { \"mean\":" << std::fixed << std::setprecision(8)
-            << pstats->mean() / nano2s << ",\"deviation\":" << pstats->deviation() / nano2s
-               << ",\"count\":" << pstats->size() << "}"
-               << ",\"time\":" << pstats->time()/nano2s << "}"
-               << ",\"meanframes\":" << (pstats->size() / (pstats->time()/nano2s)) << "}\n";
+         out << ",\"detector\":";
+         statistics_json(out, sharded);
       }
-      pstats = repository->rendererStats(id, false);
-      if (pstats)
+      sharded = repository->rendererStats(id, false);
+      if (sharded)
       {
-         ss << "\"renderer\": { \"mean\":" << std::fixed << std::setprecision(8)
-            << pstats->mean() / nano2s << ",\"deviation\":" << pstats->deviation() / nano2s
-            << ",\"count\":" << pstats->size() << "}"
-            << ",\"time\":" << pstats->time()/nano2s << "}"
-            << ",\"meanframes\":" << (pstats->size() / (pstats->time()/nano2s)) << "}\n";
+         out << ",\"renderer\":";
+         statistics_json(out, sharded);
       }
-
 #ifdef QUEUE_STATS
+      constexpr long double nano2s = static_cast<long double>(1000000000.0);
       std::pair<int64_t, RunningStatistics<uint64_t, long double>> pp = enqueueStats[id];
-      pstats = &pp.second;
-      ss << "\"enqueue\": { \"mean\":" << std::fixed << std::setprecision(8)
-         << pstats->mean() / nano2s << ",\"deviation\":" << pstats->deviation() / nano2s
-         << ",\"meanframes\":" << (nano2s / pstats->mean()) << "}\n";
+      RunningStatistics<uint64_t, long double>* pstats = &pp.second;
+      out << ",\"enqueue\":{\"mean\":" << std::fixed << std::setprecision(8);
+      json_number(out, pstats->mean() / nano2s);
+      out << ",\"deviation\":";
+      json_number(out, pstats->deviation() / nano2s);
+      out << ",\"meanframes\":";
+      json_number(out, nano2s / pstats->mean());
+      out << "}";
 #endif
-      ss << "}\n";
-   }
-   ss << "]\n";
-   std::ofstream ofs("/sdcard/detector-stats.json");
-   if (ofs)
-   {
-      ofs << ss.str() << std::endl;
-      ofs.close();
+      out << "}";
    }
-   const std::string sss = ss.str();
+   out << "]";
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL Java_no_pack_drill_ararch_mar_MAR_getStats
+      (JNIEnv* env, jobject inst)
+//------------------------------------------------------------------
+{  // Returns the exporter's latest snapshot so the caller never waits on (or stalls) the pipeline
+   const std::string sss = util::Metrics::instance().latest();
    const char* pch = sss.c_str();
    jstring ret = env->NewStringUTF(pch);
    if (env->ExceptionCheck())
@@ -203,23 +229,21 @@ JNIEXPORT jobject JNICALL Java_no_pack_drill_ararch_mar_MAR_allocateBuffer
 
 extern "C"
 JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_enqueue
-  (JNIEnv* env, jobject instance, jstring cameraid, jboolean isRGBA, jlong ts,
+  (JNIEnv* env, jobject instance, jint handle, jboolean isRGBA, jlong ts,
    jint rgbaLen, jbyteArray rgba_arr, jint monoLen, jbyteArray grey_arr)
 //----------------------------------------------------------------------------------------------
 {
    if (! repository->initialised.load())
       return JNI_TRUE;
-   const char *psz = env->GetStringUTFChars(cameraid, 0);
-   std::string id = psz;
-   env->ReleaseStringUTFChars(cameraid, psz);
-   const unsigned long cid = Camera::camera_ID(id);
-   Camera* camera = repository->hardware_camera_interface_ptr(cid);
+   util::CpuPlacement::instance().pin_current_thread(util::StageClass::CAMERA);
+   Camera* camera = repository->camera(handle);
    if (camera == nullptr)
    {
       __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueue",
-                          "Camera %s not defined", id.c_str());
+                          "Camera handle %d not defined", handle);
       return JNI_FALSE;
    }
+   const unsigned long cid = camera->camera_id();
 
    int w, h;
    camera->get_preview_size(w, h);
@@ -241,11 +265,9 @@ JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_enqueue
 //    __android_log_print(ANDROID_LOG_INFO, "jni::enqueue", "FrameInfo instances: %d", FrameInfo::instances());
    if (! camera->enqueue(frame_info))
    {
-      env->DeleteGlobalRef(rgbaData);
-      if (monoData)
-         env->DeleteGlobalRef(monoData);
+      // The queue has already disposed of the frame and with it the global references
       __android_log_print(ANDROID_LOG_ERROR, "jni::enqueue",
-                          "Error in enqueue of frame for camera %s.", id.c_str());
+                          "Error in enqueue of frame for camera %s.", camera->camera_name().c_str());
       return JNI_FALSE;
    }
 #ifdef QUEUE_STATS
@@ -267,10 +289,50 @@ JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_enqueue
    return JNI_TRUE;
 }
 
+// Per camera handle pools for the NV12 copies below (each handle is only enqueued from its camera's thread).
+static std::shared_ptr<util::BufferPool> yuvPools[Repository::MAX_CAMERAS];
+
+// NV12 copy of a camera image for FrameInfo::nativeYuv if the renderer uploads YUV textures
+// (Repository::isYUVRendering), else null. pool is set to the pool the buffer must be returned to.
+static std::unique_ptr<unsigned char[]> nv12_copy(int handle, const void* Y, const void* U, const void* V,
+                                                  int yRowStride, int uvRowStride, int uvPixelStride, int w, int h,
+                                                  std::shared_ptr<util::BufferPool>& pool)
+//--------------------------------------------------------------------------------------------------------------
+{
+   std::unique_ptr<unsigned char[]> nv12;
+   if (! repository->isYUVRendering.load(std::memory_order_relaxed))
+      return nv12;
+   const size_t size = static_cast<size_t>(w*h + w*h/2);
+   std::shared_ptr<util::BufferPool>& cameraPool = yuvPools[handle];
+   if ( (! cameraPool) || (cameraPool->buffer_size() != size) )
+      cameraPool = std::make_shared<util::BufferPool>(size, 4);
+   pool = cameraPool;
+   nv12.reset(pool->acquire());
+   toMAR::vision::Planes2NV12(Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h, nv12.get());
+   return nv12;
+}
+
+// Addresses of the direct Image.Plane buffers, or false if any is not direct or too small for a w x h image with
+// these strides (as CppHardwareCamera checks AImage planes).
+static bool direct_planes(JNIEnv* env, jobject Ybuf, jobject Ubuf, jobject Vbuf, int yRowStride, int uvRowStride,
+                          int uvPixelStride, int w, int h, const void*& Y, const void*& U, const void*& V)
+//--------------------------------------------------------------------------------------------------------------
+{
+   Y = env->GetDirectBufferAddress(Ybuf);
+   U = env->GetDirectBufferAddress(Ubuf);
+   V = env->GetDirectBufferAddress(Vbuf);
+   if ( (Y == nullptr) || (U == nullptr) || (V == nullptr) || (w <= 0) || (h <= 0) || (w % 2) || (h % 2) ||
+        (yRowStride < w) || (uvRowStride <= 0) || (uvPixelStride <= 0) )
+      return false;
+   const jlong uvLength = static_cast<jlong>(uvRowStride)*(h/2 - 1) + static_cast<jlong>(uvPixelStride)*(w/2 - 1) + 1;
+   return ( (env->GetDirectBufferCapacity(Ybuf) >= static_cast<jlong>(yRowStride)*(h - 1) + w) &&
+            (env->GetDirectBufferCapacity(Ubuf) >= uvLength) && (env->GetDirectBufferCapacity(Vbuf) >= uvLength) );
+}
+
 extern "C"
 JNIEXPORT jboolean JNICALL
 Java_no_pack_drill_ararch_mar_HardwareCamera_enqueueYUV(JNIEnv *env, jobject inst,
-                                                        jstring cameraid, jbyteArray YUVJava, jint w,
+                                                        jint handle, jbyteArray YUVJava, jint w,
                                                         jint h, jboolean isRGBA, jlong ts,
                                                         jint rgbaLen, jbyteArray rgbaJavaArr,
                                                         jint monoLen, jbyteArray greyJavaArr)
@@ -278,17 +340,15 @@ Java_no_pack_drill_ararch_mar_HardwareCamera_enqueueYUV(JNIEnv *env, jobject ins
 {
    if (! repository->initialised.load())
       return JNI_TRUE;
-   const char *psz = env->GetStringUTFChars(cameraid, 0);
-   std::string id = psz;
-   env->ReleaseStringUTFChars(cameraid, psz);
-   const unsigned long cid = Camera::camera_ID(id);
-   Camera* camera = repository->hardware_camera_interface_ptr(cid);
+   util::CpuPlacement::instance().pin_current_thread(util::StageClass::CAMERA);
+   Camera* camera = repository->camera(handle);
    if (camera == nullptr)
    {
       __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueueYUV",
-                          "Camera %s not defined", id.c_str());
+                          "Camera handle %d not defined", handle);
       return JNI_FALSE;
    }
+   const unsigned long cid = camera->camera_id();
 
    void* YUVData = env->GetPrimitiveArrayCritical(YUVJava, 0);
    if (YUVData == nullptr)
@@ -305,6 +365,10 @@ Java_no_pack_drill_ararch_mar_HardwareCamera_enqueueYUV(JNIEnv *env, jobject ins
       return JNI_FALSE;
    }
 
+   StreamRecorder& recorder = StreamRecorder::instance();
+   if (recorder.is_recording())
+      recorder.record_frame(camera->camera_name(), cid, static_cast<int64_t>(ts), w, h, (isRGBA == JNI_TRUE),
+                            (monoLen > 0), camera->is_rear_facing(), YUVData, static_cast<size_t>(env->GetArrayLength(YUVJava)));
    if (! toMAR::vision::YUV2RGBA(YUVData, outputJavaRGB, w, h, (isRGBA == JNI_TRUE), "jni::enqueueYUV"))
    {
       env->ReleasePrimitiveArrayCritical(rgbaJavaArr, outputJavaRGB, 0);
@@ -319,6 +383,10 @@ Java_no_pack_drill_ararch_mar_HardwareCamera_enqueueYUV(JNIEnv *env, jobject ins
          monoLen = 0;
       env->ReleasePrimitiveArrayCritical(greyJavaArr, outputJavaGrey, 0);
    }
+   std::shared_ptr<util::BufferPool> yuvPool;
+   const unsigned char* I420 = static_cast<const unsigned char*>(YUVData);
+   std::unique_ptr<unsigned char[]> nv12 = nv12_copy(handle, I420, I420 + w*h, I420 + w*h + w*h/4, w, w/2, 1, w, h,
+                                                     yuvPool);
    env->ReleasePrimitiveArrayCritical(YUVJava, YUVData, 0);
 
    int64_t timestamp = static_cast<int64_t>(ts);
@@ -336,14 +404,14 @@ Java_no_pack_drill_ararch_mar_HardwareCamera_enqueueYUV(JNIEnv *env, jobject ins
       frame_info = new FrameInfo(cid, timestamp, w, h,
                                  (isRGBA) ? ColorFormats::RGBA : ColorFormats::BGRA, vm,
                                  rgbaLen, rgbaData);
+   frame_info->nativeYuv = std::move(nv12);
+   frame_info->yuvPool = yuvPool;
 //   __android_log_print(ANDROID_LOG_INFO, "jni::enqueue", "FrameInfo instances: %d", FrameInfo::instances());
    if (! camera->enqueue(frame_info))
    {
-      env->DeleteGlobalRef(rgbaData);
-      if (monoData)
-         env->DeleteGlobalRef(monoData);
+      // The queue has already disposed of the frame and with it the global references
       __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueueYUV",
-                          "Error in enqueue of frame for camera %s.", id.c_str());
+                          "Error in enqueue of frame for camera %s.", camera->camera_name().c_str());
       return JNI_FALSE;
    }
 #ifdef QUEUE_STATS
@@ -366,26 +434,137 @@ Java_no_pack_drill_ararch_mar_HardwareCamera_enqueueYUV(JNIEnv *env, jobject ins
 }
 
 /*
- JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_addCamera
+ * As enqueueYUV, but takes the YUV_420_888 planes (direct ByteBuffers from Image.getPlanes) with their strides and
+ * converts them in one pass, so the caller does not have to pack them into a contiguous I420 array first.
+ * conversion is a vision::YUVConversion (YUVConversions ordinal in Kotlin).
+ */
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_no_pack_drill_ararch_mar_HardwareCamera_enqueuePlanes(JNIEnv *env, jobject inst, jint handle,
+                                                           jobject Ybuf, jobject Ubuf, jobject Vbuf,
+                                                           jint yRowStride, jint uvRowStride, jint uvPixelStride,
+                                                           jint w, jint h, jboolean isRGBA, jint conversion,
+                                                           jlong ts, jint rgbaLen, jbyteArray rgbaJavaArr,
+                                                           jint monoLen, jbyteArray greyJavaArr)
+//------------------------------------------------------------------------------------------------------------
+{
+   if (! repository->initialised.load())
+      return JNI_TRUE;
+   util::CpuPlacement::instance().pin_current_thread(util::StageClass::CAMERA);
+   Camera* camera = repository->camera(handle);
+   if (camera == nullptr)
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueuePlanes",
+                          "Camera handle %d not defined", handle);
+      return JNI_FALSE;
+   }
+   const unsigned long cid = camera->camera_id();
+   const void *Y, *U, *V;
+   if (! direct_planes(env, Ybuf, Ubuf, Vbuf, yRowStride, uvRowStride, uvPixelStride, w, h, Y, U, V))
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueuePlanes",
+                          "Planes must be direct buffers large enough for %dx%d with strides %d %d %d", w, h,
+                          yRowStride, uvRowStride, uvPixelStride);
+      return JNI_FALSE;
+   }
+   if ( (rgbaLen < w*h*4) || (env->GetArrayLength(rgbaJavaArr) < w*h*4) || ( (monoLen > 0) &&
+        (greyJavaArr != nullptr) && ( (monoLen < w*h) || (env->GetArrayLength(greyJavaArr) < w*h) ) ) )
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueuePlanes",
+                          "Output arrays too small for %dx%d", w, h);
+      return JNI_FALSE;
+   }
+
+   StreamRecorder& recorder = StreamRecorder::instance();
+   if (recorder.is_recording())
+   {
+      thread_local std::vector<unsigned char> I420;
+      I420.resize(static_cast<size_t>(w*h + w*h/2));
+      toMAR::vision::Planes2I420(Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h, I420.data());
+      recorder.record_frame(camera->camera_name(), cid, static_cast<int64_t>(ts), w, h, (isRGBA == JNI_TRUE),
+                            (monoLen > 0), camera->is_rear_facing(), I420.data(), I420.size());
+   }
+   // Without a consumer for RGBA only the mono plane (if any) is converted and rgbaJavaArr is not enqueued
+   const bool isRGBANeeded = camera->is_rgba_needed();
+   void* outputJavaRGB = (isRGBANeeded) ? env->GetPrimitiveArrayCritical(rgbaJavaArr, 0) : nullptr;
+   if ( (isRGBANeeded) && (outputJavaRGB == nullptr) )
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::enqueuePlanes", "Could not pin outputJavaRGB parameter");
+      return JNI_FALSE;
+   }
+   void* outputJavaGrey = ( (monoLen > 0) && (greyJavaArr != nullptr) )
+                          ? env->GetPrimitiveArrayCritical(greyJavaArr, 0) : nullptr;
+   bool isConverted;
+   if ( (isRGBANeeded) && (conversion == static_cast<jint>(toMAR::vision::YUVConversion::RENDERSCRIPT)) )
+      isConverted = toMAR::vision::RSPlanes2RGBA(Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h,
+                                                 (isRGBA == JNI_TRUE), outputJavaRGB, outputJavaGrey, true,
+                                                 "jni::enqueuePlanes");
+   else
+      isConverted = toMAR::vision::Planes2RGBA(Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h,
+                                               (isRGBA == JNI_TRUE), outputJavaRGB, outputJavaGrey,
+                                               "jni::enqueuePlanes");
+   if (outputJavaGrey != nullptr)
+      env->ReleasePrimitiveArrayCritical(greyJavaArr, outputJavaGrey, 0);
+   else
+      monoLen = 0;
+   if (outputJavaRGB != nullptr)
+      env->ReleasePrimitiveArrayCritical(rgbaJavaArr, outputJavaRGB, 0);
+   else
+      rgbaLen = 0;
+   if (! isConverted)
+      return JNI_FALSE;
+   std::shared_ptr<util::BufferPool> yuvPool;
+   std::unique_ptr<unsigned char[]> nv12 = nv12_copy(handle, Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h,
+                                                     yuvPool);
+
+   const int64_t timestamp = static_cast<int64_t>(ts);
+   FrameInfo* frame_info = nullptr;
+   jbyteArray rgbaData = (rgbaLen > 0) ? reinterpret_cast<jbyteArray>(env->NewGlobalRef(rgbaJavaArr)) : nullptr;
+   jbyteArray monoData = nullptr;
+   if (monoLen > 0)
+   {
+      monoData = reinterpret_cast<jbyteArray>(env->NewGlobalRef(greyJavaArr));
+      frame_info = new FrameInfo(cid, timestamp, w, h,
+                                 (isRGBA) ? ColorFormats::RGBA : ColorFormats::BGRA, vm,
+                                 rgbaLen, rgbaData, monoLen, monoData);
+   }
+   else
+      frame_info = new FrameInfo(cid, timestamp, w, h,
+                                 (isRGBA) ? ColorFormats::RGBA : ColorFormats::BGRA, vm,
+                                 rgbaLen, rgbaData);
+   frame_info->nativeYuv = std::move(nv12);
+   frame_info->yuvPool = yuvPool;
+   if (! camera->enqueue(frame_info))
+   {
+      // The queue has already disposed of the frame and with it the global references
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_enqueuePlanes",
+                          "Error in enqueue of frame for camera %s.", camera->camera_name().c_str());
+      return JNI_FALSE;
+   }
+   return JNI_TRUE;
+}
+
+/*
+ JNIEXPORT jint JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_addCamera
   (JNIEnv *, jobject, jstring, jint, jboolean);
  */
 
+// Returns the handle to pass to the per camera calls (enqueue etc) or -1 on error.
 extern "C"
-JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_addCamera
+JNIEXPORT jint JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_addCamera
   (JNIEnv* env, jobject inst, jstring cameraid, jint queueSize, jboolean isRearFacing)
 //--------------------------------------------------------------------------
 {
    const char *psz = env->GetStringUTFChars(cameraid, 0);
    std::string id = psz;
    env->ReleaseStringUTFChars(cameraid, psz);
-   if (! repository->add_camera(id, queueSize, (isRearFacing == JNI_TRUE)))
-   {
+   int handle = -1;
+   if (! repository->add_camera(id, queueSize, (isRearFacing == JNI_TRUE), &handle))
       __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_addCamera",
                           "Camera %s previously added", id.c_str());
-      return JNI_FALSE;
-   }
-   repository->next_seqno(Camera::camera_ID(id));
-   return JNI_TRUE;
+   else
+      repository->next_seqno(Camera::camera_ID(id));
+   return static_cast<jint>(handle);
 }
 
 extern "C"
@@ -416,45 +595,219 @@ JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_MAR_addSensors
 
 extern "C"
 JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_setPreviewSize
-  (JNIEnv* env, jobject, jstring cameraid, jint previewWidth, jint previewHeight)
+  (JNIEnv* env, jobject, jint handle, jint previewWidth, jint previewHeight)
 //-----------------------------------------------------------------------------
 {
-   const char *psz = env->GetStringUTFChars(cameraid, 0);
-   std::string id = psz;
-   env->ReleaseStringUTFChars(cameraid, psz);
-   Camera* camera = repository->hardware_camera_interface_ptr(Camera::camera_ID(id));
+   Camera* camera = repository->camera(handle);
    if (camera == nullptr)
    {
-      __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_setPreviewSize", "Camera %s not defined",
-                          id.c_str());
+      __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_setPreviewSize",
+                          "Camera handle %d not defined", handle);
       return JNI_FALSE;
    }
    camera->preview_size(previewWidth, previewHeight);
    return JNI_TRUE;
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_setOptics
+  (JNIEnv* env, jobject, jint handle, jfloat focalLength, jfloat sensorWidth, jfloat sensorHeight,
+   jint sensorOrientation)
+//------------------------------------------------------------------------------------------------
+{
+   Camera* camera = repository->camera(handle);
+   if (camera == nullptr)
+   {
+      __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_setOptics",
+                          "Camera handle %d not defined", handle);
+      return JNI_FALSE;
+   }
+   camera->optics(focalLength, sensorWidth, sensorHeight, sensorOrientation);
+   return JNI_TRUE;
+}
+
 extern "C"
 JNIEXPORT jboolean JNICALL
 Java_no_pack_drill_ararch_mar_HardwareCamera_clearQueue(JNIEnv *env, jobject inst,
-                                                        jstring cameraId)
+                                                        jint handle)
 //-----------------------------------------------------------------------------------------------
 {
-   const char *psz = env->GetStringUTFChars(cameraId, 0);
-   std::string id = psz;
-   env->ReleaseStringUTFChars(cameraId, psz);
-   unsigned long cid = Camera::camera_ID(id);
-   Camera* camera = repository->hardware_camera_interface_ptr(cid);
+   Camera* camera = repository->camera(handle);
    if (camera == nullptr)
    {
-      __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_clearQueue", "Camera %s not defined",
-                          id.c_str());
+      __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_clearQueue",
+                          "Camera handle %d not defined", handle);
       return JNI_FALSE;
    }
+   const unsigned long cid = camera->camera_id();
    camera->clear();
    repository->clear_queued(cid);
    return JNI_TRUE;
 }
 
+// Buffers must be direct (eg MAR.allocateBuffer) and stay referenced on the Java side while the camera runs.
+extern "C"
+JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_registerFrameBuffers
+  (JNIEnv* env, jobject inst, jint handle, jobjectArray bufferArr)
+//-----------------------------------------------------------------------------------------
+{
+   Camera* camera = repository->camera(handle);
+   if (camera == nullptr)
+   {
+      __android_log_print(ANDROID_LOG_WARN, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_registerFrameBuffers",
+                          "Camera handle %d not defined", handle);
+      return JNI_FALSE;
+   }
+   std::vector<std::pair<unsigned char*, size_t>> buffers;
+   const jsize n = env->GetArrayLength(bufferArr);
+   for (jsize i = 0; i < n; i++)
+   {
+      jobject buffer = env->GetObjectArrayElement(bufferArr, i);
+      unsigned char* address = static_cast<unsigned char*>(env->GetDirectBufferAddress(buffer));
+      const jlong capacity = env->GetDirectBufferCapacity(buffer);
+      env->DeleteLocalRef(buffer);
+      if ( (address == nullptr) || (capacity <= 0) )
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_registerFrameBuffers",
+                             "Buffer %d of camera %s is not a direct buffer", i, camera->camera_name().c_str());
+         return JNI_FALSE;
+      }
+      buffers.emplace_back(address, static_cast<size_t>(capacity));
+   }
+   camera->frame_buffers(buffers);
+   return JNI_TRUE;
+}
+
+// Packs the planes of a YUV_420_888 image as I420 into registered buffer i of the camera, for MAR.enqueueBatch.
+extern "C"
+JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_HardwareCamera_writeFrameBuffer
+  (JNIEnv* env, jobject inst, jint handle, jint i, jobject Ybuf, jobject Ubuf, jobject Vbuf, jint yRowStride,
+   jint uvRowStride, jint uvPixelStride, jint w, jint h)
+//-----------------------------------------------------------------------------------------------------------------
+{
+   Camera* camera = repository->camera(handle);
+   const void *Y, *U, *V;
+   if ( (camera == nullptr) ||
+        (! direct_planes(env, Ybuf, Ubuf, Vbuf, yRowStride, uvRowStride, uvPixelStride, w, h, Y, U, V)) )
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_writeFrameBuffer",
+                          "Invalid camera handle %d or planes (%dx%d)", handle, w, h);
+      return JNI_FALSE;
+   }
+   size_t size = 0;
+   tbb::spin_rw_mutex::scoped_lock bufferLock(camera->frame_buffers_mutex(), false);
+   unsigned char* yuv = camera->frame_buffer(i, size);
+   if ( (yuv == nullptr) || (size < static_cast<size_t>(w*h + w*h/2)) )
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_HardwareCamera_writeFrameBuffer",
+                          "Invalid buffer %d for camera %s (%dx%d)", i, camera->camera_name().c_str(), w, h);
+      return JNI_FALSE;
+   }
+   toMAR::vision::Planes2I420(Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h, yuv);
+   return JNI_TRUE;
+}
+
+// Converts the YUV frame in one of the camera's registered buffers to a FrameInfo owning its RGBA/mono data.
+static FrameInfo* native_frame(Camera* camera, int handle, int buffer, int64_t timestamp, bool isRGBA, bool hasMono)
+//-----------------------------------------------------------------------------------------------------------------
+{
+   int w, h;
+   camera->get_preview_size(w, h);
+   size_t size = 0;
+   tbb::spin_rw_mutex::scoped_lock bufferLock(camera->frame_buffers_mutex(), false);
+   unsigned char* yuv = camera->frame_buffer(buffer, size);
+   if ( (yuv == nullptr) || (w <= 0) || (h <= 0) || (size < static_cast<size_t>(w*h + w*h/2)) )
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::native_frame", "Invalid buffer %d for camera %s (%dx%d)",
+                          buffer, camera->camera_name().c_str(), w, h);
+      return nullptr;
+   }
+   StreamRecorder& recorder = StreamRecorder::instance();
+   if (recorder.is_recording())
+      recorder.record_frame(camera->camera_name(), camera->camera_id(), timestamp, w, h, isRGBA, hasMono,
+                            camera->is_rear_facing(), yuv, static_cast<size_t>(w*h + w*h/2));
+   int rgbaLen = 0;
+   std::unique_ptr<unsigned char[]> rgba;
+   if (camera->is_rgba_needed())
+   {
+      rgbaLen = w*h*4;
+      rgba.reset(new unsigned char[rgbaLen]);
+      if (! toMAR::vision::YUV2RGBA(yuv, rgba.get(), w, h, isRGBA, "jni::native_frame"))
+         return nullptr;
+   }
+   int monoLen = 0;
+   std::unique_ptr<unsigned char[]> mono;
+   if (hasMono)
+   {
+      monoLen = w*h;
+      mono.reset(new unsigned char[monoLen]);
+      if (! toMAR::vision::YUV2Mono(yuv, mono.get(), w, h, "jni::native_frame"))
+      {
+         mono.reset();
+         monoLen = 0;
+      }
+   }
+   FrameInfo* frame = new FrameInfo(camera->camera_id(), timestamp, w, h,
+                                    (isRGBA) ? ColorFormats::RGBA : ColorFormats::BGRA, rgbaLen, std::move(rgba),
+                                    monoLen, std::move(mono));
+   frame->nativeYuv = nv12_copy(handle, yuv, yuv + w*h, yuv + w*h + w*h/4, w, w/2, 1, w, h, frame->yuvPool);
+   return frame;
+}
+
+/*
+ * Submits frames from several cameras in one call. Frame i was written by Java to registered buffer buffers[i]
+ * of camera handles[i]. If isStereoPair the two frames are enqueued together or not at all so the stereo join
+ * sees exact pairs. Returns the number of frames enqueued.
+ */
+extern "C"
+JNIEXPORT jint JNICALL Java_no_pack_drill_ararch_mar_MAR_enqueueBatch
+  (JNIEnv* env, jobject inst, jint count, jintArray handleArr, jintArray bufferArr, jlongArray timestampArr,
+   jboolean isRGBA, jboolean hasMono, jboolean isStereoPair)
+//------------------------------------------------------------------------------------------------------
+{
+   if (! repository->initialised.load())
+      return 0;
+   util::CpuPlacement::instance().pin_current_thread(util::StageClass::CAMERA);
+   constexpr int MAX_BATCH = Repository::MAX_CAMERAS;
+   if ( (count <= 0) || (count > MAX_BATCH) || ( (isStereoPair == JNI_TRUE) && (count != 2) ) )
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_MAR_enqueueBatch",
+                          "Invalid batch size %d", count);
+      return 0;
+   }
+   jint handles[MAX_BATCH], buffers[MAX_BATCH];
+   jlong timestamps[MAX_BATCH];
+   env->GetIntArrayRegion(handleArr, 0, count, handles);
+   env->GetIntArrayRegion(bufferArr, 0, count, buffers);
+   env->GetLongArrayRegion(timestampArr, 0, count, timestamps);
+
+   Camera* cameras[MAX_BATCH];
+   FrameInfo* frames[MAX_BATCH];
+   int converted = 0;
+   for (int i = 0; i < count; i++)
+   {
+      cameras[i] = repository->camera(handles[i]);
+      frames[i] = (cameras[i] == nullptr) ? nullptr
+                  : native_frame(cameras[i], handles[i], buffers[i], static_cast<int64_t>(timestamps[i]),
+                                 (isRGBA == JNI_TRUE), (hasMono == JNI_TRUE));
+      if (frames[i] != nullptr)
+         converted++;
+   }
+   if (isStereoPair == JNI_TRUE)
+   {
+      if (converted == 2)
+         return (repository->enqueue_stereo(cameras[0], frames[0], cameras[1], frames[1])) ? 2 : 0;
+      delete frames[0];
+      delete frames[1];
+      return 0;
+   }
+   int enqueued = 0;
+   for (int i = 0; i < count; i++)
+      if ( (frames[i] != nullptr) && (cameras[i]->enqueue(frames[i])) )
+         enqueued++;
+   return enqueued;
+}
+
 extern "C"
 JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_MAR_startMAR
   (JNIEnv* env, jobject, jint rendererType, jboolean aprilTagDetect, jboolean facialRecog)
@@ -561,6 +914,7 @@ JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_MAR_startMAR
       __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_MAR_startMAR", "Error starting parallel architecture");
       return JNI_FALSE;
    }
+   util::Metrics::instance().start_exporter("/sdcard", 1000);
    return JNI_TRUE;
 }
 
@@ -572,6 +926,107 @@ JNIEXPORT void JNICALL Java_no_pack_drill_ararch_mar_MAR_stopMAR
    repository->initialised.store(false);
    if (architecture)
       architecture->stop();
+   util::Metrics::instance().stop_exporter();
+   FrameTracer::instance().write_chrome_trace("/sdcard/frame-trace.json");
+   NodeProfiler::instance().write_chrome_trace("/sdcard/node-trace.json");
+}
+
+static std::unique_ptr<ReplaySource> replay;
+
+static std::mutex nativeCamerasMutex;
+static std::unique_ptr<CppHardwareCamera> nativeCameras[Repository::MAX_CAMERAS];
+
+/*
+ * Starts native (NDK AImageReader) acquisition for the camera previously added with HardwareCamera.addCamera, so
+ * its frames are enqueued without the Java ImageReader or the enqueue/enqueueYUV calls.
+ */
+extern "C"
+JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_MAR_startNativeCamera
+      (JNIEnv* env, jobject inst, jint handle, jint width, jint height, jboolean isRGBA, jboolean hasMono)
+//------------------------------------------------------------------------------------------------------
+{
+   static std::shared_ptr<ACameraManager> manager(ACameraManager_create(), ManagerDeleter());
+   Camera* camera = repository->camera(handle);
+   if (camera == nullptr)
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_MAR_startNativeCamera",
+                          "Camera handle %d not defined", handle);
+      return JNI_FALSE;
+   }
+   std::lock_guard<std::mutex> lock(nativeCamerasMutex);
+   std::unique_ptr<CppHardwareCamera>& nativeCamera = nativeCameras[handle];
+   if (! nativeCamera)
+      nativeCamera.reset(new CppHardwareCamera(camera, manager));
+   if ( (! nativeCamera->opened()) && (! nativeCamera->open(camera->camera_name())) )
+      return JNI_FALSE;
+   return (nativeCamera->start_preview(width, height, (isRGBA == JNI_TRUE), (hasMono == JNI_TRUE))) ? JNI_TRUE
+                                                                                                  : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL Java_no_pack_drill_ararch_mar_MAR_stopNativeCamera
+      (JNIEnv* env, jobject inst, jint handle)
+//--------------------------------------------------------------------
+{
+   if ( (handle < 0) || (handle >= Repository::MAX_CAMERAS) )
+      return;
+   std::lock_guard<std::mutex> lock(nativeCamerasMutex);
+   nativeCameras[handle].reset();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_MAR_startRecording
+      (JNIEnv* env, jobject inst, jstring filename)
+//--------------------------------------------------------------------
+{
+   const char *psz = env->GetStringUTFChars(filename, 0);
+   std::string file = psz;
+   env->ReleaseStringUTFChars(filename, psz);
+   return (StreamRecorder::instance().start(file)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL Java_no_pack_drill_ararch_mar_MAR_stopRecording
+      (JNIEnv* env, jobject inst)
+//--------------------------------------------------------------------
+{
+   StreamRecorder::instance().stop();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL Java_no_pack_drill_ararch_mar_MAR_startReplay
+      (JNIEnv* env, jobject inst, jstring filename, jfloat speed, jboolean isLoop)
+//--------------------------------------------------------------------------------
+{
+   const char *psz = env->GetStringUTFChars(filename, 0);
+   std::string file = psz;
+   env->ReleaseStringUTFChars(filename, psz);
+   if (replay)
+      replay->stop();
+   replay.reset(new ReplaySource(file, static_cast<double>(speed), (isLoop == JNI_TRUE)));
+   if (! replay->start())
+   {
+      __android_log_print(ANDROID_LOG_ERROR, "jni::Java_no_pack_drill_arach_mar_MAR_startReplay",
+                          "Error replaying %s", file.c_str());
+      replay.reset();
+      return JNI_FALSE;
+   }
+   return JNI_TRUE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL Java_no_pack_drill_ararch_mar_MAR_stopReplay
+      (JNIEnv* env, jobject inst)
+//--------------------------------------------------------------------
+{
+   if (replay)
+   {
+      replay->stop();
+      __android_log_print(ANDROID_LOG_INFO, "jni::Java_no_pack_drill_arach_mar_MAR_stopReplay",
+                          "Replayed %lu frames and %lu sensor events", static_cast<unsigned long>(replay->frames()),
+                          static_cast<unsigned long>(replay->events()));
+      replay.reset();
+   }
 }
 
 extern "C"
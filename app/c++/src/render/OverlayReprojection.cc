@@ -0,0 +1,103 @@
+#include <cmath>
+#include <algorithm>
+
+#include <Eigen/Geometry>
+
+#include "mar/render/OverlayReprojection.h"
+#include "mar/acquisition/Camera.h"
+#include "mar/acquisition/ImuIntegrator.h"
+#include "mar/util/Metrics.h"
+
+namespace toMAR
+{
+   // Rows are the camera axes (x right and y down in the sensor image, z along the optical axis) in Android
+   // sensor (device) coordinates, for a sensor whose image is rotated clockwise by orientation to be upright.
+   static Eigen::Matrix3d device_to_camera(bool isRearFacing, int orientation)
+   //------------------------------------------------------------------------
+   {
+      const double theta = orientation * M_PI / 180.0, c = std::cos(theta), s = std::sin(theta);
+      // Upright image axes: the rear camera sees the scene as the screen does, the front camera mirrored
+      const Eigen::Vector3d uprightX((isRearFacing) ? 1 : -1, 0, 0), uprightY(0, -1, 0);
+      const Eigen::Vector3d x = c*uprightX + s*uprightY, y = -s*uprightX + c*uprightY;
+      Eigen::Matrix3d C;
+      C.row(0) = x.transpose();
+      C.row(1) = y.transpose();
+      C.row(2) = x.cross(y).transpose();
+      return C;
+   }
+
+   bool OverlayReprojection::latch(Camera* camera, uint64_t detectedSeqno, uint64_t displayedSeqno, int w, int h)
+   //------------------------------------------------------------------------------------------------------------
+   {
+      static util::Counter* latched = util::Metrics::instance().counter("reprojection.latched");
+      static util::Counter* unavailable = util::Metrics::instance().counter("reprojection.unavailable");
+      H.setIdentity();
+      isIdentity = true;
+      latchedCamera = (camera == nullptr) ? 0 : camera->camera_id();
+      latchedDetected = detectedSeqno;
+      latchedDisplayed = displayedSeqno;
+      if ( (camera == nullptr) || (detectedSeqno == displayedSeqno) )
+         return false;
+      const double f = camera->focal_pixels(w, h);
+      ImuIntegrator& imu = ImuIntegrator::instance();
+      FrameMotion detected, displayed, between;
+      if ( (f <= 0) || (! imu.motion(latchedCamera, detectedSeqno, detected)) ||
+           (! imu.motion(latchedCamera, displayedSeqno, displayed)) )
+      {
+         unavailable->add();
+         return false;
+      }
+      // FrameMotion::end is the frame timestamp, the rotation satisfies v_detected = R * v_displayed
+      Eigen::Quaterniond q;
+      if (detected.end <= displayed.end)
+      {
+         if (! imu.integrate(detected.end, displayed.end, between))
+         {
+            unavailable->add();
+            return false;
+         }
+         q = between.rotation.cast<double>();
+      }
+      else
+      {  // Overlay from a newer frame than the one displayed (eg a frame skipped by the renderer)
+         if (! imu.integrate(displayed.end, detected.end, between))
+         {
+            unavailable->add();
+            return false;
+         }
+         q = between.rotation.cast<double>().inverse();
+      }
+
+      Eigen::Matrix3d K;
+      K << f, 0, w/2.0,
+           0, f, h/2.0,
+           0, 0, 1;
+      const Eigen::Matrix3d C = device_to_camera(camera->is_rear_facing(), camera->sensor_orientation());
+      H = K * C * q.toRotationMatrix().transpose() * C.transpose() * K.inverse();
+      isIdentity = false;
+      latched->add();
+      return true;
+   }
+
+   DetectRect<double> OverlayReprojection::apply(const DetectRect<double>& rect) const
+   //--------------------------------------------------------------------------------
+   {
+      if (isIdentity)
+         return rect;
+      const double xs[2] = { rect.top, rect.bottom }, ys[2] = { rect.left, rect.right };
+      double minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+      for (double x : xs)
+      {
+         for (double y : ys)
+         {
+            const Eigen::Vector3d p = H * Eigen::Vector3d(x, y, 1.0);
+            if (p.z() <= 0) // Behind the camera after the rotation, leave the overlay where it was
+               return rect;
+            const double px = p.x() / p.z(), py = p.y() / p.z();
+            minX = std::min(minX, px); maxX = std::max(maxX, px);
+            minY = std::min(minY, py); maxY = std::max(maxY, py);
+         }
+      }
+      return DetectRect<double>(minX, minY, maxX, maxY);
+   }
+}
@@ -9,6 +9,9 @@
 #include <queue>
 #include <functional>
 #include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
 
 #include "mar/render/VulkanRenderer.h"
 #include "mar/render/VulkanTools.h"
@@ -33,6 +36,7 @@ namespace toMAR
       std::shared_ptr<FrameInfo> frame;
       if ( (repository->get_frame(cameraNo, seqno, frame)) && (frame) )
       {
+         frame->trace.stamp(TraceStage::RENDER_START);
          frame->isRendering.store(false);
          uint32_t index = UINT32_MAX;
          VkResult last_error;
@@ -64,10 +68,9 @@ namespace toMAR
                __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::render",
                                    "Screen resize required (vkAcquireNextImageKHR %d %s)", last_error,
                                    VulkanTools::result_string(last_error).c_str());
-               destroy(true);
-               if (! recreate())
-                  return false;
-               break;
+               // No image was acquired and the per image sync objects are recreated so this frame is dropped
+               recreate();
+               return false;
             }
             default:
             {
@@ -95,6 +98,7 @@ namespace toMAR
          submitInfo.pCommandBuffers = &buffer;
          submitInfo.signalSemaphoreCount = 1;
          submitInfo.pSignalSemaphores = submitSignalSemaphores;
+         frame->trace.stamp(TraceStage::RENDER_SUBMIT);
          if ((last_error = fpQueueSubmit(graphics_queue, 1, &submitInfo, fence)) != VK_SUCCESS)
          {
              __android_log_print(ANDROID_LOG_ERROR,
@@ -126,7 +130,6 @@ namespace toMAR
                __android_log_print(ANDROID_LOG_ERROR,
                                    "VulkanRenderer::render", "Screen resize required (vkQueuePresentKHR %d %s)",
                                    last_error, VulkanTools::result_string(last_error).c_str());
-               destroy(true);
                if (!recreate())
                   return false;
                break;
@@ -139,6 +142,7 @@ namespace toMAR
                return false;
             }
          }
+         frame->trace.stamp(TraceStage::PRESENT);
          return true;
       }
       else
@@ -189,6 +193,11 @@ namespace toMAR
    bool VulkanRenderer::update_camera_texture(uint64_t seqno, FrameInfo* frame, const VkCommandBuffer& commandBuffer)
    //------------------------------------------------------------------------------------------
    {
+      if ( (frame->nativeYuv) && (yuv_pipeline != VK_NULL_HANDLE) && (camera_luma_image != VK_NULL_HANDLE) &&
+           (! is_drawing()) )
+         return ( (update_camera_yuv_texture(frame)) && (bind_camera_pipeline(true)) );
+      if (! frame->has_color())
+         return false; // Enqueued for YUV rendering, keep the previous texture
 //      uint32_t w = static_cast<uint32_t>(frame->width), h = static_cast<uint32_t>(frame->height);
       const uint32_t w = static_cast<uint32_t>(std::min(camera_width, frame->width)),
                      h = static_cast<uint32_t>(std::min(camera_height, frame->height));
@@ -287,7 +296,7 @@ namespace toMAR
          end_single_command();
       }
 
-      return true;
+      return bind_camera_pipeline(false);
    }
 
    bool VulkanRenderer::update_camera_texture_view()
@@ -331,6 +340,207 @@ namespace toMAR
       return true;
    }
 
+   bool VulkanRenderer::create_camera_yuv_textures(uint32_t w, uint32_t h)
+   //---------------------------------------------------------------------
+   {
+      destroy_camera_yuv_textures();
+      if (! is_staged)
+         return false; // Linear images are not used on Android so only the staged upload is implemented
+
+      VkImageCreateInfo imageInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.extent.depth = 1;
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+      VmaAllocationCreateInfo imageAllocCreateInfo = {};
+      imageAllocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+      // R8 and R8G8 sampling with linear filtering are mandatory formats so no support check is needed
+      struct
+      {
+         VkImage& image; VmaAllocation& alloc; VkImageView& view; VkFormat format; uint32_t w, h, binding;
+      } planes[2] =
+      {
+         { camera_luma_image, camera_luma_image_alloc, camera_luma_image_view, VK_FORMAT_R8_UNORM, w, h, 2 },
+         { camera_chroma_image, camera_chroma_image_alloc, camera_chroma_image_view, VK_FORMAT_R8G8_UNORM,
+           (w + 1) / 2, (h + 1) / 2, 3 }
+      };
+      VkDescriptorImageInfo descriptorImageInfos[2] = {};
+      VkWriteDescriptorSet writeDescriptorSets[2] = {};
+      VkResult last_error;
+      for (int i = 0; i < 2; i++)
+      {
+         imageInfo.format = planes[i].format;
+         imageInfo.extent.width = planes[i].w;
+         imageInfo.extent.height = planes[i].h;
+         if ((last_error = vmaCreateImage(vma_allocator, &imageInfo, &imageAllocCreateInfo, &planes[i].image,
+                                          &planes[i].alloc, nullptr)) != VK_SUCCESS)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::create_camera_yuv_textures",
+                                "Error creating %s image for camera frame (vmaCreateImage %d %s)",
+                                (i == 0) ? "luma" : "chroma", last_error,
+                                VulkanTools::result_string(last_error).c_str());
+            destroy_camera_yuv_textures();
+            return false;
+         }
+
+         VkImageViewCreateInfo imageViewInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+         imageViewInfo.image = planes[i].image;
+         imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+         imageViewInfo.format = planes[i].format;
+         imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         imageViewInfo.subresourceRange.levelCount = 1;
+         imageViewInfo.subresourceRange.layerCount = 1;
+         if ((last_error = vkCreateImageView(device, &imageViewInfo, nullptr, &planes[i].view)) != VK_SUCCESS)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::create_camera_yuv_textures",
+                                "Error creating %s image view for camera frame (vkCreateImageView %d %s)",
+                                (i == 0) ? "luma" : "chroma", last_error,
+                                VulkanTools::result_string(last_error).c_str());
+            destroy_camera_yuv_textures();
+            return false;
+         }
+
+         descriptorImageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+         descriptorImageInfos[i].imageView = planes[i].view;
+         descriptorImageInfos[i].sampler = camera_texture_sampler;
+         writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+         writeDescriptorSets[i].dstSet = camera_tex_descriptor_set;
+         writeDescriptorSets[i].dstBinding = planes[i].binding;
+         writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+         writeDescriptorSets[i].descriptorCount = 1;
+         writeDescriptorSets[i].pImageInfo = &descriptorImageInfos[i];
+      }
+      vkUpdateDescriptorSets(device, 2, writeDescriptorSets, 0, nullptr);
+      return true;
+   }
+
+   void VulkanRenderer::destroy_camera_yuv_textures()
+   //------------------------------------------------
+   {
+      if (device != VK_NULL_HANDLE)
+      {
+         if (camera_luma_image_view != VK_NULL_HANDLE)
+            vkDestroyImageView(device, camera_luma_image_view, nullptr);
+         if (camera_chroma_image_view != VK_NULL_HANDLE)
+            vkDestroyImageView(device, camera_chroma_image_view, nullptr);
+      }
+      camera_luma_image_view = camera_chroma_image_view = VK_NULL_HANDLE;
+      if (vma_allocator != VK_NULL_HANDLE)
+      {
+         if (camera_luma_image != VK_NULL_HANDLE)
+            vmaDestroyImage(vma_allocator, camera_luma_image, camera_luma_image_alloc);
+         if (camera_chroma_image != VK_NULL_HANDLE)
+            vmaDestroyImage(vma_allocator, camera_chroma_image, camera_chroma_image_alloc);
+         if (yuv_staging_buffer != VK_NULL_HANDLE)
+            vmaDestroyBuffer(vma_allocator, yuv_staging_buffer, yuv_staging_alloc);
+      }
+      camera_luma_image = camera_chroma_image = VK_NULL_HANDLE;
+      camera_luma_image_alloc = camera_chroma_image_alloc = VK_NULL_HANDLE;
+      yuv_staging_buffer = VK_NULL_HANDLE;
+      yuv_staging_alloc = VK_NULL_HANDLE;
+      yuv_staging_size = 0;
+   }
+
+   bool VulkanRenderer::update_camera_yuv_texture(FrameInfo* frame)
+   //--------------------------------------------------------------
+   {  // Uploads w*h*3/2 bytes instead of the w*h*4 of the RGBA conversion, camera_yuv.frag converts to RGB.
+      const uint32_t fw = static_cast<uint32_t>(frame->width), fh = static_cast<uint32_t>(frame->height);
+      const uint32_t w = static_cast<uint32_t>(std::min(camera_width, frame->width)) & ~1U,
+                     h = static_cast<uint32_t>(std::min(camera_height, frame->height)) & ~1U;
+      const VkDeviceSize lumaSize = fw * fh, size = lumaSize + lumaSize / 2;
+      if (yuv_staging_size < size)
+      {
+         if (yuv_staging_buffer != VK_NULL_HANDLE)
+            vmaDestroyBuffer(vma_allocator, yuv_staging_buffer, yuv_staging_alloc);
+         yuv_staging_buffer = VK_NULL_HANDLE;
+         yuv_staging_size = 0;
+         VkBufferCreateInfo bufferInfo =
+         {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = size, .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+         };
+         VmaAllocationCreateInfo allocInfo =
+         {
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_CPU_ONLY
+         };
+         VkResult last_error = vmaCreateBuffer(vma_allocator, &bufferInfo, &allocInfo, &yuv_staging_buffer,
+                                               &yuv_staging_alloc, &yuv_staging_alloc_info);
+         if (last_error !=  VK_SUCCESS)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::update_camera_yuv_texture",
+                                "Error creating staging buffer (vmaCreateBuffer %d %s)",
+                                last_error, VulkanTools::result_string(last_error).c_str());
+            yuv_staging_buffer = VK_NULL_HANDLE;
+            return false;
+         }
+         yuv_staging_size = size;
+      }
+      memcpy(yuv_staging_alloc_info.pMappedData, frame->nativeYuv.get(), static_cast<size_t>(size));
+
+      if (! begin_single_command())
+         return false;
+      VkImageMemoryBarrier imgMemBarriers[2];
+      for (int i = 0; i < 2; i++)
+      {
+         VkImageMemoryBarrier& imgMemBarrier = imgMemBarriers[i];
+         imgMemBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+         imgMemBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         imgMemBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         imgMemBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         imgMemBarrier.subresourceRange.levelCount = 1;
+         imgMemBarrier.subresourceRange.layerCount = 1;
+         imgMemBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+         imgMemBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+         imgMemBarrier.image = (i == 0) ? camera_luma_image : camera_chroma_image;
+         imgMemBarrier.srcAccessMask = 0;
+         imgMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      }
+      fpCmdPipelineBarrier(one_time_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0, 0, nullptr, 0, nullptr, 2, imgMemBarriers);
+
+      VkBufferImageCopy region = {};
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.layerCount = 1;
+      region.bufferRowLength = fw;
+      region.imageExtent.width = w;
+      region.imageExtent.height = h;
+      region.imageExtent.depth = 1;
+      fpCmdCopyBufferToImage(one_time_buffer, yuv_staging_buffer, camera_luma_image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+      region.bufferOffset = lumaSize; // Interleaved CbCr rows are fw bytes, ie fw/2 R8G8 texels
+      region.bufferRowLength = fw / 2;
+      region.imageExtent.width = w / 2;
+      region.imageExtent.height = h / 2;
+      fpCmdCopyBufferToImage(one_time_buffer, yuv_staging_buffer, camera_chroma_image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+      for (VkImageMemoryBarrier& imgMemBarrier : imgMemBarriers)
+      {
+         imgMemBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+         imgMemBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+         imgMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+         imgMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      }
+      fpCmdPipelineBarrier(one_time_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                           0, 0, nullptr, 0, nullptr, 2, imgMemBarriers);
+      return end_single_command();
+   }
+
+   bool VulkanRenderer::bind_camera_pipeline(bool isYUV)
+   //---------------------------------------------------
+   {  // Called after a texture upload, which leaves the graphics queue idle, so the default command buffers are not
+      // in use and can be re-recorded. Sources switch between YUV and RGBA rarely (eg a replay or renderer change).
+      if (isYUV == is_yuv_bound)
+         return true;
+      is_yuv_bound = isYUV;
+      return record_default_commands();
+   }
+
    bool
    VulkanRenderer::create(void* nativeSurface, void* nativeConnection, int width, int height,
                           const char* shaderAssetOverrideDir)
@@ -384,6 +594,8 @@ namespace toMAR
          destroy();
          return false;
       }
+      if (! create_pipeline_cache())
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::create", "Continuing without a pipeline cache");
 
       if (!create_swapchain())
       {
@@ -424,6 +636,8 @@ namespace toMAR
          destroy();
          return false;
       }
+      if (!create_camera_yuv_textures(swapchain_extent.width, swapchain_extent.height))
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::create", "Continuing without YUV camera textures");
       if (!create_camera_vertex_buffer())
       {
          destroy();
@@ -434,21 +648,54 @@ namespace toMAR
          destroy();
          return false;
       }
+      save_pipeline_cache(); // Once the pipelines are built, and again on shutdown (not on swapchain recreation)
       if (!record_default_commands())
       {
          destroy();
          return false;
       }
+      // Camera sources only attach NV12 copies to frames while a renderer can use them
+      repository->isYUVRendering.store( (yuv_pipeline != VK_NULL_HANDLE) && (camera_luma_image != VK_NULL_HANDLE) &&
+                                        (! is_drawing()) );
       return true;
    }
 
    bool VulkanRenderer::recreate()
    //----------------------------
-   {
+   {  // Viewport and scissor are dynamic so only the swapchain size dependent objects need to be rebuilt. The render
+      // pass, pipeline, descriptor set and camera texture are kept unless the surface format changed.
+      const VkFormat previous_format = surface_format;
+      destroy_swapchain();
       if (!create_swapchain())
          return false;
 
-      if (!create_render_pass())
+      if (surface_format != previous_format)
+      {
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::recreate",
+                             "Surface format changed from %s to %s, rebuilding render pass and pipeline",
+                             VulkanTools::surface_format_string(previous_format).c_str(),
+                             VulkanTools::surface_format_string(surface_format).c_str());
+         if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, pipeline, nullptr);
+         pipeline = VK_NULL_HANDLE;
+         if (yuv_pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, yuv_pipeline, nullptr);
+         yuv_pipeline = VK_NULL_HANDLE;
+         if (pipeline_layout != VK_NULL_HANDLE)
+            vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+         pipeline_layout = VK_NULL_HANDLE;
+         if (render_pass != VK_NULL_HANDLE)
+            vkDestroyRenderPass(device, render_pass, nullptr);
+         render_pass = VK_NULL_HANDLE;
+         if (!create_render_pass())
+            return false;
+         if (!create_camera_texture(swapchain_extent.width, swapchain_extent.height))
+            return false;
+         if (!create_pipeline())
+            return false;
+      }
+
+      if (!create_depth_buffer())
          return false;
 
       if (!create_framebuffers())
@@ -457,13 +704,8 @@ namespace toMAR
       if (!create_command_buffers_and_pool())
          return false;
 
-      if (!create_camera_tex_descriptor())
-         return false;
-      if (!create_camera_texture(swapchain_extent.width, swapchain_extent.height))
-         return false;
-      if (!create_pipeline())
-         return false;
-      return true;
+      current_index = 0;
+      return record_default_commands();
    }
 
    bool VulkanRenderer::create_logical_device()
@@ -730,15 +972,19 @@ namespace toMAR
          return false;
       }
 
-      VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-      samplerLayoutBinding.binding = 1;
-      samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      samplerLayoutBinding.descriptorCount = 1;
-      samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+      // Binding 1 is the RGBA camera texture (camera.frag), 2 and 3 the luma and chroma textures (camera_yuv.frag)
+      VkDescriptorSetLayoutBinding samplerLayoutBindings[3] = {};
+      for (uint32_t i = 0; i < 3; i++)
+      {
+         samplerLayoutBindings[i].binding = i + 1;
+         samplerLayoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+         samplerLayoutBindings[i].descriptorCount = 1;
+         samplerLayoutBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+      }
 
       VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-      descriptorSetLayoutInfo.bindingCount = 1;
-      descriptorSetLayoutInfo.pBindings = &samplerLayoutBinding;
+      descriptorSetLayoutInfo.bindingCount = 3;
+      descriptorSetLayoutInfo.pBindings = samplerLayoutBindings;
       if ((last_error = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr,
                                                     &descriptor_set_layout)) != VK_SUCCESS)
       {
@@ -751,7 +997,7 @@ namespace toMAR
       VkDescriptorPoolSize descriptorPoolSizes[1];
       memset(descriptorPoolSizes, 0, sizeof(descriptorPoolSizes));
       descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorPoolSizes[0].descriptorCount = 1;
+      descriptorPoolSizes[0].descriptorCount = 3;
 
       VkDescriptorPoolCreateInfo descriptorPoolInfo =
       {
@@ -861,6 +1107,15 @@ namespace toMAR
          vkDestroyShaderModule(device, vertex_shader, nullptr);
          return false;
       }
+      std::string yuv_fragment_shader_asset = shadersAssetsDir + CAMERA_YUV_FRAGMENT_SHADER;
+      VkShaderModule yuv_fragment_shader = VK_NULL_HANDLE;
+      if (!load_shader(yuv_fragment_shader_asset, yuv_fragment_shader))
+      {
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::create_pipeline",
+                             "Error reading camera YUV fragment shader %s, frames will be rendered from RGBA",
+                             yuv_fragment_shader_asset.c_str());
+         yuv_fragment_shader = VK_NULL_HANDLE;
+      }
 
       VkPipelineShaderStageCreateInfo vertPipelineShaderStageInfo = {
             VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
@@ -879,6 +1134,12 @@ namespace toMAR
          vertPipelineShaderStageInfo,
          fragPipelineShaderStageInfo
       };
+      VkPipelineShaderStageCreateInfo yuvPipelineShaderStageInfos[] =
+      {
+         vertPipelineShaderStageInfo,
+         fragPipelineShaderStageInfo
+      };
+      yuvPipelineShaderStageInfos[1].module = yuv_fragment_shader;
 
       VkVertexInputBindingDescription bindingDescription = {.binding = 0, .stride = sizeof(CameraTextureVertex),
             .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
@@ -967,6 +1228,7 @@ namespace toMAR
                              "Error creating pipeline layout (vkCreatePipelineLayout %d %s)",
                              last_error, VulkanTools::result_string(last_error).c_str());
          vkDestroyShaderModule(device, fragment_shader, nullptr);
+         vkDestroyShaderModule(device, yuv_fragment_shader, nullptr);
          vkDestroyShaderModule(device, vertex_shader, nullptr);
          return false;
       }
@@ -989,22 +1251,152 @@ namespace toMAR
       pipelineInfo.subpass = 0;
       pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
       pipelineInfo.basePipelineIndex = -1;
-      if ((last_error = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline)) !=
-          VK_SUCCESS)
+      // The YUV pipeline only differs in the fragment shader so both are created in one call
+      VkGraphicsPipelineCreateInfo pipelineInfos[2] = { pipelineInfo, pipelineInfo };
+      pipelineInfos[1].pStages = yuvPipelineShaderStageInfos;
+      const uint32_t pipelineCount = (yuv_fragment_shader != VK_NULL_HANDLE) ? 2 : 1;
+      VkPipeline pipelines[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+      if ((last_error = vkCreateGraphicsPipelines(device, pipeline_cache, pipelineCount, pipelineInfos, nullptr,
+                                                  pipelines)) != VK_SUCCESS)
       {
          __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::create_pipeline",
                              "Error creating pipeline (vkCreateGraphicsPipelines %d %s)",
                              last_error, VulkanTools::result_string(last_error).c_str());
 
          vkDestroyShaderModule(device, fragment_shader, nullptr);
+         vkDestroyShaderModule(device, yuv_fragment_shader, nullptr);
          vkDestroyShaderModule(device, vertex_shader, nullptr);
          return false;
       }
+      pipeline = pipelines[0];
+      yuv_pipeline = pipelines[1];
+      if (yuv_pipeline == VK_NULL_HANDLE)
+         is_yuv_bound = false;
       vkDestroyShaderModule(device, fragment_shader, nullptr);
+      vkDestroyShaderModule(device, yuv_fragment_shader, nullptr);
       vkDestroyShaderModule(device, vertex_shader, nullptr);
       return true;
    }
 
+   bool VulkanRenderer::create_pipeline_cache()
+   //------------------------------------------
+   {
+      std::vector<char> cache_data;
+      pipeline_cache_file.clear();
+      if (! repository->cacheDir.empty())
+      {  // Keyed on vendor, device and driver cache UUID so a driver update invalidates the cache
+         std::stringstream ss;
+         ss << repository->cacheDir << "/pipeline-" << std::hex << physical_device_properties.vendorID << "-"
+            << physical_device_properties.deviceID << "-";
+         for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+            ss << std::setw(2) << std::setfill('0') << static_cast<unsigned>(physical_device_properties.pipelineCacheUUID[i]);
+         ss << ".bin";
+         pipeline_cache_file = ss.str();
+         std::ifstream ifs(pipeline_cache_file, std::ios::binary | std::ios::ate);
+         if (ifs)
+         {
+            std::streamsize len = ifs.tellg();
+            if (len > 0)
+            {
+               cache_data.resize(static_cast<size_t>(len));
+               ifs.seekg(0, std::ios::beg);
+               if (! ifs.read(cache_data.data(), len))
+                  cache_data.clear();
+            }
+         }
+      }
+
+      // Some Android drivers do not validate the header themselves so check it before handing it over
+      const size_t header_len = 4*sizeof(uint32_t) + VK_UUID_SIZE;
+      if (cache_data.size() >= header_len)
+      {
+         uint32_t header[4];
+         memcpy(header, cache_data.data(), sizeof(header));
+         if ( (header[0] < header_len) || (header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) ||
+              (header[2] != physical_device_properties.vendorID) || (header[3] != physical_device_properties.deviceID) ||
+              (memcmp(cache_data.data() + sizeof(header), physical_device_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) )
+         {
+            __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::create_pipeline_cache",
+                                "Discarding stale pipeline cache %s", pipeline_cache_file.c_str());
+            cache_data.clear();
+         }
+      }
+      else
+         cache_data.clear();
+
+      VkPipelineCacheCreateInfo pipelineCacheInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+      pipelineCacheInfo.initialDataSize = cache_data.size();
+      pipelineCacheInfo.pInitialData = (cache_data.empty()) ? nullptr : cache_data.data();
+      VkResult last_error;
+      if ((last_error = vkCreatePipelineCache(device, &pipelineCacheInfo, nullptr, &pipeline_cache)) != VK_SUCCESS)
+      {
+         if (cache_data.empty())
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::create_pipeline_cache",
+                                "Error creating pipeline cache (vkCreatePipelineCache %d %s)",
+                                last_error, VulkanTools::result_string(last_error).c_str());
+            pipeline_cache = VK_NULL_HANDLE;
+            return false;
+         }
+         pipelineCacheInfo.initialDataSize = 0;
+         pipelineCacheInfo.pInitialData = nullptr;
+         if ((last_error = vkCreatePipelineCache(device, &pipelineCacheInfo, nullptr, &pipeline_cache)) != VK_SUCCESS)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "VulkanRenderer::create_pipeline_cache",
+                                "Error creating empty pipeline cache (vkCreatePipelineCache %d %s)",
+                                last_error, VulkanTools::result_string(last_error).c_str());
+            pipeline_cache = VK_NULL_HANDLE;
+            return false;
+         }
+         cache_data.clear();
+      }
+      __android_log_print(ANDROID_LOG_INFO, "VulkanRenderer::create_pipeline_cache",
+                          "Pipeline cache %s (%zu bytes loaded)", pipeline_cache_file.c_str(), cache_data.size());
+      return true;
+   }
+
+   bool VulkanRenderer::save_pipeline_cache()
+   //----------------------------------------
+   {
+      if ( (pipeline_cache == VK_NULL_HANDLE) || (pipeline_cache_file.empty()) )
+         return false;
+      size_t len = 0;
+      VkResult last_error;
+      if ( ((last_error = vkGetPipelineCacheData(device, pipeline_cache, &len, nullptr)) != VK_SUCCESS) || (len == 0) )
+      {
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::save_pipeline_cache",
+                             "Error getting pipeline cache size (vkGetPipelineCacheData %d %s)",
+                             last_error, VulkanTools::result_string(last_error).c_str());
+         return false;
+      }
+      std::vector<char> cache_data(len);
+      if ((last_error = vkGetPipelineCacheData(device, pipeline_cache, &len, cache_data.data())) != VK_SUCCESS)
+      {
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::save_pipeline_cache",
+                             "Error getting pipeline cache data (vkGetPipelineCacheData %d %s)",
+                             last_error, VulkanTools::result_string(last_error).c_str());
+         return false;
+      }
+      // Write to a temporary and rename so a crash mid-write cannot leave a truncated cache behind
+      const std::string tmpname = pipeline_cache_file + ".tmp";
+      std::ofstream ofs(tmpname, std::ios::binary | std::ios::trunc);
+      if ( (! ofs) || (! ofs.write(cache_data.data(), len)) )
+      {
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::save_pipeline_cache",
+                             "Error writing pipeline cache %s", tmpname.c_str());
+         return false;
+      }
+      ofs.close();
+      if (std::rename(tmpname.c_str(), pipeline_cache_file.c_str()) != 0)
+      {
+         __android_log_print(ANDROID_LOG_WARN, "VulkanRenderer::save_pipeline_cache",
+                             "Error renaming pipeline cache %s to %s", tmpname.c_str(), pipeline_cache_file.c_str());
+         std::remove(tmpname.c_str());
+         return false;
+      }
+      return true;
+   }
+
    bool VulkanRenderer::create_depth_buffer()
    //---------------------------------------
    {
@@ -1312,7 +1704,9 @@ namespace toMAR
           vkCmdSetScissor(commandbuf, 0, 1, &scissor);
           vkCmdBindDescriptorSets(commandbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
                                   &camera_tex_descriptor_set, 0, nullptr);
-          vkCmdBindPipeline(commandbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+          const VkPipeline& cameraPipeline = ( (is_yuv_bound) && (yuv_pipeline != VK_NULL_HANDLE) ) ? yuv_pipeline
+                                                                                                     : pipeline;
+          vkCmdBindPipeline(commandbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, cameraPipeline);
           VkBuffer vertexBuffers[] = {camera_vertex_buffer};
           VkDeviceSize offsets[] = {0};
           vkCmdBindVertexBuffers(commandbuf, 0, 1, vertexBuffers, offsets);
@@ -1401,7 +1795,7 @@ namespace toMAR
          physical_device = physicalDevices[0];
       else
          physical_device = select_device(physicalDevices, preferredType);
-      VkPhysicalDeviceProperties devProps;
+      VkPhysicalDeviceProperties& devProps = physical_device_properties;
       vkGetPhysicalDeviceProperties(physical_device, &devProps);
       std::stringstream surfaceFormatDesc;
       if (surface != VK_NULL_HANDLE)
@@ -1648,20 +2042,61 @@ namespace toMAR
    void VulkanRenderer::destroy_framebuffer()
    //---------------------------------------
    {
-      for (uint32_t i = 0; i < swapchain_len; i++)
-      {
-         VkImage img = swapchain_images[i];
-         vkDestroyImage(device, img, nullptr);
+      for (uint32_t i = 0; i < swapchain_views.size(); i++)
+      {  // Swapchain images belong to the swapchain and are released with it
          VkImageView imvw = swapchain_views[i];
          vkDestroyImageView(device, imvw, nullptr);
-         VkFramebuffer buf = swapchain_framebuffers[i];
-         vkDestroyFramebuffer(device, buf, nullptr);
+         if (i < swapchain_framebuffers.size())
+            vkDestroyFramebuffer(device, swapchain_framebuffers[i], nullptr);
       }
       swapchain_images.clear();
       swapchain_views.clear();
       swapchain_framebuffers.clear();
    }
 
+   void VulkanRenderer::destroy_swapchain()
+   //--------------------------------------
+   {
+      if (device == VK_NULL_HANDLE)
+         return;
+      vkDeviceWaitIdle(device);
+      for (VkCommandBuffer buffer : command_buffers)
+      {
+         if (buffer != VK_NULL_HANDLE)
+            vkFreeCommandBuffers(device, command_pool, 1, &buffer);
+      }
+      command_buffers.clear();
+      one_time_buffer = VK_NULL_HANDLE;
+      for (VkFence fence : camera_fences)
+         vkDestroyFence(device, fence, nullptr);
+      camera_fences.clear();
+      for (VkSemaphore semaphore : frame_available_semaphores)
+         vkDestroySemaphore(device, semaphore, nullptr);
+      frame_available_semaphores.clear();
+      for (VkSemaphore semaphore : render_complete_semaphores)
+         vkDestroySemaphore(device, semaphore, nullptr);
+      render_complete_semaphores.clear();
+      if (command_pool != VK_NULL_HANDLE)
+         vkDestroyCommandPool(device, command_pool, nullptr);
+      command_pool = VK_NULL_HANDLE;
+
+      destroy_framebuffer();
+      if (depth_image_view != VK_NULL_HANDLE)
+         vkDestroyImageView(device, depth_image_view, nullptr);
+      depth_image_view = VK_NULL_HANDLE;
+      if ( (vma_allocator != VK_NULL_HANDLE) && (depth_image != VK_NULL_HANDLE) )
+         vmaDestroyImage(vma_allocator, depth_image, depth_image_alloc);
+      depth_image = VK_NULL_HANDLE;
+      depth_image_alloc = VK_NULL_HANDLE;
+      if (swapchain != VK_NULL_HANDLE)
+      {
+         PFN_vkDestroySwapchainKHR fpDestroySwapchainKHR =
+               reinterpret_cast<PFN_vkDestroySwapchainKHR>(vkGetInstanceProcAddr(instance, "vkDestroySwapchainKHR"));
+         fpDestroySwapchainKHR(device, swapchain, nullptr);
+      }
+      swapchain = VK_NULL_HANDLE;
+   }
+
 #if !defined(NDEBUG)
 
    void VulkanRenderer::debug_layers(std::vector<const char*>& instance_layers)
@@ -1796,55 +2231,36 @@ namespace toMAR
          vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
       descriptor_pool = VK_NULL_HANDLE;
 
-      for (VkCommandBuffer buffer : command_buffers)
-      {
-         if ((device != VK_NULL_HANDLE) && (buffer != VK_NULL_HANDLE))
-            vkFreeCommandBuffers(device, command_pool, 1, &buffer);
-      }
       if ((vma_allocator != VK_NULL_HANDLE) && (staging_buffer != VK_NULL_HANDLE))
          vmaDestroyBuffer(vma_allocator, staging_buffer, staging_alloc);
-      if ((device != VK_NULL_HANDLE) && (one_time_buffer != VK_NULL_HANDLE))
-         vkFreeCommandBuffers(device, command_pool, 1, &one_time_buffer);
-      one_time_buffer = VK_NULL_HANDLE;
-      command_buffers.resize(0);
+      staging_buffer = VK_NULL_HANDLE;
+      repository->isYUVRendering.store(false);
+      destroy_camera_yuv_textures();
+      is_yuv_bound = false;
       if ((device != VK_NULL_HANDLE) && (pipeline_layout != VK_NULL_HANDLE))
          vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
       pipeline_layout = VK_NULL_HANDLE;
       if ((device != VK_NULL_HANDLE) && (pipeline != VK_NULL_HANDLE))
          vkDestroyPipeline(device, pipeline, nullptr);
       pipeline = VK_NULL_HANDLE;
+      if ((device != VK_NULL_HANDLE) && (yuv_pipeline != VK_NULL_HANDLE))
+         vkDestroyPipeline(device, yuv_pipeline, nullptr);
+      yuv_pipeline = VK_NULL_HANDLE;
       if ((device != VK_NULL_HANDLE) && (camera_texture_sampler != VK_NULL_HANDLE))
          vkDestroySampler(device, camera_texture_sampler, nullptr);
       camera_texture_sampler = VK_NULL_HANDLE;
-      if ((device != VK_NULL_HANDLE) && (depth_image_view != VK_NULL_HANDLE))
-         vkDestroyImageView(device, depth_image_view, nullptr);
-      depth_image_view = VK_NULL_HANDLE;
-      if ((device != VK_NULL_HANDLE) && (depth_image != VK_NULL_HANDLE))
-         vkDestroyImage(device, depth_image, nullptr);
-      depth_image = VK_NULL_HANDLE;
-      clear_command_buffers();
-      destroy_framebuffer();
-      for (size_t i = 0; i < swapchain_views.size(); i++)
-      {
-         if ((device != VK_NULL_HANDLE) && (swapchain_views[i] != VK_NULL_HANDLE))
-            vkDestroyImageView(device, swapchain_views[i], nullptr);
-         if ((device != VK_NULL_HANDLE) && (swapchain_images[i] != VK_NULL_HANDLE))
-            vkDestroyImage(device, swapchain_images[i], nullptr);
-      }
-      swapchain_views.resize(0);
-      swapchain_images.resize(0);
-      if ((device != VK_NULL_HANDLE) && (swapchain != VK_NULL_HANDLE))
-      {
-         PFN_vkDestroySwapchainKHR fpDestroySwapchainKHR =
-               reinterpret_cast<PFN_vkDestroySwapchainKHR>(vkGetInstanceProcAddr(instance, "vkDestroySwapchainKHR"));
-         fpDestroySwapchainKHR(device, swapchain, nullptr);
-      }
-      swapchain = VK_NULL_HANDLE;
-      if ((device != VK_NULL_HANDLE) && (command_pool != VK_NULL_HANDLE))
-         vkDestroyCommandPool(device, command_pool, nullptr);
-      command_pool = VK_NULL_HANDLE;
+      destroy_swapchain();
+      if ((device != VK_NULL_HANDLE) && (render_pass != VK_NULL_HANDLE))
+         vkDestroyRenderPass(device, render_pass, nullptr);
+      render_pass = VK_NULL_HANDLE;
       if (! isRenderOnly)
       {
+         if ((device != VK_NULL_HANDLE) && (pipeline_cache != VK_NULL_HANDLE))
+         {
+            save_pipeline_cache();
+            vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+         }
+         pipeline_cache = VK_NULL_HANDLE;
 #if !defined(NDEBUG)
          PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT =
                reinterpret_cast<PFN_vkDestroyDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance,
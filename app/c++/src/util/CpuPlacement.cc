@@ -0,0 +1,320 @@
+#include <sched.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <android/log.h>
+
+#include "mar/util/CpuPlacement.h"
+#include "mar/util/Metrics.h"
+
+namespace toMAR
+{
+   namespace util
+   {
+      bool parse_cpu_list(const std::string& list, std::vector<int>& cpus)
+      //------------------------------------------------------------------
+      {
+         cpus.clear();
+         std::istringstream ss(list);
+         std::string range;
+         while (std::getline(ss, range, ','))
+         {
+            range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+            if (range.empty()) continue;
+            const size_t dash = range.find('-');
+            try
+            {
+               size_t end = 0;
+               const int first = std::stoi(range.substr(0, dash), &end);
+               if (end != ((dash == std::string::npos) ? range.size() : dash))
+                  return false;
+               int last = first;
+               if (dash != std::string::npos)
+               {
+                  last = std::stoi(range.substr(dash + 1), &end);
+                  if (end != range.size() - dash - 1)
+                     return false;
+               }
+               if ( (first < 0) || (last < first) || (last >= CPU_SETSIZE) )
+                  return false;
+               for (int cpu = first; cpu <= last; cpu++)
+                  cpus.push_back(cpu);
+            }
+            catch (...)
+            {
+               return false;
+            }
+         }
+         std::sort(cpus.begin(), cpus.end());
+         cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+         return (! cpus.empty());
+      }
+
+      std::string cpu_list(const std::vector<int>& cpus)
+      //------------------------------------------------
+      {
+         std::stringstream ss;
+         for (size_t i = 0; i < cpus.size(); )
+         {
+            size_t j = i;
+            while ( (j + 1 < cpus.size()) && (cpus[j + 1] == cpus[j] + 1) ) j++;
+            ss << ((i > 0) ? "," : "") << cpus[i];
+            if (j > i)
+               ss << "-" << cpus[j];
+            i = j + 1;
+         }
+         return ss.str();
+      }
+
+      static int64_t read_value(const std::string& path)
+      //------------------------------------------------
+      {
+         std::ifstream ifs(path);
+         int64_t v = 0;
+         if ( (ifs) && (ifs >> v) )
+            return v;
+         return 0;
+      }
+
+      CpuTopology CpuTopology::read(const std::string& sysfs)
+      //-----------------------------------------------------
+      {
+         CpuTopology topology;
+         std::vector<int> online;
+         std::ifstream ifs(sysfs + "/online");
+         std::string list;
+         if ( (! ifs) || (! std::getline(ifs, list)) || (! parse_cpu_list(list, online)) )
+         {
+            const long n = sysconf(_SC_NPROCESSORS_CONF);
+            for (int cpu = 0; cpu < n; cpu++)
+               online.push_back(cpu);
+         }
+         cpu_set_t allowed;
+         CPU_ZERO(&allowed);
+         const bool hasMask = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+         for (int cpu : online)
+         {
+            if ( (hasMask) && (! CPU_ISSET(cpu, &allowed)) )
+               continue;
+            const std::string dir = sysfs + "/cpu" + std::to_string(cpu);
+            int64_t capacity = read_value(dir + "/cpu_capacity");
+            if (capacity <= 0)
+               capacity = read_value(dir + "/cpufreq/cpuinfo_max_freq");
+            topology.cpus.push_back(Cpu{ cpu, capacity });
+         }
+         return topology;
+      }
+
+      std::vector<int> CpuTopology::all() const
+      //---------------------------------------
+      {
+         std::vector<int> ids;
+         for (const Cpu& cpu : cpus)
+            ids.push_back(cpu.id);
+         return ids;
+      }
+
+      bool CpuTopology::is_heterogeneous() const
+      //----------------------------------------
+      {
+         for (const Cpu& cpu : cpus)
+            if (cpu.capacity != cpus.front().capacity) return true;
+         return false;
+      }
+
+      std::vector<int> CpuTopology::big() const
+      //---------------------------------------
+      {
+         int64_t highest = 0;
+         for (const Cpu& cpu : cpus)
+            highest = std::max(highest, cpu.capacity);
+         std::vector<int> ids;
+         for (const Cpu& cpu : cpus)
+            if (cpu.capacity == highest) ids.push_back(cpu.id);
+         return ids;
+      }
+
+      std::vector<int> CpuTopology::little() const
+      //------------------------------------------
+      {
+         if (! is_heterogeneous())
+            return all();
+         int64_t highest = 0;
+         for (const Cpu& cpu : cpus)
+            highest = std::max(highest, cpu.capacity);
+         std::vector<int> ids;
+         for (const Cpu& cpu : cpus)
+            if (cpu.capacity < highest) ids.push_back(cpu.id);
+         return ids;
+      }
+
+      bool CpuTopology::resolve(const std::string& spec, std::vector<int>& resolved) const
+      //----------------------------------------------------------------------------------
+      {
+         if (spec == "all")
+            resolved = all();
+         else if (spec == "big")
+            resolved = big();
+         else if (spec == "little")
+            resolved = little();
+         else
+         {
+            std::vector<int> listed;
+            if (! parse_cpu_list(spec, listed))
+               return false;
+            resolved.clear();
+            for (const Cpu& cpu : cpus)
+               if (std::binary_search(listed.begin(), listed.end(), cpu.id)) resolved.push_back(cpu.id);
+         }
+         return (! resolved.empty());
+      }
+
+      static const char* STAGE_CLASS_NAMES[static_cast<unsigned>(StageClass::COUNT)] =
+      {
+         "pipeline", "compute", "sensors", "camera"
+      };
+
+      const char* stage_class_name(StageClass stage)
+      //--------------------------------------------
+      {
+         const unsigned i = static_cast<unsigned>(stage);
+         return (i < static_cast<unsigned>(StageClass::COUNT)) ? STAGE_CLASS_NAMES[i] : "unknown";
+      }
+
+      CpuPlacement& CpuPlacement::instance()
+      //------------------------------------
+      {
+         static CpuPlacement the_instance;
+         return the_instance;
+      }
+
+      bool CpuPlacement::set(StageClass stage, const std::string& spec)
+      //---------------------------------------------------------------
+      {
+         std::vector<int> resolved;
+         if ( (! spec.empty()) && (! topo.resolve(spec, resolved)) )
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "CpuPlacement::set", "Invalid core set '%s' for %s (allowed %s)",
+                                spec.c_str(), stage_class_name(stage), cpu_list(topo.all()).c_str());
+            return false;
+         }
+         {
+            tbb::spin_mutex::scoped_lock lock(mutex);
+            coreSets[static_cast<unsigned>(stage)] = resolved;
+         }
+         generation.fetch_add(1, std::memory_order_release);
+         if (! resolved.empty())
+            __android_log_print(ANDROID_LOG_INFO, "CpuPlacement::set", "%s threads on cores %s",
+                                stage_class_name(stage), cpu_list(resolved).c_str());
+         return true;
+      }
+
+      std::vector<int> CpuPlacement::cores(StageClass stage)
+      //----------------------------------------------------
+      {
+         tbb::spin_mutex::scoped_lock lock(mutex);
+         return coreSets[static_cast<unsigned>(stage)];
+      }
+
+      // Placement last applied to the calling thread and its result, so repeated pins are free until the placement
+      // changes
+      static thread_local StageClass pinnedStage = StageClass::COUNT;
+      static thread_local unsigned pinnedGeneration = 0;
+      static thread_local bool isPinned = false;
+
+      bool CpuPlacement::pin_current_thread(StageClass stage)
+      //-----------------------------------------------------
+      {
+         const unsigned current = generation.load(std::memory_order_acquire);
+         if ( (pinnedStage == stage) && (pinnedGeneration == current) )
+            return isPinned;
+         const std::vector<int> cpus = cores(stage);
+         if (cpus.empty())
+         {
+            if (pinnedStage != StageClass::COUNT)
+               unpin_current_thread();
+            return false;
+         }
+         // Not retried until the placement changes, even if it failed or was not honoured
+         pinnedStage = stage;
+         pinnedGeneration = current;
+         isPinned = false;
+         if (! set_affinity(cpus))
+            return false;
+         std::vector<int> actual;
+         if ( (get_affinity(actual)) && (actual != cpus) )
+         {
+            Metrics::instance().counter(std::string("placement.") + stage_class_name(stage) + ".not_honoured")->add();
+            __android_log_print(ANDROID_LOG_WARN, "CpuPlacement::pin_current_thread",
+                                "%s thread %d pinned to %s but runs on %s", stage_class_name(stage), gettid(),
+                                cpu_list(cpus).c_str(), cpu_list(actual).c_str());
+            return false;
+         }
+         isPinned = true;
+         return true;
+      }
+
+      void CpuPlacement::unpin_current_thread()
+      //---------------------------------------
+      {
+         if (pinnedStage == StageClass::COUNT)
+            return;
+         set_affinity(topo.all());
+         pinnedStage = StageClass::COUNT;
+         pinnedGeneration = 0;
+         isPinned = false;
+      }
+
+      bool CpuPlacement::set_affinity(const std::vector<int>& cpus, pid_t tid)
+      //----------------------------------------------------------------------
+      {
+         if (cpus.empty())
+            return false;
+         cpu_set_t set;
+         CPU_ZERO(&set);
+         for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+         if (sched_setaffinity(tid, sizeof(set), &set) != 0)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "CpuPlacement::set_affinity", "sched_setaffinity(%s) failed (%d)",
+                                cpu_list(cpus).c_str(), errno);
+            return false;
+         }
+         return true;
+      }
+
+      bool CpuPlacement::get_affinity(std::vector<int>& cpus, pid_t tid)
+      //---------------------------------------------------------------
+      {
+         cpus.clear();
+         cpu_set_t set;
+         CPU_ZERO(&set);
+         if (sched_getaffinity(tid, sizeof(set), &set) != 0)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "CpuPlacement::get_affinity", "sched_getaffinity failed (%d)",
+                                errno);
+            return false;
+         }
+         for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+         return true;
+      }
+
+      void ArenaPlacementObserver::on_scheduler_entry(bool isWorker)
+      //------------------------------------------------------------
+      {
+         CpuPlacement::instance().pin_current_thread(stage);
+      }
+
+      void ArenaPlacementObserver::on_scheduler_exit(bool isWorker)
+      //-----------------------------------------------------------
+      {
+         CpuPlacement::instance().unpin_current_thread();
+      }
+   }
+}
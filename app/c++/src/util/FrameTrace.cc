@@ -0,0 +1,181 @@
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+
+#include <android/log.h>
+
+#include "mar/util/FrameTrace.h"
+
+namespace toMAR
+{
+   static const char* STAGE_NAMES[TRACE_STAGES] =
+   {
+      "enqueue", "source", "route", "detect_start", "detect_end", "track_start", "track_end", "render_start",
+      "render_submit", "present"
+   };
+
+   const char* trace_stage_name(TraceStage stage)
+   //-------------------------------------------
+   {
+      const unsigned i = static_cast<unsigned>(stage);
+      return (i < TRACE_STAGES) ? STAGE_NAMES[i] : "unknown";
+   }
+
+   FrameTracer& FrameTracer::instance()
+   //----------------------------------
+   {
+      static FrameTracer the_instance;
+      return the_instance;
+   }
+
+   void FrameTracer::complete(unsigned long camera, uint64_t seqno, int64_t javaTimestamp, const FrameTrace& trace)
+   //--------------------------------------------------------------------------------------------------------------
+   {
+      if (! enabled.load(std::memory_order_relaxed))
+         return;
+      TraceRecord record;
+      record.camera = camera;
+      record.seqno = seqno;
+      for (unsigned i = 0; i < TRACE_STAGES; i++)
+         record.stamps[i] = trace.stamps[i].load(std::memory_order_relaxed);
+      const int64_t enqueued = record.stamps[static_cast<unsigned>(TraceStage::ENQUEUE)];
+      if (record.stamps[static_cast<unsigned>(TraceStage::SOURCE)] == 0)
+      {  // Never left the camera queue (overwritten by a newer frame or cleared)
+         droppedFrames.fetch_add(1, std::memory_order_relaxed);
+         return;
+      }
+
+      StageHistograms& h = histograms.local();
+      for (unsigned i = 1; i < TRACE_STAGES; i++)
+      {
+         if (record.stamps[i] > 0)
+            h.stages[i].record(record.stamps[i] - enqueued);
+      }
+      const int64_t presented = record.stamps[static_cast<unsigned>(TraceStage::PRESENT)];
+      if (presented > 0)
+      {
+         h.total.record(presented - enqueued);
+         if (javaTimestamp > 0)
+         {  // Camera timestamps are CLOCK_BOOTTIME based, so move present time onto the same clock.
+            const int64_t glass = presented + (util::now_boot() - util::now_monotonic()) - javaTimestamp;
+            if ( (glass > 0) && (glass < 10000000000L) ) // Ignore sources whose timestamps are on another clock
+               h.glass.record(glass);
+         }
+      }
+
+      tbb::spin_mutex::scoped_lock lock(recentMutex);
+      recent[recentNext] = record;
+      recentNext = (recentNext + 1) % RECENT_TRACES;
+      if (recentCount < RECENT_TRACES) recentCount++;
+   }
+
+   static void histogram_json(std::ostream& out, const char* name, const util::LatencyHistogram& h)
+   //---------------------------------------------------------------------------------------------
+   {
+      constexpr double ns2ms = 1000000.0;
+      out << "\"" << name << "\":{\"count\":" << h.size() << std::fixed << std::setprecision(3)
+          << ",\"mean\":" << h.mean() / ns2ms << ",\"p50\":" << h.percentile(50) / ns2ms
+          << ",\"p95\":" << h.percentile(95) / ns2ms << ",\"p99\":" << h.percentile(99) / ns2ms
+          << ",\"max\":" << h.max() / ns2ms << "}";
+   }
+
+   void FrameTracer::latency_json(std::ostream& out)
+   //-----------------------------------------------
+   {
+      std::unique_ptr<StageHistograms> merged(new StageHistograms);
+      for (const StageHistograms& h : histograms)
+      {
+         for (unsigned i = 0; i < TRACE_STAGES; i++)
+            h.stages[i].merge_into(merged->stages[i]);
+         h.total.merge_into(merged->total);
+         h.glass.merge_into(merged->glass);
+      }
+      out << "{\"units\":\"ms\",\"dropped\":" << dropped();
+      for (unsigned i = 1; i < TRACE_STAGES; i++)
+      {
+         out << ",";
+         histogram_json(out, STAGE_NAMES[i], merged->stages[i]);
+      }
+      out << ",";
+      histogram_json(out, "enqueue_to_present", merged->total);
+      out << ",";
+      histogram_json(out, "sensor_to_present", merged->glass);
+      out << "}";
+   }
+
+   bool FrameTracer::write_chrome_trace(const char* filename)
+   //--------------------------------------------------------
+   {
+      std::vector<TraceRecord> records;
+      {
+         tbb::spin_mutex::scoped_lock lock(recentMutex);
+         records.reserve(recentCount);
+         const size_t start = (recentNext + RECENT_TRACES - recentCount) % RECENT_TRACES;
+         for (size_t i = 0; i < recentCount; i++)
+            records.push_back(recent[(start + i) % RECENT_TRACES]);
+      }
+      std::ofstream ofs(filename);
+      if (! ofs)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "FrameTracer::write_chrome_trace", "Error opening %s", filename);
+         return false;
+      }
+      // One process per camera with a lane (thread) for each of the intervals below
+      struct Span { const char* name; TraceStage from, to; int lane; };
+      static const Span spans[] =
+      {
+         { "queue", TraceStage::ENQUEUE, TraceStage::SOURCE, 0 },
+         { "route", TraceStage::SOURCE, TraceStage::ROUTE, 0 },
+         { "detect", TraceStage::DETECT_START, TraceStage::DETECT_END, 1 },
+         { "track", TraceStage::TRACK_START, TraceStage::TRACK_END, 2 },
+         { "render", TraceStage::RENDER_START, TraceStage::RENDER_SUBMIT, 3 },
+         { "present", TraceStage::RENDER_SUBMIT, TraceStage::PRESENT, 3 }
+      };
+      static const char* lanes[] = { "ingest", "detect", "track", "render" };
+      ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      bool first = true;
+      std::vector<unsigned long> named;
+      ofs << std::fixed << std::setprecision(3);
+      for (const TraceRecord& record : records)
+      {
+         if (std::find(named.begin(), named.end(), record.camera) == named.end())
+         {
+            named.push_back(record.camera);
+            for (int lane = 0; lane < 4; lane++)
+            {
+               ofs << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << record.camera
+                   << ",\"tid\":" << lane << ",\"args\":{\"name\":\"" << lanes[lane] << "\"}}";
+               first = false;
+            }
+         }
+         for (const Span& span : spans)
+         {
+            const int64_t from = record.stamps[static_cast<unsigned>(span.from)];
+            const int64_t to = record.stamps[static_cast<unsigned>(span.to)];
+            if ( (from <= 0) || (to < from) ) continue;
+            ofs << (first ? "" : ",") << "\n{\"name\":\"" << span.name << "\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":"
+                << from / 1000.0 << ",\"dur\":" << (to - from) / 1000.0 << ",\"pid\":" << record.camera
+                << ",\"tid\":" << span.lane << ",\"args\":{\"seqno\":" << record.seqno << "}}";
+            first = false;
+         }
+      }
+      ofs << "\n]}\n";
+      return ofs.good();
+   }
+
+   void FrameTracer::clear()
+   //-----------------------
+   {
+      for (StageHistograms& h : histograms)
+      {
+         for (unsigned i = 0; i < TRACE_STAGES; i++)
+            h.stages[i].clear();
+         h.total.clear();
+         h.glass.clear();
+      }
+      droppedFrames.store(0, std::memory_order_relaxed);
+      tbb::spin_mutex::scoped_lock lock(recentMutex);
+      recentNext = recentCount = 0;
+   }
+}
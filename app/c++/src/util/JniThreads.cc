@@ -0,0 +1,81 @@
+#include <android/log.h>
+
+#include "mar/util/JniThreads.h"
+
+namespace toMAR
+{
+   namespace util
+   {
+      struct ThreadEnv
+      {
+         JavaVM* vm = nullptr;
+         JNIEnv* env = nullptr;
+         bool isAttached = false; // Attached by thread_env (so detached here)
+
+         ~ThreadEnv() { detach(); }
+
+         void detach()
+         {
+            if ( (isAttached) && (vm != nullptr) )
+               vm->DetachCurrentThread();
+            isAttached = false;
+            env = nullptr;
+         }
+      };
+      static thread_local ThreadEnv threadEnv;
+
+      JNIEnv* thread_env(JavaVM* vm, const char* name)
+      //----------------------------------------------
+      {
+         ThreadEnv& te = threadEnv;
+         if ( (te.env != nullptr) && (te.vm == vm) )
+            return te.env;
+         if (vm == nullptr)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "util::thread_env", "Call to thread_env before vm initialized");
+            return nullptr;
+         }
+         te.detach();
+         te.vm = vm;
+         JNIEnv* env = nullptr;
+         const jint status = vm->GetEnv((void **) &env, JNI_VERSION_1_6);
+         if (status == JNI_OK)
+         {
+            te.env = env;
+            return env;
+         }
+         if (status == JNI_EVERSION)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "util::thread_env", "Java version not supported");
+            return nullptr;
+         }
+         JavaVMAttachArgs args{ JNI_VERSION_1_6, const_cast<char*>(name), nullptr };
+         if (vm->AttachCurrentThread(&env, (name == nullptr) ? nullptr : &args) != JNI_OK)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "util::thread_env", "Error attaching thread");
+            return nullptr;
+         }
+         te.env = env;
+         te.isAttached = true;
+         return env;
+      }
+
+      void detach_current_thread()
+      //--------------------------
+      {
+         threadEnv.detach();
+      }
+
+      void JniAttachObserver::on_scheduler_entry(bool isWorker)
+      //-------------------------------------------------------
+      {
+         thread_env(vm, (isWorker) ? "MAR TBB worker" : nullptr);
+      }
+
+      void JniAttachObserver::on_scheduler_exit(bool isWorker)
+      //------------------------------------------------------
+      {
+         detach_current_thread();
+      }
+   }
+}
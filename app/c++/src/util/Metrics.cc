@@ -0,0 +1,429 @@
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+
+#include <android/log.h>
+
+#include "mar/util/Metrics.h"
+#include "mar/util/util.hh"
+
+namespace toMAR
+{
+   namespace util
+   {
+      static const char* TYPE_NAMES[] = { "counter", "gauge", "gauge", "histogram", "section" };
+
+      Metrics& Metrics::instance()
+      //--------------------------
+      {
+         static Metrics the_instance;
+         return the_instance;
+      }
+
+      std::shared_ptr<Metrics::Entry> Metrics::find_or_add(const std::string& name, MetricType type)
+      //--------------------------------------------------------------------------------------------
+      {
+         tbb::spin_mutex::scoped_lock lock(entriesMutex);
+         for (const std::shared_ptr<Entry>& entry : entries)
+         {
+            if (entry->name == name)
+               return entry;
+         }
+         std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+         entry->name = name;
+         entry->id = nextId++;
+         entry->type = type;
+         switch (type)
+         {
+            case MetricType::COUNTER:   entry->counterMetric.reset(new Counter); break;
+            case MetricType::GAUGE:     entry->gaugeMetric.reset(new Gauge); break;
+            case MetricType::HISTOGRAM: entry->histogramMetric.reset(new Histogram); break;
+            default: break;
+         }
+         entries.push_back(entry);
+         return entry;
+      }
+
+      Counter* Metrics::counter(const std::string& name)
+      //------------------------------------------------
+      {
+         std::shared_ptr<Entry> entry = find_or_add(name, MetricType::COUNTER);
+         if (! entry->counterMetric)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "Metrics::counter", "%s is already registered as a %s, not reported",
+                                name.c_str(), TYPE_NAMES[static_cast<unsigned>(entry->type)]);
+            return &unreportedCounter;
+         }
+         return entry->counterMetric.get();
+      }
+
+      Gauge* Metrics::gauge(const std::string& name)
+      //--------------------------------------------
+      {
+         std::shared_ptr<Entry> entry = find_or_add(name, MetricType::GAUGE);
+         if (! entry->gaugeMetric)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "Metrics::gauge", "%s is already registered as a %s, not reported",
+                                name.c_str(), TYPE_NAMES[static_cast<unsigned>(entry->type)]);
+            return &unreportedGauge;
+         }
+         return entry->gaugeMetric.get();
+      }
+
+      void Metrics::gauge(const std::string& name, std::function<int64_t()> poll, const void* owner)
+      //--------------------------------------------------------------------------------------------
+      {
+         std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+         entry->name = name;
+         entry->type = MetricType::POLLED;
+         entry->poll = std::move(poll);
+         entry->owner = owner;
+         tbb::spin_mutex::scoped_lock lock(entriesMutex);
+         for (std::shared_ptr<Entry>& existing : entries)
+         {
+            if (existing->name == name)
+            {  // Re-registration (eg a camera restarted) replaces the callback but keeps the id
+               entry->id = existing->id;
+               existing = entry;
+               return;
+            }
+         }
+         entry->id = nextId++;
+         entries.push_back(entry);
+      }
+
+      Histogram* Metrics::histogram(const std::string& name, bool isTime)
+      //-----------------------------------------------------------------
+      {
+         std::shared_ptr<Entry> entry = find_or_add(name, MetricType::HISTOGRAM);
+         if (! entry->histogramMetric)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, "Metrics::histogram",
+                                "%s is already registered as a %s, not reported", name.c_str(),
+                                TYPE_NAMES[static_cast<unsigned>(entry->type)]);
+            return &unreportedHistogram;
+         }
+         entry->isTime = isTime;
+         return entry->histogramMetric.get();
+      }
+
+      void Metrics::section(const std::string& name, std::function<void(std::ostream&)> json)
+      //-------------------------------------------------------------------------------------
+      {
+         std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+         entry->name = name;
+         entry->type = MetricType::SECTION;
+         entry->json = std::move(json);
+         tbb::spin_mutex::scoped_lock lock(entriesMutex);
+         for (std::shared_ptr<Entry>& existing : entries)
+         {
+            if (existing->name == name)
+            {
+               entry->id = existing->id;
+               existing = entry;
+               return;
+            }
+         }
+         entry->id = nextId++;
+         entries.push_back(entry);
+      }
+
+      void Metrics::remove(const std::string& name, const void* owner)
+      //--------------------------------------------------------------
+      {
+         tbb::spin_mutex::scoped_lock lock(entriesMutex);
+         for (auto it = entries.begin(); it != entries.end(); ++it)
+         {
+            const std::shared_ptr<Entry>& entry = *it;
+            if ( (entry->name == name) &&
+                 ( (entry->type == MetricType::POLLED) || (entry->type == MetricType::SECTION) ) )
+            {
+               if ( (owner != nullptr) && (entry->owner != owner) )
+                  return;
+               entries.erase(it);
+               return;
+            }
+         }
+      }
+
+      std::vector<Metrics::Sample> Metrics::sample()
+      //--------------------------------------------
+      {
+         std::vector<std::shared_ptr<Entry>> current;
+         {
+            tbb::spin_mutex::scoped_lock lock(entriesMutex);
+            current = entries;
+         }
+         std::vector<Sample> samples;
+         samples.reserve(current.size());
+         std::unique_ptr<LatencyHistogram> merged;
+         for (std::shared_ptr<Entry>& entry : current)
+         {
+            Sample sample;
+            sample.entry = entry;
+            switch (entry->type)
+            {
+               case MetricType::COUNTER:
+                  sample.value = static_cast<int64_t>(entry->counterMetric->value());
+                  break;
+               case MetricType::GAUGE:
+                  sample.value = entry->gaugeMetric->value();
+                  break;
+               case MetricType::POLLED:
+                  sample.value = entry->poll();
+                  break;
+               case MetricType::HISTOGRAM:
+                  if (! merged)
+                     merged.reset(new LatencyHistogram);
+                  else
+                     merged->clear();
+                  entry->histogramMetric->merge_into(*merged);
+                  sample.count = merged->size();
+                  sample.mean = merged->mean();
+                  sample.p50 = merged->percentile(50);
+                  sample.p95 = merged->percentile(95);
+                  sample.p99 = merged->percentile(99);
+                  sample.max = merged->max();
+                  break;
+               case MetricType::SECTION:
+                  break;
+            }
+            samples.push_back(std::move(sample));
+         }
+         return samples;
+      }
+
+      void Metrics::write_json(std::ostream& out, int64_t timestamp, const std::vector<Sample>& samples)
+      //------------------------------------------------------------------------------------------------
+      {
+         constexpr double ns2ms = 1000000.0;
+         out << "{\"timestamp\":" << timestamp;
+         const MetricType groups[] = { MetricType::COUNTER, MetricType::GAUGE, MetricType::HISTOGRAM };
+         const char* groupNames[] = { "counters", "gauges", "histograms" };
+         for (int g = 0; g < 3; g++)
+         {
+            out << ",\"" << groupNames[g] << "\":{";
+            bool first = true;
+            for (const Sample& sample : samples)
+            {
+               MetricType type = sample.entry->type;
+               if (type == MetricType::POLLED) type = MetricType::GAUGE;
+               if (type != groups[g]) continue;
+               out << (first ? "" : ",") << "\"" << sample.entry->name << "\":";
+               first = false;
+               if ( (type == MetricType::HISTOGRAM) && (! sample.entry->isTime) )
+                  out << "{\"count\":" << sample.count << std::fixed << std::setprecision(1)
+                      << ",\"mean\":" << sample.mean << ",\"p50\":" << sample.p50 << ",\"p95\":" << sample.p95
+                      << ",\"p99\":" << sample.p99 << ",\"max\":" << sample.max << "}";
+               else if (type == MetricType::HISTOGRAM)
+                  out << "{\"count\":" << sample.count << std::fixed << std::setprecision(3)
+                      << ",\"mean_ms\":" << sample.mean / ns2ms << ",\"p50_ms\":" << sample.p50 / ns2ms
+                      << ",\"p95_ms\":" << sample.p95 / ns2ms << ",\"p99_ms\":" << sample.p99 / ns2ms
+                      << ",\"max_ms\":" << sample.max / ns2ms << "}";
+               else
+                  out << sample.value;
+            }
+            out << "}";
+         }
+         for (const Sample& sample : samples)
+         {
+            if (sample.entry->type != MetricType::SECTION) continue;
+            out << ",\"" << sample.entry->name << "\":";
+            sample.entry->json(out);
+         }
+         out << "}";
+      }
+
+      void Metrics::write_csv(std::ostream& out, int64_t timestamp, const std::vector<Sample>& samples)
+      //-----------------------------------------------------------------------------------------------
+      {
+         for (const Sample& sample : samples)
+         {
+            const MetricType type = sample.entry->type;
+            if (type == MetricType::SECTION) continue;
+            out << timestamp << "," << TYPE_NAMES[static_cast<unsigned>(type)] << "," << sample.entry->name << ",";
+            if (type == MetricType::HISTOGRAM)
+               out << "," << sample.count << "," << std::fixed << std::setprecision(0) << sample.mean << ","
+                   << sample.p50 << "," << sample.p95 << "," << sample.p99 << "," << sample.max << "\n";
+            else
+               out << sample.value << ",,,,,,\n";
+         }
+      }
+
+      // Binary ring layout (little endian, as written by the device):
+      //    header:  char magic[8] "MARRING1", uint32 recordSize (24), uint32 reserved, uint64 capacity (records),
+      //             uint64 written (total records ever written, the next record goes to slot written % capacity)
+      //    records: int64 timestamp (CLOCK_MONOTONIC ns), uint32 metric id, uint32 field, double value
+      // field is 0 for the value of a counter/gauge, 1-6 for histogram count, mean, p50, p95, p99, max (ns).
+      // Metric ids map to names through the "id,type,name" lines in the .names file written alongside.
+      struct RingHeader
+      {
+         char magic[8];
+         uint32_t recordSize;
+         uint32_t reserved;
+         uint64_t capacity;
+         uint64_t written;
+      };
+      struct RingRecord
+      {
+         int64_t timestamp;
+         uint32_t id;
+         uint32_t field;
+         double value;
+      };
+
+      void Metrics::write_ring(std::fstream& ring, const std::string& namesFile, std::string& names,
+                               int64_t timestamp, const std::vector<Sample>& samples, size_t capacity,
+                               uint64_t& written)
+      //--------------------------------------------------------------------------------------------
+      {
+         std::stringstream ss;
+         for (const Sample& sample : samples)
+            ss << sample.entry->id << "," << TYPE_NAMES[static_cast<unsigned>(sample.entry->type)] << ","
+               << sample.entry->name << "\n";
+         if (ss.str() != names)
+         {
+            names = ss.str();
+            std::ofstream ofs(namesFile, std::ios::trunc);
+            ofs << names;
+         }
+         auto put = [&ring, &written, capacity, timestamp](uint32_t id, uint32_t field, double value)
+         {
+            RingRecord record{timestamp, id, field, value};
+            ring.seekp(static_cast<std::streamoff>(sizeof(RingHeader) + (written % capacity)*sizeof(RingRecord)));
+            ring.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            written++;
+         };
+         for (const Sample& sample : samples)
+         {
+            const uint32_t id = sample.entry->id;
+            switch (sample.entry->type)
+            {
+               case MetricType::SECTION:
+                  break;
+               case MetricType::HISTOGRAM:
+                  put(id, 1, sample.count); put(id, 2, sample.mean); put(id, 3, sample.p50);
+                  put(id, 4, sample.p95); put(id, 5, sample.p99); put(id, 6, sample.max);
+                  break;
+               default:
+                  put(id, 0, sample.value);
+                  break;
+            }
+         }
+         RingHeader header{{'M','A','R','R','I','N','G','1'}, sizeof(RingRecord), 0, capacity, written};
+         ring.seekp(0);
+         ring.write(reinterpret_cast<const char*>(&header), sizeof(header));
+         ring.flush();
+      }
+
+      std::string Metrics::snapshot_json()
+      //----------------------------------
+      {
+         std::stringstream ss;
+         write_json(ss, now_monotonic(), sample());
+         return ss.str();
+      }
+
+      std::string Metrics::latest()
+      //---------------------------
+      {
+         if (isExporting.load())
+         {
+            tbb::spin_mutex::scoped_lock lock(latestMutex);
+            if (! latestSnapshot.empty())
+               return latestSnapshot;
+         }
+         return snapshot_json();
+      }
+
+      bool Metrics::start_exporter(const std::string& directory, int64_t intervalMs, bool isCSV, bool isBinary,
+                                   size_t ringRecords)
+      //-------------------------------------------------------------------------------------------------------
+      {
+         bool exporting = false;
+         if (! isExporting.compare_exchange_strong(exporting, true))
+            return false;
+         {
+            std::lock_guard<std::mutex> lock(exporterMutex);
+            stopExporter = false;
+         }
+         exporterThread = std::thread(&Metrics::exporter, this, directory, intervalMs, isCSV, isBinary,
+                                      (ringRecords == 0) ? 1 : ringRecords);
+         return true;
+      }
+
+      void Metrics::stop_exporter()
+      //---------------------------
+      {
+         {
+            std::lock_guard<std::mutex> lock(exporterMutex);
+            stopExporter = true;
+         }
+         exporterCondition.notify_all();
+         if (exporterThread.joinable())
+            exporterThread.join();
+         isExporting.store(false);
+      }
+
+      void Metrics::exporter(std::string directory, int64_t intervalMs, bool isCSV, bool isBinary, size_t ringRecords)
+      //--------------------------------------------------------------------------------------------------------------
+      {
+         const std::string jsonFile = directory + "/mar-metrics.json", csvFile = directory + "/mar-metrics.csv",
+                           ringFile = directory + "/mar-metrics.ring";
+         std::ofstream csv;
+         if (isCSV)
+         {
+            csv.open(csvFile, std::ios::trunc);
+            if (csv)
+               csv << "timestamp_ns,type,name,value,count,mean,p50,p95,p99,max\n";
+            else
+               __android_log_print(ANDROID_LOG_ERROR, "Metrics::exporter", "Error opening %s", csvFile.c_str());
+         }
+         std::fstream ring;
+         std::string names;
+         uint64_t written = 0;
+         if (isBinary)
+         {
+            ring.open(ringFile, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+            if (! ring)
+               __android_log_print(ANDROID_LOG_ERROR, "Metrics::exporter", "Error opening %s", ringFile.c_str());
+         }
+         std::unique_lock<std::mutex> lock(exporterMutex);
+         while (! stopExporter)
+         {
+            lock.unlock();
+            const int64_t timestamp = now_monotonic();
+            std::vector<Sample> samples = sample();
+            std::stringstream ss;
+            write_json(ss, timestamp, samples);
+            std::string snapshot = ss.str();
+            const std::string tmp = jsonFile + ".tmp";
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (ofs)
+            {
+               ofs << snapshot << std::endl;
+               ofs.close();
+               if (std::rename(tmp.c_str(), jsonFile.c_str()) != 0)
+                  __android_log_print(ANDROID_LOG_ERROR, "Metrics::exporter", "Error renaming %s to %s (%s)",
+                                      tmp.c_str(), jsonFile.c_str(), std::strerror(errno));
+            }
+            if (csv)
+            {
+               write_csv(csv, timestamp, samples);
+               csv.flush();
+            }
+            if (ring)
+               write_ring(ring, directory + "/mar-metrics.names", names, timestamp, samples, ringRecords, written);
+            {
+               tbb::spin_mutex::scoped_lock latestLock(latestMutex);
+               latestSnapshot.swap(snapshot);
+            }
+            lock.lock();
+            exporterCondition.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]{ return stopExporter; });
+         }
+      }
+   }
+}
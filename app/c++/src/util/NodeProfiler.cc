@@ -0,0 +1,133 @@
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+
+#include <android/log.h>
+
+#include "mar/util/NodeProfiler.h"
+
+namespace toMAR
+{
+   NodeProfiler& NodeProfiler::instance()
+   //------------------------------------
+   {
+      static NodeProfiler the_instance;
+      return the_instance;
+   }
+
+   NodeStats* NodeProfiler::node(const std::string& name)
+   //----------------------------------------------------
+   {
+      tbb::spin_mutex::scoped_lock lock(nodesMutex);
+      for (const std::unique_ptr<NodeStats>& stats : nodes)
+      {
+         if (stats->name == name)
+            return stats.get();
+      }
+      nodes.emplace_back(new NodeStats(name));
+      return nodes.back().get();
+   }
+
+   void NodeProfiler::completed(NodeStats* stats, uint64_t seqno, int64_t start, int64_t end)
+   //----------------------------------------------------------------------------------------
+   {
+      stats->invocations.fetch_add(1, std::memory_order_relaxed);
+      stats->busyNs.fetch_add(static_cast<uint64_t>(end - start), std::memory_order_relaxed);
+      stats->active.fetch_sub(1, std::memory_order_relaxed);
+      if (! tracing.load(std::memory_order_relaxed))
+         return;
+      SpanRing& ring = rings.local();
+      tbb::spin_mutex::scoped_lock lock(ring.mutex);
+      if (ring.spans.empty())
+         ring.spans.resize(RECENT_SPANS);
+      Span& span = ring.spans[ring.next];
+      span.node = stats;
+      span.seqno = seqno;
+      span.start = start;
+      span.end = end;
+      ring.next = (ring.next + 1) % RECENT_SPANS;
+      if (ring.count < RECENT_SPANS) ring.count++;
+   }
+
+   void NodeProfiler::stats_json(std::ostream& out)
+   //----------------------------------------------
+   {
+      tbb::spin_mutex::scoped_lock lock(nodesMutex);
+      out << "[";
+      bool first = true;
+      for (const std::unique_ptr<NodeStats>& stats : nodes)
+      {
+         const uint64_t invocations = stats->invocations.load(std::memory_order_relaxed);
+         const uint64_t busy = stats->busyNs.load(std::memory_order_relaxed);
+         out << (first ? "" : ",") << "{\"name\":\"" << stats->name << "\",\"invocations\":" << invocations
+             << ",\"busy_ns\":" << busy << ",\"mean_ns\":" << ((invocations > 0) ? busy / invocations : 0)
+             << ",\"active\":" << stats->active.load(std::memory_order_relaxed)
+             << ",\"max_concurrency\":" << stats->maxActive.load(std::memory_order_relaxed)
+             << ",\"queued\":" << stats->queued()
+             << ",\"rejected\":" << stats->rejected.load(std::memory_order_relaxed) << "}";
+         first = false;
+      }
+      out << "]";
+   }
+
+   bool NodeProfiler::write_chrome_trace(const char* filename)
+   //---------------------------------------------------------
+   {
+      std::ofstream ofs(filename);
+      if (! ofs)
+      {
+         __android_log_print(ANDROID_LOG_ERROR, "NodeProfiler::write_chrome_trace", "Error opening %s", filename);
+         return false;
+      }
+      // One lane (thread) per TBB thread that ran a node body
+      ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      ofs << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"flow graph\"}}";
+      ofs << std::fixed << std::setprecision(3);
+      int lane = 0;
+      std::vector<Span> spans;
+      for (SpanRing& ring : rings)
+      {
+         spans.clear();
+         {
+            tbb::spin_mutex::scoped_lock lock(ring.mutex);
+            const size_t start = (ring.next + RECENT_SPANS - ring.count) % RECENT_SPANS;
+            for (size_t i = 0; i < ring.count; i++)
+               spans.push_back(ring.spans[(start + i) % RECENT_SPANS]);
+         }
+         if (spans.empty()) continue;
+         ofs << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << lane
+             << ",\"args\":{\"name\":\"worker " << lane << "\"}}";
+         for (const Span& span : spans)
+         {
+            ofs << ",\n{\"name\":\"" << span.node->name << "\",\"cat\":\"node\",\"ph\":\"X\",\"ts\":"
+                << span.start / 1000.0 << ",\"dur\":" << (span.end - span.start) / 1000.0 << ",\"pid\":0,\"tid\":"
+                << lane << ",\"args\":{\"seqno\":" << span.seqno << "}}";
+         }
+         lane++;
+      }
+      ofs << "\n]}\n";
+      return ofs.good();
+   }
+
+   void NodeProfiler::clear()
+   //------------------------
+   {
+      {
+         tbb::spin_mutex::scoped_lock lock(nodesMutex);
+         for (const std::unique_ptr<NodeStats>& stats : nodes)
+         {  // active is left alone as bodies may be running
+            stats->invocations.store(0, std::memory_order_relaxed);
+            stats->busyNs.store(0, std::memory_order_relaxed);
+            stats->accepted.store(0, std::memory_order_relaxed);
+            stats->started.store(0, std::memory_order_relaxed);
+            stats->rejected.store(0, std::memory_order_relaxed);
+            stats->maxActive.store(stats->active.load(std::memory_order_relaxed), std::memory_order_relaxed);
+         }
+      }
+      for (SpanRing& ring : rings)
+      {
+         tbb::spin_mutex::scoped_lock lock(ring.mutex);
+         ring.next = ring.count = 0;
+      }
+   }
+}
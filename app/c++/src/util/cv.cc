@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/imgproc.hpp>
@@ -9,8 +11,11 @@
 #include <android/log.h>
 #include <mar/Structures.h>
 #include <mar/util/android.hh>
+#include <mar/util/cv.h>
 #include <mar/Repository.h>
 
+#include "mar/util/RowBands.hh"
+
 namespace toMAR
 {
    namespace vision
@@ -18,6 +23,14 @@ namespace toMAR
       bool YUV2RGBA(void* YUVData, void* outputJavaRGB, int w, int h, bool isRGBA, const char *logtag)
       //----------------------------------------------------------------------------------------------
       {
+         if ( (w*h >= PARALLEL_MIN_PIXELS) && (w % 2 == 0) && (h % 2 == 0) )
+         { // A contiguous I420 band is not a valid cv::Mat layout, so large frames use the (same numerics) kernel
+            const unsigned char* Y = static_cast<const unsigned char*>(YUVData);
+            const unsigned char* U = Y + w*h;
+            const unsigned char* V = U + (w / 2)*(h / 2);
+            strided_yuv2rgba(Y, U, V, w, w / 2, 1, w, h, isRGBA, outputJavaRGB);
+            return true;
+         }
          cv::Mat yuv(h + h / 2, w, CV_8UC1, YUVData), rgba(h, w, CV_8UC4, outputJavaRGB);
          try //OpenCV throws exceptions.
          {
@@ -74,10 +87,12 @@ namespace toMAR
                  rgba(h, w, CV_8UC4, outputJavaRGB);
          try
          {
-            if (isRGBA)
-               cv::cvtColorTwoPlane(Ym, Vm, rgba, cv::COLOR_YUV2RGBA_NV21);
-            else
-               cv::cvtColorTwoPlane(Ym, Vm, rgba, cv::COLOR_YUV2BGRA_NV21);
+            const int code = (isRGBA) ? cv::COLOR_YUV2RGBA_NV21 : cv::COLOR_YUV2BGRA_NV21;
+            for_row_bands(w, h, [&](int y0, int y1)
+            {
+               cv::Mat rgbaBand = rgba.rowRange(y0, y1);
+               cv::cvtColorTwoPlane(Ym.rowRange(y0, y1), Vm.rowRange(y0 / 2, y1 / 2), rgbaBand, code);
+            });
          }
          catch (cv::Exception& cverr)
          {
@@ -116,6 +131,62 @@ namespace toMAR
          return true;
       }
 
+      bool Planes2RGBA(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                       int uvPixelStride, int w, int h, bool isRGBA, void* RGBA, void* mono, const char *logtag)
+      //---------------------------------------------------------------------------------------------------------
+      {
+         if ( (w <= 0) || (h <= 0) || (w % 2) || (h % 2) || (yRowStride < w) || (uvPixelStride < 1) ||
+              (uvRowStride < (w / 2)*uvPixelStride - (uvPixelStride - 1)) )
+         {
+            __android_log_print(ANDROID_LOG_ERROR, logtag, "Planes2RGBA: Invalid %dx%d strides %d %d %d", w, h,
+                                yRowStride, uvRowStride, uvPixelStride);
+            return false;
+         }
+         try
+         {
+            cv::Mat Ym(h, w, CV_8UC1, const_cast<void*>(Y), static_cast<size_t>(yRowStride));
+            const YUVLayout layout = yuv_layout(U, V, uvPixelStride);
+            if (RGBA != nullptr)
+            {
+               if ( (layout == YUVLayout::NV12) || (layout == YUVLayout::NV21) )
+               {
+                  cv::Mat UVm(h / 2, w / 2, CV_8UC2, const_cast<void*>((layout == YUVLayout::NV12) ? U : V),
+                              static_cast<size_t>(uvRowStride)), rgba(h, w, CV_8UC4, RGBA);
+                  int code;
+                  if (layout == YUVLayout::NV12)
+                     code = (isRGBA) ? cv::COLOR_YUV2RGBA_NV12 : cv::COLOR_YUV2BGRA_NV12;
+                  else
+                     code = (isRGBA) ? cv::COLOR_YUV2RGBA_NV21 : cv::COLOR_YUV2BGRA_NV21;
+                  for_row_bands(w, h, [&](int y0, int y1)
+                  {
+                     cv::Mat rgbaBand = rgba.rowRange(y0, y1);
+                     cv::cvtColorTwoPlane(Ym.rowRange(y0, y1), UVm.rowRange(y0 / 2, y1 / 2), rgbaBand, code);
+                  });
+               }
+               else
+                  strided_yuv2rgba(Y, U, V, yRowStride, uvRowStride, uvPixelStride, w, h, isRGBA, RGBA);
+            }
+            if (mono != nullptr)
+            {
+               cv::Mat grey(h, w, CV_8UC1, mono);
+               Ym.copyTo(grey);
+            }
+         }
+         catch (cv::Exception& cverr)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, logtag,
+                                "Planes2RGBA: OpenCV exception (%s %s:%d in %s)", cverr.what(),
+                                cverr.file.c_str(), cverr.line, cverr.func.c_str());
+            return false;
+         }
+         catch (...)
+         {
+            __android_log_print(ANDROID_LOG_ERROR, logtag, "Planes2RGBA: Catchall exception converting YUV planes");
+            return false;
+         }
+         return true;
+      }
+
       bool drawBB(void* img, int width, int height, double top, double left, double bottom, double right,
                   int r, int g, int b, int stroke, const char *logtag)
       //------------------------------------------------------------------------------------------------
@@ -218,20 +289,37 @@ namespace toMAR
          return true;
       }
 
+      std::shared_ptr<cv::CascadeClassifier> face_cascade()
+      //---------------------------------------------------
+      {
+         if (cascade == nullptr) return nullptr;
+         auto classifier = std::make_shared<cv::CascadeClassifier>();
+         if (! classifier->load(FACE_DETECTOR_CASCADE_LOCAL))
+            return nullptr;
+         return classifier;
+      }
+
       bool find_face(void *src, int width, int height, int minArea, DetectRect<int>& faceBB,
                      const char *logtag)
       //---------------------------------------------------------------------------------------------
+      {
+         return find_face(cascade, src, width, height, minArea, faceBB, logtag);
+      }
+
+      bool find_face(cv::CascadeClassifier* classifier, void *src, int width, int height, int minArea,
+                     DetectRect<int>& faceBB, const char *logtag)
+      //-----------------------------------------------------------------------------------------------
       {
          faceBB = DetectRect<int>();
-         if (cascade == nullptr) return false;
+         if (classifier == nullptr) return false;
          cv::Mat rgba(height, width, CV_8UC4, src), gray;
          std::vector<cv::Rect> faces;
          try
          {
             cv::cvtColor(rgba, gray, cv::COLOR_RGBA2GRAY); //TODO: Support BGRA
             cv::equalizeHist(gray, gray);
-            cascade->detectMultiScale(gray, faces, 1.4, 3,
-                                      cv::CASCADE_SCALE_IMAGE + cv::CASCADE_FIND_BIGGEST_OBJECT);
+            classifier->detectMultiScale(gray, faces, 1.4, 3,
+                                         cv::CASCADE_SCALE_IMAGE + cv::CASCADE_FIND_BIGGEST_OBJECT);
          }
          catch (cv::Exception& cverr)
          {
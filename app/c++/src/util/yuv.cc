@@ -0,0 +1,169 @@
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+
+#include <android/log.h>
+
+#include "mar/util/cv.h"
+#include "mar/util/RowBands.hh"
+
+// YUV_420_888 kernels that need neither OpenCV nor the rest of the library, so they also build (and are tested) on
+// the host, see test/CMakeLists.txt.
+namespace toMAR
+{
+   namespace vision
+   {
+      YUVLayout yuv_layout(const void* U, const void* V, int uvPixelStride)
+      //-------------------------------------------------------------------
+      {
+         const unsigned char* u = static_cast<const unsigned char*>(U);
+         const unsigned char* v = static_cast<const unsigned char*>(V);
+         if (uvPixelStride == 1)
+            return YUVLayout::I420;
+         if (uvPixelStride == 2)
+         {
+            if (v == u + 1) return YUVLayout::NV12;
+            if (u == v + 1) return YUVLayout::NV21;
+         }
+         return YUVLayout::STRIDED;
+      }
+
+      // BT.601 video range YUV to RGB in 20 bit fixed point (the coefficients OpenCV uses for COLOR_YUV2RGBA_I420)
+      constexpr int BT601_CY = 1220542, BT601_CUB = 2116026, BT601_CUG = -409993, BT601_CVG = -852492,
+                    BT601_CVR = 1673527, BT601_SHIFT = 20, BT601_HALF = 1 << (BT601_SHIFT - 1);
+
+      static inline unsigned char bt601_clamp(int v)
+      {
+         v >>= BT601_SHIFT;
+         return static_cast<unsigned char>((v < 0) ? 0 : ((v > 255) ? 255 : v));
+      }
+
+      void strided_yuv2rgba(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                            int uvPixelStride, int w, int h, bool isRGBA, void* RGBA)
+      //---------------------------------------------------------------------------------------------------
+      {
+         const int ri = (isRGBA) ? 0 : 2, bi = (isRGBA) ? 2 : 0;
+         for_row_bands(w, h, [&](int y0, int y1)
+         {
+            for (int y = y0; y < y1; y++)
+            {
+               const unsigned char* yrow = static_cast<const unsigned char*>(Y) + y*yRowStride;
+               const unsigned char* urow = static_cast<const unsigned char*>(U) + (y / 2)*uvRowStride;
+               const unsigned char* vrow = static_cast<const unsigned char*>(V) + (y / 2)*uvRowStride;
+               unsigned char* out = static_cast<unsigned char*>(RGBA) + y*w*4;
+               for (int x = 0; x < w; x += 2)
+               {
+                  const int u = urow[(x / 2)*uvPixelStride] - 128, v = vrow[(x / 2)*uvPixelStride] - 128;
+                  const int ruv = BT601_HALF + BT601_CVR*v, guv = BT601_HALF + BT601_CVG*v + BT601_CUG*u,
+                            buv = BT601_HALF + BT601_CUB*u;
+                  for (int i = 0; i < 2; i++, out += 4)
+                  {
+                     const int yy = std::max(0, yrow[x + i] - 16) * BT601_CY;
+                     out[ri] = bt601_clamp(yy + ruv);
+                     out[1] = bt601_clamp(yy + guv);
+                     out[bi] = bt601_clamp(yy + buv);
+                     out[3] = 255;
+                  }
+               }
+            }
+         });
+      }
+
+      static inline unsigned char clamp_u8(int v)
+      {
+         return static_cast<unsigned char>((v < 0) ? 0 : ((v > 255) ? 255 : v));
+      }
+
+      bool RSPlanes2RGBA(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                         int uvPixelStride, int w, int h, bool isRGBA, void* RGBA, void* grey, bool isGreyWeighted,
+                         const char *logtag)
+      //-----------------------------------------------------------------------------------------------------------
+      {
+         if ( (w <= 0) || (h <= 0) || (w % 2) || (h % 2) || (yRowStride < w) || (uvPixelStride < 1) )
+         {
+            __android_log_print(ANDROID_LOG_ERROR, logtag, "RSPlanes2RGBA: Invalid %dx%d strides %d %d %d", w, h,
+                                yRowStride, uvRowStride, uvPixelStride);
+            return false;
+         }
+         const int ri = (isRGBA) ? 0 : 2, bi = (isRGBA) ? 2 : 0;
+         for_row_bands(w, h, [&](int y0, int y1)
+         {
+            for (int y = y0; y < y1; y++)
+            {
+               const unsigned char* yrow = static_cast<const unsigned char*>(Y) + y*yRowStride;
+               const unsigned char* urow = static_cast<const unsigned char*>(U) + (y / 2)*uvRowStride;
+               const unsigned char* vrow = static_cast<const unsigned char*>(V) + (y / 2)*uvRowStride;
+               unsigned char* out = static_cast<unsigned char*>(RGBA) + y*w*4;
+               unsigned char* greyOut = (grey == nullptr) ? nullptr : static_cast<unsigned char*>(grey) + y*w;
+               for (int x = 0; x < w; x++, out += 4)
+               {
+                  // yuvToRGBA4, with BGRA swapping the first and third bytes as yuvToBGRA4 does
+                  const int Yv = yrow[x] - 16, Uv = urow[(x / 2)*uvPixelStride] - 128,
+                            Vv = vrow[(x / 2)*uvPixelStride] - 128;
+                  out[ri] = clamp_u8((Yv*298 + Vv*409 + 128) >> 8);
+                  out[1] = clamp_u8((Yv*298 - Uv*100 - Vv*208 + 128) >> 8);
+                  out[bi] = clamp_u8((Yv*298 + Uv*516 + 128) >> 8);
+                  out[3] = 255;
+                  if (greyOut != nullptr)
+                  {
+                     // The kernels weight out.r/g/b, ie the output byte order (so BGRA weights blue by 0.299)
+                     if (isGreyWeighted)
+                        greyOut[x] = static_cast<unsigned char>(0.299*out[0] + 0.587*out[1] + 0.114*out[2]);
+                     else
+                        greyOut[x] = yrow[x];
+                  }
+               }
+            }
+         });
+         return true;
+      }
+
+      void Planes2I420(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                       int uvPixelStride, int w, int h, void* I420)
+      //---------------------------------------------------------------------------------------------
+      {
+         unsigned char* dst = static_cast<unsigned char*>(I420);
+         for (int y = 0; y < h; y++, dst += w)
+            std::memcpy(dst, static_cast<const unsigned char*>(Y) + y*yRowStride, static_cast<size_t>(w));
+         const int cw = w / 2, ch = h / 2;
+         for (const void* plane : { U, V })
+         {
+            for (int y = 0; y < ch; y++, dst += cw)
+            {
+               const unsigned char* src = static_cast<const unsigned char*>(plane) + y*uvRowStride;
+               if (uvPixelStride == 1)
+                  std::memcpy(dst, src, static_cast<size_t>(cw));
+               else
+                  for (int x = 0; x < cw; x++)
+                     dst[x] = src[x*uvPixelStride];
+            }
+         }
+      }
+
+      void Planes2NV12(const void* Y, const void* U, const void* V, int yRowStride, int uvRowStride,
+                       int uvPixelStride, int w, int h, void* NV12)
+      //---------------------------------------------------------------------------------------------
+      {
+         unsigned char* dst = static_cast<unsigned char*>(NV12);
+         for (int y = 0; y < h; y++, dst += w)
+            std::memcpy(dst, static_cast<const unsigned char*>(Y) + y*yRowStride, static_cast<size_t>(w));
+         const int cw = w / 2, ch = h / 2;
+         const bool isNV12 = (yuv_layout(U, V, uvPixelStride) == YUVLayout::NV12);
+         for (int y = 0; y < ch; y++, dst += w)
+         {
+            const unsigned char* u = static_cast<const unsigned char*>(U) + y*uvRowStride;
+            if (isNV12)
+               std::memcpy(dst, u, static_cast<size_t>(w)); // Last byte of the last row is V's, which follows U
+            else
+            {
+               const unsigned char* v = static_cast<const unsigned char*>(V) + y*uvRowStride;
+               for (int x = 0; x < cw; x++)
+               {
+                  dst[2*x] = u[x*uvPixelStride];
+                  dst[2*x + 1] = v[x*uvPixelStride];
+               }
+            }
+         }
+      }
+   }
+}
@@ -0,0 +1,207 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mar/util/CpuPlacement.h"
+#include "mar/util/Metrics.h"
+
+// Checks of src/util/CpuPlacement.cc: CPU list parsing, the topology read from fake sysfs trees, and pinning against
+// the sched_*affinity calls defined below, which replace libc's in this executable.
+using namespace toMAR::util;
+
+static int failures = 0;
+
+static void check(const char* name, bool isOk)
+//--------------------------------------------
+{
+   if (! isOk)
+   {
+      std::fprintf(stderr, "FAIL %s\n", name);
+      failures++;
+   }
+   else
+      std::printf("ok   %s\n", name);
+}
+
+static void check(const char* name, const std::vector<int>& actual, const std::vector<int>& expected)
+//--------------------------------------------------------------------------------------------------
+{
+   if (actual != expected)
+   {
+      std::fprintf(stderr, "FAIL %s: %s, expected %s\n", name, cpu_list(actual).c_str(), cpu_list(expected).c_str());
+      failures++;
+   }
+   else
+      std::printf("ok   %s\n", name);
+}
+
+// The affinity mask of the (single threaded) test: sched_setaffinity stores it, sched_getaffinity returns it.
+// extraCpu is added on every set, as the kernel would if a cpuset widened the mask, so the pin is not honoured.
+static cpu_set_t mask;
+static int extraCpu = -1;
+static int setCalls = 0;
+
+extern "C" int sched_setaffinity(pid_t, size_t, const cpu_set_t* set)
+{
+   setCalls++;
+   mask = *set;
+   if (extraCpu >= 0)
+      CPU_SET(extraCpu, &mask);
+   return 0;
+}
+
+extern "C" int sched_getaffinity(pid_t, size_t, cpu_set_t* set)
+{
+   *set = mask;
+   return 0;
+}
+
+static void allow(const std::vector<int>& cpus)
+{
+   CPU_ZERO(&mask);
+   for (int cpu : cpus)
+      CPU_SET(cpu, &mask);
+}
+
+static void write_file(const std::string& path, const std::string& contents)
+{
+   std::ofstream ofs(path);
+   ofs << contents << "\n";
+}
+
+// A sysfs cpu directory with CPUs online, each with cpu_capacity (or cpufreq/cpuinfo_max_freq if !hasCapacity)
+static std::string fake_sysfs(const std::string& online, const std::vector<int64_t>& capacities, bool hasCapacity)
+//--------------------------------------------------------------------------------------------------------------
+{
+   char dir[] = "/tmp/cpu_placement_XXXXXX";
+   if (mkdtemp(dir) == nullptr)
+      return "";
+   const std::string root(dir);
+   write_file(root + "/online", online);
+   for (size_t cpu = 0; cpu < capacities.size(); cpu++)
+   {
+      const std::string cpuDir = root + "/cpu" + std::to_string(cpu);
+      mkdir(cpuDir.c_str(), 0755);
+      if (hasCapacity)
+         write_file(cpuDir + "/cpu_capacity", std::to_string(capacities[cpu]));
+      else
+      {
+         mkdir((cpuDir + "/cpufreq").c_str(), 0755);
+         write_file(cpuDir + "/cpufreq/cpuinfo_max_freq", std::to_string(capacities[cpu]));
+      }
+   }
+   return root;
+}
+
+static void remove_tree(const std::string& root)
+{
+   const std::string command = "rm -rf '" + root + "'";
+   if (std::system(command.c_str()) != 0)
+      std::fprintf(stderr, "Could not remove %s\n", root.c_str());
+}
+
+static void cpu_lists()
+//---------------------
+{
+   std::vector<int> cpus;
+   check("parse range and single", parse_cpu_list("0-3,6", cpus));
+   check("parse range and single cpus", cpus, { 0, 1, 2, 3, 6 });
+   check("parse unsorted with spaces", parse_cpu_list(" 2, 0-1 ,1", cpus));
+   check("parse unsorted with spaces cpus", cpus, { 0, 1, 2 });
+   for (const char* invalid : { "", "3-1", "a", "1-", "0-x", "-1", "2x", "4096" })
+   {
+      const std::string name = std::string("parse rejects '") + invalid + "'";
+      check(name.c_str(), ! parse_cpu_list(invalid, cpus));
+   }
+   check("format ranges", cpu_list({ 0, 1, 2, 3, 6, 8, 9 }) == "0-3,6,8-9");
+   check("format empty", cpu_list({}).empty());
+}
+
+static void big_little_topology()
+//-------------------------------
+{
+   // Four little and four big cores with the last big core outside the process's cpuset
+   const std::string root = fake_sysfs("0-7", { 446, 446, 446, 446, 1024, 1024, 1024, 1024 }, true);
+   allow({ 0, 1, 2, 3, 4, 5, 6 });
+   const CpuTopology topology = CpuTopology::read(root);
+   check("big.LITTLE all", topology.all(), { 0, 1, 2, 3, 4, 5, 6 });
+   check("big.LITTLE heterogeneous", topology.is_heterogeneous());
+   check("big.LITTLE big", topology.big(), { 4, 5, 6 });
+   check("big.LITTLE little", topology.little(), { 0, 1, 2, 3 });
+
+   std::vector<int> resolved;
+   check("resolve big", topology.resolve("big", resolved));
+   check("resolve big cpus", resolved, { 4, 5, 6 });
+   check("resolve list", topology.resolve("2-5,7", resolved));
+   check("resolve list cpus (allowed only)", resolved, { 2, 3, 4, 5 });
+   check("resolve disallowed list", ! topology.resolve("7", resolved));
+   check("resolve invalid", ! topology.resolve("fast", resolved));
+   remove_tree(root);
+}
+
+static void cpufreq_topology()
+//----------------------------
+{
+   // No cpu_capacity (eg x86 or older kernels), equal cpufreq maxima, CPU 1 offline
+   const std::string root = fake_sysfs("0,2-3", { 1800000, 1800000, 1800000, 1800000 }, false);
+   allow({ 0, 1, 2, 3 });
+   const CpuTopology topology = CpuTopology::read(root);
+   check("cpufreq all", topology.all(), { 0, 2, 3 });
+   check("cpufreq capacity", (! topology.cpus.empty()) && (topology.cpus.front().capacity == 1800000));
+   check("cpufreq homogeneous", ! topology.is_heterogeneous());
+   check("cpufreq little is all", topology.little(), { 0, 2, 3 });
+   check("cpufreq big is all", topology.big(), { 0, 2, 3 });
+   remove_tree(root);
+}
+
+static void pinning()
+//-------------------
+{
+   // The singleton reads the real sysfs, restricted to this mask
+   std::vector<int> all;
+   for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      all.push_back(cpu);
+   allow(all);
+   CpuPlacement& placement = CpuPlacement::instance();
+   const std::vector<int> cpus = placement.topology().all();
+   check("topology has cpus", ! cpus.empty());
+   check("no core set not pinned", ! placement.pin_current_thread(StageClass::CAMERA));
+   check("invalid core set rejected", ! placement.set(StageClass::CAMERA, "fast"));
+
+   check("set all", placement.set(StageClass::CAMERA, "all"));
+   setCalls = 0;
+   check("pinned", placement.pin_current_thread(StageClass::CAMERA));
+   check("pinned to the core set", std::vector<int>(cpus), placement.cores(StageClass::CAMERA));
+   check("pinned again from the cache", placement.pin_current_thread(StageClass::CAMERA) && (setCalls == 1));
+
+   Counter* notHonoured = Metrics::instance().counter("placement.camera.not_honoured");
+   const uint64_t notHonouredBefore = notHonoured->value();
+   extraCpu = CPU_SETSIZE - 1;
+   check("set all again", placement.set(StageClass::CAMERA, "all"));
+   setCalls = 0;
+   check("not honoured", ! placement.pin_current_thread(StageClass::CAMERA));
+   check("not honoured counted", notHonoured->value() == notHonouredBefore + 1);
+   check("not honoured cached", (! placement.pin_current_thread(StageClass::CAMERA)) && (setCalls == 1));
+   extraCpu = -1;
+
+   check("cleared", placement.set(StageClass::CAMERA, ""));
+   check("cleared not pinned", ! placement.pin_current_thread(StageClass::CAMERA));
+}
+
+int main(int argc, char** argv)
+//-----------------------------
+{
+   cpu_lists();
+   big_little_topology();
+   cpufreq_topology();
+   pinning();
+   if (failures > 0)
+      std::fprintf(stderr, "%d failures\n", failures);
+   return (failures > 0) ? 1 : 0;
+}
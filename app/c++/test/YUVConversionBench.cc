@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "tbb/global_control.h"
+
+#include "mar/util/cv.h"
+
+// Mean time per frame of the YUV_420_888 kernels (src/util/yuv.cc) by resolution and number of threads the row bands
+// may use, limited with tbb::global_control. Frames below PARALLEL_MIN_PIXELS are always converted serially.
+// Usage: yuv_conversion_bench [seconds per measurement]
+using namespace toMAR::vision;
+
+struct Resolution
+{
+   const char* name;
+   int w, h;
+};
+
+template <typename Convert>
+static double ms_per_frame(double seconds, const Convert& convert)
+//----------------------------------------------------------------
+{
+   convert(); // Warm up (and create the conversion arena)
+   const auto start = std::chrono::steady_clock::now();
+   double elapsed = 0;
+   long n = 0;
+   do
+   {
+      convert();
+      n++;
+      elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   } while (elapsed < seconds);
+   return elapsed*1000.0 / static_cast<double>(n);
+}
+
+int main(int argc, char** argv)
+//-----------------------------
+{
+   const double seconds = (argc > 1) ? std::atof(argv[1]) : 0.5;
+   const Resolution resolutions[] = { { "640x480", 640, 480 }, { "1280x720", 1280, 720 },
+                                      { "1920x1080", 1920, 1080 }, { "3840x2160", 3840, 2160 } };
+   const int threads[] = { 1, 2, 4 };
+
+   std::printf("%-10s %-16s", "frame", "kernel");
+   for (int n : threads)
+      std::printf(" %7d thr", n);
+   std::printf("  (ms/frame)\n");
+   for (const Resolution& r : resolutions)
+   {
+      const int yStride = r.w + 64, uvStride = r.w + 64; // Padded NV12 planes as AImageReader delivers them
+      std::vector<unsigned char> Y(static_cast<size_t>(yStride*r.h), 100), UV(static_cast<size_t>(uvStride*r.h/2), 90);
+      std::vector<unsigned char> rgba(static_cast<size_t>(r.w*r.h*4)), grey(static_cast<size_t>(r.w*r.h));
+      const char* kernels[] = { "strided_yuv2rgba", "RSPlanes2RGBA", "+grey" };
+      for (int k = 0; k < 3; k++)
+      {
+         std::printf("%-10s %-16s", r.name, kernels[k]);
+         for (int n : threads)
+         {
+            tbb::global_control limit(tbb::global_control::max_allowed_parallelism, static_cast<size_t>(n));
+            const double ms = ms_per_frame(seconds, [&]()
+            {
+               if (k == 0)
+                  strided_yuv2rgba(Y.data(), UV.data(), UV.data() + 1, yStride, uvStride, 2, r.w, r.h, true,
+                                   rgba.data());
+               else
+                  RSPlanes2RGBA(Y.data(), UV.data(), UV.data() + 1, yStride, uvStride, 2, r.w, r.h, true,
+                                rgba.data(), (k == 1) ? nullptr : grey.data(), true, "bench");
+            });
+            std::printf(" %11.3f", ms);
+         }
+         std::printf("\n");
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <vector>
+
+#include "mar/util/cv.h"
+
+#include "data/YUVGolden.h"
+
+// Bit exact checks of the YUV_420_888 kernels (src/util/yuv.cc) against the golden frames of data/YUVGolden.h.
+using namespace toMAR::vision;
+
+static int failures = 0;
+
+static void check(const char* name, const unsigned char* actual, const unsigned char* expected, size_t size)
+//----------------------------------------------------------------------------------------------------------
+{
+   for (size_t i = 0; i < size; i++)
+   {
+      if (actual[i] != expected[i])
+      {
+         std::fprintf(stderr, "FAIL %s: byte %zu is %d, expected %d\n", name, i, actual[i], expected[i]);
+         failures++;
+         return;
+      }
+   }
+   std::printf("ok   %s\n", name);
+}
+
+static void check(const char* name, bool isOk)
+//--------------------------------------------
+{
+   if (! isOk)
+   {
+      std::fprintf(stderr, "FAIL %s\n", name);
+      failures++;
+   }
+   else
+      std::printf("ok   %s\n", name);
+}
+
+static void planar_padded()
+//-------------------------
+{
+   std::vector<unsigned char> rgba(golden::W*golden::H*4), grey(golden::W*golden::H);
+   check("planar RGBA", RSPlanes2RGBA(golden::Y, golden::U, golden::V, golden::Y_STRIDE, golden::I420_UV_STRIDE, 1,
+                                      golden::W, golden::H, true, rgba.data(), grey.data(), false, "test"));
+   check("planar RGBA pixels", rgba.data(), golden::RGBA, rgba.size());
+   check("planar luma", grey.data(), golden::I420, grey.size());
+
+   check("planar BGRA", RSPlanes2RGBA(golden::Y, golden::U, golden::V, golden::Y_STRIDE, golden::I420_UV_STRIDE, 1,
+                                      golden::W, golden::H, false, rgba.data(), grey.data(), true, "test"));
+   check("planar BGRA pixels", rgba.data(), golden::BGRA, rgba.size());
+   check("planar BGRA weighted grey", grey.data(), golden::GREY_BGRA, grey.size());
+
+   strided_yuv2rgba(golden::Y, golden::U, golden::V, golden::Y_STRIDE, golden::I420_UV_STRIDE, 1, golden::W,
+                    golden::H, true, rgba.data());
+   check("planar BT.601 RGBA pixels", rgba.data(), golden::BT601_RGBA, rgba.size());
+   strided_yuv2rgba(golden::Y, golden::U, golden::V, golden::Y_STRIDE, golden::I420_UV_STRIDE, 1, golden::W,
+                    golden::H, false, rgba.data());
+   check("planar BT.601 BGRA pixels", rgba.data(), golden::BT601_BGRA, rgba.size());
+
+   std::vector<unsigned char> packed(sizeof(golden::I420));
+   Planes2I420(golden::Y, golden::U, golden::V, golden::Y_STRIDE, golden::I420_UV_STRIDE, 1, golden::W, golden::H,
+               packed.data());
+   check("planar Planes2I420", packed.data(), golden::I420, packed.size());
+   Planes2NV12(golden::Y, golden::U, golden::V, golden::Y_STRIDE, golden::I420_UV_STRIDE, 1, golden::W, golden::H,
+               packed.data());
+   check("planar Planes2NV12", packed.data(), golden::NV12, packed.size());
+}
+
+static void semi_planar_padded()
+//------------------------------
+{
+   const unsigned char* U = golden::UV;
+   const unsigned char* V = golden::UV + 1;
+   std::vector<unsigned char> rgba(golden::W*golden::H*4), grey(golden::W*golden::H);
+   check("NV12 layout", yuv_layout(U, V, 2) == YUVLayout::NV12);
+   check("NV12 RGBA", RSPlanes2RGBA(golden::Y, U, V, golden::Y_STRIDE, golden::NV_UV_STRIDE, 2, golden::W, golden::H,
+                                    true, rgba.data(), grey.data(), true, "test"));
+   check("NV12 RGBA pixels", rgba.data(), golden::RGBA, rgba.size());
+   check("NV12 RGBA weighted grey", grey.data(), golden::GREY_RGBA, grey.size());
+
+   check("NV21 layout", yuv_layout(V, U, 2) == YUVLayout::NV21);
+   check("NV21 RGBA", RSPlanes2RGBA(golden::Y, V, U, golden::Y_STRIDE, golden::NV_UV_STRIDE, 2, golden::W, golden::H,
+                                    true, rgba.data(), nullptr, false, "test"));
+   check("NV21 RGBA pixels", rgba.data(), golden::RGBA_NV21, rgba.size());
+
+   std::vector<unsigned char> packed(sizeof(golden::I420));
+   Planes2I420(golden::Y, U, V, golden::Y_STRIDE, golden::NV_UV_STRIDE, 2, golden::W, golden::H, packed.data());
+   check("NV12 Planes2I420", packed.data(), golden::I420, packed.size());
+   Planes2NV12(golden::Y, U, V, golden::Y_STRIDE, golden::NV_UV_STRIDE, 2, golden::W, golden::H, packed.data());
+   check("NV12 Planes2NV12", packed.data(), golden::NV12, packed.size());
+}
+
+static void strided_padded()
+//--------------------------
+{
+   check("strided layout", yuv_layout(golden::U_STRIDED, golden::V_STRIDED, golden::STRIDED_PIXEL_STRIDE) ==
+                           YUVLayout::STRIDED);
+   std::vector<unsigned char> rgba(golden::W*golden::H*4);
+   strided_yuv2rgba(golden::Y, golden::U_STRIDED, golden::V_STRIDED, golden::Y_STRIDE, golden::STRIDED_UV_STRIDE,
+                    golden::STRIDED_PIXEL_STRIDE, golden::W, golden::H, true, rgba.data());
+   check("strided BT.601 RGBA pixels", rgba.data(), golden::BT601_RGBA, rgba.size());
+
+   std::vector<unsigned char> packed(sizeof(golden::I420));
+   Planes2I420(golden::Y, golden::U_STRIDED, golden::V_STRIDED, golden::Y_STRIDE, golden::STRIDED_UV_STRIDE,
+               golden::STRIDED_PIXEL_STRIDE, golden::W, golden::H, packed.data());
+   check("strided Planes2I420", packed.data(), golden::I420, packed.size());
+   Planes2NV12(golden::Y, golden::U_STRIDED, golden::V_STRIDED, golden::Y_STRIDE, golden::STRIDED_UV_STRIDE,
+               golden::STRIDED_PIXEL_STRIDE, golden::W, golden::H, packed.data());
+   check("strided Planes2NV12", packed.data(), golden::NV12, packed.size());
+}
+
+static unsigned char clamp(int v) { return static_cast<unsigned char>((v < 0) ? 0 : ((v > 255) ? 255 : v)); }
+
+// A frame above PARALLEL_MIN_PIXELS, converted in parallel row bands, against the same planes converted two rows at a
+// time (each too small to be split).
+static void parallel_bands()
+//--------------------------
+{
+   const int w = 1920, h = 1080, yStride = 1920 + 64, uvStride = 960 + 32;
+   std::vector<unsigned char> Y(static_cast<size_t>(yStride*h)), U(static_cast<size_t>(uvStride*h/2)),
+                              V(static_cast<size_t>(uvStride*h/2));
+   unsigned seed = 12345;
+   for (std::vector<unsigned char>* plane : { &Y, &U, &V })
+      for (unsigned char& b : *plane) b = static_cast<unsigned char>((seed = seed*1103515245 + 12345) >> 16);
+   std::vector<unsigned char> rgba(static_cast<size_t>(w*h*4)), expected(rgba.size());
+   for (int y = 0; y < h; y += 2)
+      strided_yuv2rgba(&Y[static_cast<size_t>(y*yStride)], &U[static_cast<size_t>((y/2)*uvStride)],
+                       &V[static_cast<size_t>((y/2)*uvStride)], yStride, uvStride, 1, w, 2, true,
+                       &expected[static_cast<size_t>(y*w*4)]);
+   strided_yuv2rgba(Y.data(), U.data(), V.data(), yStride, uvStride, 1, w, h, true, rgba.data());
+   check("1080p BT.601 RGBA pixels", rgba.data(), expected.data(), rgba.size());
+
+   // RSPlanes2RGBA against yuvToRGBA4 pixel by pixel, on the same planes
+   for (int y = 0; y < h; y++)
+   {
+      for (int x = 0; x < w; x++)
+      {
+         const int Yv = Y[y*yStride + x] - 16, Uv = U[(y/2)*uvStride + x/2] - 128, Vv = V[(y/2)*uvStride + x/2] - 128;
+         unsigned char* p = &expected[static_cast<size_t>((y*w + x)*4)];
+         p[0] = clamp((Yv*298 + Vv*409 + 128) >> 8);
+         p[1] = clamp((Yv*298 - Uv*100 - Vv*208 + 128) >> 8);
+         p[2] = clamp((Yv*298 + Uv*516 + 128) >> 8);
+         p[3] = 255;
+      }
+   }
+   check("1080p RGBA", RSPlanes2RGBA(Y.data(), U.data(), V.data(), yStride, uvStride, 1, w, h, true, rgba.data(),
+                                     nullptr, false, "test"));
+   check("1080p RGBA pixels", rgba.data(), expected.data(), rgba.size());
+}
+
+static void invalid()
+//-------------------
+{
+   unsigned char out[64];
+   check("odd width rejected", ! RSPlanes2RGBA(golden::Y, golden::U, golden::V, golden::Y_STRIDE,
+                                               golden::I420_UV_STRIDE, 1, 7, 4, true, out, nullptr, false, "test"));
+   check("short row stride rejected", ! RSPlanes2RGBA(golden::Y, golden::U, golden::V, 4, golden::I420_UV_STRIDE, 1,
+                                                      golden::W, golden::H, true, out, nullptr, false, "test"));
+}
+
+int main(int argc, char** argv)
+//-----------------------------
+{
+   planar_padded();
+   semi_planar_padded();
+   strided_padded();
+   parallel_bands();
+   invalid();
+   if (failures > 0)
+      std::fprintf(stderr, "%d failures\n", failures);
+   return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+// Generated by make_yuv_golden.py, do not edit.
+#ifndef _MAR_TEST_YUV_GOLDEN_H
+#define _MAR_TEST_YUV_GOLDEN_H
+
+namespace golden
+{
+   constexpr int W = 8, H = 4;
+   constexpr int Y_STRIDE = 10, I420_UV_STRIDE = 6, NV_UV_STRIDE = 10;
+   constexpr int STRIDED_UV_STRIDE = 14, STRIDED_PIXEL_STRIDE = 3;
+
+   // Luma rows padded to Y_STRIDE
+   const unsigned char Y[] =
+   {
+        0,  16,  17,  64, 128, 200, 235, 255, 238, 238, 255, 235, 180, 120,  90,  30,
+       16,   0, 238, 238,  40,  41, 100, 101, 160, 161, 220, 221, 238, 238,  16, 128,
+      235, 255,   0,  64, 192, 250, 238, 238,
+   };
+
+   // Planar chroma (pixelStride 1) rows padded to I420_UV_STRIDE
+   const unsigned char U[] =
+   {
+        0, 128, 255,  90, 238, 238,  16, 240, 128,  60, 238, 238,
+   };
+
+   const unsigned char V[] =
+   {
+      255, 128,   0, 200, 238, 238, 240,  16, 100, 128, 238, 238,
+   };
+
+   // The same chroma interleaved U first (pixelStride 2) in rows padded to NV_UV_STRIDE, read as NV21 from UV + 1
+   const unsigned char UV[] =
+   {
+        0, 255, 128, 128, 255,   0,  90, 200, 238, 238,  16, 240, 240,  16, 128, 100,
+       60, 128, 238, 238,
+   };
+
+   // The same chroma with STRIDED_PIXEL_STRIDE in rows padded to STRIDED_UV_STRIDE
+   const unsigned char U_STRIDED[] =
+   {
+        0, 238, 238, 128, 238, 238, 255, 238, 238,  90, 238, 238, 238, 238,  16, 238,
+      238, 240, 238, 238, 128, 238, 238,  60, 238, 238, 238, 238,
+   };
+
+   const unsigned char V_STRIDED[] =
+   {
+      255, 238, 238, 128, 238, 238,   0, 238, 238, 200, 238, 238, 238, 238, 240, 238,
+      238,  16, 238, 238, 100, 238, 238, 128, 238, 238, 238, 238,
+   };
+
+   // RSPlanes2RGBA of Y, U and V
+   const unsigned char RGBA[] =
+   {
+      184,   0,   0, 255, 203,   0,   0, 255,   1,   1,   1, 255,  56,  56,  56, 255,
+        0, 185, 255, 255,  10, 255, 255, 255, 255, 211, 178, 255, 255, 235, 202, 255,
+      255, 225,  20, 255, 255, 202,   0, 255, 191, 191, 191, 255, 121, 121, 121, 255,
+        0, 141, 255, 255,   0,  71, 255, 255, 115,   0,   0, 255,  96,   0,   0, 255,
+      207,   0,   0, 255, 208,   0,   0, 255,   0, 145, 255, 255,   0, 146, 255, 255,
+      123, 190, 168, 255, 124, 192, 169, 255, 237, 255, 100, 255, 239, 255, 102, 255,
+      179,   0,   0, 255, 255,  83,   0, 255,  76, 255, 255, 255,  99, 255, 255, 255,
+        0,   4,   0, 255,  11,  79,  56, 255, 205, 231,  68, 255, 255, 255, 135, 255,
+   };
+
+   const unsigned char BGRA[] =
+   {
+        0,   0, 184, 255,   0,   0, 203, 255,   1,   1,   1, 255,  56,  56,  56, 255,
+      255, 185,   0, 255, 255, 255,  10, 255, 178, 211, 255, 255, 202, 235, 255, 255,
+       20, 225, 255, 255,   0, 202, 255, 255, 191, 191, 191, 255, 121, 121, 121, 255,
+      255, 141,   0, 255, 255,  71,   0, 255,   0,   0, 115, 255,   0,   0,  96, 255,
+        0,   0, 207, 255,   0,   0, 208, 255, 255, 145,   0, 255, 255, 146,   0, 255,
+      168, 190, 123, 255, 169, 192, 124, 255, 100, 255, 237, 255, 102, 255, 239, 255,
+        0,   0, 179, 255,   0,  83, 255, 255, 255, 255,  76, 255, 255, 255,  99, 255,
+        0,   4,   0, 255,  56,  79,  11, 255,  68, 231, 205, 255, 135, 255, 255, 255,
+   };
+
+   // Weighted grey (YUVtoRGBAGrey, YUVtoBGRAGrey)
+   const unsigned char GREY_RGBA[] =
+   {
+       55,  60,   0,  56, 137, 181, 220, 237, 210, 194, 191, 121, 111,  70,  34,  28,
+       61,  62, 114, 114, 167, 169, 231, 232,  53, 124, 201, 208,   2,  56, 204, 241,
+   };
+
+   const unsigned char GREY_BGRA[] =
+   {
+       20,  23,   0,  56, 184, 227, 206, 227, 167, 147, 191, 121, 159, 117,  13,  10,
+       23,  23, 161, 161, 175, 177, 206, 207,  20,  77, 234, 237,   2,  64, 179, 219,
+   };
+
+   // RSPlanes2RGBA of the UV buffer read as NV21, ie with U and V swapped
+   const unsigned char RGBA_NV21[] =
+   {
+        0,  36, 237, 255,   0,  54, 255, 255,   1,   1,   1, 255,  56,  56,  56, 255,
+      255,  77,   0, 255, 255, 161,   0, 255, 194, 255, 255, 255, 218, 255, 255, 255,
+       74, 255, 255, 255,  50, 255, 255, 255, 191, 191, 191, 255, 121, 121, 121, 255,
+      255,  33,   0, 255, 219,   0,   0, 255,   0,   3, 145, 255,   0,   0, 127, 255,
+        0,  75, 254, 255,   0,  76, 255, 255, 255,  51,   0, 255, 255,  52,   0, 255,
+      168, 179, 111, 255, 169, 180, 112, 255, 129, 255, 237, 255, 130, 255, 239, 255,
+        0,  47, 226, 255,   0, 178, 255, 255, 255, 208,  29, 255, 255, 231,  52, 255,
+        0,   0,   0, 255,  56,  67,   0, 255,  96, 255, 205, 255, 164, 255, 255, 255,
+   };
+
+   // cv::cvtColor(COLOR_YUV2RGBA_I420), for strided_yuv2rgba
+   const unsigned char BT601_RGBA[] =
+   {
+      203,   0,   0, 255, 203,   0,   0, 255,   1,   1,   1, 255,  56,  56,  56, 255,
+        0, 185, 255, 255,  10, 255, 255, 255, 255, 211, 178, 255, 255, 235, 202, 255,
+      255, 225,  20, 255, 255, 202,   0, 255, 191, 191, 191, 255, 121, 121, 121, 255,
+        0, 141, 255, 255,   0,  71, 255, 255, 115,   0,   0, 255, 115,   0,   0, 255,
+      207,   0,   0, 255, 208,   0,   0, 255,   0, 145, 255, 255,   0, 146, 255, 255,
+      123, 190, 168, 255, 124, 192, 169, 255, 237, 255, 100, 255, 239, 255, 101, 255,
+      179,   0,   0, 255, 255,  83,   0, 255,  76, 255, 255, 255,  99, 255, 255, 255,
+        0,  23,   0, 255,  11,  79,  56, 255, 205, 231,  68, 255, 255, 255, 135, 255,
+   };
+
+   const unsigned char BT601_BGRA[] =
+   {
+        0,   0, 203, 255,   0,   0, 203, 255,   1,   1,   1, 255,  56,  56,  56, 255,
+      255, 185,   0, 255, 255, 255,  10, 255, 178, 211, 255, 255, 202, 235, 255, 255,
+       20, 225, 255, 255,   0, 202, 255, 255, 191, 191, 191, 255, 121, 121, 121, 255,
+      255, 141,   0, 255, 255,  71,   0, 255,   0,   0, 115, 255,   0,   0, 115, 255,
+        0,   0, 207, 255,   0,   0, 208, 255, 255, 145,   0, 255, 255, 146,   0, 255,
+      168, 190, 123, 255, 169, 192, 124, 255, 100, 255, 237, 255, 101, 255, 239, 255,
+        0,   0, 179, 255,   0,  83, 255, 255, 255, 255,  76, 255, 255, 255,  99, 255,
+        0,  23,   0, 255,  56,  79,  11, 255,  68, 231, 205, 255, 135, 255, 255, 255,
+   };
+
+   // Planes2I420
+   const unsigned char I420[] =
+   {
+        0,  16,  17,  64, 128, 200, 235, 255, 255, 235, 180, 120,  90,  30,  16,   0,
+       40,  41, 100, 101, 160, 161, 220, 221,  16, 128, 235, 255,   0,  64, 192, 250,
+        0, 128, 255,  90,  16, 240, 128,  60, 255, 128,   0, 200, 240,  16, 100, 128,
+   };
+
+   // Planes2NV12
+   const unsigned char NV12[] =
+   {
+        0,  16,  17,  64, 128, 200, 235, 255, 255, 235, 180, 120,  90,  30,  16,   0,
+       40,  41, 100, 101, 160, 161, 220, 221,  16, 128, 235, 255,   0,  64, 192, 250,
+        0, 255, 128, 128, 255,   0,  90, 200,  16, 240, 240,  16, 128, 100,  60, 128,
+   };
+}
+#endif
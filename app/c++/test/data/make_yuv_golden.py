@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# Writes YUVGolden.h, the golden YUV_420_888 frames and their conversions, computed here independently of the C++
+# kernels: the RenderScript ones from a transcription of app/rs/YUV2RGBA.rs and the OpenCV ones by cvtColor (so
+# opencv-python is needed). Run from this directory:
+#    ./make_yuv_golden.py > YUVGolden.h
+import cv2
+import numpy
+
+W, H = 8, 4
+CW, CH = W // 2, H // 2
+PAD = 0xEE  # Row padding, never read by a correct conversion
+
+Y = [0, 16, 17, 64, 128, 200, 235, 255,
+     255, 235, 180, 120, 90, 30, 16, 0,
+     40, 41, 100, 101, 160, 161, 220, 221,
+     16, 128, 235, 255, 0, 64, 192, 250]
+U = [0, 128, 255, 90,
+     16, 240, 128, 60]
+V = [255, 128, 0, 200,
+     240, 16, 100, 128]
+
+Y_STRIDE, I420_UV_STRIDE, NV_UV_STRIDE, STRIDED_UV_STRIDE = 10, 6, 10, 14
+STRIDED_PIXEL_STRIDE = 3
+
+def clamp(v):
+   return 0 if v < 0 else (255 if v > 255 else v)
+
+def rgba4(y, u, v):  # yuvToRGBA4
+   y, u, v = y - 16, u - 128, v - 128
+   return [clamp((y*298 + v*409 + 128) >> 8), clamp((y*298 - u*100 - v*208 + 128) >> 8),
+           clamp((y*298 + u*516 + 128) >> 8), 255]
+
+def convert(u_plane, v_plane, is_rgba):
+   out = []
+   for y in range(H):
+      for x in range(W):
+         p = rgba4(Y[y*W + x], u_plane[(y//2)*CW + x//2], v_plane[(y//2)*CW + x//2])
+         out += p if is_rgba else [p[2], p[1], p[0], p[3]]
+   return out
+
+def weighted(out):  # The grey kernels weight the first three output bytes, in double as the C++ kernel does
+   return [int(0.299*out[i] + 0.587*out[i + 1] + 0.114*out[i + 2]) for i in range(0, len(out), 4)]
+
+def cv_convert(code):  # cvtColor of the packed I420 frame
+   i420 = numpy.array(Y + U + V, dtype=numpy.uint8).reshape(H*3 // 2, W)
+   return [int(b) for b in cv2.cvtColor(i420, code).flatten()]
+
+def padded(plane, w, stride):
+   out = []
+   for r in range(len(plane) // w):
+      out += plane[r*w:(r + 1)*w] + [PAD]*(stride - w)
+   return out
+
+def interleaved(first, second):
+   out = []
+   for r in range(CH):
+      for x in range(CW):
+         out += [first[r*CW + x], second[r*CW + x]]
+      out += [PAD]*(NV_UV_STRIDE - 2*CW)
+   return out
+
+def strided(plane):  # Each chroma sample followed by STRIDED_PIXEL_STRIDE - 1 padding bytes
+   out = []
+   for r in range(CH):
+      for x in range(CW):
+         out += [plane[r*CW + x]] + [PAD]*(STRIDED_PIXEL_STRIDE - 1)
+      out += [PAD]*(STRIDED_UV_STRIDE - STRIDED_PIXEL_STRIDE*CW)
+   return out
+
+def array(name, values, comment):
+   lines = (["   // " + comment] if comment else []) + ["   const unsigned char %s[] =" % name, "   {"]
+   for i in range(0, len(values), 16):
+      lines.append("      " + ", ".join("%3d" % v for v in values[i:i + 16]) + ",")
+   lines.append("   };")
+   return "\n".join(lines)
+
+rgba, bgra = convert(U, V, True), convert(U, V, False)
+nv12 = Y[:]
+for r in range(CH):
+   for x in range(CW):
+      nv12 += [U[r*CW + x], V[r*CW + x]]
+
+print("// Generated by make_yuv_golden.py, do not edit.")
+print("#ifndef _MAR_TEST_YUV_GOLDEN_H")
+print("#define _MAR_TEST_YUV_GOLDEN_H")
+print()
+print("namespace golden")
+print("{")
+print("   constexpr int W = %d, H = %d;" % (W, H))
+print("   constexpr int Y_STRIDE = %d, I420_UV_STRIDE = %d, NV_UV_STRIDE = %d;" % (Y_STRIDE, I420_UV_STRIDE,
+                                                                                  NV_UV_STRIDE))
+print("   constexpr int STRIDED_UV_STRIDE = %d, STRIDED_PIXEL_STRIDE = %d;" % (STRIDED_UV_STRIDE, STRIDED_PIXEL_STRIDE))
+print()
+sections = [
+   ("Y", padded(Y, W, Y_STRIDE), "Luma rows padded to Y_STRIDE"),
+   ("U", padded(U, CW, I420_UV_STRIDE), "Planar chroma (pixelStride 1) rows padded to I420_UV_STRIDE"),
+   ("V", padded(V, CW, I420_UV_STRIDE), ""),
+   ("UV", interleaved(U, V), "The same chroma interleaved U first (pixelStride 2) in rows padded to NV_UV_STRIDE, "
+                             "read as NV21 from UV + 1"),
+   ("U_STRIDED", strided(U), "The same chroma with STRIDED_PIXEL_STRIDE in rows padded to STRIDED_UV_STRIDE"),
+   ("V_STRIDED", strided(V), ""),
+   ("RGBA", rgba, "RSPlanes2RGBA of Y, U and V"),
+   ("BGRA", bgra, ""),
+   ("GREY_RGBA", weighted(rgba), "Weighted grey (YUVtoRGBAGrey, YUVtoBGRAGrey)"),
+   ("GREY_BGRA", weighted(bgra), ""),
+   ("RGBA_NV21", convert(V, U, True), "RSPlanes2RGBA of the UV buffer read as NV21, ie with U and V swapped"),
+   ("BT601_RGBA", cv_convert(cv2.COLOR_YUV2RGBA_I420), "cv::cvtColor(COLOR_YUV2RGBA_I420), for strided_yuv2rgba"),
+   ("BT601_BGRA", cv_convert(cv2.COLOR_YUV2BGRA_I420), ""),
+   ("I420", Y + U + V, "Planes2I420"),
+   ("NV12", nv12, "Planes2NV12"),
+]
+print("\n\n".join(array(name, values, comment) for name, values, comment in sections))
+print("}")
+print("#endif")
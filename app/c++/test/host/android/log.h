@@ -0,0 +1,33 @@
+#ifndef _MAR_TEST_HOST_ANDROID_LOG_H
+#define _MAR_TEST_HOST_ANDROID_LOG_H
+
+// Host stand in for the NDK's android/log.h, printing to stderr.
+#include <cstdio>
+#include <cstdlib>
+
+enum android_LogPriority
+{
+   ANDROID_LOG_UNKNOWN = 0, ANDROID_LOG_DEFAULT, ANDROID_LOG_VERBOSE, ANDROID_LOG_DEBUG, ANDROID_LOG_INFO,
+   ANDROID_LOG_WARN, ANDROID_LOG_ERROR, ANDROID_LOG_FATAL, ANDROID_LOG_SILENT
+};
+
+template <typename... Args>
+inline int __android_log_print(int priority, const char* tag, const char* fmt, Args... args)
+{
+   std::fprintf(stderr, "%s: ", tag);
+   std::fprintf(stderr, fmt, args...);
+   return std::fprintf(stderr, "\n");
+}
+
+inline int __android_log_print(int priority, const char* tag, const char* msg)
+{
+   return std::fprintf(stderr, "%s: %s\n", tag, msg);
+}
+
+template <typename... Args>
+[[noreturn]] inline void __android_log_assert(const char* cond, const char* tag, const char* fmt, Args... args)
+{
+   __android_log_print(ANDROID_LOG_FATAL, tag, fmt, args...);
+   std::abort();
+}
+#endif
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+// NV12 camera frame: full resolution luma (R8) and half resolution interleaved CbCr (R8G8)
+layout(binding = 2) uniform sampler2D lumaSampler;
+layout(binding = 3) uniform sampler2D chromaSampler;
+
+// BT.601 video range, the coefficients vision::YUV2RGBA (OpenCV) uses for the CPU conversion
+const mat3 yuv2rgb = mat3(1.164,  1.164, 1.164,
+                          0.0,   -0.391, 2.018,
+                          1.596, -0.813, 0.0);
+
+void main()
+{
+    vec3 yuv = vec3(texture(lumaSampler, inTexCoord).r - 16.0/255.0,
+                    texture(chromaSampler, inTexCoord).rg - vec2(128.0/255.0));
+    outColor = vec4(clamp(yuv2rgb * yuv, 0.0, 1.0), 1.0);
+}
@@ -40,6 +40,7 @@ class MainActivity : AppCompatActivity()
       const val WANT_HIGH_SPEED = false // Not working at the moment as there does not appear to be
                                        // any way to send the frames from the high speed API to
                                        // anything other than a Surface.
+      const val NATIVE_CAMERA = false // Acquire frames with an NDK AImageReader instead of the Java ImageReader
 
 //      var dialog : MessageDialog? = null
 //
@@ -177,7 +178,7 @@ class MainActivity : AppCompatActivity()
    {
       super.onCreate(savedInstanceState)
       setContentView(R.layout.activity_main)
-      MAR.initialize(packageName, this.assets)
+      MAR.initialize(packageName, this.assets, cacheDir.absolutePath)
       checkPermissions()
    }
 
@@ -244,7 +245,7 @@ class MainActivity : AppCompatActivity()
          }
          val cameraList = listOf(cid0, cid1, cid2)
          var results = MAR.initialize(this, cameraList, DEFAULT_QUEUE_SIZE, WANT_HIGH_SPEED,
-                                      isRenderscript.isChecked)
+                                      isRenderscript.isChecked, NATIVE_CAMERA)
          cid0 = checkResults(cid0, size0, 0, results)
          if (cid0 == null)
             return@setOnClickListener
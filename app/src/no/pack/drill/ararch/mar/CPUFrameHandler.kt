@@ -16,10 +16,12 @@ import java.io.FileOutputStream
 import java.nio.ByteBuffer
 
 class CPUFrameHandler(val context: Context, private val hardwareCamera: HardwareCamera, private val inputFormat: Int,
-                      private val colorFormat: ColorFormats, private val isGrey: Boolean = false):
+                      private val colorFormat: ColorFormats, private val isGrey: Boolean = false,
+                      private val conversion: YUVConversions = YUVConversions.OPENCV):
    ImageReader.OnImageAvailableListener, SurfaceProvidable
 {
    private val cameraId: String = hardwareCamera.cameraId
+   private val cameraHandle: Int = hardwareCamera.handle
    val cameraWidth: Int = hardwareCamera.width
    val cameraHeight: Int = hardwareCamera.height
    private var lastFrameTime: Long = 0
@@ -71,45 +73,14 @@ class CPUFrameHandler(val context: Context, private val hardwareCamera: Hardware
          val planes = image.planes
          val w = image.width
          val h = image.height
-   //         val chromaPixelStride = planes[1].pixelStride
-         if (inputFormat == ImageFormat.YUV_420_888) // && (chromaPixelStride != 2) )
-         {
-            val YUV = ByteArray(w * (h + h / 2))
-            val Y = planes[0].buffer
-            val U = planes[1].buffer
-            val V = planes[2].buffer
-
-            Y.get(YUV, 0, w * h)
-
-            val chromaRowStride = planes[1].rowStride
-            val chromaRowPadding = chromaRowStride - w / 2
-
-            var offset = w * h
-            if (chromaRowPadding == 0)
-            {
-               U.get(YUV, offset, w * h / 4)
-               offset += (w*h)/4
-               V.get(YUV, offset, w * h / 4)
-            }
-            else
-            {
-               for (i in 0 until h / 2)
-               {
-                  U.get(YUV, offset, w / 2)
-                  offset += w / 2
-                  if (i < h / 2 - 1)
-                     U.position(U.position() + chromaRowPadding)
-
-               }
-               for (i in 0 until h / 2)
-               {
-                  V.get(YUV, offset, w / 2)
-                  offset += w / 2
-                  if (i < h / 2 - 1)
-                     V.position(V.position() + chromaRowPadding)
-               }
-            }
-
+         val stereoBatch = hardwareCamera.stereoBatch
+         if ( (stereoBatch != null) && (inputFormat == ImageFormat.YUV_420_888) )
+         { // Converted natively once paired with the other stereo camera's frame
+            if (! stereoBatch.submit(hardwareCamera, image, ts))
+               Log.e(TAG, "Error submitting stereo frame for camera $cameraId")
+         }
+         else if ( (inputFormat == ImageFormat.YUV_420_888) || (inputFormat == ImageFormat.NV21) )
+         { // Planes are converted in place using their strides (I420, NV12 or NV21 chroma layouts)
             val greySize = if (isGrey) w*h else 0
             val rgbaSize = w*h*4
             val rgbaData : ByteArray
@@ -124,67 +95,17 @@ class CPUFrameHandler(val context: Context, private val hardwareCamera: Hardware
                Log.e(TAG, "CPUFrameHandler out of memory for camera id $cameraId  " +
                      " rear facing = ${hardwareCamera.isRearFacing} (${e.message}). " +
                      "Attempting to clear queue")
-               hardwareCamera.clearQueue(cameraId)
+               hardwareCamera.clearQueue(cameraHandle)
                return
             }
 
 //            Log.i(TAG, "Enqueue Time Java CPU: thread ${Thread.currentThread().id} for camera $cameraId ${hardwareCamera.isRearFacing}: ${((ts - lastFrameTime)/1000000)}ms")
-            if (! hardwareCamera.enqueueYUV(cameraId, YUV, w, h, colorFormat==ColorFormats.RGBA,
-                                            ts, rgbaSize, rgbaData, greySize, greyData))
+            if (! hardwareCamera.enqueuePlanes(cameraHandle, planes[0].buffer, planes[1].buffer, planes[2].buffer,
+                                               planes[0].rowStride, planes[1].rowStride, planes[1].pixelStride,
+                                               w, h, colorFormat==ColorFormats.RGBA, conversion.ordinal, ts,
+                                               rgbaSize, rgbaData, greySize, greyData))
                Log.e(TAG, "Error enqueueing frame for camera $cameraId (rear facing ${hardwareCamera.isRearFacing})")
-
-   //            CPUConvertYUV(YUV, w, h, colorFormat==ColorFormats.RGBA, rgbaData, greyData)
    //           if (DEBUG_SAVE_FRAME) saveCooked(cameraId, rgbaData, cameraWidth, cameraHeight)
-   //            hardwareCamera.enqueue(cameraId, colorFormat==ColorFormats.RGBA, ts,
-   //                                   rgbaSize, rgbaData, greySize, greyData)
-
-   //         val yuv_mat = Mat(h + h / 2, w, CvType.CV_8UC1)
-   //         yuv_mat.put(0, 0, yuv_bytes)
-   //         Imgproc.cvtColor(yuv_mat, mRgba, Imgproc.COLOR_YUV2RGBA_I420, 4)
-         }
-         else if (inputFormat == ImageFormat.NV21)
-         { // Chroma channels are interleaved
-            val Y = planes[0].buffer
-            val UV1 = planes[1].buffer
-            val UV2 = planes[2].buffer
-            val greySize = if (isGrey) w*h else 0
-            val rgbaSize = greySize*4
-            var rgbaData: ByteArray? = null
-            var greyData: ByteArray? = null
-            try
-            {
-               rgbaData = ByteArray(rgbaSize)
-               greyData = if (isGrey) ByteArray(greySize) else null
-            }
-            catch (e: OutOfMemoryError)
-            {
-               Log.e(TAG, "CPUFrameHandler out of memory for camera id $cameraId  " +
-                     " rear facing = ${hardwareCamera.isRearFacing} (${e.message}). " +
-                     "Attempting to clear queue")
-               hardwareCamera.clearQueue(cameraId)
-               return
-            }
-            image.close()
-            image = null
-            CPUConvertNV21(Y, UV1, UV2, w, h, colorFormat==ColorFormats.RGBA, rgbaData, greyData)
-            hardwareCamera.enqueue(cameraId, colorFormat==ColorFormats.RGBA, ts,
-                                   rgbaSize, rgbaData, greySize, greyData)
-
-   //         val y_mat = Mat(h, w, CvType.CV_8UC1, y_plane)
-   //         val uv_mat1 = Mat(h / 2, w / 2, CvType.CV_8UC2, uv_plane1)
-   //         val uv_mat2 = Mat(h / 2, w / 2, CvType.CV_8UC2, uv_plane2)
-   //         val addr_diff = uv_mat2.dataAddr() - uv_mat1.dataAddr()
-   //         if (addr_diff > 0)
-   //         {
-   //            assert(addr_diff == 1L)
-   //            Imgproc.cvtColorTwoPlane(y_mat, uv_mat1, mRgba, Imgproc.COLOR_YUV2RGBA_NV12)
-   //         }
-   //         else
-   //         {
-   //            assert(addr_diff == -1)
-   //            Imgproc.cvtColorTwoPlane(y_mat, uv_mat2, mRgba, Imgproc.COLOR_YUV2RGBA_NV21)
-   //         }
-   //         return mRgba
          }
          else
             Log.e(TAG, "Invalid or mismatched image format $inputFormat in CPUFrameHandler.onImageAvailable")
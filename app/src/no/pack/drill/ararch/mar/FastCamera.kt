@@ -50,6 +50,8 @@ class FastCamera(context: Context, id: String, colorFormat: ColorFormats,
    override fun startPreview(context: Context, size: Size, callback: CameraPreviewable): Boolean
    //-------------------------------------------------------------------------
    {
+      if (isNativeAcquisition)
+         return startNativePreview(size, callback)
       if (manager == null)
       {
          try
@@ -64,7 +66,7 @@ class FastCamera(context: Context, id: String, colorFormat: ColorFormats,
       previewCallback = callback
       greySize = cameraWidth * cameraHeight
       rgbaSize = greySize * 4
-      setPreviewSize(id, cameraWidth, cameraHeight)
+      setPreviewSize(handle, cameraWidth, cameraHeight)
       isConfigured.set(false)
       var isLock = false
       stopping = false
@@ -158,7 +160,9 @@ class FastCamera(context: Context, id: String, colorFormat: ColorFormats,
          }
          if (previewFrameHandler == null)
          {
-            cpuFrameHandler = CPUFrameHandler(context, this, inputFormat, colorFormat, false)
+            // A failed RenderScript handler falls back to the native kernels with the same numerics
+            cpuFrameHandler = CPUFrameHandler(context, this, inputFormat, colorFormat, false,
+                                              if (renderscript != null) YUVConversions.RENDERSCRIPT else yuvConversion)
             if (cpuFrameHandler?.good!!)
             {
                if (renderscript != null)
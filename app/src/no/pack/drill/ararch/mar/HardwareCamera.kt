@@ -13,11 +13,15 @@ import android.util.Log
 import android.util.Range
 import android.util.Size
 import android.view.Surface
+import java.nio.ByteBuffer
 import java.util.concurrent.Semaphore
 import java.util.concurrent.atomic.AtomicBoolean
 
 enum class ColorFormats{ RGBA, BGRA }
 
+// Numerics of the CPU YUV conversion: OpenCV's, or the same as the RenderScript YUV2RGBA kernels (vision::YUVConversion)
+enum class YUVConversions { OPENCV, RENDERSCRIPT }
+
 interface CameraPreviewable
 {
    fun onPreviewResult(cameraId: String, isPreviewing: Boolean, message: String)
@@ -47,15 +51,28 @@ abstract class HardwareCamera(protected val context: Context, protected val id:
 {
    var manager: CameraManager? = context.getSystemService(Context.CAMERA_SERVICE) as CameraManager?
 
-   external fun addCamera(cameraId: String, queueSize: Int, isRearFacing: Boolean): Boolean
-   external fun setPreviewSize(id: String, w: Int, h: Int): Boolean
-   external fun enqueue(id: String, isRGBA: Boolean, timestamp: Long,
+   // addCamera returns the native camera handle passed to the other calls (-1 on error)
+   external fun addCamera(cameraId: String, queueSize: Int, isRearFacing: Boolean): Int
+   external fun setPreviewSize(handle: Int, w: Int, h: Int): Boolean
+   external fun setOptics(handle: Int, focalLength: Float, sensorWidth: Float, sensorHeight: Float,
+                          sensorOrientation: Int): Boolean
+   external fun enqueue(handle: Int, isRGBA: Boolean, timestamp: Long,
                         rgbaSize: Int, rgbaData: ByteArray,
                         greySize: Int, greyData: ByteArray?): Boolean
-   external fun enqueueYUV(cameraId: String, YUV: ByteArray, w: Int, h: Int, isRGBA: Boolean,
+   external fun enqueueYUV(handle: Int, YUV: ByteArray, w: Int, h: Int, isRGBA: Boolean,
                            timestamp: Long, rgbaSize: Int, rgbaData: ByteArray,
                         greySize: Int, greyData: ByteArray?): Boolean
-   external fun clearQueue(cameraId: String)  : Boolean
+   // Image.Plane buffers converted in place using their strides (no packing into a YUV array)
+   external fun enqueuePlanes(handle: Int, Y: ByteBuffer, U: ByteBuffer, V: ByteBuffer, yRowStride: Int,
+                              uvRowStride: Int, uvPixelStride: Int, w: Int, h: Int, isRGBA: Boolean,
+                              conversion: Int, timestamp: Long, rgbaSize: Int, rgbaData: ByteArray,
+                              greySize: Int, greyData: ByteArray?): Boolean
+   external fun clearQueue(handle: Int)  : Boolean
+   // Direct buffers (kept referenced while the camera runs) that frames are written to for MAR.enqueueBatch
+   external fun registerFrameBuffers(handle: Int, buffers: Array<ByteBuffer>): Boolean
+   // Packs Image.Plane buffers as I420 into registered buffer i
+   external fun writeFrameBuffer(handle: Int, i: Int, Y: ByteBuffer, U: ByteBuffer, V: ByteBuffer, yRowStride: Int,
+                                 uvRowStride: Int, uvPixelStride: Int, w: Int, h: Int): Boolean
    external fun inFlight(): Int
 
    protected var cameraDevice: CameraDevice? = null
@@ -73,6 +90,14 @@ abstract class HardwareCamera(protected val context: Context, protected val id:
    val cameraId: String
       get() = id
    var queueSize: Int = 0
+   // Numerics of the CPU frame handler conversion (RENDERSCRIPT matches the RenderScript handler without RenderScript)
+   var yuvConversion: YUVConversions = YUVConversions.OPENCV
+   var handle: Int = -1
+      private set
+   // Set for the two rear cameras of a stereo pair, whose frames are then submitted together
+   var stereoBatch: StereoBatch? = null
+   // Frames are acquired natively with an NDK AImageReader (MAR.startNativeCamera) instead of a Java frame handler
+   var isNativeAcquisition: Boolean = false
 
    protected var isConfigured: AtomicBoolean = AtomicBoolean(false)
 //      private set
@@ -180,12 +205,56 @@ abstract class HardwareCamera(protected val context: Context, protected val id:
 
    abstract fun getHandler(): Handler?
 
-   fun stopPreview() { stopping = true }
+   fun stopPreview()
+   //---------------
+   {
+      stopping = true
+      if (isNativeAcquisition)
+         MAR.stopNativeCamera(handle)
+   }
+
+   // startPreview for isNativeAcquisition, the camera is opened and its frames enqueued by CppHardwareCamera
+   protected fun startNativePreview(size: Size, callback: CameraPreviewable): Boolean
+   //------------------------------------------------------------------------------
+   {
+      cameraWidth = size.width
+      cameraHeight = size.height
+      previewCallback = callback
+      stopping = false
+      val isOK = MAR.startNativeCamera(handle, cameraWidth, cameraHeight, colorFormat == ColorFormats.RGBA, false)
+      isConfigured.set(isOK)
+      if (! isOK)
+         Log.e(TAG, "Could not start native acquisition for camera $id")
+      callback.onPreviewResult(id, isOK, if (isOK) "OK" else "Could not start native acquisition for camera $id")
+      return isOK
+   }
 
    fun initialize(queueSize: Int, isRearFacing: Boolean) : Boolean
    {
       this.queueSize = queueSize
-      return addCamera(id, queueSize, isRearFacing)
+      handle = addCamera(id, queueSize, isRearFacing)
+      if (handle >= 0)
+         setCameraOptics()
+      return handle >= 0
+   }
+
+   // Lens and sensor geometry used natively to reproject overlays with the gyro (skipped if unavailable)
+   private fun setCameraOptics()
+   //---------------------------
+   {
+      try
+      {
+         val characteristics = manager?.getCameraCharacteristics(id) ?: return
+         val focalLengths = characteristics.get(CameraCharacteristics.LENS_INFO_AVAILABLE_FOCAL_LENGTHS)
+         val sensorSize = characteristics.get(CameraCharacteristics.SENSOR_INFO_PHYSICAL_SIZE)
+         val orientation = characteristics.get(CameraCharacteristics.SENSOR_ORIENTATION) ?: 90
+         if ( (focalLengths != null) && (focalLengths.isNotEmpty()) && (sensorSize != null) )
+            setOptics(handle, focalLengths[0], sensorSize.width, sensorSize.height, orientation)
+      }
+      catch (e: java.lang.Exception)
+      {
+         Log.w(TAG, "Could not read the optics of camera $id", e)
+      }
    }
 
    open fun stopCamera()
@@ -32,7 +32,8 @@ object MAR
       }
    }
 
-   external fun initialize(mainPackageName: String, assman: AssetManager)
+   // cacheDir is the app's cache directory (Context.getCacheDir), where the Vulkan pipeline cache is kept
+   external fun initialize(mainPackageName: String, assman: AssetManager, cacheDir: String)
    fun addSensor(sensor: Int): Boolean { return addSensors(IntArray(1) { sensor }) }
    external fun addSensors(sensors: IntArray): Boolean
    external fun allocateBuffer(size: Int): ByteBuffer
@@ -41,6 +42,16 @@ object MAR
    external fun startMAR(rendererType: Int, aprilTagsOnOff: Boolean, faceRecogOnOff: Boolean): Boolean
    external fun stopMAR()
    external fun getStats(): String
+   external fun startRecording(filename: String): Boolean
+   external fun stopRecording()
+   external fun startReplay(filename: String, speed: Float, loop: Boolean): Boolean
+   external fun stopReplay()
+   // Native AImageReader acquisition for a camera added with HardwareCamera.addCamera (replaces its Java ImageReader)
+   external fun startNativeCamera(handle: Int, width: Int, height: Int, isRGBA: Boolean, hasMono: Boolean): Boolean
+   external fun stopNativeCamera(handle: Int)
+   // Frame i is in registered buffer buffers[i] of camera handles[i] (see HardwareCamera.registerFrameBuffers)
+   external fun enqueueBatch(count: Int, handles: IntArray, buffers: IntArray, timestamps: LongArray,
+                             isRGBA: Boolean, hasMono: Boolean, isStereoPair: Boolean): Int
 
    private var cameras: MutableMap<String, HardwareCamera> = HashMap()
    private var cameraThreads: MutableMap<String, Thread> = HashMap()
@@ -115,8 +126,10 @@ object MAR
 
    val renderscripts: MutableList<RenderScript?> = mutableListOf()
 
+   // isNativeCamera acquires frames with an NDK AImageReader (startNativeCamera) instead of a Java ImageReader
    fun initialize(context: Context, cameraIds: List<String?>, queueSize: Int,
-                  wantHighSpeed: Boolean, isRenderScript: Boolean): MutableMap<String, Boolean>
+                  wantHighSpeed: Boolean, isRenderScript: Boolean, isNativeCamera: Boolean = false):
+         MutableMap<String, Boolean>
    //----------------------------------------------------------------------
    {
       var results: MutableMap<String, Boolean> = mutableMapOf()
@@ -205,12 +218,14 @@ object MAR
                      StandardCamera(context, cameraId, COLOR_FORMAT, rs, (sortedCameras.size > 1))
                if (camera.open())
                {
+                  camera.isNativeAcquisition = isNativeCamera
                   cameras[cameraId] = camera
                   results[cameraId] = camera.initialize(queueSize, camera.isRearFacing)
                }
                else
                   results[cameraId] = false
             }
+            pairStereoCameras()
          }
       }
       catch (e: java.lang.Exception)
@@ -220,6 +235,21 @@ object MAR
       return results
    }
 
+   // Two rear cameras are joined natively as a stereo pair (see TBBGraphArchitecture), so their frames are submitted
+   // in pairs. The RenderScript frame handler and native acquisition still enqueue each camera's frames separately.
+   private fun pairStereoCameras()
+   //-----------------------------
+   {
+      val rear = cameras.values.filter { it.isRearFacing && (it.handle >= 0) && (! it.isNativeAcquisition) }
+      cameras.values.forEach { it.stereoBatch = null }
+      if (rear.size == 2)
+      {
+         val batch = StereoBatch(rear[0], rear[1], COLOR_FORMAT == ColorFormats.RGBA, false)
+         rear.forEach { it.stereoBatch = batch }
+         Log.i(TAG, "Cameras ${rear[0].cameraId} and ${rear[1].cameraId} submit frames as stereo pairs")
+      }
+   }
+
    private fun createRenderscript(context: Context,  isMultiCamera: Boolean): RenderScript?
    //--------------------------------------------------------------------------------------
    {
@@ -18,6 +18,7 @@ class RenderScriptFrameHandler(val renderscript: RenderScript, private val hardw
 //=====================================================================
 {
    private val cameraId: String = hardwareCamera.cameraId
+   private val cameraHandle: Int = hardwareCamera.handle
    val cameraWidth: Int = hardwareCamera.width
    val cameraHeight: Int = hardwareCamera.height
    private lateinit var rsYUVConvert: ScriptC_YUV2RGBA
@@ -102,7 +103,7 @@ class RenderScriptFrameHandler(val renderscript: RenderScript, private val hardw
       if (hardwareCamera.inFlight() > hardwareCamera.queueSize)
       {
          Log.w(TAG, "In flight max exceeded (" + hardwareCamera.inFlight() + ")")
-//         hardwareCamera.clearQueue(cameraId)
+//         hardwareCamera.clearQueue(cameraHandle)
          return;
       }
 //      Log.i(TAG, "onBufferAvailable: $cameraId ${allocation.toString()} ${allocYUVIn.toString()}")
@@ -157,7 +158,7 @@ class RenderScriptFrameHandler(val renderscript: RenderScript, private val hardw
             Log.e(TAG, "RenderScriptFrameHandler out of memory for camera id $cameraId  " +
                   " rear facing = ${hardwareCamera.isRearFacing} (${e.message}). " +
                   "Attempting to clear queue")
-            hardwareCamera.clearQueue(cameraId)
+            hardwareCamera.clearQueue(cameraHandle)
             return
          }
          allocRGBAOut.copyTo(rgbaData)
@@ -169,7 +170,7 @@ class RenderScriptFrameHandler(val renderscript: RenderScript, private val hardw
          }
 ////         if (DEBUG_SAVE_FRAME) saveCooked(allocRGBAOut, qitem.rgbaSize)
 //         Log.i(TAG, "Enqueue Time Java: thread ${Thread.currentThread().id} for camera $cameraId ${hardwareCamera.isRearFacing}: ${((ts - lastFrameTime)/1000000)}ms")
-         hardwareCamera.enqueue(cameraId, colorFormat==ColorFormats.RGBA, ts,
+         hardwareCamera.enqueue(cameraHandle, colorFormat==ColorFormats.RGBA, ts,
                                 rgbaSize, rgbaData, greySize, greyData)
 //         lastFrameTime = ts
       }
@@ -35,6 +35,8 @@ class StandardCamera(context: Context, id: String, colorFormat: ColorFormats,
    override fun startPreview(context: Context, size: Size, callback: CameraPreviewable): Boolean
    //-------------------------------------------------------------------------
    {
+      if (isNativeAcquisition)
+         return startNativePreview(size, callback)
       if (manager == null)
       {
          try
@@ -51,7 +53,7 @@ class StandardCamera(context: Context, id: String, colorFormat: ColorFormats,
       previewCallback = callback
       greySize = cameraWidth * cameraHeight
       rgbaSize = greySize * 4
-      setPreviewSize(id, cameraWidth, cameraHeight)
+      setPreviewSize(handle, cameraWidth, cameraHeight)
       isConfigured.set(false)
       var isLock = false
       stopping = false
@@ -121,7 +123,9 @@ class StandardCamera(context: Context, id: String, colorFormat: ColorFormats,
          }
          if (previewFrameHandler == null)
          {
-            cpuFrameHandler = CPUFrameHandler(context, this, inputFormat, colorFormat, false)
+            // A failed RenderScript handler falls back to the native kernels with the same numerics
+            cpuFrameHandler = CPUFrameHandler(context, this, inputFormat, colorFormat, false,
+                                              if (renderscript != null) YUVConversions.RENDERSCRIPT else yuvConversion)
             if (cpuFrameHandler?.good!!)
             {
                if (renderscript != null)
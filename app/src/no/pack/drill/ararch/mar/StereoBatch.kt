@@ -0,0 +1,83 @@
+package no.pack.drill.ararch.mar
+
+import android.media.Image
+import android.util.Log
+import java.nio.ByteBuffer
+
+/*
+Pairs the latest frames of the two cameras of a stereo pair and submits them with MAR.enqueueBatch, so the native
+stereo join only sees frames enqueued together (each camera otherwise enqueues on its own thread).
+ */
+class StereoBatch(private val camera1: HardwareCamera, private val camera2: HardwareCamera,
+                  private val isRGBA: Boolean, private val hasMono: Boolean)
+//==============================================================================
+{
+   // Per camera: registered buffers, the buffer last written and whether it is waiting for the other camera
+   private class Slot(val camera: HardwareCamera)
+   {
+      var buffers: Array<ByteBuffer>? = null
+      var written: Int = 1
+      var isPending: Boolean = false
+      var timestamp: Long = 0
+   }
+
+   private val slots = arrayOf(Slot(camera1), Slot(camera2))
+   private val handles = IntArray(2)
+   private val bufferNos = IntArray(2)
+   private val timestamps = LongArray(2)
+
+   // Called on the camera's thread. The image is copied, so it may be closed on return.
+   fun submit(camera: HardwareCamera, image: Image, timestamp: Long): Boolean
+   //-----------------------------------------------------------------------
+   {
+      val slot = if (camera === camera1) slots[0] else slots[1]
+      val w = image.width
+      val h = image.height
+      if (slot.buffers == null)
+      {
+         val buffers = Array(BUFFERS) { MAR.allocateBuffer(w*h + w*h/2) }
+         if (! camera.registerFrameBuffers(camera.handle, buffers))
+            return false
+         slot.buffers = buffers
+      }
+      // Only this camera's thread writes its buffers and a buffer being submitted is always the other one (the
+      // one last written), so the copy is made outside the lock
+      val next = 1 - slot.written
+      val planes = image.planes
+      if (! camera.writeFrameBuffer(camera.handle, next, planes[0].buffer, planes[1].buffer, planes[2].buffer,
+                                    planes[0].rowStride, planes[1].rowStride, planes[1].pixelStride, w, h))
+         return false
+      synchronized(this)
+      {
+         slot.written = next
+         slot.isPending = true
+         slot.timestamp = timestamp
+         val other = if (slot === slots[0]) slots[1] else slots[0]
+         if (! other.isPending)
+            return true
+         if (Math.abs(timestamp - other.timestamp) > MAX_SKEW_NS)
+         {  // Too far apart to be a pair, keep the newer frame waiting for its twin
+            other.isPending = false
+            return true
+         }
+         for (i in 0 until 2)
+         {
+            handles[i] = slots[i].camera.handle
+            bufferNos[i] = slots[i].written
+            timestamps[i] = slots[i].timestamp
+            slots[i].isPending = false
+         }
+         val enqueued = MAR.enqueueBatch(2, handles, bufferNos, timestamps, isRGBA, hasMono, true)
+         if (enqueued != 2)
+            Log.w(TAG, "Stereo pair of cameras ${camera1.cameraId} and ${camera2.cameraId} dropped")
+         return (enqueued == 2)
+      }
+   }
+
+   companion object
+   {
+      private val TAG = StereoBatch::class.java.simpleName
+      private const val BUFFERS = 2
+      private const val MAX_SKEW_NS = 20000000L
+   }
+}